@@ -268,12 +268,17 @@ Libs: -L\${libdir} -lfontconfig
 Cflags: -I\${includedir}
 EOF
 
-# Copy our patched ffplay.c over the original
+# Copy our patched ffplay.c over the original, with the units it links
 echo "=== Applying patched ffplay.c ==="
-cp $FFPLAY_DIR/ffplay.c $BUILD_DIR/fftools/ffplay.c
+cp $FFPLAY_DIR/ffplay.c $FFPLAY_DIR/ffplay_cenc.c $FFPLAY_DIR/ffplay_cenc.h \
+   $FFPLAY_DIR/ffplay_gov.c $FFPLAY_DIR/ffplay_gov.h $BUILD_DIR/fftools/
+grep -q ffplay_cenc.o $BUILD_DIR/fftools/Makefile || \
+    sed -i '/^define DOFFTOOL/i OBJS-ffplay += fftools/ffplay_cenc.o\n' $BUILD_DIR/fftools/Makefile
+grep -q ffplay_gov.o $BUILD_DIR/fftools/Makefile || \
+    sed -i '/^define DOFFTOOL/i OBJS-ffplay += fftools/ffplay_gov.o\n' $BUILD_DIR/fftools/Makefile
 
 # Configure (force reconfigure to pick up libass)
-if [ ! -f "$BUILD_DIR/config.h" ] || ! grep -q "CONFIG_LIBASS 1" "$BUILD_DIR/config.h" || ! grep -q "CONFIG_LIBXML2 1" "$BUILD_DIR/config.h"; then
+if [ ! -f "$BUILD_DIR/config.h" ] || ! grep -q "CONFIG_LIBASS 1" "$BUILD_DIR/config.h" || ! grep -q "CONFIG_LIBXML2 1" "$BUILD_DIR/config.h" || ! grep -q "CONFIG_MATROSKA_MUXER 1" "$BUILD_DIR/config.h"; then
     echo "=== Configuring FFmpeg (with libass + libxml2/DASH support) ==="
     make distclean 2>/dev/null || true
 
@@ -303,6 +308,7 @@ if [ ! -f "$BUILD_DIR/config.h" ] || ! grep -q "CONFIG_LIBASS 1" "$BUILD_DIR/con
         --disable-devices \
         --disable-encoders \
         --disable-muxers \
+        --enable-muxer=matroska \
         --enable-decoder=h264 \
         --enable-decoder=hevc \
         --enable-decoder=mpeg4 \
@@ -25,14 +25,33 @@
 
 #include "config.h"
 #include "config_components.h"
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE                     /* syscall(), ppoll() */
+#endif
 #include <inttypes.h>
 #include <math.h>
 #include <limits.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <linux/input.h>
+#if ARCH_AARCH64
+#include <arm_neon.h>
+#endif
 
 #include "libavutil/avstring.h"
 #include "libavutil/channel_layout.h"
+#include "libavutil/cpu.h"
+#include "libavutil/encryption_info.h"
 #include "libavutil/eval.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/pixdesc.h"
@@ -44,6 +63,8 @@
 #include "libavutil/time.h"
 #include "libavutil/bprint.h"
 #include "libavformat/avformat.h"
+#include "libavformat/avio_internal.h"
+#include "libavformat/http.h"
 #include "libavdevice/avdevice.h"
 #include "libswscale/swscale.h"
 #include "libavutil/opt.h"
@@ -60,11 +81,26 @@
 
 #include "cmdutils.h"
 #include "opt_common.h"
+#include "ffplay_cenc.h"
+#include "ffplay_gov.h"
 
 const char program_name[] = "ffplay";
 const int program_birth_year = 2003;
 
-#define MAX_QUEUE_SIZE (64 * 1024 * 1024)
+/* the packet queues together may use 1/BUFFER_MEM_SHARE of the memory the
+ * system reports available, within these bounds; re-read every second */
+#define BUFFER_BUDGET_MIN (8 * 1024 * 1024)
+#define BUFFER_BUDGET_MAX (64 * 1024 * 1024)
+#define BUFFER_MEM_SHARE 8
+#define BUFFER_BUDGET_INTERVAL 1000000
+#define BUFFER_HEALTHY 2.0      /* seconds queued for a green OSD readout */
+/* the read thread sleeps on full queues for 1/READ_WAIT_SHARE of what the
+ * shortest holds, within these bounds (us); the decoders also wake it when
+ * a queue runs empty */
+#define READ_WAIT_SHARE 8
+#define READ_WAIT_MIN 10000
+#define READ_WAIT_MAX 250000
+#define READ_WAIT_IDLE 100000   /* at the end of the input, or caught up with timeshift */
 #define MIN_FRAMES 25
 #define EXTERNAL_CLOCK_MIN_FRAMES 2
 #define EXTERNAL_CLOCK_MAX_FRAMES 10
@@ -73,6 +109,10 @@ const int program_birth_year = 2003;
 #define SDL_AUDIO_MIN_BUFFER_SIZE 512
 /* Calculate actual buffer size keeping in mind not cause too frequent audio callbacks */
 #define SDL_AUDIO_MAX_CALLBACKS_PER_SEC 30
+/* PCM ring between the audio fill thread and the SDL callback: at least this
+ * many device buffers, and room for this many frames */
+#define AUDIO_RING_BUFFERS 4
+#define AUDIO_RING_MARKS 64
 
 /* Step size for volume control in dB */
 #define SDL_VOLUME_STEP (0.75)
@@ -94,11 +134,42 @@ const int program_birth_year = 2003;
 #define EXTERNAL_CLOCK_SPEED_MAX  1.010
 #define EXTERNAL_CLOCK_SPEED_STEP 0.001
 
+/* low-latency live: the buffer low-water mark over a window is what can be
+ * played away without stalling (HLS and friends deliver in bursts) */
+#define LIVE_WINDOW         (10 * 1000000) /* microseconds */
+#define LIVE_CATCHUP_SPEED  1.05
+#define LIVE_CATCHUP_MARGIN 0.5            /* seconds above the target before speeding up */
+#define LIVE_JUMP_MARGIN    6.0            /* seconds above the target before skipping ahead */
+
+/* stall watchdog: a read blocked this long while the queues are nearly
+ * empty makes the input reconnect, with back-off between attempts */
+#define STALL_QUEUE_LOW     0.5            /* seconds */
+#define RECONNECT_MAX_TRIES 6
+#define RECONNECT_MAX_DELAY 8000           /* ms */
+
+/* how far ahead each kind of input is read */
+enum { BUFFER_LOCAL, BUFFER_VOD, BUFFER_LIVE };
+
+typedef struct BufferPolicy {
+    double min_duration;    /* reading pauses once every queue holds this much (0 = never) */
+    double max_duration;    /* no queue is filled beyond this */
+} BufferPolicy;
+
+static const BufferPolicy buffer_policies[] = {
+    [BUFFER_LOCAL] = {  1.0, 10.0 },    /* files and the timeshift ring: the card is fast */
+    [BUFFER_VOD]   = { 30.0, 60.0 },    /* ride out network hiccups */
+    [BUFFER_LIVE]  = {  0.0, 60.0 },    /* take what arrives, the sender does not wait */
+};
+
+/* each queue's share of the byte budget, in percent */
+static const int buffer_share[3] = { 80, 15, 5 };   /* video, audio, subtitles */
+
 /* we use about AUDIO_DIFF_AVG_NB A-V differences to make the average */
 #define AUDIO_DIFF_AVG_NB   20
 
-/* polls for possible required screen refresh at least this often, should be less than 1/fps */
+/* without input devices to wait on, polls SDL for events at least this often */
 #define REFRESH_RATE 0.01
+#define REFRESH_MAX_INPUTS 16
 
 /* NOTE: the size must be big enough to compensate the hardware audio buffersize size */
 /* TODO: We assume that a decoded and resampled frame fits into this buffer */
@@ -108,20 +179,43 @@ const int program_birth_year = 2003;
 
 #define USE_ONEPASS_SUBTITLE_RENDER 1
 
+/* The packet queues and the audio ring have one writer and one reader thread
+ * each and pass entries through atomic pointers and positions; a thread only
+ * sleeps, on a futex, when its queue is empty or full. The frame queues keep
+ * upstream's mutex and condition variable: their consumer runs at the frame
+ * rate, so one side nearly always waits, and there the futex measured slower
+ * (tests/queue_bench.c). */
+typedef struct QueueWait {
+    atomic_uint seq;                    /* futex word: wake count << 8 | sleepers */
+} QueueWait;
+
+#define QUEUE_WAITER  1u
+#define QUEUE_WAITERS 0xffu
+#define QUEUE_SEQ     0x100u
+#define QUEUE_SPIN    100               /* polls before sleeping, on SMP */
+
 typedef struct MyAVPacketList {
     AVPacket *pkt;
     int serial;
+    int size;                           /* what it adds to the queue totals */
+    int64_t duration;
+    atomic_int taken;                   /* by the reader, or dropped by a flush */
+    _Atomic(struct MyAVPacketList *) next;
 } MyAVPacketList;
 
+/* singly linked list: the reader moves head along, the writer appends after
+ * tail and reuses the nodes from first up to head */
 typedef struct PacketQueue {
-    AVFifo *pkt_list;
-    int nb_packets;
-    int size;
-    int64_t duration;
-    int abort_request;
+    _Atomic(MyAVPacketList *) head;     /* last node taken, its data is gone */
+    MyAVPacketList *tail;
+    MyAVPacketList *first;
+    MyAVPacketList *head_copy;          /* writer's last look at head */
+    atomic_int nb_packets;
+    atomic_int size;
+    _Atomic int64_t duration;
+    atomic_int abort_request;
     int serial;
-    SDL_mutex *mutex;
-    SDL_cond *cond;
+    QueueWait wait;
 } PacketQueue;
 
 #define VIDEO_PICTURE_QUEUE_SIZE 6
@@ -180,6 +274,28 @@ typedef struct FrameQueue {
     PacketQueue *pktq;
 } FrameQueue;
 
+/* where a frame ends in the audio ring, and its clock there */
+typedef struct AudioMark {
+    int64_t end;
+    double clock;
+    int serial;
+} AudioMark;
+
+/* Resampled PCM from the fill thread to the SDL callback. Positions only
+ * grow; each side writes its own and reads the other's. A frame's mark goes
+ * in before its samples, and the callback plays no further than both. */
+typedef struct AudioRing {
+    uint8_t *buf;
+    int size;                           /* a power of two */
+    _Atomic int64_t wpos, rpos;
+    AudioMark marks[AUDIO_RING_MARKS];
+    atomic_uint mark_w, mark_r;
+    atomic_int abort_request;
+    QueueWait wait;                     /* the fill thread, while the ring is full */
+    double clock;                       /* of the last mark the callback passed */
+    int clock_serial;
+} AudioRing;
+
 enum {
     AV_SYNC_AUDIO_MASTER, /* default choice */
     AV_SYNC_VIDEO_MASTER,
@@ -193,12 +309,14 @@ typedef struct Decoder {
     int pkt_serial;
     int finished;
     int packet_pending;
-    SDL_cond *empty_queue_cond;
+    QueueWait *empty_queue_wake;
     int64_t start_pts;
     AVRational start_pts_tb;
     int64_t next_pts;
     AVRational next_pts_tb;
     SDL_Thread *decoder_tid;
+    struct Cenc *cenc;                  /* decrypts the packets, NULL = clear stream */
+    struct FramePool *frame_pool;       /* video buffers, NULL = libavcodec's own */
 } Decoder;
 
 typedef struct VideoState {
@@ -244,10 +362,10 @@ typedef struct VideoState {
     int audio_hw_buf_size;
     uint8_t *audio_buf;
     uint8_t *audio_buf1;
-    unsigned int audio_buf_size; /* in bytes */
     unsigned int audio_buf1_size;
-    int audio_buf_index; /* in bytes */
-    int audio_write_buf_size;
+    AudioRing audio_ring;
+    SDL_Thread *audio_fill_tid;
+    int audio_write_buf_size;           /* in the ring at the last callback, in bytes */
     int audio_volume;
     int muted;
     struct AudioParams audio_src;
@@ -281,6 +399,9 @@ typedef struct VideoState {
     double frame_timer;
     double frame_last_returned_time;
     double frame_last_filter_delay;
+    int64_t filter_time;                /* microseconds spent in the filtergraph, */
+    int64_t upload_time;                /* and uploading textures, */
+    int nb_filtered, nb_uploaded;       /* over this many frames */
     int video_stream;
     AVStream *video_st;
     PacketQueue videoq;
@@ -301,7 +422,49 @@ typedef struct VideoState {
 
     int last_video_stream, last_audio_stream, last_subtitle_stream;
 
-    SDL_cond *continue_read_thread;
+    QueueWait continue_read_thread;     /* read thread sleeps, the others signal */
+
+    struct Timeshift *timeshift;        /* live input recorded to disk, NULL = off */
+    struct Recorder *recorder;          /* remuxing to a file, NULL = off */
+    int record_req;                     /* start/stop asked, done by the input thread */
+
+    /* low-latency live (-live_latency) */
+    double live_delay;                  /* smallest buffered seconds lately, NAN = unknown */
+    double live_min, live_min_prev;     /* buffer low-water marks of this and the last window */
+    int64_t live_window_start;
+    int live_catchup;                   /* audio played LIVE_CATCHUP_SPEED times faster */
+    int live_jump_req;                  /* drop the buffered input, done by the input thread */
+    int live_wait_key;                  /* after a jump: discard input up to a video keyframe */
+    int live_rewound;                   /* timeshift: paused or sought back, not caught up */
+
+    /* stall watchdog (-stall_timeout) */
+    int64_t read_wait_start;            /* input read in progress since, 0 = none */
+    int stalled;                        /* the watchdog interrupted the input */
+    int reconnecting;
+    int reconnects;                     /* successful reconnects, shown in the stats */
+    int reconnect_tries;                /* attempts since the last packet */
+    AVFormatContext **ic_retired;       /* replaced inputs, freed by stream_close() */
+    int nb_ic_retired;
+
+    int buffer_type;                    /* BUFFER_LOCAL / VOD / LIVE policy */
+    int64_t buffer_budget;              /* bytes all packet queues may hold */
+    int64_t buffer_budget_time;
+
+    /* HLS variant selection (-variant_select) */
+    struct Variant *variants;           /* usable variants by increasing bitrate, NULL = off */
+    int nb_variants;
+    int variant;                        /* the one being played */
+    int variant_next;                   /* switching to, -1 = none */
+    int64_t variant_switch_time;
+    int64_t variant_up_since;           /* throughput has allowed the next one up since */
+    int *stream_alias;                  /* input stream -> decoder stream, -1 = drop */
+    int nb_stream_alias;
+    int64_t alias_last_dts[2];          /* video, audio: last fed, AV_TIME_BASE */
+    int64_t bw_bytes, bw_time, bw_window_start;
+    double bandwidth;                   /* measured throughput in bit/s, 0 = unknown */
+
+    int cenc;                           /* ClearKey, decrypted by the decoders */
+    uint8_t cenc_key[16];
 } VideoState;
 
 /* options specified by the user */
@@ -338,6 +501,8 @@ static int exit_on_mousedown;
 static int loop = 1;
 static int framedrop = -1;
 static int infinite_buffer = -1;
+static float live_latency;               /* target buffer in seconds, 0 = off */
+static float stall_timeout;              /* seconds, 0 = no watchdog */
 static enum ShowMode show_mode = SHOW_MODE_NONE;
 static const char *audio_codec_name;
 static const char *subtitle_codec_name;
@@ -351,10 +516,26 @@ static char *afilters = NULL;
 static int autorotate = 1;
 static int find_stream_info = 1;
 static int filter_nbthreads = 0;
+static int cpu_placement = 1;
+static int cpu_governor = 1;
+static int direct_10bit = 1;
+static const char *sysfs_root = "/sys";
+static const char *cpu_limits_file;
 
 /* current context */
 static int is_full_screen;
 static int64_t audio_callback_time;
+static int queue_spin;                  /* QUEUE_SPIN, or 0 on one core */
+
+/* The refresh loop sleeps in ppoll() until its next deadline. Other threads
+ * wake it through an eventfd when there is something new to show, input
+ * through read-only copies of the evdev nodes SDL reads from. */
+static int refresh_fd = -1;
+static atomic_int refresh_sleeping;
+static int refresh_inputs[REFRESH_MAX_INPUTS];
+static int nb_refresh_inputs;
+static int64_t refresh_start, refresh_wakeups;
+static int64_t refresh_paused_time, refresh_paused_wakeups;
 
 #define FF_QUIT_EVENT    (SDL_USEREVENT + 2)
 
@@ -365,6 +546,7 @@ static SDL_AudioDeviceID audio_dev;
 
 /* Forward declaration for OSD */
 static double get_master_clock(VideoState *is);
+static double queued_duration(VideoState *is);
 
 /* OSD (on-screen display) state */
 static int osd_visible = 0;
@@ -389,6 +571,233 @@ static int64_t hat_last_seek_time = 0;
 #define HAT_REPEAT_DELAY_US  400000      /* initial delay before repeat */
 #define HAT_REPEAT_INTERVAL_US 150000    /* repeat interval */
 
+/* IPTV channel zapping (-channel_list): D-pad up/down switches channels
+ * in-process, while the neighbours of the current channel are opened and
+ * probed in the background so a zap only has to start the decoders. */
+typedef struct ZapChannel {
+    char *name;
+    char *url;
+    char *key;                           /* ClearKey, "" = none */
+    int dead;                            /* known unreachable: skipped when zapping */
+} ZapChannel;
+
+typedef struct ZapPrefetch {
+    int index;                           /* channel index, -1 = free */
+    SDL_Thread *thread;
+    AVFormatContext *ic;                 /* probed demuxer, NULL if open failed */
+    int abort_request;
+    SDL_atomic_t done;                   /* thread finished (ic/ready_time valid) */
+    SDL_atomic_t owned;                  /* handed to a read thread */
+    _Atomic(QueueWait *) waker;          /* signalled once done, by the thread */
+    int64_t ready_time;
+} ZapPrefetch;
+
+#define ZAP_PREFETCH_SLOTS 3             /* both neighbours + one being handed over */
+#define ZAP_PREFETCH_DELAY_US 1500000    /* let the current channel buffer first */
+#define ZAP_PREFETCH_MAX_AGE_US 20000000 /* live playlists move on; reopen older ones */
+
+static const char *zap_list_path;
+static int zap_index = -1;
+static ZapChannel *zap_channels;
+static int zap_count;
+static char zap_title[256];
+static ZapPrefetch zap_prefetch[ZAP_PREFETCH_SLOTS];
+static ZapPrefetch *zap_handoff;         /* slot for the next read thread */
+static int64_t zap_prefetch_due;
+
+static void zap_prefetch_release(ZapPrefetch *p);
+static void zap_save_position(void);
+
+/* HLS variants: the demuxer exposes each variant as an AVProgram and only
+ * downloads the ones with streams in use. One is enabled at a time and its
+ * streams are fed under the indices of the streams the decoders were opened
+ * with, so switching needs no decoder reopen. A switch enables the new
+ * variant next to the old one and takes over at its first keyframe past
+ * what was already fed: a segment or GOP boundary. */
+typedef struct Variant {
+    int program;                         /* index in ic->programs */
+    int64_t bitrate;                     /* advertised BANDWIDTH, bit/s */
+    int height;
+    int video, audio;                    /* stream indices, -1 = none */
+} Variant;
+
+#define VARIANT_WINDOW      (2 * 1000000)  /* throughput sample period */
+#define VARIANT_MAX_READ    (1 * 1000000)  /* reads blocked longer wait for content, not the network */
+#define VARIANT_UP_MARGIN   1.5            /* throughput over the next bitrate up to switch up */
+#define VARIANT_DOWN_MARGIN 1.1            /* throughput under the bitrate times this to switch down */
+#define VARIANT_UP_DELAY    (10 * 1000000) /* ... sustained this long */
+#define VARIANT_SETTLE      (10 * 1000000) /* no decision this soon after a switch */
+#define VARIANT_OVERLAP     (10 * 1000000) /* new variant packets this far behind are dropped */
+
+static int variant_select = 1;
+static int panel_height;                 /* output height, variants above are skipped */
+
+/* Segment prefetch (-prefetch_segments): the hls and dash demuxers open one
+ * segment at a time, so each boundary costs a request round trip. Their
+ * io_open is hooked: media playlists passing through are parsed, and when
+ * a segment is opened the next ones start downloading into memory on worker
+ * threads that keep their HTTP connection alive. A later open of a
+ * downloaded segment is served from memory. Segment names of a DASH template
+ * are predicted from the numbers in consecutive requests. */
+#define PREFETCH_MAX_WORKERS 4
+#define PREFETCH_LISTS 8                 /* media playlists followed at once */
+#define PREFETCH_PATTERNS 4
+#define PREFETCH_MAX_BYTES (16 * 1024 * 1024) /* not yet opened by the demuxer */
+#define PREFETCH_STALE (30 * 1000000)    /* never opened this long after download: dropped */
+#define PREFETCH_RETRIES 2               /* restarts of a broken download */
+#define PREFETCH_CHUNK (64 * 1024)
+
+enum { PREFETCH_QUEUED, PREFETCH_LOADING, PREFETCH_DONE, PREFETCH_FAILED };
+
+typedef struct PrefetchSegment {
+    char *url;
+    int list;                            /* playlist or pattern it was predicted from */
+    int state;
+    int error;                           /* AVERROR once FAILED */
+    int opened;                          /* handed to the demuxer */
+    int cancel;                          /* free once the worker lets go */
+    uint8_t *data;
+    size_t size, alloc;
+    int64_t done_time;
+    struct PrefetchSegment *next;
+} PrefetchSegment;
+
+typedef struct PrefetchList {
+    char *url;                           /* media playlist as requested */
+    char **segments;                     /* absolute segment URLs */
+    int nb_segments;
+    char *last;                          /* last segment the demuxer opened */
+} PrefetchList;
+
+typedef struct PrefetchPattern {
+    char *last;                          /* last unlisted segment URL */
+    int predicted;                       /* segments were queued after it */
+    int misses;                          /* opens that did not find them */
+} PrefetchPattern;
+
+typedef struct Prefetcher {
+    int (*io_open)(AVFormatContext *s, AVIOContext **pb, const char *url,
+                   int flags, AVDictionary **options);
+    int (*io_close2)(AVFormatContext *s, AVIOContext *pb);
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    SDL_Thread *workers[PREFETCH_MAX_WORKERS];
+    int nb_workers;
+    int abort;
+    AVIOInterruptCB icb;
+    AVDictionary *opts;                  /* request options the demuxer uses */
+    PrefetchSegment *segments;           /* in the order they were queued */
+    size_t bytes;
+    PrefetchList lists[PREFETCH_LISTS];
+    int next_list;
+    PrefetchPattern patterns[PREFETCH_PATTERNS];
+    int next_pattern;
+    int64_t bw_bytes, bw_time;           /* downloaded, and for how long some worker was */
+    int bw_active;                       /* workers inside a read */
+    int64_t bw_busy_since;
+} Prefetcher;
+
+/* the AVIOContext given to the demuxer for a segment or a playlist */
+typedef struct PrefetchReader {
+    Prefetcher *pf;
+    PrefetchSegment *seg;
+    size_t pos;
+    AVIOContext *src;                    /* playlist connection, for its options */
+    const AVIOInterruptCB *icb;
+} PrefetchReader;
+
+static int prefetch_segments;            /* segments ahead, 0 = off */
+static void input_close(AVFormatContext **ic);
+
+/* Live timeshift (-timeshift): a writer thread demuxes the live input into a
+ * ring file while read_thread feeds the decoders from that file, so pause,
+ * rewind and catch-up work on live TV and the packet queues stay small. */
+typedef struct TimeshiftKey {
+    int64_t offset;                      /* ring position of a keyframe record */
+    int64_t time;                        /* timeline, AV_TIME_BASE */
+} TimeshiftKey;
+
+/* on disk: record, payload, then side data as (type, size, data) entries */
+typedef struct TimeshiftRecord {
+    int32_t size;
+    int32_t side_data_size;
+    int32_t stream_index;
+    int32_t flags;
+    int64_t pts;
+    int64_t dts;
+    int64_t duration;
+    int64_t time;                        /* timeline when it was recorded */
+} TimeshiftRecord;
+
+typedef struct Timeshift {
+    int fd;
+    int64_t size;                        /* ring bytes */
+    int64_t window;                      /* longest rewind, AV_TIME_BASE */
+    SDL_Thread *thread;
+    SDL_mutex *mutex;
+    int abort_request;
+    int eof;                             /* input at EOF (may resume) */
+    int error;                           /* input failed, writer stopped */
+    int64_t write_pos;                   /* logical positions: only grow, */
+    int64_t read_pos;                    /* the file offset is pos % size */
+    int64_t reserve_pos;                 /* end of the record being written: what
+                                          * is below reserve_pos - size is gone */
+    TimeshiftKey *keys;                  /* keys[first_key..nb_keys-1], oldest first */
+    int first_key, nb_keys, max_keys;
+    int64_t live_time;                   /* timeline of the newest packet */
+    int64_t read_time;                   /* timeline of the last packet read */
+    int64_t last_dts;                    /* AV_TIME_BASE, AV_NOPTS_VALUE = none yet */
+} Timeshift;
+
+#define TIMESHIFT_MAX_GAP (10 * AV_TIME_BASE) /* larger dts jumps are discontinuities */
+
+static int timeshift_window;             /* seconds, 0 = off */
+static int timeshift_size_mb = 512;
+static const char *timeshift_file;
+
+#define TIMESHIFT_LIVE_SLACK 3.0         /* OSD says LIVE when this close (seconds) */
+
+static void timeshift_position(VideoState *is, double *behind, double *frac);
+static void timeshift_close(VideoState *is);
+
+/* Recording (-record_dir): compressed packets of the input are remuxed into
+ * Matroska as they arrive, no decoding involved. The muxer output is gathered
+ * into chunks that a separate thread writes at chunk-aligned offsets, so a
+ * slow SD card doesn't hold up demuxing. */
+#define RECORD_CHUNK_SIZE (1 << 20)
+#define RECORD_CHUNKS 4
+#define RECORD_IO_BUFFER (64 * 1024)
+#define RECORD_MAX_GAP (10 * AV_TIME_BASE) /* larger dts jumps are discontinuities */
+
+typedef struct Recorder {
+    AVFormatContext *oc;
+    AVPacket *pkt;
+    int *stream_map;                     /* input stream -> output stream, -1 = not recorded */
+    int nb_stream_map;
+    int64_t *last_dts;                   /* per output stream, AV_TIME_BASE */
+    int started;                         /* first video keyframe seen */
+    int64_t offset;                      /* subtracted from input timestamps, AV_TIME_BASE */
+    char path[1024];
+    char tmp_path[1024];                 /* hidden from the browser until finished */
+
+    int fd;
+    SDL_Thread *io_thread;
+    SDL_mutex *mutex;
+    SDL_cond *cond;
+    uint8_t *chunks[RECORD_CHUNKS];
+    int64_t chunk_pos[RECORD_CHUNKS];
+    int chunk_len[RECORD_CHUNKS];
+    int queue_head, queue_count;         /* chunks waiting for the io thread */
+    int fill;                            /* chunk being filled (not queued) */
+    int64_t pos, size;                   /* muxer position, file size */
+    int io_error;
+    int io_stop;
+    struct Cenc *cenc;                   /* recordings are saved decrypted */
+} Recorder;
+
+static const char *record_dir;
+static void record_stop(VideoState *is);
+
 static void osd_show(void) {
     osd_visible = 1;
     osd_last_activity = av_gettime_relative();
@@ -418,6 +827,15 @@ static const unsigned char font_5x7[][7] = {
     /* D (19) */ {0x1C,0x12,0x11,0x11,0x11,0x12,0x1C},
     /* T (20) */ {0x1F,0x04,0x04,0x04,0x04,0x04,0x04},
     /* O (21) */ {0x0E,0x11,0x11,0x11,0x11,0x11,0x0E},
+    /* L (22) */ {0x10,0x10,0x10,0x10,0x10,0x10,0x1F},
+    /* I (23) */ {0x0E,0x04,0x04,0x04,0x04,0x04,0x0E},
+    /* V (24) */ {0x11,0x11,0x11,0x11,0x11,0x0A,0x04},
+    /* R (25) */ {0x1E,0x11,0x11,0x1E,0x14,0x12,0x11},
+    /* C (26) */ {0x0E,0x11,0x10,0x10,0x10,0x11,0x0E},
+    /* . (27) */ {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C},
+    /* B (28) */ {0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E},
+    /* F (29) */ {0x1F,0x10,0x10,0x1E,0x10,0x10,0x10},
+    /* % (30) */ {0x18,0x19,0x02,0x04,0x08,0x13,0x03},
 };
 
 static int font_char_index(char c) {
@@ -434,55 +852,173 @@ static int font_char_index(char c) {
     if (c == 'D') return 19;
     if (c == 'T') return 20;
     if (c == 'O') return 21;
+    if (c == 'L') return 22;
+    if (c == 'I') return 23;
+    if (c == 'V') return 24;
+    if (c == 'R') return 25;
+    if (c == 'C') return 26;
+    if (c == '.') return 27;
+    if (c == 'B') return 28;
+    if (c == 'F') return 29;
+    if (c == '%') return 30;
     return 12; /* space for unknown */
 }
 
-static void osd_draw_text(int x, int y, const char *text, int scale,
-                          int r, int g, int b, int a) {
-    SDL_SetRenderDrawColor(renderer, r, g, b, a);
-    while (*text) {
-        int idx = font_char_index(*text);
-        int row, col;
-        for (row = 0; row < 7; row++) {
-            unsigned char bits = font_5x7[idx][row];
-            for (col = 0; col < 5; col++) {
-                if (bits & (0x10 >> col)) {
-                    SDL_Rect px = { x + col * scale, y + row * scale,
-                                    scale, scale };
-                    SDL_RenderFillRect(renderer, &px);
-                }
-            }
+/* Both OSD fonts are baked once into an atlas texture, white on transparent,
+ * and a string is drawn as one batch of textured quads tinted by vertex
+ * color, instead of a filled rectangle per lit pixel. */
+#define OSD_SMALL_CELL_W 6                /* 5x7 glyph and a transparent pad, */
+#define OSD_SMALL_CELL_H 8                /* so scaled glyphs don't bleed */
+#define OSD_VGA_CELL_W 9                  /* 8x16, 32 glyphs per row below the small font */
+#define OSD_VGA_CELL_H 17
+#define OSD_ATLAS_W (32 * OSD_VGA_CELL_W)
+#define OSD_ATLAS_H (OSD_SMALL_CELL_H + 8 * OSD_VGA_CELL_H)
+#define OSD_MAX_GLYPHS 128                /* per string */
+
+static SDL_Texture *osd_atlas;
+
+static SDL_Texture *osd_atlas_get(void)
+{
+    static uint32_t pixels[OSD_ATLAS_H][OSD_ATLAS_W];
+    int i, row, col, x, y;
+
+    if (osd_atlas)
+        return osd_atlas;
+    for (y = 0; y < OSD_ATLAS_H; y++)
+        for (x = 0; x < OSD_ATLAS_W; x++)
+            pixels[y][x] = 0x00FFFFFF;
+    for (i = 0; i < FF_ARRAY_ELEMS(font_5x7); i++)
+        for (row = 0; row < 7; row++)
+            for (col = 0; col < 5; col++)
+                if (font_5x7[i][row] & (0x10 >> col))
+                    pixels[row][i * OSD_SMALL_CELL_W + col] = 0xFFFFFFFF;
+    for (i = 0; i < 256; i++) {
+        x = i % 32 * OSD_VGA_CELL_W;
+        y = OSD_SMALL_CELL_H + i / 32 * OSD_VGA_CELL_H;
+        for (row = 0; row < 16; row++)
+            for (col = 0; col < 8; col++)
+                if (avpriv_vga16_font[i * 16 + row] & (0x80 >> col))
+                    pixels[y + row][x + col] = 0xFFFFFFFF;
+    }
+    osd_atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                                  OSD_ATLAS_W, OSD_ATLAS_H);
+    if (!osd_atlas)
+        return NULL;
+    if (SDL_UpdateTexture(osd_atlas, NULL, pixels, sizeof(pixels[0])) < 0) {
+        SDL_DestroyTexture(osd_atlas);
+        return osd_atlas = NULL;
+    }
+    SDL_SetTextureBlendMode(osd_atlas, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(osd_atlas, SDL_ScaleModeNearest);
+    return osd_atlas;
+}
+
+/* one quad per visible glyph, in the 8x16 font if vga; stops before max_w
+ * (if > 0) is exceeded */
+static void osd_draw_glyphs(int x, int y, const char *text, int vga, int scale,
+                            int r, int g, int b, int a, int max_w)
+{
+    SDL_Vertex vert[4 * OSD_MAX_GLYPHS];
+    int index[6 * OSD_MAX_GLYPHS];
+    static const int quad[6] = { 0, 1, 2, 2, 1, 3 };
+    SDL_Color color = { r, g, b, a };
+    SDL_Texture *atlas = osd_atlas_get();
+    int gw = vga ? 8 : 5, gh = vga ? 16 : 7, advance = vga ? 8 : 6;
+    int start_x = x, n = 0, i, j, sx, sy;
+
+    if (!atlas)
+        return;
+    for (; *text && n < OSD_MAX_GLYPHS; text++, x += advance * scale) {
+        unsigned char c = *text;
+
+        if (max_w > 0 && x - start_x + advance * scale > max_w)
+            break;
+        if (c == ' ')
+            continue;
+        if (vga) {
+            sx = c % 32 * OSD_VGA_CELL_W;
+            sy = OSD_SMALL_CELL_H + c / 32 * OSD_VGA_CELL_H;
+        } else {
+            sx = font_char_index(c) * OSD_SMALL_CELL_W;
+            sy = 0;
+        }
+        for (i = 0; i < 4; i++) {
+            SDL_Vertex *v = &vert[4 * n + i];
+            v->position.x  = x + (i & 1) * gw * scale;
+            v->position.y  = y + (i >> 1) * gh * scale;
+            v->color       = color;
+            v->tex_coord.x = (float)(sx + (i & 1) * gw) / OSD_ATLAS_W;
+            v->tex_coord.y = (float)(sy + (i >> 1) * gh) / OSD_ATLAS_H;
         }
-        x += 6 * scale; /* 5 pixels + 1 gap */
-        text++;
+        for (j = 0; j < 6; j++)
+            index[6 * n + j] = 4 * n + quad[j];
+        n++;
     }
+    if (n)
+        SDL_RenderGeometry(renderer, atlas, vert, 4 * n, index, 6 * n);
+}
+
+static void osd_draw_text(int x, int y, const char *text, int scale,
+                          int r, int g, int b, int a) {
+    osd_draw_glyphs(x, y, text, 0, scale, r, g, b, a, 0);
 }
 
 /* Draw text using FFmpeg's built-in VGA 8x16 font (full ASCII support) */
 static void osd_draw_vga_text(int x, int y, const char *text, int scale,
                               int r, int g, int b, int a, int max_w) {
-    int start_x = x;
-    SDL_SetRenderDrawColor(renderer, r, g, b, a);
-    while (*text) {
-        unsigned char c = (unsigned char)*text;
-        const uint8_t *glyph = &avpriv_vga16_font[c * 16];
-        int row, col;
-        /* Stop if we'd exceed max width */
-        if (max_w > 0 && (x - start_x + 8 * scale) > max_w)
-            break;
-        for (row = 0; row < 16; row++) {
-            uint8_t bits = glyph[row];
-            for (col = 0; col < 8; col++) {
-                if (bits & (0x80 >> col)) {
-                    SDL_Rect px = { x + col * scale, y + row * scale,
-                                    scale, scale };
-                    SDL_RenderFillRect(renderer, &px);
-                }
-            }
+    osd_draw_glyphs(x, y, text, 1, scale, r, g, b, a, max_w);
+}
+
+/* The title bar only changes with the title or the window width: it is kept
+ * in a texture and redrawn into it only then. */
+static SDL_Texture *osd_title_tex;
+static char osd_title_text[300];
+static int osd_title_w;
+
+/* the renderer lost its textures' contents, or the textures themselves */
+static void osd_reset_textures(void)
+{
+    if (osd_atlas)
+        SDL_DestroyTexture(osd_atlas);
+    if (osd_title_tex)
+        SDL_DestroyTexture(osd_title_tex);
+    osd_atlas = osd_title_tex = NULL;
+    osd_title_w = 0;
+}
+
+static void osd_draw_title_bar(const char *title, int w)
+{
+    SDL_Rect tbg = { 0, 0, w, OSD_TITLE_HEIGHT };
+
+    if (osd_title_w != w || strcmp(osd_title_text, title)) {
+        if (osd_title_tex && osd_title_w != w) {
+            SDL_DestroyTexture(osd_title_tex);
+            osd_title_tex = NULL;
+        }
+        if (!osd_title_tex && SDL_RenderTargetSupported(renderer) &&
+            (osd_title_tex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                               w, OSD_TITLE_HEIGHT)))
+            SDL_SetTextureBlendMode(osd_title_tex, SDL_BLENDMODE_BLEND);
+        if (!osd_title_tex || SDL_SetRenderTarget(renderer, osd_title_tex) < 0) {
+            /* no render targets: draw it every time */
+            SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+            SDL_RenderFillRect(renderer, &tbg);
+            osd_draw_vga_text(OSD_MARGIN, OSD_TITLE_Y_OFFSET, title,
+                              OSD_TITLE_SCALE, 255, 255, 255, 230, w - 2 * OSD_MARGIN);
+            return;
         }
-        x += 8 * scale; /* 8 pixels wide, no extra gap needed */
-        text++;
+        /* the translucent background goes in as is, the text over it */
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
+        SDL_RenderClear(renderer);
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        osd_draw_vga_text(OSD_MARGIN, OSD_TITLE_Y_OFFSET, title,
+                          OSD_TITLE_SCALE, 255, 255, 255, 230, w - 2 * OSD_MARGIN);
+        SDL_SetRenderTarget(renderer, NULL);
+        av_strlcpy(osd_title_text, title, sizeof(osd_title_text));
+        osd_title_w = w;
     }
+    SDL_RenderCopy(renderer, osd_title_tex, NULL, &tbg);
 }
 
 /* Extract display title from file path: strip directory and extension */
@@ -514,14 +1050,35 @@ static void format_time(char *buf, int bufsize, double secs) {
         snprintf(buf, bufsize, "%d:%02d", m, s);
 }
 
+static void osd_live_text(VideoState *is, char *buf, size_t size)
+{
+    if (live_latency > 0 && !isnan(is->live_delay))
+        snprintf(buf, size, "LIVE %.1fS", is->live_delay);
+    else
+        snprintf(buf, size, "LIVE");
+}
+
 static void osd_draw(VideoState *is) {
     double pos, dur, frac;
     int w, h, bar_x, bar_w, bar_y, fill_w, text_scale;
     int dot_x, dot_r;
     char time_cur[32], time_dur[32], time_str[80];
 
-    /* Keep OSD visible while paused; otherwise auto-hide after timeout */
-    if (is->paused) {
+    w = 0; h = 0;
+    SDL_GetRendererOutputSize(renderer, &w, &h);
+
+    /* Recording marker: stays up when the rest of the OSD hides */
+    if (is->recorder && w > 0) {
+        int rec_w = 3 * 6 * 3;
+        SDL_Rect dot = { w - OSD_MARGIN - rec_w - 28, OSD_TITLE_HEIGHT + 16, 20, 20 };
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+        SDL_SetRenderDrawColor(renderer, 230, 40, 40, 230);
+        SDL_RenderFillRect(renderer, &dot);
+        osd_draw_text(w - OSD_MARGIN - rec_w, OSD_TITLE_HEIGHT + 16, "REC", 3, 230, 40, 40, 230);
+    }
+
+    /* Keep OSD visible while paused or reconnecting; otherwise auto-hide after timeout */
+    if (is->paused || is->reconnecting) {
         osd_visible = 1;
     } else if (!osd_visible) {
         return;
@@ -530,15 +1087,6 @@ static void osd_draw(VideoState *is) {
         return;
     }
 
-    pos = get_master_clock(is);
-    dur = 0;
-    if (is->ic && is->ic->duration > 0)
-        dur = (double)is->ic->duration / AV_TIME_BASE;
-
-    if (isnan(pos)) return;
-
-    w = 0; h = 0;
-    SDL_GetRendererOutputSize(renderer, &w, &h);
     if (w <= 0 || h <= 0) return;
 
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
@@ -546,18 +1094,23 @@ static void osd_draw(VideoState *is) {
     /* Title bar (top) */
     {
         char title[256];
-        SDL_Rect tbg = { 0, 0, w, OSD_TITLE_HEIGHT };
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 180);
-        SDL_RenderFillRect(renderer, &tbg);
         if (window_title && window_title != input_filename)
             snprintf(title, sizeof(title), "%s", window_title);
         else
             osd_get_title(input_filename, title, sizeof(title));
-        osd_draw_vga_text(OSD_MARGIN, OSD_TITLE_Y_OFFSET, title,
-                          OSD_TITLE_SCALE, 255, 255, 255, 230,
-                          w - 2 * OSD_MARGIN);
+        if (is->reconnecting)
+            av_strlcat(title, " - reconnecting...", sizeof(title));
+        osd_draw_title_bar(title, w);
     }
 
+    /* Title only until the clock runs (e.g. while a channel is opening) */
+    pos = get_master_clock(is);
+    dur = 0;
+    if (is->ic && is->ic->duration > 0)
+        dur = (double)is->ic->duration / AV_TIME_BASE;
+
+    if (isnan(pos)) return;
+
     /* Bottom bar background */
     {
         SDL_Rect bg = { 0, h - OSD_BG_HEIGHT, w, OSD_BG_HEIGHT };
@@ -565,10 +1118,25 @@ static void osd_draw(VideoState *is) {
         SDL_RenderFillRect(renderer, &bg);
     }
 
-    /* Time text: "0:23 / 3:45" or "0:23" if no duration */
+    /* Time text: "0:23 / 3:45" or "0:23" if no duration; with timeshift
+     * "LIVE" or how far behind live, and the bar spans the recorded window.
+     * In low-latency mode "LIVE" carries the measured latency ("LIVE 2.4S") */
     text_scale = 4;
+    frac = -1;
     format_time(time_cur, sizeof(time_cur), pos);
-    if (dur > 0) {
+    if (is->timeshift) {
+        double behind;
+        timeshift_position(is, &behind, &frac);
+        if (behind < TIMESHIFT_LIVE_SLACK) {
+            osd_live_text(is, time_str, sizeof(time_str));
+        } else {
+            format_time(time_cur, sizeof(time_cur), behind);
+            snprintf(time_str, sizeof(time_str), "-%s", time_cur);
+        }
+    } else if (live_latency > 0 && dur <= 0) {
+        osd_live_text(is, time_str, sizeof(time_str));
+    } else if (dur > 0) {
+        frac = pos / dur;
         format_time(time_dur, sizeof(time_dur), dur);
         snprintf(time_str, sizeof(time_str), "%s / %s", time_cur, time_dur);
     } else {
@@ -585,6 +1153,20 @@ static void osd_draw(VideoState *is) {
         osd_draw_text(w - OSD_MARGIN - pause_text_w,
                       h - OSD_BG_HEIGHT + OSD_TEXT_Y_OFFSET,
                       "PAUSED", text_scale, 255, 200, 0, 230);
+    } else if (is->buffer_budget > 0) {
+        /* Buffer health: seconds queued and share of the memory budget in use */
+        char buf_str[32];
+        double ahead = queued_duration(is);
+        int64_t used = (is->audioq.size + is->videoq.size + is->subtitleq.size) * 100 / is->buffer_budget;
+        int len = snprintf(buf_str, sizeof(buf_str), "BUF %.1fS %d%%", ahead, (int)FFMIN(used, 100));
+        int r = 80, g = 220, b = 80;                    /* green: healthy */
+        if (ahead < STALL_QUEUE_LOW) {
+            r = 230; g = 40; b = 40;                    /* red: about to stall */
+        } else if (ahead < BUFFER_HEALTHY) {
+            r = 255; g = 200; b = 0;                    /* amber */
+        }
+        osd_draw_text(w - OSD_MARGIN - len * 6 * 3,
+                      h - OSD_BG_HEIGHT + OSD_TEXT_Y_OFFSET + 4, buf_str, 3, r, g, b, 230);
     }
 
 
@@ -600,9 +1182,16 @@ static void osd_draw(VideoState *is) {
         SDL_RenderFillRect(renderer, &track);
     }
 
+    /* Buffered ahead of the playhead */
+    if (frac >= 0 && dur > 0 && !is->timeshift) {
+        double ahead = av_clipd((pos + queued_duration(is)) / dur, 0, 1);
+        SDL_Rect ahead_rect = { bar_x, bar_y, (int)(bar_w * ahead), OSD_BAR_HEIGHT };
+        SDL_SetRenderDrawColor(renderer, 150, 150, 150, 200);
+        SDL_RenderFillRect(renderer, &ahead_rect);
+    }
+
     /* Fill */
-    if (dur > 0) {
-        frac = pos / dur;
+    if (frac >= 0) {
         if (frac < 0) frac = 0;
         if (frac > 1) frac = 1;
         fill_w = (int)(bar_w * frac);
@@ -645,6 +1234,8 @@ static const struct TextureFormatEntry {
     { AV_PIX_FMT_BGR32,          SDL_PIXELFORMAT_ABGR8888 },
     { AV_PIX_FMT_BGR32_1,        SDL_PIXELFORMAT_BGRA8888 },
     { AV_PIX_FMT_YUV420P,        SDL_PIXELFORMAT_IYUV },
+    { AV_PIX_FMT_YUV420P10,      SDL_PIXELFORMAT_IYUV },   /* converted by upload_texture() */
+    { AV_PIX_FMT_P010,           SDL_PIXELFORMAT_IYUV },
     { AV_PIX_FMT_YUYV422,        SDL_PIXELFORMAT_YUY2 },
     { AV_PIX_FMT_UYVY422,        SDL_PIXELFORMAT_UYVY },
     { AV_PIX_FMT_NONE,           SDL_PIXELFORMAT_UNKNOWN },
@@ -671,49 +1262,197 @@ int cmp_audio_fmts(enum AVSampleFormat fmt1, int64_t channel_count1,
         return channel_count1 != channel_count2 || fmt1 != fmt2;
 }
 
-static int packet_queue_put_private(PacketQueue *q, AVPacket *pkt)
+static inline void queue_cpu_relax(void)
 {
-    MyAVPacketList pkt1;
-    int ret;
+#if ARCH_AARCH64
+    __asm__ volatile("yield");
+#elif ARCH_X86
+    __asm__ volatile("pause");
+#endif
+}
 
-    if (q->abort_request)
-       return -1;
+/* register as a sleeper, then recheck the queue */
+static unsigned queue_wait_begin(QueueWait *w)
+{
+    unsigned seq = atomic_fetch_add(&w->seq, QUEUE_WAITER) + QUEUE_WAITER;
+    atomic_thread_fence(memory_order_seq_cst);
+    return seq;
+}
 
+/* drop a registration no wake has cleared yet */
+static void queue_unregister(QueueWait *w, unsigned seq)
+{
+    unsigned cur = atomic_load_explicit(&w->seq, memory_order_relaxed);
 
-    pkt1.pkt = pkt;
-    pkt1.serial = q->serial;
+    while ((cur & ~QUEUE_WAITERS) == (seq & ~QUEUE_WAITERS) && (cur & QUEUE_WAITERS) &&
+           !atomic_compare_exchange_weak(&w->seq, &cur, cur - QUEUE_WAITER))
+        ;
+}
 
-    ret = av_fifo_write(q->pkt_list, &pkt1, 1);
-    if (ret < 0)
-        return ret;
-    q->nb_packets++;
-    q->size += pkt1.pkt->size + sizeof(pkt1);
-    q->duration += pkt1.pkt->duration;
-    /* XXX: should duplicate packet data in DV case */
-    SDL_CondSignal(q->cond);
-    return 0;
+/* sleep if the recheck says so; returns at once if woken since the begin.
+ * Either way the registration goes, or the next wake would pay a syscall
+ * for nobody. */
+static void queue_wait_end(QueueWait *w, unsigned seq, int sleep)
+{
+    if (sleep)
+        syscall(SYS_futex, &w->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+    queue_unregister(w, seq);
 }
 
-static int packet_queue_put(PacketQueue *q, AVPacket *pkt)
+/* Wait while busy holds: poll a little first, as on SMP the other side is
+ * often a few hundred cycles from publishing, then sleep. The caller loops,
+ * since a wake only means the state changed. */
+#define QUEUE_WAIT_WHILE(w, busy) do {                                          \
+        unsigned queue_seq_;                                                    \
+        int queue_spin_;                                                        \
+        for (queue_spin_ = 0; queue_spin_ < queue_spin && (busy); queue_spin_++) \
+            queue_cpu_relax();                                                  \
+        if (!(busy))                                                            \
+            break;                                                              \
+        queue_seq_ = queue_wait_begin(w);                                       \
+        queue_wait_end(w, queue_seq_, (busy));                                  \
+    } while (0)
+
+/* Call after publishing: whoever registered before is woken, whoever
+ * registers later sees the new state. No syscall while no one sleeps, and
+ * one per sleep, as the waker clears the registrations. */
+static void queue_wake(QueueWait *w)
 {
-    AVPacket *pkt1;
-    int ret;
+    unsigned cur;
 
-    pkt1 = av_packet_alloc();
-    if (!pkt1) {
-        av_packet_unref(pkt);
-        return -1;
+    atomic_thread_fence(memory_order_seq_cst);
+    cur = atomic_load_explicit(&w->seq, memory_order_relaxed);
+    while (cur & QUEUE_WAITERS) {
+        if (atomic_compare_exchange_weak(&w->seq, &cur, (cur & ~QUEUE_WAITERS) + QUEUE_SEQ)) {
+            syscall(SYS_futex, &w->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+            break;
+        }
     }
-    av_packet_move_ref(pkt1, pkt);
+}
+
+/* For a sleeper that waits for requests rather than queue state: it reads
+ * seq before looking at its flags, and any signal after that makes
+ * queue_wait_timeout() return at once. */
+static void queue_signal(QueueWait *w)
+{
+    atomic_fetch_add(&w->seq, QUEUE_SEQ);
+    queue_wake(w);
+}
 
-    SDL_LockMutex(q->mutex);
-    ret = packet_queue_put_private(q, pkt1);
-    SDL_UnlockMutex(q->mutex);
+/* sleep until signalled since seq was read, or for timeout_us (< 0: no limit) */
+static void queue_wait_timeout(QueueWait *w, unsigned seq, int64_t timeout_us)
+{
+    struct timespec ts = { timeout_us / 1000000, timeout_us % 1000000 * 1000 };
+    unsigned cur = queue_wait_begin(w);
 
-    if (ret < 0)
-        av_packet_free(&pkt1);
+    if ((cur & ~QUEUE_WAITERS) == (seq & ~QUEUE_WAITERS))
+        syscall(SYS_futex, &w->seq, FUTEX_WAIT_PRIVATE, cur, timeout_us < 0 ? NULL : &ts, NULL, 0);
+    queue_unregister(w, cur);
+}
 
-    return ret;
+/* Call after publishing something for the refresh loop to show. Like
+ * queue_wake(): costs a syscall only if the loop is asleep. */
+static void refresh_wake(void)
+{
+    static const uint64_t one = 1;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&refresh_sleeping, memory_order_relaxed) &&
+        atomic_exchange(&refresh_sleeping, 0) &&
+        write(refresh_fd, &one, sizeof(one)) < 0)
+        av_log(NULL, AV_LOG_DEBUG, "refresh: wake failed: %s\n", av_err2str(AVERROR(errno)));
+}
+
+static void refresh_init(void)
+{
+    char path[32];
+    int i;
+
+    refresh_start = av_gettime_relative();
+    refresh_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (refresh_fd < 0)
+        av_log(NULL, AV_LOG_WARNING, "refresh: eventfd: %s\n", av_err2str(AVERROR(errno)));
+    /* only a wake-up hint: SDL still reads the events through its own fds */
+    for (i = 0; i < REFRESH_MAX_INPUTS; i++) {
+        int fd;
+
+        snprintf(path, sizeof(path), "/dev/input/event%d", i);
+        if ((fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) >= 0)
+            refresh_inputs[nb_refresh_inputs++] = fd;
+    }
+    if (!nb_refresh_inputs)
+        av_log(NULL, AV_LOG_VERBOSE, "refresh: no input devices, polling SDL every %.0f ms\n",
+               REFRESH_RATE * 1000);
+}
+
+static void refresh_uninit(void)
+{
+    double elapsed = (av_gettime_relative() - refresh_start) / 1000000.0;
+    double paused = refresh_paused_time / 1000000.0;
+    int i;
+
+    if (refresh_start)
+        av_log(NULL, AV_LOG_INFO,
+               "refresh: %"PRId64" wakeups in %.1fs (%.1f/s), %"PRId64" of them in %.1fs paused (%.1f/s)\n",
+               refresh_wakeups, elapsed, elapsed > 0 ? refresh_wakeups / elapsed : 0,
+               refresh_paused_wakeups, paused, paused > 0 ? refresh_paused_wakeups / paused : 0);
+    for (i = 0; i < nb_refresh_inputs; i++)
+        close(refresh_inputs[i]);
+    nb_refresh_inputs = 0;
+    if (refresh_fd >= 0)
+        close(refresh_fd);
+    refresh_fd = -1;
+}
+
+static MyAVPacketList *packet_queue_node(PacketQueue *q)
+{
+    MyAVPacketList *n;
+
+    if (q->first == q->head_copy)
+        q->head_copy = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (q->first != q->head_copy) {
+        n = q->first;
+        q->first = atomic_load_explicit(&n->next, memory_order_relaxed);
+    } else {
+        if (!(n = av_mallocz(sizeof(*n))))
+            return NULL;
+        if (!(n->pkt = av_packet_alloc())) {
+            av_free(n);
+            return NULL;
+        }
+    }
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&n->taken, 0, memory_order_relaxed);
+    return n;
+}
+
+/* counted out once, by whoever takes the packet first */
+static void packet_queue_uncount(PacketQueue *q, MyAVPacketList *n)
+{
+    q->nb_packets--;
+    q->size -= n->size;
+    q->duration -= n->duration;
+}
+
+static int packet_queue_put(PacketQueue *q, AVPacket *pkt)
+{
+    MyAVPacketList *n;
+
+    if (q->abort_request || !(n = packet_queue_node(q))) {
+        av_packet_unref(pkt);
+        return -1;
+    }
+    av_packet_move_ref(n->pkt, pkt);
+    n->serial = q->serial;
+    n->size = n->pkt->size + sizeof(*n);
+    n->duration = n->pkt->duration;
+    q->nb_packets++;
+    q->size += n->size;
+    q->duration += n->duration;
+    atomic_store_explicit(&q->tail->next, n, memory_order_release);
+    q->tail = n;
+    queue_wake(&q->wait);
+    return 0;
 }
 
 static int packet_queue_put_nullpacket(PacketQueue *q, AVPacket *pkt, int stream_index)
@@ -725,161 +1464,558 @@ static int packet_queue_put_nullpacket(PacketQueue *q, AVPacket *pkt, int stream
 /* packet queue handling */
 static int packet_queue_init(PacketQueue *q)
 {
+    MyAVPacketList *n;
+
     memset(q, 0, sizeof(PacketQueue));
-    q->pkt_list = av_fifo_alloc2(1, sizeof(MyAVPacketList), AV_FIFO_FLAG_AUTO_GROW);
-    if (!q->pkt_list)
-        return AVERROR(ENOMEM);
-    q->mutex = SDL_CreateMutex();
-    if (!q->mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    q->cond = SDL_CreateCond();
-    if (!q->cond) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+    if (!(n = av_mallocz(sizeof(*n))) || !(n->pkt = av_packet_alloc())) {
+        av_free(n);
         return AVERROR(ENOMEM);
     }
+    atomic_init(&q->head, n);
+    q->tail = q->first = q->head_copy = n;
     q->abort_request = 1;
     return 0;
 }
 
+/* Runs on the writer thread, or while the reader is stopped: either way the
+ * nodes after head are not reused meanwhile. */
 static void packet_queue_flush(PacketQueue *q)
 {
-    MyAVPacketList pkt1;
+    MyAVPacketList *n = atomic_load_explicit(&q->head, memory_order_acquire);
 
-    SDL_LockMutex(q->mutex);
-    while (av_fifo_read(q->pkt_list, &pkt1, 1) >= 0)
-        av_packet_free(&pkt1.pkt);
-    q->nb_packets = 0;
-    q->size = 0;
-    q->duration = 0;
+    while ((n = atomic_load_explicit(&n->next, memory_order_acquire))) {
+        if (!atomic_exchange(&n->taken, 1)) {
+            packet_queue_uncount(q, n);
+            av_packet_unref(n->pkt);
+        }
+    }
     q->serial++;
-    SDL_UnlockMutex(q->mutex);
 }
 
 static void packet_queue_destroy(PacketQueue *q)
 {
-    packet_queue_flush(q);
-    av_fifo_freep2(&q->pkt_list);
-    SDL_DestroyMutex(q->mutex);
-    SDL_DestroyCond(q->cond);
+    MyAVPacketList *n = q->first, *next;
+
+    while (n) {
+        next = atomic_load_explicit(&n->next, memory_order_relaxed);
+        av_packet_free(&n->pkt);
+        av_free(n);
+        n = next;
+    }
 }
 
 static void packet_queue_abort(PacketQueue *q)
 {
-    SDL_LockMutex(q->mutex);
-
     q->abort_request = 1;
-
-    SDL_CondSignal(q->cond);
-
-    SDL_UnlockMutex(q->mutex);
+    queue_wake(&q->wait);
 }
 
 static void packet_queue_start(PacketQueue *q)
 {
-    SDL_LockMutex(q->mutex);
     q->abort_request = 0;
     q->serial++;
-    SDL_UnlockMutex(q->mutex);
 }
 
 /* return < 0 if aborted, 0 if no packet and > 0 if packet.  */
 static int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, int *serial)
 {
-    MyAVPacketList pkt1;
-    int ret;
-
-    SDL_LockMutex(q->mutex);
+    MyAVPacketList *head, *n;
 
     for (;;) {
-        if (q->abort_request) {
-            ret = -1;
-            break;
-        }
+        if (q->abort_request)
+            return -1;
 
-        if (av_fifo_read(q->pkt_list, &pkt1, 1) >= 0) {
-            q->nb_packets--;
-            q->size -= pkt1.pkt->size + sizeof(pkt1);
-            q->duration -= pkt1.pkt->duration;
-            av_packet_move_ref(pkt, pkt1.pkt);
-            if (serial)
-                *serial = pkt1.serial;
-            av_packet_free(&pkt1.pkt);
-            ret = 1;
-            break;
+        head = atomic_load_explicit(&q->head, memory_order_relaxed);
+        if ((n = atomic_load_explicit(&head->next, memory_order_acquire))) {
+            int taken = atomic_exchange(&n->taken, 1);
+            if (!taken) {
+                packet_queue_uncount(q, n);
+                av_packet_move_ref(pkt, n->pkt);
+                if (serial)
+                    *serial = n->serial;
+            }
+            atomic_store_explicit(&q->head, n, memory_order_release);
+            if (!taken)
+                return 1;
         } else if (!block) {
-            ret = 0;
-            break;
+            return 0;
         } else {
-            SDL_CondWait(q->cond, q->mutex);
+            QUEUE_WAIT_WHILE(&q->wait, !q->abort_request &&
+                             !atomic_load_explicit(&head->next, memory_order_acquire));
         }
     }
-    SDL_UnlockMutex(q->mutex);
-    return ret;
 }
 
-static int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, SDL_cond *empty_queue_cond) {
-    memset(d, 0, sizeof(Decoder));
-    d->pkt = av_packet_alloc();
-    if (!d->pkt)
+/* ClearKey CENC: the key is kept from the demuxer, which then leaves the
+ * samples encrypted and attaches their parameters as side data. Each
+ * decoder thread decrypts its own packets in place, so decryption runs next
+ * to decoding instead of holding up the read thread. The schemes themselves
+ * are in ffplay_cenc.c. */
+
+/* decrypt a packet in place if the demuxer marked it encrypted */
+static int cenc_decrypt(Cenc *c, AVPacket *pkt)
+{
+    AVEncryptionInfo *info;
+    size_t size;
+    uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_ENCRYPTION_INFO, &size);
+    int ret;
+
+    if (!sd || !size)
+        return 0;
+    if (!(info = av_encryption_info_get_side_data(sd, size)))
         return AVERROR(ENOMEM);
-    d->avctx = avctx;
-    d->queue = queue;
-    d->empty_queue_cond = empty_queue_cond;
-    d->start_pts = AV_NOPTS_VALUE;
-    d->pkt_serial = -1;
-    return 0;
+    if ((ret = av_packet_make_writable(pkt)) >= 0 &&
+        (ret = cenc_decrypt_sample(c, info, pkt->data, pkt->size)) >= 0)
+        /* done: a second pass (packet kept pending) must not decrypt again */
+        av_packet_shrink_side_data(pkt, AV_PKT_DATA_ENCRYPTION_INFO, 0);
+    av_encryption_info_free(info);
+    return ret;
 }
 
-static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
-    int ret = AVERROR(EAGAIN);
+/* CPU placement: the video decoder and its codec threads run on the
+ * performance cores, the demuxer, the I/O helpers and audio on the efficiency
+ * cores, and the main thread (events, texture upload, presentation) next to
+ * the decoder. A thread inherits the affinity of the thread that creates it,
+ * so threads are placed by pinning their creator. The two kinds of cores are
+ * told apart by the kernel's cpu_capacity, then by their highest clock; on a
+ * single cluster both sets hold every core. */
+enum { CPU_BIG, CPU_LITTLE, CPU_NB };
+
+static cpu_set_t cpu_sets[CPU_NB];
+static int cpu_counts[CPU_NB];
+
+/* decoder threads by codec and frame size, capped at the performance cores:
+ * more threads than the frame keeps busy only add a frame of latency each
+ * (threads 0 = one per performance core, also for codecs not listed) */
+static const struct {
+    enum AVCodecID codec_id;
+    int64_t max_pixels;                  /* the first row this fits applies */
+    int threads;
+} decoder_threads[] = {
+    { AV_CODEC_ID_H264,        640 * 480, 2 },
+    { AV_CODEC_ID_H264,       1280 * 720, 3 },
+    { AV_CODEC_ID_HEVC,        640 * 480, 2 },
+    { AV_CODEC_ID_VP9,         640 * 480, 2 },
+    { AV_CODEC_ID_VP8,        1280 * 720, 2 },
+    { AV_CODEC_ID_MPEG2VIDEO, 1280 * 720, 1 },
+    { AV_CODEC_ID_MPEG4,      1280 * 720, 1 },
+    { AV_CODEC_ID_MPEG4,       INT64_MAX, 2 },
+};
 
-    for (;;) {
-        if (d->queue->serial == d->pkt_serial) {
-            do {
-                if (d->queue->abort_request)
-                    return -1;
+static void cpu_topology_init(void)
+{
+    long score[CPU_SETSIZE], max = -1;
+    int nb_cpus = FFMIN(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+    int cpu, i;
+
+    for (cpu = 0; cpu < nb_cpus; cpu++) {
+        /* cpu0 usually has no online file: it cannot go offline */
+        if (!sysfs_read_long(sysfs_root, "devices/system/cpu/cpu%d/online", cpu)) {
+            score[cpu] = -1;
+            continue;
+        }
+        score[cpu] = FFMAX(sysfs_read_long(sysfs_root, "devices/system/cpu/cpu%d/cpu_capacity", cpu), 0) * 10000000 +
+                     FFMAX(sysfs_read_long(sysfs_root, "devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu), 0);
+        max = FFMAX(max, score[cpu]);
+    }
+    for (i = 0; i < CPU_NB; i++) {
+        CPU_ZERO(&cpu_sets[i]);
+        cpu_counts[i] = 0;
+    }
+    for (cpu = 0; cpu < nb_cpus; cpu++) {
+        if (score[cpu] < 0)
+            continue;
+        i = score[cpu] == max ? CPU_BIG : CPU_LITTLE;
+        CPU_SET(cpu, &cpu_sets[i]);
+        cpu_counts[i]++;
+    }
+    av_log(NULL, AV_LOG_VERBOSE, "cpu: %d performance and %d efficiency cores\n",
+           cpu_counts[CPU_BIG], cpu_counts[CPU_LITTLE]);
+    if (!cpu_counts[CPU_LITTLE]) {
+        cpu_sets[CPU_LITTLE]   = cpu_sets[CPU_BIG];
+        cpu_counts[CPU_LITTLE] = cpu_counts[CPU_BIG];
+    }
+}
 
-                switch (d->avctx->codec_type) {
-                    case AVMEDIA_TYPE_VIDEO:
-                        ret = avcodec_receive_frame(d->avctx, frame);
-                        if (ret >= 0) {
-                            if (decoder_reorder_pts == -1) {
-                                frame->pts = frame->best_effort_timestamp;
-                            } else if (!decoder_reorder_pts) {
-                                frame->pts = frame->pkt_dts;
-                            }
-                        }
-                        break;
-                    case AVMEDIA_TYPE_AUDIO:
-                        ret = avcodec_receive_frame(d->avctx, frame);
-                        if (ret >= 0) {
-                            AVRational tb = (AVRational){1, frame->sample_rate};
-                            if (frame->pts != AV_NOPTS_VALUE)
-                                frame->pts = av_rescale_q(frame->pts, d->avctx->pkt_timebase, tb);
-                            else if (d->next_pts != AV_NOPTS_VALUE)
-                                frame->pts = av_rescale_q(d->next_pts, d->next_pts_tb, tb);
-                            if (frame->pts != AV_NOPTS_VALUE) {
-                                d->next_pts = frame->pts + frame->nb_samples;
-                                d->next_pts_tb = tb;
-                            }
-                        }
-                        break;
-                }
-                if (ret == AVERROR_EOF) {
-                    d->finished = d->pkt_serial;
-                    avcodec_flush_buffers(d->avctx);
-                    return 0;
-                }
-                if (ret >= 0)
-                    return 1;
-            } while (ret != AVERROR(EAGAIN));
+/* pin the calling thread to one kind of core; returns 1 with the previous
+ * affinity in old (when not NULL) if it did */
+static int cpu_pin(int kind, cpu_set_t *old)
+{
+    if (!cpu_placement || !cpu_counts[kind])
+        return 0;
+    if (old && sched_getaffinity(0, sizeof(*old), old) < 0)
+        return 0;
+    return !sched_setaffinity(0, sizeof(cpu_sets[kind]), &cpu_sets[kind]);
+}
+
+static void cpu_unpin(const cpu_set_t *old)
+{
+    sched_setaffinity(0, sizeof(*old), old);
+}
+
+static int decoder_thread_count(const AVCodecContext *avctx)
+{
+    int64_t pixels = (int64_t)avctx->width * avctx->height;
+    int cores = cpu_placement && cpu_counts[CPU_BIG] ? cpu_counts[CPU_BIG] : av_cpu_count();
+    int i, threads = 0;
+
+    if (!pixels)
+        pixels = INT64_MAX;
+    for (i = 0; i < FF_ARRAY_ELEMS(decoder_threads); i++)
+        if (decoder_threads[i].codec_id == avctx->codec_id && pixels <= decoder_threads[i].max_pixels) {
+            threads = decoder_threads[i].threads;
+            break;
+        }
+    return threads > 0 ? FFMIN(threads, cores) : cores;
+}
+
+/* CPU frequency governor: for the whole playback a thread clamps the
+ * scaling_min_freq and scaling_max_freq of every cpufreq policy to a single
+ * frequency, the lowest that does not drop video frames. It steps up at once
+ * when frames are dropped or the decoder has almost no time to spare, and
+ * steps down slowly while the decoder would still wait on a full picture
+ * queue at the next lower clock. It does not step up while the thermal zones
+ * are hot, and steps down when they are critical. The limits found at start
+ * are restored on exit, and saved to -cpu_limits_file for the launcher to
+ * restore if this process is killed or crashes. The policy and thermal
+ * reading and the step decisions are in ffplay_gov.c. */
+static Gov gov;
+static atomic_int gov_stop;
+static SDL_mutex *gov_mutex;             /* the limits are written by one thread at a time */
+static int64_t gov_ticks, gov_freq_sum, gov_drops;
+static int gov_temp_peak = INT_MIN;
+
+/* playback stats the governor decides on, fed by the video threads */
+static _Atomic int64_t stat_frames;      /* pictures queued */
+static _Atomic int64_t stat_frame_drops;
+static _Atomic int64_t stat_decoder_idle; /* microseconds waiting for room in the picture queue */
+
+static int gov_thread(void *arg)
+{
+    int64_t drops, frames, idle, now;
+    int64_t last_drops = 0, last_frames = 0, last_idle = 0, last_time = av_gettime_relative();
+    int temp, f = 0;
+    double idle_share;
+    sigset_t sigs;
+
+    cpu_pin(CPU_LITTLE, NULL);
+    /* signals go to the other threads: a handler that exits restores the
+     * limits, and must not wait for this thread to release gov_mutex */
+    sigfillset(&sigs);
+    pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+    while (!atomic_load(&gov_stop)) {
+        av_usleep(GOV_INTERVAL);
+        now    = av_gettime_relative();
+        drops  = atomic_load(&stat_frame_drops);
+        frames = atomic_load(&stat_frames);
+        idle   = atomic_load(&stat_decoder_idle);
+        temp   = gov_temperature(&gov);
+
+        /* no new frame: paused, or nothing to decode */
+        idle_share = frames > last_frames ? (double)(idle - last_idle) / (now - last_time) : 1;
+        SDL_LockMutex(gov_mutex);
+        if (!atomic_load(&gov_stop)) {
+            gov_step(&gov, drops > last_drops, idle_share, temp);
+            f = gov_apply(&gov);
+        }
+        SDL_UnlockMutex(gov_mutex);
+
+        gov_freq_sum += f;
+        gov_ticks++;
+        gov_drops += drops - last_drops;
+        gov_temp_peak = FFMAX(gov_temp_peak, temp);
+        av_log(NULL, AV_LOG_DEBUG, "cpu governor: idle %.2f, %"PRId64" dropped, %d mC, level %d/%d\n",
+               idle_share, drops - last_drops, temp, gov.level, gov.levels);
+        last_drops  = drops;
+        last_frames = frames;
+        last_idle   = idle;
+        last_time   = now;
+    }
+    return 0;
+}
+
+/* at exit, also from the signal handler: the thread is not joined, but it
+ * is either done writing or sees gov_stop once it gets gov_mutex */
+static void gov_uninit(void)
+{
+    SDL_LockMutex(gov_mutex);
+    atomic_store(&gov_stop, 1);
+    gov_restore(&gov);
+    SDL_UnlockMutex(gov_mutex);
+    if (cpu_limits_file)
+        unlink(cpu_limits_file);
+    if (gov_ticks)
+        av_log(NULL, AV_LOG_INFO,
+               "cpu governor: %.0f MHz on average over %"PRId64"s, %"PRId64" frames dropped, %.1f C at most\n",
+               gov_freq_sum / 1000.0 / gov_ticks, gov_ticks * GOV_INTERVAL / 1000000,
+               gov_drops, gov_temp_peak / 1000.0);
+}
+
+static void gov_start(void)
+{
+    SDL_Thread *tid;
+    int f, ret;
+
+    if (!gov_init(&gov, sysfs_root, FFMIN(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE))) {
+        av_log(NULL, AV_LOG_VERBOSE, "cpu governor: no writable cpufreq policy\n");
+        return;
+    }
+    if (!(gov_mutex = SDL_CreateMutex())) {
+        av_log(NULL, AV_LOG_ERROR, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        gov.nb_policies = 0;
+        return;
+    }
+
+    if (cpu_limits_file && (ret = gov_save_limits(&gov, cpu_limits_file)) < 0)
+        av_log(NULL, AV_LOG_WARNING, "cpu governor: cannot save the limits to %s: %s\n",
+               cpu_limits_file, av_err2str(ret));
+    atexit(gov_uninit);
+    f = gov_apply(&gov);
+    if (!(tid = SDL_CreateThread(gov_thread, "cpu_governor", NULL))) {
+        av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+        return;
+    }
+    SDL_DetachThread(tid);
+    av_log(NULL, AV_LOG_VERBOSE, "cpu governor: %d policies, %d levels, %d thermal zones, starting at %d MHz\n",
+           gov.nb_policies, gov.levels + 1, gov.nb_zones, f / 1000);
+}
+
+/* Video frame buffers: the decoder draws into pools kept per stream, so a
+ * frame that went through the filtergraph and the picture queue hands its
+ * memory to the next one instead of freeing it. The pools are filled up front
+ * for the picture queue, the codec's reference frames and its frame threads;
+ * planes and lines are aligned for NEON and the texture upload. */
+#define FRAME_POOL_ALIGN 64
+#define FRAME_POOL_MAX 64                /* buffers filled up front per plane */
+
+typedef struct FramePool {
+    SDL_mutex *mutex;                    /* the frame threads share the pools */
+    AVBufferPool *pools[4];
+    int nb_planes;
+    int linesize[4];
+    int format, width, height;           /* what the pools were built for */
+    int64_t nb_frames;                   /* frames handed to the decoder */
+    int64_t nb_fallback;                 /* frames left to libavcodec */
+    int nb_allocs;                       /* plane buffers allocated */
+    int nb_prealloc;                     /* of them when (re)building the pools */
+} FramePool;
+
+static void frame_pool_free_buf(void *opaque, uint8_t *data)
+{
+    free(data);
+}
+
+/* called with fp->mutex held, from av_buffer_pool_get() */
+static AVBufferRef *frame_pool_alloc_buf(void *opaque, size_t size)
+{
+    FramePool *fp = opaque;
+    AVBufferRef *buf;
+    void *data;
+
+    if (posix_memalign(&data, FRAME_POOL_ALIGN, size))
+        return NULL;
+    if (!(buf = av_buffer_create(data, size, frame_pool_free_buf, NULL, 0))) {
+        free(data);
+        return NULL;
+    }
+    fp->nb_allocs++;
+    return buf;
+}
+
+static FramePool *frame_pool_alloc(void)
+{
+    FramePool *fp = av_mallocz(sizeof(*fp));
+
+    if (!fp)
+        return NULL;
+    if (!(fp->mutex = SDL_CreateMutex())) {
+        av_free(fp);
+        return NULL;
+    }
+    fp->format = AV_PIX_FMT_NONE;
+    return fp;
+}
+
+/* buffers still out in frames stay valid: an uninited pool goes away with
+ * its last buffer */
+static void frame_pool_free(FramePool **pfp)
+{
+    FramePool *fp = *pfp;
+    int i;
+
+    if (!fp)
+        return;
+    if (fp->nb_frames || fp->nb_fallback)
+        av_log(NULL, AV_LOG_INFO,
+               "frame pool: %"PRId64" frames, %d plane buffers allocated up front, %d during playback, "
+               "%"PRId64" frames from the default allocator\n",
+               fp->nb_frames, fp->nb_prealloc, fp->nb_allocs - fp->nb_prealloc, fp->nb_fallback);
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&fp->pools[i]);
+    SDL_DestroyMutex(fp->mutex);
+    av_freep(pfp);
+}
+
+/* (re)build the pools for the frame's format and size, fp->mutex held */
+static int frame_pool_configure(FramePool *fp, AVCodecContext *avctx, const AVFrame *frame)
+{
+    AVBufferRef *bufs[FRAME_POOL_MAX];
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    ptrdiff_t linesizes[4];
+    size_t sizes[4];
+    int w = frame->width, h = frame->height;
+    int allocs = fp->nb_allocs;
+    int i, j, n, ret, unaligned;
+
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&fp->pools[i]);
+    fp->nb_planes = 0;
+    fp->format = AV_PIX_FMT_NONE;
+
+    avcodec_align_dimensions2(avctx, &w, &h, linesize_align);
+    /* widen the lines until every plane is aligned, like libavcodec's pool */
+    do {
+        if ((ret = av_image_fill_linesizes(fp->linesize, frame->format, w)) < 0)
+            return ret;
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (i = 0; i < 4; i++)
+            unaligned |= fp->linesize[i] % FRAME_POOL_ALIGN;
+    } while (unaligned);
+    for (i = 0; i < 4; i++)
+        linesizes[i] = fp->linesize[i];
+    if ((ret = av_image_fill_plane_sizes(sizes, frame->format, h, linesizes)) < 0)
+        return ret;
+    for (i = 0; i < 4 && sizes[i]; i++)
+        if (!(fp->pools[i] = av_buffer_pool_init2(sizes[i] + 16 + FRAME_POOL_ALIGN - 1, fp,
+                                                  frame_pool_alloc_buf, NULL)))
+            return AVERROR(ENOMEM);
+    fp->nb_planes = i;
+
+    /* every frame the pipeline can hold at once: the picture queue, the
+     * codec's references and one in flight per frame thread */
+    n = VIDEO_PICTURE_QUEUE_SIZE + FFMAX(avctx->refs, 1) +
+        (avctx->active_thread_type & FF_THREAD_FRAME ? avctx->thread_count : 1);
+    n = FFMIN(n, FRAME_POOL_MAX);
+    for (i = 0; i < fp->nb_planes; i++) {
+        for (j = 0; j < n && (bufs[j] = av_buffer_pool_get(fp->pools[i])); j++)
+            ;
+        while (j > 0)
+            av_buffer_unref(&bufs[--j]);
+    }
+    fp->nb_prealloc += fp->nb_allocs - allocs;
+
+    fp->format = frame->format;
+    fp->width  = frame->width;
+    fp->height = frame->height;
+    av_log(avctx, AV_LOG_VERBOSE, "frame pool: %d buffers of %s %dx%d\n",
+           n, av_get_pix_fmt_name(frame->format), frame->width, frame->height);
+    return 0;
+}
+
+static int frame_pool_get_buffer(AVCodecContext *avctx, AVFrame *frame, int flags)
+{
+    FramePool *fp = avctx->opaque;
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    int i, ret = 0;
+
+    SDL_LockMutex(fp->mutex);
+    if (!desc || desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL)) {
+        fp->nb_fallback++;
+        SDL_UnlockMutex(fp->mutex);
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    }
+    if (frame->format != fp->format || frame->width != fp->width || frame->height != fp->height)
+        ret = frame_pool_configure(fp, avctx, frame);
+    for (i = 0; ret >= 0 && i < fp->nb_planes; i++) {
+        if (!(frame->buf[i] = av_buffer_pool_get(fp->pools[i]))) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        frame->data[i]     = frame->buf[i]->data;
+        frame->linesize[i] = fp->linesize[i];
+    }
+    if (ret >= 0)
+        fp->nb_frames++;
+    SDL_UnlockMutex(fp->mutex);
+
+    if (ret < 0) {
+        for (i = 0; i < 4; i++) {
+            av_buffer_unref(&frame->buf[i]);
+            frame->data[i] = NULL;
+        }
+        return ret;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+}
+
+static int decoder_init(Decoder *d, AVCodecContext *avctx, PacketQueue *queue, QueueWait *empty_queue_wake,
+                        const uint8_t *cenc_key) {
+    memset(d, 0, sizeof(Decoder));
+    d->pkt = av_packet_alloc();
+    if (!d->pkt)
+        return AVERROR(ENOMEM);
+    if (cenc_key && !(d->cenc = cenc_alloc(cenc_key, 1))) {
+        av_packet_free(&d->pkt);
+        return AVERROR(ENOMEM);
+    }
+    d->avctx = avctx;
+    d->queue = queue;
+    d->empty_queue_wake = empty_queue_wake;
+    d->start_pts = AV_NOPTS_VALUE;
+    d->pkt_serial = -1;
+    return 0;
+}
+
+static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
+    int ret = AVERROR(EAGAIN);
+
+    for (;;) {
+        if (d->queue->serial == d->pkt_serial) {
+            do {
+                if (d->queue->abort_request)
+                    return -1;
+
+                switch (d->avctx->codec_type) {
+                    case AVMEDIA_TYPE_VIDEO:
+                        ret = avcodec_receive_frame(d->avctx, frame);
+                        if (ret >= 0) {
+                            if (decoder_reorder_pts == -1) {
+                                frame->pts = frame->best_effort_timestamp;
+                            } else if (!decoder_reorder_pts) {
+                                frame->pts = frame->pkt_dts;
+                            }
+                        }
+                        break;
+                    case AVMEDIA_TYPE_AUDIO:
+                        ret = avcodec_receive_frame(d->avctx, frame);
+                        if (ret >= 0) {
+                            AVRational tb = (AVRational){1, frame->sample_rate};
+                            if (frame->pts != AV_NOPTS_VALUE)
+                                frame->pts = av_rescale_q(frame->pts, d->avctx->pkt_timebase, tb);
+                            else if (d->next_pts != AV_NOPTS_VALUE)
+                                frame->pts = av_rescale_q(d->next_pts, d->next_pts_tb, tb);
+                            if (frame->pts != AV_NOPTS_VALUE) {
+                                d->next_pts = frame->pts + frame->nb_samples;
+                                d->next_pts_tb = tb;
+                            }
+                        }
+                        break;
+                }
+                if (ret == AVERROR_EOF) {
+                    d->finished = d->pkt_serial;
+                    avcodec_flush_buffers(d->avctx);
+                    return 0;
+                }
+                if (ret >= 0)
+                    return 1;
+            } while (ret != AVERROR(EAGAIN));
         }
 
         do {
             if (d->queue->nb_packets == 0)
-                SDL_CondSignal(d->empty_queue_cond);
+                queue_signal(d->empty_queue_wake);
             if (d->packet_pending) {
                 d->packet_pending = 0;
             } else {
@@ -898,6 +2034,12 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
             av_packet_unref(d->pkt);
         } while (1);
 
+        if (d->cenc && (ret = cenc_decrypt(d->cenc, d->pkt)) < 0) {
+            av_log(d->avctx, AV_LOG_WARNING, "Cannot decrypt packet: %s\n", av_err2str(ret));
+            av_packet_unref(d->pkt);
+            continue;
+        }
+
         if (d->avctx->codec_type == AVMEDIA_TYPE_SUBTITLE) {
             int got_frame = 0;
             ret = avcodec_decode_subtitle2(d->avctx, sub, &got_frame, d->pkt);
@@ -933,7 +2075,9 @@ static int decoder_decode_frame(Decoder *d, AVFrame *frame, AVSubtitle *sub) {
 
 static void decoder_destroy(Decoder *d) {
     av_packet_free(&d->pkt);
+    cenc_free(&d->cenc);
     avcodec_free_context(&d->avctx);
+    frame_pool_free(&d->frame_pool);
 }
 
 static void frame_queue_unref_item(Frame *vp)
@@ -1165,6 +2309,93 @@ static void get_sdl_pix_fmt_and_blendmode(int format, Uint32 *sdl_pix_fmt, SDL_B
     }
 }
 
+/* 10-bit 4:2:0 (yuv420p10, P010) goes to the IYUV texture as is: it is
+ * brought down to 8 bits while being written into the locked texture, in one
+ * pass instead of a swscale conversion in the filtergraph. The two bits lost
+ * are dithered with a 2x2 ordered pattern so gradients do not band. */
+static const uint8_t depth10_dither[2][2] = { { 0, 2 }, { 3, 1 } };
+
+static int is_depth10(int format)
+{
+    return format == AV_PIX_FMT_YUV420P10 || format == AV_PIX_FMT_P010;
+}
+
+/* one line: the sample sits in the low bits (shift 2) or high bits (shift 8) */
+static void depth10_to_8(uint8_t *dst, const uint16_t *src, int w, int row, int shift)
+{
+    const uint8_t *d = depth10_dither[row & 1];
+    int x = 0;
+
+#if ARCH_AARCH64
+    uint16x8_t dv = vreinterpretq_u16_u32(vdupq_n_u32((d[0] | d[1] << 16) << (shift - 2)));
+    int16x8_t sh = vdupq_n_s16(-shift);
+
+    for (; x + 16 <= w; x += 16) {
+        uint16x8_t a = vshlq_u16(vqaddq_u16(vld1q_u16(src + x),     dv), sh);
+        uint16x8_t b = vshlq_u16(vqaddq_u16(vld1q_u16(src + x + 8), dv), sh);
+        vst1q_u8(dst + x, vcombine_u8(vqmovn_u16(a), vqmovn_u16(b)));
+    }
+#endif
+    for (; x < w; x++)
+        dst[x] = FFMIN((src[x] + (d[x & 1] << (shift - 2))) >> shift, 255);
+}
+
+/* one line of P010's interleaved chroma into the U and V planes */
+static void depth10_to_8_uv(uint8_t *dst_u, uint8_t *dst_v, const uint16_t *src, int w, int row)
+{
+    const uint8_t *d = depth10_dither[row & 1];
+    int x = 0;
+
+#if ARCH_AARCH64
+    uint16x8_t dv = vreinterpretq_u16_u32(vdupq_n_u32((d[0] | d[1] << 16) << 6));
+
+    for (; x + 8 <= w; x += 8) {
+        uint16x8x2_t uv = vld2q_u16(src + 2 * x);
+        vst1_u8(dst_u + x, vqshrn_n_u16(vqaddq_u16(uv.val[0], dv), 8));
+        vst1_u8(dst_v + x, vqshrn_n_u16(vqaddq_u16(uv.val[1], dv), 8));
+    }
+#endif
+    for (; x < w; x++) {
+        dst_u[x] = FFMIN((src[2 * x]     + (d[x & 1] << 6)) >> 8, 255);
+        dst_v[x] = FFMIN((src[2 * x + 1] + (d[x & 1] << 6)) >> 8, 255);
+    }
+}
+
+static int upload_texture_10bit(SDL_Texture *tex, AVFrame *frame)
+{
+    int w = frame->width, h = frame->height;
+    int cw = AV_CEIL_RSHIFT(w, 1), ch = AV_CEIL_RSHIFT(h, 1);
+    int p010 = frame->format == AV_PIX_FMT_P010;
+    uint8_t *pixels, *dst[3];
+    int pitch, cpitch, y;
+
+    if (frame->linesize[0] < 0 || frame->linesize[1] < 0 || (!p010 && frame->linesize[2] < 0)) {
+        av_log(NULL, AV_LOG_ERROR, "Negative linesizes are not supported for 10-bit video.\n");
+        return -1;
+    }
+    if (SDL_LockTexture(tex, NULL, (void **)&pixels, &pitch) < 0)
+        return -1;
+    /* a locked IYUV texture is its three planes back to back */
+    cpitch = (pitch + 1) / 2;
+    dst[0] = pixels;
+    dst[1] = dst[0] + pitch * h;
+    dst[2] = dst[1] + cpitch * ch;
+    for (y = 0; y < h; y++)
+        depth10_to_8(dst[0] + y * pitch, (const uint16_t *)(frame->data[0] + y * frame->linesize[0]),
+                     w, y, p010 ? 8 : 2);
+    for (y = 0; y < ch; y++) {
+        if (p010) {
+            depth10_to_8_uv(dst[1] + y * cpitch, dst[2] + y * cpitch,
+                            (const uint16_t *)(frame->data[1] + y * frame->linesize[1]), cw, y);
+        } else {
+            depth10_to_8(dst[1] + y * cpitch, (const uint16_t *)(frame->data[1] + y * frame->linesize[1]), cw, y, 2);
+            depth10_to_8(dst[2] + y * cpitch, (const uint16_t *)(frame->data[2] + y * frame->linesize[2]), cw, y, 2);
+        }
+    }
+    SDL_UnlockTexture(tex);
+    return 0;
+}
+
 static int upload_texture(SDL_Texture **tex, AVFrame *frame)
 {
     int ret = 0;
@@ -1175,7 +2406,9 @@ static int upload_texture(SDL_Texture **tex, AVFrame *frame)
         return -1;
     switch (sdl_pix_fmt) {
         case SDL_PIXELFORMAT_IYUV:
-            if (frame->linesize[0] > 0 && frame->linesize[1] > 0 && frame->linesize[2] > 0) {
+            if (is_depth10(frame->format)) {
+                ret = upload_texture_10bit(*tex, frame);
+            } else if (frame->linesize[0] > 0 && frame->linesize[1] > 0 && frame->linesize[2] > 0) {
                 ret = SDL_UpdateYUVTexture(*tex, NULL, frame->data[0], frame->linesize[0],
                                                        frame->data[1], frame->linesize[1],
                                                        frame->data[2], frame->linesize[2]);
@@ -1203,7 +2436,8 @@ static void set_sdl_yuv_conversion_mode(AVFrame *frame)
 {
 #if SDL_VERSION_ATLEAST(2,0,8)
     SDL_YUV_CONVERSION_MODE mode = SDL_YUV_CONVERSION_AUTOMATIC;
-    if (frame && (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUYV422 || frame->format == AV_PIX_FMT_UYVY422)) {
+    if (frame && (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUYV422 || frame->format == AV_PIX_FMT_UYVY422 ||
+                  is_depth10(frame->format))) {
         if (frame->color_range == AVCOL_RANGE_JPEG)
             mode = SDL_YUV_CONVERSION_JPEG;
         else if (frame->colorspace == AVCOL_SPC_BT709)
@@ -1271,10 +2505,13 @@ static void video_image_display(VideoState *is)
     set_sdl_yuv_conversion_mode(vp->frame);
 
     if (!vp->uploaded) {
+        int64_t upload_start = av_gettime_relative();
         if (upload_texture(&is->vid_texture, vp->frame) < 0) {
             set_sdl_yuv_conversion_mode(NULL);
             return;
         }
+        is->upload_time += av_gettime_relative() - upload_start;
+        is->nb_uploaded++;
         vp->uploaded = 1;
         vp->flip_v = vp->frame->linesize[0] < 0;
     }
@@ -1468,12 +2705,14 @@ static void stream_component_close(VideoState *is, int stream_index)
     switch (codecpar->codec_type) {
     case AVMEDIA_TYPE_AUDIO:
         decoder_abort(&is->auddec, &is->sampq);
+        audio_fill_stop(is);
         SDL_CloseAudioDevice(audio_dev);
         decoder_destroy(&is->auddec);
         swr_free(&is->swr_ctx);
         av_freep(&is->audio_buf1);
         is->audio_buf1_size = 0;
         is->audio_buf = NULL;
+        av_freep(&is->audio_ring.buf);
 
         if (is->rdft) {
             av_tx_uninit(&is->rdft);
@@ -1485,6 +2724,13 @@ static void stream_component_close(VideoState *is, int stream_index)
         break;
     case AVMEDIA_TYPE_VIDEO:
         decoder_abort(&is->viddec, &is->pictq);
+        av_log(NULL, AV_LOG_INFO, "video decoder: %s with %d %s threads, %d frames dropped early, %d late\n",
+               is->viddec.avctx->codec->name, is->viddec.avctx->thread_count,
+               is->viddec.avctx->active_thread_type & FF_THREAD_FRAME ? "frame" : "slice",
+               is->frame_drops_early, is->frame_drops_late);
+        if (is->nb_filtered && is->nb_uploaded)
+            av_log(NULL, AV_LOG_INFO, "video: %.2f ms filtering and %.2f ms texture upload per frame\n",
+                   is->filter_time / 1000.0 / is->nb_filtered, is->upload_time / 1000.0 / is->nb_uploaded);
         decoder_destroy(&is->viddec);
         break;
     case AVMEDIA_TYPE_SUBTITLE:
@@ -1516,9 +2762,14 @@ static void stream_component_close(VideoState *is, int stream_index)
 
 static void stream_close(VideoState *is)
 {
+    int i;
+
     /* XXX: use a special url_shutdown call to abort parse cleanly */
     is->abort_request = 1;
+    queue_signal(&is->continue_read_thread);
     SDL_WaitThread(is->read_tid, NULL);
+    timeshift_close(is);
+    record_stop(is);
 
     /* close each stream */
     if (is->audio_stream >= 0)
@@ -1528,7 +2779,12 @@ static void stream_close(VideoState *is)
     if (is->subtitle_stream >= 0)
         stream_component_close(is, is->subtitle_stream);
 
-    avformat_close_input(&is->ic);
+    input_close(&is->ic);
+    for (i = 0; i < is->nb_ic_retired; i++)
+        input_close(&is->ic_retired[i]);
+    av_freep(&is->ic_retired);
+    av_freep(&is->variants);
+    av_freep(&is->stream_alias);
 
     packet_queue_destroy(&is->videoq);
     packet_queue_destroy(&is->audioq);
@@ -1538,7 +2794,6 @@ static void stream_close(VideoState *is)
     frame_queue_destroy(&is->pictq);
     frame_queue_destroy(&is->sampq);
     frame_queue_destroy(&is->subpq);
-    SDL_DestroyCond(is->continue_read_thread);
     sws_freeContext(is->sub_convert_ctx);
     av_free(is->filename);
     if (is->vis_texture)
@@ -1552,9 +2807,16 @@ static void stream_close(VideoState *is)
 
 static void do_exit(VideoState *is)
 {
+    int i;
+
     if (is) {
         stream_close(is);
     }
+    if (zap_count) {
+        zap_save_position();
+        for (i = 0; i < ZAP_PREFETCH_SLOTS; i++)
+            zap_prefetch_release(&zap_prefetch[i]);
+    }
     if (renderer)
         SDL_DestroyRenderer(renderer);
     if (window)
@@ -1564,6 +2826,7 @@ static void do_exit(VideoState *is)
     avformat_network_deinit();
     if (show_status)
         printf("\n");
+    refresh_uninit();
     SDL_Quit();
     av_log(NULL, AV_LOG_QUIET, "%s", "");
     exit(0);
@@ -1735,6 +2998,73 @@ static double get_master_clock(VideoState *is)
     return val;
 }
 
+/* seconds of input waiting in the packet queues */
+static double queued_duration(VideoState *is)
+{
+    if (is->video_st)
+        return is->videoq.duration * av_q2d(is->video_st->time_base);
+    if (is->audio_st)
+        return is->audioq.duration * av_q2d(is->audio_st->time_base);
+    return 0;
+}
+
+static void live_reset(VideoState *is)
+{
+    is->live_delay = is->live_min = is->live_min_prev = NAN;
+    is->live_window_start = av_gettime_relative();
+    is->live_catchup = 0;
+}
+
+/* low-latency live: keep the buffer near -live_latency seconds by playing a
+ * little faster, or by skipping ahead when it got far too long. With
+ * timeshift the queues are short and the backlog is in the ring, so the
+ * latency is how far playback is behind the recorder. */
+static void check_live_latency(VideoState *is)
+{
+    int64_t now = av_gettime_relative();
+    double depth, frac;
+
+    if (!is->ic || (is->ic->duration > 0 && !is->realtime))
+        return;     /* not live */
+    if (is->paused || is->seek_req || is->live_jump_req || is->live_wait_key)
+        return;
+    if (is->timeshift) {
+        timeshift_position(is, &depth, &frac);
+        if (depth < TIMESHIFT_LIVE_SLACK)
+            is->live_rewound = 0;
+        if (is->live_rewound) {
+            /* behind on purpose: leave it there */
+            if (!isnan(is->live_delay))
+                live_reset(is);
+            return;
+        }
+    } else {
+        depth = queued_duration(is);
+        if (is->audio_st && is->audio_clock_serial == is->audclk.serial && !isnan(is->audio_clock))
+            depth += FFMAX(is->audio_clock - get_clock(&is->audclk), 0);
+    }
+    is->live_min = isnan(is->live_min) ? depth : FFMIN(is->live_min, depth);
+    if (now - is->live_window_start < LIVE_WINDOW)
+        return;
+    is->live_delay = isnan(is->live_min_prev) ? is->live_min : FFMIN(is->live_min, is->live_min_prev);
+    is->live_min_prev = is->live_min;
+    is->live_min = NAN;
+    is->live_window_start = now;
+
+    if (is->live_delay > live_latency + LIVE_JUMP_MARGIN) {
+        av_log(NULL, AV_LOG_INFO, "live: %.1fs behind, skipping to live\n", is->live_delay);
+        live_reset(is);
+        is->live_jump_req = 1;
+        queue_signal(&is->continue_read_thread);
+    } else if (is->live_delay > live_latency + LIVE_CATCHUP_MARGIN) {
+        is->live_catchup = 1;
+    } else if (is->live_delay <= live_latency) {
+        is->live_catchup = 0;
+    }
+    if (get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK)
+        set_clock_speed(&is->extclk, is->live_catchup ? LIVE_CATCHUP_SPEED : 1.0);
+}
+
 static void check_external_clock_speed(VideoState *is) {
    if (is->video_stream >= 0 && is->videoq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES ||
        is->audio_stream >= 0 && is->audioq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES) {
@@ -1759,7 +3089,8 @@ static void stream_seek(VideoState *is, int64_t pos, int64_t rel, int by_bytes)
         if (by_bytes)
             is->seek_flags |= AVSEEK_FLAG_BYTE;
         is->seek_req = 1;
-        SDL_CondSignal(is->continue_read_thread);
+        live_reset(is);
+        queue_signal(&is->continue_read_thread);
     }
 }
 
@@ -1775,6 +3106,11 @@ static void stream_toggle_pause(VideoState *is)
     }
     set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
     is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = !is->paused;
+    /* the recorder goes on: resuming plays from where it was paused */
+    if (is->paused && is->timeshift)
+        is->live_rewound = 1;
+    queue_signal(&is->continue_read_thread);
+    refresh_wake();
 }
 
 static void toggle_pause(VideoState *is)
@@ -1860,16 +3196,19 @@ static void video_refresh(void *opaque, double *remaining_time)
 
     Frame *sp, *sp2;
 
-    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
+    if (live_latency > 0)
+        check_live_latency(is);
+    else if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
         check_external_clock_speed(is);
 
     if (!display_disable && is->show_mode != SHOW_MODE_VIDEO && is->audio_st) {
         time = av_gettime_relative() / 1000000.0;
-        if (is->force_refresh || is->last_vis_time + rdftspeed < time) {
+        if (is->force_refresh || (!is->paused && is->last_vis_time + rdftspeed < time)) {
             video_display(is);
             is->last_vis_time = time;
         }
-        *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
+        if (!is->paused)
+            *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
     }
 
     if (is->video_st) {
@@ -1909,16 +3248,15 @@ retry:
             if (delay > 0 && time - is->frame_timer > AV_SYNC_THRESHOLD_MAX)
                 is->frame_timer = time;
 
-            SDL_LockMutex(is->pictq.mutex);
             if (!isnan(vp->pts))
                 update_video_pts(is, vp->pts, vp->serial);
-            SDL_UnlockMutex(is->pictq.mutex);
 
             if (frame_queue_nb_remaining(&is->pictq) > 1) {
                 Frame *nextvp = frame_queue_peek_next(&is->pictq);
                 duration = vp_duration(is, vp, nextvp);
                 if(!is->step && (framedrop>0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration){
                     is->frame_drops_late++;
+                    atomic_fetch_add(&stat_frame_drops, 1);
                     frame_queue_next(&is->pictq);
                     goto retry;
                 }
@@ -1965,9 +3303,9 @@ retry:
                 stream_toggle_pause(is);
         }
 display:
-        /* display picture */
+        /* display picture; while paused only what changed the screen is redrawn */
         if (!display_disable && is->show_mode == SHOW_MODE_VIDEO && is->pictq.rindex_shown
-            && (is->force_refresh || is->paused))
+            && is->force_refresh)
             video_display(is);
     }
     is->force_refresh = 0;
@@ -1999,7 +3337,7 @@ display:
 
             av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
             av_bprintf(&buf,
-                      "%7.2f %s:%7.3f fd=%4d aq=%5dKB vq=%5dKB sq=%5dB f=%"PRId64"/%"PRId64"   \r",
+                      "%7.2f %s:%7.3f fd=%4d aq=%5dKB vq=%5dKB sq=%5dB f=%"PRId64"/%"PRId64" rc=%d   \r",
                       get_master_clock(is),
                       (is->audio_st && is->video_st) ? "A-V" : (is->video_st ? "M-V" : (is->audio_st ? "M-A" : "   ")),
                       av_diff,
@@ -2008,7 +3346,8 @@ display:
                       vqsize / 1024,
                       sqsize,
                       is->video_st ? is->viddec.avctx->pts_correction_num_faulty_dts : 0,
-                      is->video_st ? is->viddec.avctx->pts_correction_num_faulty_pts : 0);
+                      is->video_st ? is->viddec.avctx->pts_correction_num_faulty_pts : 0,
+                      is->reconnects);
 
             if (show_status == 1 && AV_LOG_INFO > av_log_get_level())
                 fprintf(stderr, "%s", buf.str);
@@ -2026,6 +3365,7 @@ display:
 static int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double duration, int64_t pos, int serial)
 {
     Frame *vp;
+    int64_t wait_start = av_gettime_relative();
 
 #if defined(DEBUG_SYNC)
     printf("frame_type=%c pts=%0.3f\n",
@@ -2034,6 +3374,8 @@ static int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double
 
     if (!(vp = frame_queue_peek_writable(&is->pictq)))
         return -1;
+    atomic_fetch_add(&stat_decoder_idle, av_gettime_relative() - wait_start);
+    atomic_fetch_add(&stat_frames, 1);
 
     vp->sar = src_frame->sample_aspect_ratio;
     vp->uploaded = 0;
@@ -2051,6 +3393,9 @@ static int queue_picture(VideoState *is, AVFrame *src_frame, double pts, double
 
     av_frame_move_ref(vp->frame, src_frame);
     frame_queue_push(&is->pictq);
+    /* with more queued the refresh loop already waits for their time */
+    if (frame_queue_nb_remaining(&is->pictq) == 1)
+        refresh_wake();
     return 0;
 }
 
@@ -2077,6 +3422,7 @@ static int get_video_frame(VideoState *is, AVFrame *frame)
                     is->viddec.pkt_serial == is->vidclk.serial &&
                     is->videoq.nb_packets) {
                     is->frame_drops_early++;
+                    atomic_fetch_add(&stat_frame_drops, 1);
                     av_frame_unref(frame);
                     got_picture = 0;
                 }
@@ -2144,11 +3490,11 @@ static int configure_video_filters(AVFilterGraph *graph, VideoState *is, const c
     int i, j;
 
     for (i = 0; i < renderer_info.num_texture_formats; i++) {
+        /* IYUV also takes the 10-bit formats, unless swscale is asked for */
         for (j = 0; j < FF_ARRAY_ELEMS(sdl_texture_format_map) - 1; j++) {
-            if (renderer_info.texture_formats[i] == sdl_texture_format_map[j].texture_fmt) {
+            if (renderer_info.texture_formats[i] == sdl_texture_format_map[j].texture_fmt &&
+                (direct_10bit || !is_depth10(sdl_texture_format_map[j].format)))
                 pix_fmts[nb_pix_fmts++] = sdl_texture_format_map[j].format;
-                break;
-            }
         }
     }
     pix_fmts[nb_pix_fmts] = AV_PIX_FMT_NONE;
@@ -2476,6 +3822,7 @@ static int video_thread(void *arg)
                     event.type = FF_QUIT_EVENT;
                     event.user.data1 = is;
                     SDL_PushEvent(&event);
+                    refresh_wake();
                     goto the_end;
                 }
             }
@@ -2509,6 +3856,8 @@ static int video_thread(void *arg)
             fd = frame->opaque_ref ? (FrameData*)frame->opaque_ref->data : NULL;
 
             is->frame_last_filter_delay = av_gettime_relative() / 1000000.0 - is->frame_last_returned_time;
+            is->filter_time += is->frame_last_filter_delay * 1000000;
+            is->nb_filtered++;
             if (fabs(is->frame_last_filter_delay) > AV_NOSYNC_THRESHOLD / 10.0)
                 is->frame_last_filter_delay = 0;
             tb = av_buffersink_get_time_base(filt_out);
@@ -2620,6 +3969,9 @@ static int synchronize_audio(VideoState *is, int nb_samples)
             is->audio_diff_avg_count = 0;
             is->audio_diff_cum       = 0;
         }
+    } else if (is->live_catchup) {
+        /* audio is the clock: playing fewer samples per frame speeds everything up */
+        wanted_nb_samples = lrint(nb_samples / LIVE_CATCHUP_SPEED);
     }
 
     return wanted_nb_samples;
@@ -2630,7 +3982,8 @@ static int synchronize_audio(VideoState *is, int nb_samples)
  *
  * The processed audio frame is decoded, converted if required, and
  * stored in is->audio_buf, with size in bytes given by the return
- * value.
+ * value. Called by the audio fill thread, which also keeps going while
+ * paused, until the ring is full.
  */
 static int audio_decode_frame(VideoState *is)
 {
@@ -2639,9 +3992,6 @@ static int audio_decode_frame(VideoState *is)
     int wanted_nb_samples;
     Frame *af;
 
-    if (is->paused)
-        return -1;
-
     do {
 #if defined(_WIN32)
         while (frame_queue_nb_remaining(&is->sampq) == 0) {
@@ -2740,46 +4090,164 @@ static int audio_decode_frame(VideoState *is)
     return resampled_data_size;
 }
 
-/* prepare a new audio buffer */
+static int audio_ring_init(AudioRing *r, int min_size)
+{
+    av_freep(&r->buf);
+    memset(r, 0, sizeof(*r));
+    r->size = 1 << av_ceil_log2(min_size);
+    r->clock = NAN;
+    if (!(r->buf = av_malloc(r->size)))
+        return AVERROR(ENOMEM);
+    return 0;
+}
+
+/* wait for the callback to make room; returns 0 once the ring is closing */
+static int audio_ring_wait(AudioRing *r)
+{
+    QUEUE_WAIT_WHILE(&r->wait, !r->abort_request &&
+                     (r->mark_w - r->mark_r >= AUDIO_RING_MARKS || r->wpos - r->rpos >= r->size));
+    return !r->abort_request;
+}
+
+static void audio_ring_write(AudioRing *r, const uint8_t *data, int size, double clock, int serial)
+{
+    int64_t wpos = atomic_load_explicit(&r->wpos, memory_order_relaxed);
+    unsigned mark_w = atomic_load_explicit(&r->mark_w, memory_order_relaxed);
+    int n, off;
+
+    while (mark_w - atomic_load_explicit(&r->mark_r, memory_order_acquire) >= AUDIO_RING_MARKS)
+        if (!audio_ring_wait(r))
+            return;
+    r->marks[mark_w % AUDIO_RING_MARKS] = (AudioMark){ wpos + size, clock, serial };
+    atomic_store_explicit(&r->mark_w, mark_w + 1, memory_order_release);
+
+    /* a frame bigger than the ring goes in as the callback makes room */
+    while (size > 0) {
+        n = r->size - (wpos - atomic_load_explicit(&r->rpos, memory_order_acquire));
+        if (!n) {
+            if (!audio_ring_wait(r))
+                return;
+            continue;
+        }
+        off = wpos & (r->size - 1);
+        n = FFMIN3(n, size, r->size - off);
+        memcpy(r->buf + off, data, n);
+        data += n;
+        size -= n;
+        wpos += n;
+        atomic_store_explicit(&r->wpos, wpos, memory_order_release);
+    }
+}
+
+/* takes the frames off the decoder, resamples them and queues them for the
+ * SDL callback, which then only copies */
+static int audio_fill_thread(void *arg)
+{
+    VideoState *is = arg;
+    int audio_size;
+
+    while (!is->audio_ring.abort_request) {
+        audio_size = audio_decode_frame(is);
+        if (audio_size < 0) {
+            if (is->audioq.abort_request)
+                break;
+            continue;
+        }
+        if (is->show_mode != SHOW_MODE_VIDEO)
+            update_sample_display(is, (int16_t *)is->audio_buf, audio_size);
+        audio_ring_write(&is->audio_ring, is->audio_buf, audio_size,
+                         is->audio_clock, is->audio_clock_serial);
+    }
+    return 0;
+}
+
+static void audio_fill_stop(VideoState *is)
+{
+    is->audio_ring.abort_request = 1;
+    queue_wake(&is->audio_ring.wait);
+    SDL_WaitThread(is->audio_fill_tid, NULL);
+    is->audio_fill_tid = NULL;
+}
+
+/* s16 samples times volume / SDL_MIX_MAXVOLUME (128), what
+ * SDL_MixAudioFormat() gives when mixing into silence */
+static void audio_gain_s16(int16_t *dst, const int16_t *src, int nb_samples, int volume)
+{
+    int i = 0;
+
+#if ARCH_AARCH64
+    /* doubling high half of the product with volume << 8 is * volume >> 7 */
+    int16x8_t gain = vdupq_n_s16(volume << 8);
+
+    for (; i + 16 <= nb_samples; i += 16) {
+        vst1q_s16(dst + i,     vqdmulhq_s16(vld1q_s16(src + i),     gain));
+        vst1q_s16(dst + i + 8, vqdmulhq_s16(vld1q_s16(src + i + 8), gain));
+    }
+#endif
+    for (; i < nb_samples; i++)
+        dst[i] = src[i] * volume >> 7;
+}
+
+/* Feed the device from the ring. Runs on SDL's audio thread: no locks, no
+ * allocations, and what is not in the ring yet is played as silence. */
 static void sdl_audio_callback(void *opaque, Uint8 *stream, int len)
 {
     VideoState *is = opaque;
-    int audio_size, len1;
+    AudioRing *r = &is->audio_ring;
+    int64_t rpos = atomic_load_explicit(&r->rpos, memory_order_relaxed);
+    int64_t wpos = atomic_load_explicit(&r->wpos, memory_order_acquire);
+    unsigned mark_r = atomic_load_explicit(&r->mark_r, memory_order_relaxed);
+    unsigned mark_w = atomic_load_explicit(&r->mark_w, memory_order_acquire);
+    int volume = is->muted ? 0 : is->audio_volume;
+    double clock;
+    int serial;
+    AudioMark *m;
+    int64_t end;
+    int len1, off;
 
     audio_callback_time = av_gettime_relative();
 
-    while (len > 0) {
-        if (is->audio_buf_index >= is->audio_buf_size) {
-           audio_size = audio_decode_frame(is);
-           if (audio_size < 0) {
-                /* if error, just output silence */
-               is->audio_buf = NULL;
-               is->audio_buf_size = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size;
-           } else {
-               if (is->show_mode != SHOW_MODE_VIDEO)
-                   update_sample_display(is, (int16_t *)is->audio_buf, audio_size);
-               is->audio_buf_size = audio_size;
-           }
-           is->audio_buf_index = 0;
-        }
-        len1 = is->audio_buf_size - is->audio_buf_index;
-        if (len1 > len)
-            len1 = len;
-        if (!is->muted && is->audio_buf && is->audio_volume == SDL_MIX_MAXVOLUME)
-            memcpy(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, len1);
-        else {
-            memset(stream, 0, len1);
-            if (!is->muted && is->audio_buf)
-                SDL_MixAudioFormat(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, AUDIO_S16SYS, len1, is->audio_volume);
-        }
-        len -= len1;
-        stream += len1;
-        is->audio_buf_index += len1;
-    }
-    is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
+    while (len > 0 && !is->paused && mark_r != mark_w) {
+        m = &r->marks[mark_r % AUDIO_RING_MARKS];
+        end = FFMIN(m->end, wpos);
+        if (m->serial != is->audioq.serial)     /* from before a seek */
+            rpos = end;
+        for (; len > 0 && rpos < end; len -= len1, stream += len1, rpos += len1) {
+            off = rpos & (r->size - 1);
+            len1 = FFMIN3(len, end - rpos, r->size - off);
+            if (volume == SDL_MIX_MAXVOLUME)
+                memcpy(stream, r->buf + off, len1);
+            else if (!volume)
+                memset(stream, 0, len1);
+            else
+                audio_gain_s16((int16_t *)stream, (const int16_t *)(r->buf + off), len1 / 2, volume);
+        }
+        if (rpos < m->end)
+            break;
+        r->clock = m->clock;
+        r->clock_serial = m->serial;
+        mark_r++;
+    }
+    memset(stream, 0, len);
+
+    /* the clock of what is played next */
+    if (mark_r != mark_w) {
+        m = &r->marks[mark_r % AUDIO_RING_MARKS];
+        clock = m->clock - (double)(m->end - rpos) / is->audio_tgt.bytes_per_sec;
+        serial = m->serial;
+    } else {
+        clock = r->clock;
+        serial = r->clock_serial;
+    }
+    is->audio_write_buf_size = wpos - rpos;
+
+    atomic_store_explicit(&r->mark_r, mark_r, memory_order_release);
+    atomic_store_explicit(&r->rpos, rpos, memory_order_release);
+    queue_wake(&r->wait);
+
     /* Let's assume the audio driver that is used by SDL has two periods. */
-    if (!isnan(is->audio_clock)) {
-        set_clock_at(&is->audclk, is->audio_clock - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
+    if (!isnan(clock)) {
+        set_clock_at(&is->audclk, clock - (double)(2 * is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec, serial, audio_callback_time / 1000000.0);
         sync_clock_to_slave(&is->extclk, &is->audclk);
     }
 }
@@ -2871,6 +4339,9 @@ static int stream_component_open(VideoState *is, int stream_index)
     const AVDictionaryEntry *t = NULL;
     int sample_rate;
     AVChannelLayout ch_layout = { 0 };
+    FramePool *frame_pool = NULL;
+    cpu_set_t cpu_old;
+    int cpu_pinned = 0;
     int ret = 0;
     int stream_lowres = lowres;
 
@@ -2920,13 +4391,30 @@ static int stream_component_open(VideoState *is, int stream_index)
     if (ret < 0)
         goto fail;
 
-    if (!av_dict_get(opts, "threads", NULL, 0))
-        av_dict_set(&opts, "threads", "auto", 0);
+    if (!av_dict_get(opts, "threads", NULL, 0)) {
+        if (avctx->codec_type == AVMEDIA_TYPE_VIDEO)
+            av_dict_set_int(&opts, "threads", decoder_thread_count(avctx), 0);
+        else
+            av_dict_set(&opts, "threads", "auto", 0);
+    }
     if (stream_lowres)
         av_dict_set_int(&opts, "lowres", stream_lowres, 0);
 
     av_dict_set(&opts, "flags", "+copy_opaque", AV_DICT_MULTIKEY);
 
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && (codec->capabilities & AV_CODEC_CAP_DR1)) {
+        if (!(frame_pool = frame_pool_alloc())) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        avctx->opaque      = frame_pool;
+        avctx->get_buffer2 = frame_pool_get_buffer;
+    }
+
+    /* the codec's threads, the decoder thread and SDL's audio thread are
+     * all started from here and take this placement */
+    cpu_pinned = cpu_pin(avctx->codec_type == AVMEDIA_TYPE_VIDEO ? CPU_BIG : CPU_LITTLE, &cpu_old);
+
     if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) {
         goto fail;
     }
@@ -2954,97 +4442,2177 @@ static int stream_component_open(VideoState *is, int stream_index)
             sample_rate    = av_buffersink_get_sample_rate(sink);
             ret = av_buffersink_get_ch_layout(sink, &ch_layout);
             if (ret < 0)
-                goto fail;
+                goto fail;
+        }
+
+        /* prepare audio output */
+        if ((ret = audio_open(is, &ch_layout, sample_rate, &is->audio_tgt)) < 0)
+            goto fail;
+        is->audio_hw_buf_size = ret;
+        is->audio_src = is->audio_tgt;
+        if ((ret = audio_ring_init(&is->audio_ring, AUDIO_RING_BUFFERS * is->audio_hw_buf_size)) < 0)
+            goto fail;
+
+        /* init averaging filter */
+        is->audio_diff_avg_coef  = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
+        is->audio_diff_avg_count = 0;
+        /* since we do not have a precise anough audio FIFO fullness,
+           we correct audio sync only if larger than this threshold */
+        is->audio_diff_threshold = (double)(is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
+
+        is->audio_stream = stream_index;
+        is->audio_st = ic->streams[stream_index];
+
+        if ((ret = decoder_init(&is->auddec, avctx, &is->audioq, &is->continue_read_thread,
+                                is->cenc ? is->cenc_key : NULL)) < 0)
+            goto fail;
+        if (is->ic->iformat->flags & AVFMT_NOTIMESTAMPS) {
+            is->auddec.start_pts = is->audio_st->start_time;
+            is->auddec.start_pts_tb = is->audio_st->time_base;
+        }
+        if ((ret = decoder_start(&is->auddec, audio_thread, "audio_decoder", is)) < 0)
+            goto out;
+        if (!(is->audio_fill_tid = SDL_CreateThread(audio_fill_thread, "audio_fill", is))) {
+            av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+            ret = AVERROR(ENOMEM);
+            goto out;
+        }
+        SDL_PauseAudioDevice(audio_dev, 0);
+        break;
+    case AVMEDIA_TYPE_VIDEO:
+        is->video_stream = stream_index;
+        is->video_st = ic->streams[stream_index];
+
+        if ((ret = decoder_init(&is->viddec, avctx, &is->videoq, &is->continue_read_thread,
+                                is->cenc ? is->cenc_key : NULL)) < 0)
+            goto fail;
+        is->viddec.frame_pool = frame_pool;
+        frame_pool = NULL;
+        if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
+            goto out;
+        is->queue_attachments_req = 1;
+        queue_signal(&is->continue_read_thread);
+        break;
+    case AVMEDIA_TYPE_SUBTITLE:
+        is->subtitle_stream = stream_index;
+        is->subtitle_st = ic->streams[stream_index];
+
+        if ((ret = decoder_init(&is->subdec, avctx, &is->subtitleq, &is->continue_read_thread,
+                                is->cenc ? is->cenc_key : NULL)) < 0)
+            goto fail;
+        if ((ret = decoder_start(&is->subdec, subtitle_thread, "subtitle_decoder", is)) < 0)
+            goto out;
+        break;
+    default:
+        break;
+    }
+    goto out;
+
+fail:
+    avcodec_free_context(&avctx);
+out:
+    if (cpu_pinned)
+        cpu_unpin(&cpu_old);
+    frame_pool_free(&frame_pool);
+    av_channel_layout_uninit(&ch_layout);
+    av_dict_free(&opts);
+
+    return ret;
+}
+
+static int decode_interrupt_cb(void *ctx)
+{
+    VideoState *is = ctx;
+
+    if (is->abort_request || (is->timeshift && is->timeshift->abort_request))
+        return 1;
+    /* stall watchdog: blocked on the input while playback runs dry */
+    if (stall_timeout > 0 && is->read_wait_start &&
+        av_gettime_relative() - is->read_wait_start > (int64_t)(stall_timeout * 1000000) &&
+        (is->timeshift || queued_duration(is) < STALL_QUEUE_LOW)) {
+        if (!is->stalled)
+            av_log(NULL, AV_LOG_WARNING, "%s: input stalled\n", is->filename);
+        is->stalled = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue, double min_duration) {
+    return stream_id < 0 ||
+           queue->abort_request ||
+           (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
+           queue->nb_packets > MIN_FRAMES && (!queue->duration || av_q2d(st->time_base) * queue->duration > min_duration);
+}
+
+static int64_t buffer_budget(VideoState *is)
+{
+    FILE *f = fopen("/proc/meminfo", "r");
+    char line[128];
+    int64_t avail = -1;
+
+    if (f) {
+        while (fgets(line, sizeof(line), f))
+            if (sscanf(line, "MemAvailable: %"SCNd64" kB", &avail) == 1)
+                break;
+        fclose(f);
+    }
+    if (avail < 0)
+        return BUFFER_BUDGET_MAX;
+    /* what the queues hold already counts as available to them */
+    avail = avail * 1024 + is->audioq.size + is->videoq.size + is->subtitleq.size;
+    return av_clip64(avail / BUFFER_MEM_SHARE, BUFFER_BUDGET_MIN, BUFFER_BUDGET_MAX);
+}
+
+/* whether the read thread should wait: the memory budget is used up, a queue
+ * is over its byte or duration cap (unless another one is starving), or
+ * every queue holds the policy's minimum */
+static int buffer_full(VideoState *is)
+{
+    const BufferPolicy *p = &buffer_policies[is->buffer_type];
+    PacketQueue *q[3] = { &is->videoq, &is->audioq, &is->subtitleq };
+    AVStream *st[3] = { is->video_st, is->audio_st, is->subtitle_st };
+    const int id[3] = { is->video_stream, is->audio_stream, is->subtitle_stream };
+    double min_duration = p->min_duration;
+    int i, over = 0, starving = 0, enough = 1;
+
+    /* -infbuf: never stop because there is enough, only at the caps */
+    if (infinite_buffer > 0 && !is->timeshift)
+        min_duration = 0;
+    if (q[0]->size + q[1]->size + q[2]->size > is->buffer_budget)
+        return 1;
+    for (i = 0; i < 3; i++) {
+        if (id[i] < 0 || !st[i])
+            continue;
+        if (q[i]->size > is->buffer_budget / 100 * buffer_share[i] ||
+            q[i]->duration * av_q2d(st[i]->time_base) > p->max_duration)
+            over = 1;
+        else if (i < 2 && q[i]->nb_packets < MIN_FRAMES)
+            starving = 1;
+        if (!stream_has_enough_packets(st[i], id[i], q[i], min_duration))
+            enough = 0;
+    }
+    return (over && !starving) || (min_duration > 0 && enough);
+}
+
+/* how long the read thread may sleep on full queues (us, -1 = until asked) */
+static int64_t buffer_full_wait(VideoState *is)
+{
+    PacketQueue *q[2] = { &is->videoq, &is->audioq };
+    AVStream *st[2] = { is->video_st, is->audio_st };
+    double queued = INFINITY;
+    int i;
+
+    /* nothing is taken from the queues until the stream is resumed */
+    if (is->paused)
+        return -1;
+    for (i = 0; i < 2; i++)
+        if (st[i] && !(st[i]->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            queued = FFMIN(queued, q[i]->duration * av_q2d(st[i]->time_base));
+    if (isinf(queued))
+        return READ_WAIT_MIN;
+    return av_clip64(queued * 1000000 / READ_WAIT_SHARE, READ_WAIT_MIN, READ_WAIT_MAX);
+}
+
+static int is_realtime(AVFormatContext *s)
+{
+    if(   !strcmp(s->iformat->name, "rtp")
+       || !strcmp(s->iformat->name, "rtsp")
+       || !strcmp(s->iformat->name, "sdp")
+    )
+        return 1;
+
+    if(s->pb && (   !strncmp(s->url, "rtp:", 4)
+                 || !strncmp(s->url, "udp:", 4)
+                )
+    )
+        return 1;
+    return 0;
+}
+
+static int prefetch_interrupt_cb(void *ctx)
+{
+    Prefetcher *pf = ctx;
+    return pf->abort;
+}
+
+/* unlink and free a segment, or leave that to the worker downloading it */
+static void prefetch_release(Prefetcher *pf, PrefetchSegment *seg)
+{
+    PrefetchSegment **p;
+
+    if (seg->state == PREFETCH_LOADING) {
+        seg->cancel = 1;
+        return;
+    }
+    for (p = &pf->segments; *p; p = &(*p)->next)
+        if (*p == seg) {
+            *p = seg->next;
+            break;
+        }
+    if (!seg->opened)
+        pf->bytes -= seg->alloc;
+    av_free(seg->url);
+    av_free(seg->data);
+    av_free(seg);
+    SDL_CondBroadcast(pf->cond);
+}
+
+static int prefetch_append(Prefetcher *pf, PrefetchSegment *seg, const uint8_t *buf, int len)
+{
+    if (seg->size + len + 1 > seg->alloc) {
+        size_t alloc = FFMAX(seg->alloc * 2, seg->size + len + 1);
+        uint8_t *data = av_realloc(seg->data, alloc);
+        if (!data)
+            return AVERROR(ENOMEM);
+        if (!seg->opened)
+            pf->bytes += alloc - seg->alloc;
+        seg->data = data;
+        seg->alloc = alloc;
+    }
+    memcpy(seg->data + seg->size, buf, len);
+    seg->size += len;
+    seg->data[seg->size] = 0;           /* playlists are parsed as text */
+    return 0;
+}
+
+static PrefetchSegment *prefetch_find(Prefetcher *pf, const char *url)
+{
+    PrefetchSegment *seg;
+
+    for (seg = pf->segments; seg; seg = seg->next)
+        if (!seg->cancel && !seg->opened && !strcmp(seg->url, url))
+            return seg;
+    return NULL;
+}
+
+/* drop downloads the demuxer went past without opening (seek, variant switch) */
+static void prefetch_evict_stale(Prefetcher *pf)
+{
+    PrefetchSegment *seg, *next;
+    int64_t now = av_gettime_relative();
+
+    for (seg = pf->segments; seg; seg = next) {
+        next = seg->next;
+        if (!seg->opened && !seg->cancel && seg->done_time &&
+            now - seg->done_time > PREFETCH_STALE)
+            prefetch_release(pf, seg);
+    }
+}
+
+static int prefetch_worker(void *arg);
+
+static void prefetch_queue(Prefetcher *pf, int list, const char *url)
+{
+    PrefetchSegment *seg, **p;
+
+    if (prefetch_find(pf, url))
+        return;
+    if (!(seg = av_mallocz(sizeof(*seg))) || !(seg->url = av_strdup(url))) {
+        av_free(seg);
+        return;
+    }
+    seg->list = list;
+    for (p = &pf->segments; *p; p = &(*p)->next)
+        ;
+    *p = seg;
+    /* workers start with the first segment worth fetching */
+    while (pf->nb_workers < FFMIN(prefetch_segments, PREFETCH_MAX_WORKERS)) {
+        if (!(pf->workers[pf->nb_workers] = SDL_CreateThread(prefetch_worker, "prefetch", pf)))
+            break;
+        pf->nb_workers++;
+    }
+    SDL_CondBroadcast(pf->cond);
+}
+
+/* remove "." and ".." segments from a URL path, in place */
+static void prefetch_dot_segments(char *path)
+{
+    char *end = path + strcspn(path, "?#");
+    char *in = path, *out = path;
+
+    while (in < end) {
+        char *next = in + 1 + strcspn(in + 1, "/?#");
+        int len = FFMIN(next, end) - in - 1;
+
+        next = FFMIN(next, end);
+        if (len == 2 && in[1] == '.' && in[2] == '.') {
+            while (out > path && *--out != '/')
+                ;
+        } else if (len != 1 || in[1] != '.') {
+            memmove(out, in, next - in);
+            out += next - in;
+            in = next;
+            continue;
+        }
+        in = next;
+        if (in == end)
+            *out++ = '/';
+    }
+    memmove(out, end, strlen(end) + 1);
+}
+
+/* absolute URL of a playlist entry, as the demuxer makes it */
+static void prefetch_resolve(char *buf, int size, const char *base, const char *rel)
+{
+    const char *scheme = strstr(base, "://");
+    size_t host, keep;
+
+    if (strstr(rel, "://") || !scheme) {
+        av_strlcpy(buf, rel, size);
+        return;
+    }
+    if (rel[0] == '/' && rel[1] == '/') {
+        av_strlcpy(buf, base, FFMIN(size, scheme - base + 2));
+        av_strlcat(buf, rel, size);
+        return;
+    }
+    host = scheme + 3 - base;
+    host += strcspn(base + host, "/?#");
+    keep = host;
+    if (rel[0] != '/') {
+        keep = strcspn(base, "?#");
+        while (keep > host && base[keep - 1] != '/')
+            keep--;
+    }
+    av_strlcpy(buf, base, FFMIN(size, keep + 1));
+    if (rel[0] != '/' && keep == host)
+        av_strlcat(buf, "/", size);
+    av_strlcat(buf, rel, size);
+    if (host < (size_t)size)
+        prefetch_dot_segments(buf + host);
+}
+
+static void prefetch_list_free(PrefetchList *l)
+{
+    int i;
+
+    for (i = 0; i < l->nb_segments; i++)
+        av_free(l->segments[i]);
+    av_freep(&l->segments);
+    l->nb_segments = 0;
+}
+
+/* segments after url in list l, copied into next[]; returns how many */
+static int prefetch_list_next(PrefetchList *l, const char *url, char **next)
+{
+    int i, n = 0, max = FFMIN(prefetch_segments, PREFETCH_MAX_WORKERS);
+
+    for (i = 0; i < l->nb_segments; i++)
+        if (!strcmp(l->segments[i], url))
+            break;
+    for (i++; i < l->nb_segments && n < max; i++)
+        if ((next[n] = av_strdup(l->segments[i])))
+            n++;
+    return n;
+}
+
+/* remember the segments of a media playlist the demuxer just read */
+static void prefetch_parse_playlist(Prefetcher *pf, const char *url, const char *base,
+                                    const char *text)
+{
+    char *copy = av_strdup(text), *line, *save = NULL;
+    char **segments = NULL, abs[MAX_URL_SIZE], *next[PREFETCH_MAX_WORKERS];
+    PrefetchList *l = NULL;
+    int i, n, nb = 0, entry = 0, byterange = 0;
+
+    if (!copy)
+        return;
+    for (line = av_strtok(copy, "\r\n", &save); line; line = av_strtok(NULL, "\r\n", &save)) {
+        size_t len;
+
+        line += strspn(line, " \t");
+        len = strlen(line);
+        while (len && (line[len - 1] == ' ' || line[len - 1] == '\t'))
+            line[--len] = 0;
+        if (av_strstart(line, "#EXT-X-BYTERANGE", NULL)) {
+            byterange = 1;              /* ranges of one file, nothing to fetch ahead */
+            break;
+        } else if (av_strstart(line, "#EXTINF", NULL)) {
+            entry = 1;
+        } else if (*line && *line != '#' && entry) {
+            char *s;
+            prefetch_resolve(abs, sizeof(abs), base, line);
+            if (!(s = av_strdup(abs)) || av_dynarray_add_nofree(&segments, &nb, s) < 0)
+                av_free(s);
+            entry = 0;
+        }
+    }
+    av_free(copy);
+    if (!nb || byterange) {             /* a master playlist, or not worth it */
+        for (i = 0; i < nb; i++)
+            av_free(segments[i]);
+        av_free(segments);
+        return;
+    }
+
+    for (i = 0; i < PREFETCH_LISTS && !l; i++)
+        if (pf->lists[i].url && !strcmp(pf->lists[i].url, url))
+            l = &pf->lists[i];
+    if (!l) {
+        l = &pf->lists[pf->next_list++ % PREFETCH_LISTS];
+        prefetch_list_free(l);
+        av_freep(&l->last);
+        av_free(l->url);
+        l->url = av_strdup(url);
+    }
+    prefetch_list_free(l);
+    l->segments = segments;
+    l->nb_segments = nb;
+
+    /* a live playlist reload: new segments may follow the one being played */
+    if (l->last) {
+        n = prefetch_list_next(l, l->last, next);
+        for (i = 0; i < n; i++) {
+            prefetch_queue(pf, l - pf->lists, next[i]);
+            av_free(next[i]);
+        }
+    }
+}
+
+/* p and url differ only in one number that grew: returns the step, with the
+ * position and length of the number in url */
+static int64_t prefetch_step(const char *p, const char *url, size_t *start, size_t *len)
+{
+    size_t i = 0, a, b;
+    int64_t step;
+
+    while (p[i] && p[i] == url[i])
+        i++;
+    while (i > 0 && av_isdigit(url[i - 1]))
+        i--;
+    if (!av_isdigit(p[i]) || !av_isdigit(url[i]))
+        return 0;
+    a = i + strspn(p + i, "0123456789");
+    b = i + strspn(url + i, "0123456789");
+    if (a - i > 18 || b - i > 18 || strcmp(p + a, url + b))
+        return 0;
+    step = strtoll(url + i, NULL, 10) - strtoll(p + i, NULL, 10);
+    *start = i;
+    *len = b - i;
+    return FFMAX(step, 0);
+}
+
+/* The segments expected after url: those following it in a known playlist,
+ * or the continuation of the numbering it shares with an earlier unlisted
+ * request (DASH templates). Fills next[], returns how many and sets *list
+ * to the id they are queued under. */
+static int prefetch_predict(Prefetcher *pf, const char *url, int hit, char **next, int *list)
+{
+    int i, j, n, max = FFMIN(prefetch_segments, PREFETCH_MAX_WORKERS);
+    PrefetchPattern *p;
+
+    *list = -1;
+    for (i = 0; i < PREFETCH_LISTS; i++) {
+        PrefetchList *l = &pf->lists[i];
+        for (j = 0; j < l->nb_segments; j++)
+            if (!strcmp(l->segments[j], url)) {
+                av_free(l->last);
+                l->last = av_strdup(url);
+                *list = i;
+                return prefetch_list_next(l, url, next);
+            }
+    }
+
+    for (i = 0; i < PREFETCH_PATTERNS; i++) {
+        size_t start, len;
+        int64_t step, value;
+        int width;
+
+        p = &pf->patterns[i];
+        if (!p->last)
+            continue;
+        if (!strcmp(p->last, url))
+            return 0;
+        if (!(step = prefetch_step(p->last, url, &start, &len)))
+            continue;
+        *list = PREFETCH_LISTS + i;
+        /* guesses that keep missing (variable $Time$ steps) are given up */
+        p->misses = hit ? 0 : p->misses + p->predicted;
+        p->predicted = 0;
+        av_free(p->last);
+        p->last = av_strdup(url);
+        if (p->misses >= 2 || !p->last)
+            return 0;
+        value = strtoll(url + start, NULL, 10);
+        width = len > 1 && url[start] == '0' ? (int)len : 0;
+        for (n = 0; n < max; n++)
+            if (!(next[n] = av_asprintf("%.*s%0*"PRId64"%s", (int)start, url, width,
+                                        value + step * (n + 1), url + start + len)))
+                break;
+        p->predicted = n > 0;
+        return n;
+    }
+
+    p = &pf->patterns[pf->next_pattern++ % PREFETCH_PATTERNS];
+    av_free(p->last);
+    p->last = av_strdup(url);
+    p->misses = p->predicted = 0;
+    return 0;
+}
+
+static int prefetch_read(void *opaque, uint8_t *buf, int size)
+{
+    PrefetchReader *r = opaque;
+    Prefetcher *pf = r->pf;
+    PrefetchSegment *seg = r->seg;
+    int ret;
+
+    SDL_LockMutex(pf->mutex);
+    while (r->pos >= seg->size && seg->state == PREFETCH_LOADING) {
+        if (r->icb->callback && r->icb->callback(r->icb->opaque)) {
+            SDL_UnlockMutex(pf->mutex);
+            return AVERROR_EXIT;
+        }
+        SDL_CondWaitTimeout(pf->cond, pf->mutex, 100);
+    }
+    if (r->pos < seg->size) {
+        ret = FFMIN(size, seg->size - r->pos);
+        memcpy(buf, seg->data + r->pos, ret);
+        r->pos += ret;
+    } else {
+        ret = seg->state == PREFETCH_FAILED ? seg->error : AVERROR_EOF;
+    }
+    SDL_UnlockMutex(pf->mutex);
+    return ret;
+}
+
+static int64_t prefetch_seek(void *opaque, int64_t offset, int whence)
+{
+    PrefetchReader *r = opaque;
+    int64_t ret = AVERROR(EINVAL);
+
+    SDL_LockMutex(r->pf->mutex);
+    whence &= ~AVSEEK_FORCE;
+    if (whence == AVSEEK_SIZE)
+        ret = r->seg->state == PREFETCH_DONE ? r->seg->size : AVERROR(ENOSYS);
+    else if (whence == SEEK_SET && offset >= 0 && offset <= r->seg->size)
+        ret = r->pos = offset;
+    SDL_UnlockMutex(r->pf->mutex);
+    return ret;
+}
+
+/* option lookups (location, cookies) on a playlist reach its connection */
+static void *prefetch_avio_child_next(void *obj, void *prev)
+{
+    AVIOContext *pb = obj;
+    PrefetchReader *r = pb->opaque;
+    return prev ? NULL : r->src;
+}
+
+static const AVClass prefetch_avio_class = {
+    .class_name = "prefetch",
+    .item_name  = av_default_item_name,
+    .version    = LIBAVUTIL_VERSION_INT,
+    .child_next = prefetch_avio_child_next,
+};
+
+static int prefetch_reader_open(Prefetcher *pf, AVFormatContext *s, AVIOContext **pb,
+                                PrefetchSegment *seg, AVIOContext *src)
+{
+    PrefetchReader *r = av_mallocz(sizeof(*r));
+    uint8_t *buf = av_malloc(PREFETCH_CHUNK);
+
+    *pb = NULL;
+    if (!r || !buf ||
+        !(*pb = avio_alloc_context(buf, PREFETCH_CHUNK, 0, r, prefetch_read, NULL, prefetch_seek))) {
+        av_free(r);
+        av_free(buf);
+        return AVERROR(ENOMEM);
+    }
+    r->pf = pf;
+    r->seg = seg;
+    r->src = src;
+    r->icb = &s->interrupt_callback;
+    (*pb)->av_class = &prefetch_avio_class;
+    (*pb)->seekable = 0;
+    return 0;
+}
+
+/* A media playlist is read in full here to learn its segments, then served
+ * from memory; anything else is handed back unread. */
+static int prefetch_peek(Prefetcher *pf, AVFormatContext *s, AVIOContext **pb, const char *url)
+{
+    PrefetchSegment *seg;
+    AVIOContext *src = *pb;
+    uint8_t head[7], *buf;
+    char *location = NULL;
+    int n = avio_read(*pb, head, sizeof(head)), ret = 0;
+
+    if (n < (int)sizeof(head) || memcmp(head, "#EXTM3U", sizeof(head))) {
+        AVDictionary *opts = NULL;
+
+        /* within the first buffer this always works */
+        if (n <= 0 || avio_seek(*pb, 0, SEEK_SET) == 0)
+            return 0;
+        SDL_LockMutex(pf->mutex);
+        av_dict_copy(&opts, pf->opts, 0);
+        SDL_UnlockMutex(pf->mutex);
+        pf->io_close2(s, *pb);
+        ret = pf->io_open(s, pb, url, AVIO_FLAG_READ, &opts);
+        av_dict_free(&opts);
+        return ret;
+    }
+
+    if (!(seg = av_mallocz(sizeof(*seg))) || !(buf = av_malloc(PREFETCH_CHUNK))) {
+        av_free(seg);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    seg->opened = 1;                    /* not one of the prefetched ones */
+    seg->state = PREFETCH_DONE;
+    ret = prefetch_append(pf, seg, head, n);
+    while (ret >= 0 && (n = avio_read(*pb, buf, PREFETCH_CHUNK)) > 0)
+        ret = prefetch_append(pf, seg, buf, n);
+    av_free(buf);
+    if (ret >= 0 && n < 0 && n != AVERROR_EOF)
+        ret = n;
+    if (ret < 0) {
+        prefetch_release(pf, seg);
+        goto fail;
+    }
+
+    /* the demuxer resolves entries against where a redirect ended up */
+    av_opt_get(*pb, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&location);
+    SDL_LockMutex(pf->mutex);
+    prefetch_parse_playlist(pf, url, location ? location : url, (const char *)seg->data);
+    SDL_UnlockMutex(pf->mutex);
+    av_free(location);
+
+    if ((ret = prefetch_reader_open(pf, s, pb, seg, src)) >= 0)
+        return 0;
+    prefetch_release(pf, seg);
+ fail:
+    pf->io_close2(s, src);
+    *pb = NULL;
+    return ret;
+}
+
+static int prefetch_io_open(AVFormatContext *s, AVIOContext **pb, const char *url,
+                            int flags, AVDictionary **options)
+{
+    Prefetcher *pf = s->opaque;
+    const char *proto = avio_find_protocol_name(url);
+    char *next[PREFETCH_MAX_WORKERS];
+    PrefetchSegment *seg, *p, *tmp;
+    int i, n, list, ret;
+
+    /* the input itself, byte ranges, encrypted and local segments go through */
+    if (pb == &s->pb || (flags & AVIO_FLAG_WRITE) || !proto || strncmp(proto, "http", 4) ||
+        (options && av_dict_get(*options, "offset", NULL, 0)))
+        return pf->io_open(s, pb, url, flags, options);
+    /* the demuxer would try to reuse our segment contexts as HTTP connections */
+    if (s->iformat && !strcmp(s->iformat->name, "hls"))
+        av_opt_set_int(s->priv_data, "http_persistent", 0, 0);
+
+    SDL_LockMutex(pf->mutex);
+    if (options) {
+        av_dict_free(&pf->opts);
+        av_dict_copy(&pf->opts, *options, 0);
+        av_dict_set(&pf->opts, "multiple_requests", NULL, 0);
+    }
+    /* not started yet: a direct open is no slower */
+    if ((seg = prefetch_find(pf, url)) && (seg->state == PREFETCH_QUEUED ||
+                                           seg->state == PREFETCH_FAILED)) {
+        prefetch_release(pf, seg);
+        seg = NULL;
+    }
+    if (seg) {
+        seg->opened = 1;
+        pf->bytes -= seg->alloc;
+    }
+    n = prefetch_predict(pf, url, !!seg, next, &list);
+    if (list >= 0) {
+        for (p = pf->segments; p; p = tmp) {
+            tmp = p->next;
+            if (p->list != list || p->opened || p->cancel)
+                continue;
+            for (i = 0; i < n && strcmp(p->url, next[i]); i++)
+                ;
+            if (i == n)
+                prefetch_release(pf, p);
+        }
+        for (i = 0; i < n; i++)
+            prefetch_queue(pf, list, next[i]);
+    }
+    for (i = 0; i < n; i++)
+        av_free(next[i]);
+    prefetch_evict_stale(pf);
+    SDL_UnlockMutex(pf->mutex);
+
+    if (seg) {
+        if ((ret = prefetch_reader_open(pf, s, pb, seg, NULL)) < 0) {
+            SDL_LockMutex(pf->mutex);
+            prefetch_release(pf, seg);
+            SDL_UnlockMutex(pf->mutex);
+        }
+        return ret;
+    }
+    if ((ret = pf->io_open(s, pb, url, flags, options)) < 0)
+        return ret;
+    return prefetch_peek(pf, s, pb, url);
+}
+
+static int prefetch_io_close2(AVFormatContext *s, AVIOContext *pb)
+{
+    Prefetcher *pf = s->opaque;
+    PrefetchReader *r;
+
+    if (!pb || pb->av_class != &prefetch_avio_class)
+        return pf->io_close2(s, pb);
+    r = pb->opaque;
+    if (r->src)
+        pf->io_close2(s, r->src);
+    SDL_LockMutex(pf->mutex);
+    prefetch_release(pf, r->seg);
+    SDL_UnlockMutex(pf->mutex);
+    av_freep(&pb->buffer);
+    avio_context_free(&pb);
+    av_free(r);
+    return 0;
+}
+
+/* request url on *conn, over the same connection when it is to the same server */
+static int prefetch_connect(Prefetcher *pf, AVIOContext **conn, char *origin, int origin_size,
+                            const char *url)
+{
+    char proto[16], host[256], o[300];
+    AVDictionary *opts = NULL;
+    int port, ret;
+
+    av_url_split(proto, sizeof(proto), NULL, 0, host, sizeof(host), &port, NULL, 0, url);
+    snprintf(o, sizeof(o), "%s://%s:%d", proto, host, port);
+    SDL_LockMutex(pf->mutex);
+    av_dict_copy(&opts, pf->opts, 0);
+    SDL_UnlockMutex(pf->mutex);
+    av_dict_set(&opts, "offset", "0", 0);  /* not carried over from the last request */
+#if CONFIG_HTTP_PROTOCOL
+    if (*conn && !strcmp(origin, o) && ffio_geturlcontext(*conn)) {
+        (*conn)->eof_reached = 0;
+        if (ff_http_do_new_request2(ffio_geturlcontext(*conn), url, &opts) >= 0) {
+            av_dict_free(&opts);
+            return 0;
+        }
+    }
+#endif
+    avio_closep(conn);
+    av_dict_set(&opts, "multiple_requests", "1", 0);
+    ret = avio_open2(conn, url, AVIO_FLAG_READ, &pf->icb, &opts);
+    av_dict_free(&opts);
+    av_strlcpy(origin, o, origin_size);
+    return ret;
+}
+
+/* download a segment; if it breaks before the demuxer gets to it, start over
+ * on a fresh connection */
+static int prefetch_fetch(Prefetcher *pf, PrefetchSegment *seg, AVIOContext **conn,
+                          char *origin, int origin_size)
+{
+    uint8_t *buf = av_malloc(PREFETCH_CHUNK);
+    int ret = AVERROR(ENOMEM), tries = 0, n, restart;
+
+    if (!buf)
+        return ret;
+    for (;;) {
+        if ((ret = prefetch_connect(pf, conn, origin, origin_size, seg->url)) < 0)
+            break;
+        while (ret >= 0) {
+            SDL_LockMutex(pf->mutex);
+            if (!pf->bw_active++)
+                pf->bw_busy_since = av_gettime_relative();
+            SDL_UnlockMutex(pf->mutex);
+            n = avio_read_partial(*conn, buf, PREFETCH_CHUNK);
+            SDL_LockMutex(pf->mutex);
+            /* parallel downloads share the link: count the time, not each one's */
+            if (!--pf->bw_active)
+                pf->bw_time += av_gettime_relative() - pf->bw_busy_since;
+            if (n <= 0) {
+                SDL_UnlockMutex(pf->mutex);
+                ret = n == 0 || n == AVERROR_EOF ? 1 : n;
+                break;
+            }
+            pf->bw_bytes += n;
+            ret = seg->cancel ? AVERROR_EXIT : prefetch_append(pf, seg, buf, n);
+            SDL_CondBroadcast(pf->cond);
+            SDL_UnlockMutex(pf->mutex);
+        }
+        if (ret > 0) {
+            ret = 0;
+            break;
+        }
+        if (ret == AVERROR_EXIT || pf->abort || ++tries > PREFETCH_RETRIES)
+            break;
+        SDL_LockMutex(pf->mutex);
+        if ((restart = !seg->opened))
+            seg->size = 0;
+        SDL_UnlockMutex(pf->mutex);
+        if (!restart)
+            break;
+        avio_closep(conn);
+    }
+    av_free(buf);
+    return ret;
+}
+
+static int prefetch_worker(void *arg)
+{
+    Prefetcher *pf = arg;
+    AVIOContext *conn = NULL;
+    char origin[300] = "";
+    PrefetchSegment *seg;
+    int ret;
+
+    SDL_LockMutex(pf->mutex);
+    while (!pf->abort) {
+        for (seg = pf->segments; seg; seg = seg->next)
+            if (seg->state == PREFETCH_QUEUED)
+                break;
+        if (!seg || pf->bytes >= PREFETCH_MAX_BYTES) {
+            prefetch_evict_stale(pf);
+            SDL_CondWaitTimeout(pf->cond, pf->mutex, 1000);
+            continue;
+        }
+        seg->state = PREFETCH_LOADING;
+        SDL_UnlockMutex(pf->mutex);
+        ret = prefetch_fetch(pf, seg, &conn, origin, sizeof(origin));
+        if (ret < 0)                    /* the connection may be mid-response */
+            avio_closep(&conn);
+        SDL_LockMutex(pf->mutex);
+        seg->state = ret < 0 ? PREFETCH_FAILED : PREFETCH_DONE;
+        seg->error = ret;
+        seg->done_time = av_gettime_relative();
+        if (seg->cancel)
+            prefetch_release(pf, seg);
+        SDL_CondBroadcast(pf->cond);
+    }
+    SDL_UnlockMutex(pf->mutex);
+    avio_closep(&conn);
+    return 0;
+}
+
+/* Adds what the workers downloaded since the last call, and for how long,
+ * to *bytes and *time. Returns 0 if ic has no prefetcher. */
+static int prefetch_throughput(AVFormatContext *ic, int64_t *bytes, int64_t *time)
+{
+    Prefetcher *pf = ic && ic->io_open == prefetch_io_open ? ic->opaque : NULL;
+    int64_t now = av_gettime_relative();
+
+    if (!pf)
+        return 0;
+    SDL_LockMutex(pf->mutex);
+    if (pf->bw_active) {
+        pf->bw_time += now - pf->bw_busy_since;
+        pf->bw_busy_since = now;
+    }
+    *bytes += pf->bw_bytes;
+    *time  += pf->bw_time;
+    pf->bw_bytes = pf->bw_time = 0;
+    SDL_UnlockMutex(pf->mutex);
+    return 1;
+}
+
+static void prefetch_free(Prefetcher *pf)
+{
+    int i;
+
+    SDL_LockMutex(pf->mutex);
+    pf->abort = 1;
+    SDL_CondBroadcast(pf->cond);
+    SDL_UnlockMutex(pf->mutex);
+    for (i = 0; i < pf->nb_workers; i++)
+        SDL_WaitThread(pf->workers[i], NULL);
+    while (pf->segments)
+        prefetch_release(pf, pf->segments);
+    for (i = 0; i < PREFETCH_LISTS; i++) {
+        prefetch_list_free(&pf->lists[i]);
+        av_free(pf->lists[i].url);
+        av_free(pf->lists[i].last);
+    }
+    for (i = 0; i < PREFETCH_PATTERNS; i++)
+        av_free(pf->patterns[i].last);
+    av_dict_free(&pf->opts);
+    SDL_DestroyCond(pf->cond);
+    SDL_DestroyMutex(pf->mutex);
+    av_free(pf);
+}
+
+/* avformat_open_input() with the segment opens of the demuxer hooked */
+static int input_open(AVFormatContext **ic, const char *url, const AVInputFormat *fmt,
+                      AVDictionary **opts)
+{
+    Prefetcher *pf = NULL;
+    int ret;
+
+    if (prefetch_segments > 0 && (pf = av_mallocz(sizeof(*pf)))) {
+        pf->mutex = SDL_CreateMutex();
+        pf->cond = SDL_CreateCond();
+        if (!pf->mutex || !pf->cond) {
+            prefetch_free(pf);
+            pf = NULL;
+        }
+    }
+    if (pf) {
+        pf->icb.callback = prefetch_interrupt_cb;
+        pf->icb.opaque = pf;
+        pf->io_open = (*ic)->io_open;
+        pf->io_close2 = (*ic)->io_close2;
+        (*ic)->opaque = pf;
+        (*ic)->io_open = prefetch_io_open;
+        (*ic)->io_close2 = prefetch_io_close2;
+    }
+    ret = avformat_open_input(ic, url, fmt, opts);
+    if (ret < 0 && pf)
+        prefetch_free(pf);
+    return ret;
+}
+
+static void input_close(AVFormatContext **ic)
+{
+    Prefetcher *pf = *ic && (*ic)->io_open == prefetch_io_open ? (*ic)->opaque : NULL;
+
+    avformat_close_input(ic);
+    if (pf)
+        prefetch_free(pf);
+}
+
+/* format options for a channel: the command line ones, without the
+ * ClearKey, which goes to the decoders (zap_cenc_key()) */
+static void zap_input_opts(AVDictionary **opts)
+{
+    av_dict_copy(opts, format_opts, 0);
+    av_dict_set(opts, "cenc_decryption_key", NULL, 0);
+}
+
+/* the channel's own key, else -cenc_decryption_key: 32 hex digits */
+static int zap_cenc_key(int index, uint8_t *key)
+{
+    const AVDictionaryEntry *e = av_dict_get(format_opts, "cenc_decryption_key", NULL, 0);
+    const char *hex = e ? e->value : NULL;
+    int i, c, v;
+
+    if (index >= 0 && index < zap_count)
+        hex = zap_channels[index].key;
+    if (!hex || !hex[0])
+        return 0;
+    for (i = 0; i < 32; i++) {
+        c = av_tolower(hex[i]);
+        v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (v < 0)
+            break;
+        key[i / 2] = i & 1 ? key[i / 2] | v : v << 4;
+    }
+    if (i < 32 || hex[32]) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid ClearKey '%s': 32 hex digits expected\n", hex);
+        return 0;
+    }
+    return 1;
+}
+
+static int zap_prefetch_interrupt_cb(void *ctx)
+{
+    ZapPrefetch *p = ctx;
+    return p->abort_request;
+}
+
+/* open and probe a neighbour channel, same as read_thread does */
+static int zap_prefetch_thread(void *arg)
+{
+    ZapPrefetch *p = arg;
+    AVFormatContext *ic = avformat_alloc_context();
+    AVDictionary *opts = NULL;
+    QueueWait *waker;
+    int err, i;
+
+    cpu_pin(CPU_LITTLE, NULL);
+
+    if (!ic)
+        goto done;
+    ic->interrupt_callback.callback = zap_prefetch_interrupt_cb;
+    ic->interrupt_callback.opaque = p;
+    zap_input_opts(&opts);
+    av_dict_set(&opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+    err = input_open(&ic, zap_channels[p->index].url, file_iformat, &opts);
+    av_dict_free(&opts);
+    if (err < 0)
+        goto done;
+
+    if (find_stream_info) {
+        AVDictionary **sopts;
+        int orig_nb_streams = ic->nb_streams;
+
+        err = setup_find_stream_info_opts(ic, codec_opts, &sopts);
+        if (err >= 0) {
+            err = avformat_find_stream_info(ic, sopts);
+            for (i = 0; i < orig_nb_streams; i++)
+                av_dict_free(&sopts[i]);
+            av_freep(&sopts);
+        }
+        if (err < 0) {
+            input_close(&ic);
+            goto done;
+        }
+    }
+    p->ic = ic;
+
+ done:
+    p->ready_time = av_gettime_relative();
+    SDL_AtomicSet(&p->done, 1);
+    /* either zap_prefetch_take() sees done or this sees its waker */
+    atomic_thread_fence(memory_order_seq_cst);
+    waker = atomic_load(&p->waker);
+    if (waker)
+        queue_signal(waker);
+    return 0;
+}
+
+static void zap_prefetch_release(ZapPrefetch *p)
+{
+    if (!p->thread)
+        return;
+    p->abort_request = 1;
+    SDL_WaitThread(p->thread, NULL);
+    p->thread = NULL;
+    input_close(&p->ic);
+    p->index = -1;
+}
+
+static void zap_prefetch_start(ZapPrefetch *p, int index)
+{
+    p->index = index;
+    p->ic = NULL;
+    p->abort_request = 0;
+    SDL_AtomicSet(&p->done, 0);
+    atomic_store(&p->waker, NULL);
+    p->thread = SDL_CreateThread(zap_prefetch_thread, "zap_prefetch", p);
+    if (!p->thread)
+        p->index = -1;
+}
+
+/* next channel dir steps away, skipping dead ones unless all are */
+static int zap_step(int index, int dir)
+{
+    int i, next = index;
+
+    for (i = 0; i < zap_count; i++) {
+        next = (next + dir + zap_count) % zap_count;
+        if (!zap_channels[next].dead)
+            return next;
+    }
+    return (index + dir + zap_count) % zap_count;
+}
+
+/* (re)fill the slots with the current channel's neighbours once it plays */
+static void zap_prefetch_update(void)
+{
+    int want[2], i, j;
+
+    if (zap_count < 2 || !zap_prefetch_due || av_gettime_relative() < zap_prefetch_due)
+        return;
+    zap_prefetch_due = 0;
+
+    want[0] = zap_step(zap_index, 1);
+    want[1] = zap_step(zap_index, -1);
+
+    for (i = 0; i < ZAP_PREFETCH_SLOTS; i++) {
+        ZapPrefetch *p = &zap_prefetch[i];
+        if (p->thread && !SDL_AtomicGet(&p->owned) &&
+            p->index != want[0] && p->index != want[1])
+            zap_prefetch_release(p);
+    }
+
+    for (j = 0; j < 2; j++) {
+        ZapPrefetch *free_slot = NULL;
+        int found = 0;
+
+        if (want[j] == zap_index || (j == 1 && want[1] == want[0]))
+            continue;
+        for (i = 0; i < ZAP_PREFETCH_SLOTS; i++) {
+            ZapPrefetch *p = &zap_prefetch[i];
+            if (p->thread && p->index == want[j])
+                found = 1;
+            else if (!p->thread && !SDL_AtomicGet(&p->owned) && !free_slot)
+                free_slot = p;
+        }
+        if (!found && free_slot)
+            zap_prefetch_start(free_slot, want[j]);
+    }
+}
+
+/* Called by read_thread for the slot it was handed: wait for the probe to
+ * finish and take over its demuxer. Returns NULL if the open failed. Sleeps
+ * on continue_read_thread, which the probe thread signals when done and
+ * stream_close() on abort. */
+static AVFormatContext *zap_prefetch_take(ZapPrefetch *p, VideoState *is)
+{
+    AVFormatContext *ic;
+    unsigned seq;
+
+    atomic_store(&p->waker, &is->continue_read_thread);
+    for (;;) {
+        seq = atomic_load(&is->continue_read_thread.seq);
+        if (SDL_AtomicGet(&p->done) || is->abort_request)
+            break;
+        queue_wait_timeout(&is->continue_read_thread, seq, -1);
+    }
+    atomic_store(&p->waker, NULL);
+    if (is->abort_request)
+        p->abort_request = 1;
+    SDL_WaitThread(p->thread, NULL);
+    ic = p->ic;
+    p->ic = NULL;
+    p->thread = NULL;
+    p->index = -1;
+    if (is->abort_request)
+        input_close(&ic);
+    SDL_AtomicSet(&p->owned, 0);
+    return ic;
+}
+
+static int variant_annexb(const AVCodecParameters *par)
+{
+    const uint8_t *p = par->extradata;
+    return par->extradata_size >= 4 && !p[0] && !p[1] && (p[2] == 1 || (!p[2] && p[3] == 1));
+}
+
+/* a variant stream can feed the decoder opened for another one */
+static int variant_compatible(AVStream *a, AVStream *b)
+{
+    AVCodecParameters *pa = a->codecpar, *pb = b->codecpar;
+
+    if (pa->codec_type != pb->codec_type || pa->codec_id != pb->codec_id ||
+        av_cmp_q(a->time_base, b->time_base))
+        return 0;
+    if (pa->extradata_size == pb->extradata_size &&
+        (!pa->extradata_size || !memcmp(pa->extradata, pb->extradata, pa->extradata_size)))
+        return 1;
+    /* Annex B video repeats its parameter sets in band (MPEG-TS segments) */
+    return variant_annexb(pa) && variant_annexb(pb);
+}
+
+static int variant_cmp(const void *a, const void *b)
+{
+    const Variant *va = a, *vb = b;
+    return (va->bitrate > vb->bitrate) - (va->bitrate < vb->bitrate);
+}
+
+/* enable the streams of the variant being played and of the one being switched to */
+static void variant_apply(VideoState *is)
+{
+    AVFormatContext *ic = is->ic;
+    Variant *cur = &is->variants[is->variant];
+    Variant *next = is->variant_next >= 0 ? &is->variants[is->variant_next] : NULL;
+    int i;
+
+    /* streams that show up later are not part of any known variant */
+    for (i = 0; i < ic->nb_streams; i++) {
+        int used = i < is->nb_stream_alias &&
+                   (i == cur->video || i == cur->audio || i == is->subtitle_stream ||
+                    (next && (i == next->video || i == next->audio)));
+        ic->streams[i]->discard = used ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    for (i = 0; i < is->nb_stream_alias; i++)
+        is->stream_alias[i] = -1;
+    is->stream_alias[cur->video] = is->video_stream;
+    if (cur->audio >= 0)
+        is->stream_alias[cur->audio] = is->audio_stream;
+    if (is->subtitle_stream >= 0)
+        is->stream_alias[is->subtitle_stream] = is->subtitle_stream;
+}
+
+static void variant_switch(VideoState *is, int index, int now)
+{
+    Variant *v = &is->variants[index];
+
+    av_log(NULL, AV_LOG_INFO, "variant: %s %dp %"PRId64" kbit/s (measured %.0f kbit/s)\n",
+           now ? "playing" : "switching to", v->height, v->bitrate / 1000, is->bandwidth / 1000);
+    if (now)
+        is->variant = index;
+    is->variant_next = now ? -1 : index;
+    is->variant_switch_time = av_gettime_relative();
+    is->variant_up_since = 0;
+    variant_apply(is);
+}
+
+/* collect the variants the open decoders can play and start with the best
+ * one that fits the screen; throughput decides from there */
+static void variant_init(VideoState *is)
+{
+    AVFormatContext *ic = is->ic;
+    AVStream *vst, *ast;
+    int i, j, best = 0;
+
+    if (!variant_select || strcmp(ic->iformat->name, "hls") || ic->nb_programs < 2 ||
+        is->video_stream < 0)
+        return;
+    vst = ic->streams[is->video_stream];
+    ast = is->audio_stream >= 0 ? ic->streams[is->audio_stream] : NULL;
+
+    for (i = 0; i < ic->nb_programs; i++) {
+        AVProgram *p = ic->programs[i];
+        AVDictionaryEntry *e = av_dict_get(p->metadata, "variant_bitrate", NULL, 0);
+        Variant v = { i, e ? strtoll(e->value, NULL, 10) : 0, 0, -1, -1 };
+
+        for (j = 0; j < p->nb_stream_indexes; j++) {
+            int idx = p->stream_index[j];
+            AVStream *st = ic->streams[idx];
+            if (v.video < 0 && variant_compatible(vst, st)) {
+                v.video = idx;
+                v.height = st->codecpar->height;
+            } else if (ast && v.audio < 0 && variant_compatible(ast, st)) {
+                v.audio = idx;
+            }
+        }
+        if (v.video < 0 || (ast && v.audio < 0))
+            continue;
+        if (av_dynarray2_add((void **)&is->variants, &is->nb_variants, sizeof(v), (uint8_t *)&v) == NULL)
+            break;
+    }
+    if (is->nb_variants < 2 || !(is->stream_alias = av_malloc_array(ic->nb_streams, sizeof(*is->stream_alias)))) {
+        av_freep(&is->variants);
+        is->nb_variants = 0;
+        return;
+    }
+    is->nb_stream_alias = ic->nb_streams;
+    qsort(is->variants, is->nb_variants, sizeof(*is->variants), variant_cmp);
+    for (i = 0; i < is->nb_variants; i++)
+        if (!panel_height || is->variants[i].height <= panel_height)
+            best = i;
+    is->alias_last_dts[0] = is->alias_last_dts[1] = AV_NOPTS_VALUE;
+    variant_switch(is, best, 1);
+}
+
+/* pick the variant the measured throughput can carry */
+static void variant_update(VideoState *is)
+{
+    int64_t now = av_gettime_relative();
+    int cap = 0, target = is->variant, i;
+    double buffered = queued_duration(is);
+
+    if (is->variant_next >= 0) {
+        /* the new variant never delivered a keyframe: stay */
+        if (now - is->variant_switch_time > 2 * VARIANT_SETTLE) {
+            is->variant_next = -1;
+            variant_apply(is);
+        }
+        return;
+    }
+    if (now - is->variant_switch_time < VARIANT_SETTLE || !is->bandwidth)
+        return;
+    for (i = 0; i < is->nb_variants; i++)
+        if (!panel_height || is->variants[i].height <= panel_height)
+            cap = i;
+
+    if (is->bandwidth < is->variants[is->variant].bitrate * VARIANT_DOWN_MARGIN ||
+        (!is->timeshift && buffered < STALL_QUEUE_LOW)) {
+        /* down right away, to what fits, at least one step when running dry */
+        for (target = 0, i = 1; i < is->variant; i++)
+            if (is->variants[i].bitrate * VARIANT_DOWN_MARGIN <= is->bandwidth)
+                target = i;
+        is->variant_up_since = 0;
+    } else if (is->variant < cap &&
+               is->bandwidth > is->variants[is->variant + 1].bitrate * VARIANT_UP_MARGIN &&
+               (is->timeshift || buffered >= BUFFER_HEALTHY)) {
+        /* up one step once the headroom has lasted */
+        if (!is->variant_up_since)
+            is->variant_up_since = now;
+        else if (now - is->variant_up_since > VARIANT_UP_DELAY)
+            target = is->variant + 1;
+    } else {
+        is->variant_up_since = 0;
+    }
+    if (target != is->variant)
+        variant_switch(is, target, 0);
+}
+
+/* account a packet read from the network in elapsed microseconds and route it
+ * to its decoder stream; returns 0 if it is to be dropped */
+static int variant_packet(VideoState *is, AVPacket *pkt, int64_t elapsed)
+{
+    int64_t now = av_gettime_relative(), dts;
+    int prefetched = is->ic->io_open == prefetch_io_open;
+    int alias, k;
+
+    if (!is->variants)
+        return 1;
+
+    /* throughput: only time spent reading counts, waits for new segments
+     * don't. Prefetched segments come from memory, so then it is the
+     * workers' downloads that count. */
+    if (!prefetched && elapsed < VARIANT_MAX_READ) {
+        is->bw_bytes += pkt->size;
+        is->bw_time  += elapsed;
+    }
+    if (!is->bw_window_start) {
+        is->bw_window_start = now;
+    } else if (now - is->bw_window_start > VARIANT_WINDOW) {
+        if (prefetched)
+            prefetch_throughput(is->ic, &is->bw_bytes, &is->bw_time);
+        if (is->bw_time > VARIANT_WINDOW / 40) {
+            double sample = is->bw_bytes * 8.0 * 1000000 / is->bw_time;
+            is->bandwidth = is->bandwidth ? 0.7 * is->bandwidth + 0.3 * sample : sample;
+        }
+        is->bw_bytes = is->bw_time = 0;
+        is->bw_window_start = now;
+        variant_update(is);
+    }
+
+    if (pkt->stream_index >= is->nb_stream_alias)
+        return 0;
+    dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (dts != AV_NOPTS_VALUE)
+        dts = av_rescale_q(dts, is->ic->streams[pkt->stream_index]->time_base, AV_TIME_BASE_Q);
+
+    if (is->variant_next >= 0 && pkt->stream_index == is->variants[is->variant_next].video &&
+        (pkt->flags & AV_PKT_FLAG_KEY) &&
+        (dts == AV_NOPTS_VALUE || is->alias_last_dts[0] == AV_NOPTS_VALUE || dts >= is->alias_last_dts[0])) {
+        is->variant = is->variant_next;
+        is->variant_next = -1;
+        variant_apply(is);
+        av_log(NULL, AV_LOG_INFO, "variant: now %dp\n", is->variants[is->variant].height);
+    }
+
+    alias = is->stream_alias[pkt->stream_index];
+    if (alias < 0)
+        return 0;
+    /* the new variant starts at its segment start, a little before the switch */
+    k = alias == is->video_stream ? 0 : alias == is->audio_stream ? 1 : -1;
+    if (k >= 0 && dts != AV_NOPTS_VALUE) {
+        int64_t last = is->alias_last_dts[k];
+        if (last != AV_NOPTS_VALUE && dts < last && last - dts < VARIANT_OVERLAP)
+            return 0;
+        is->alias_last_dts[k] = dts;
+    }
+    pkt->stream_index = alias;
+    return 1;
+}
+
+/* whether a failed read means the connection is gone: the watchdog fired,
+ * the I/O failed, or a live input has had nothing for -stall_timeout */
+static int input_lost(VideoState *is, int live, int64_t idle_since)
+{
+    if (stall_timeout <= 0 || is->abort_request)
+        return 0;
+    return is->stalled || (is->ic->pb && is->ic->pb->error) ||
+           (live && av_gettime_relative() - idle_since > (int64_t)(stall_timeout * 1000000));
+}
+
+/* same layout as the input it replaces, so the open decoders can go on */
+static int reconnect_compatible(VideoState *is, AVFormatContext *nic)
+{
+    const int streams[3] = { is->video_stream, is->audio_stream, is->subtitle_stream };
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        AVStream *old, *st;
+        if (streams[i] < 0)
+            continue;
+        if (streams[i] >= nic->nb_streams)
+            return 0;
+        old = is->ic->streams[streams[i]];
+        st  = nic->streams[streams[i]];
+        if (st->codecpar->codec_type != old->codecpar->codec_type ||
+            st->codecpar->codec_id   != old->codecpar->codec_id ||
+            av_cmp_q(st->time_base, old->time_base))
+            return 0;
+    }
+    return 1;
+}
+
+/* Reopen a dropped or stalled input in place: the decoders, the window and
+ * the last frame stay; VOD resumes at what was on screen, live at the edge.
+ * Called by the thread that reads the input. */
+static int input_reconnect(VideoState *is, int live)
+{
+    AVFormatContext *nic = NULL;
+    AVDictionary *opts = NULL;
+    double pos = get_master_clock(is);
+    int i, ret = AVERROR(EIO);
+
+    is->stalled = 0;
+    is->read_wait_start = 0;
+    is->reconnecting = 1;
+    is->force_refresh = 1;      /* OSD over the last frame */
+    refresh_wake();
+    while (!is->abort_request && is->reconnect_tries < RECONNECT_MAX_TRIES) {
+        int delay = FFMIN(1000 << is->reconnect_tries, RECONNECT_MAX_DELAY);
+        is->reconnect_tries++;
+        for (i = 0; i < delay && !is->abort_request; i += 100)
+            SDL_Delay(100);
+        if (is->abort_request)
+            break;
+        av_log(NULL, AV_LOG_INFO, "%s: reconnecting (try %d)\n", is->filename, is->reconnect_tries);
+
+        if (!(nic = avformat_alloc_context())) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        nic->interrupt_callback.callback = decode_interrupt_cb;
+        nic->interrupt_callback.opaque = is;
+        zap_input_opts(&opts);
+        av_dict_set(&opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+        ret = input_open(&nic, is->filename, is->iformat, &opts);
+        av_dict_free(&opts);
+        if (ret >= 0 && find_stream_info) {
+            AVDictionary **sopts;
+            int orig_nb_streams = nic->nb_streams;
+            if ((ret = setup_find_stream_info_opts(nic, codec_opts, &sopts)) >= 0) {
+                ret = avformat_find_stream_info(nic, sopts);
+                for (i = 0; i < orig_nb_streams; i++)
+                    av_dict_free(&sopts[i]);
+                av_freep(&sopts);
+            }
+        }
+        if (ret >= 0 && !reconnect_compatible(is, nic))
+            ret = AVERROR(EINVAL);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_WARNING, "%s: reconnect failed: %s\n", is->filename, av_err2str(ret));
+            input_close(&nic);
+            continue;
+        }
+
+        for (i = 0; i < nic->nb_streams; i++)
+            nic->streams[i]->discard = (i == is->video_stream || i == is->audio_stream ||
+                                        i == is->subtitle_stream) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+        if (nic->pb)
+            nic->pb->eof_reached = 0;
+        if (!live && !isnan(pos) &&
+            avformat_seek_file(nic, -1, INT64_MIN, (int64_t)(pos * AV_TIME_BASE),
+                               (int64_t)(pos * AV_TIME_BASE), 0) < 0)
+            av_log(NULL, AV_LOG_WARNING, "%s: could not resume at %0.3f\n", is->filename, pos);
+
+        /* The other threads may still hold the old input or its streams:
+         * it is only freed once they have all stopped, in stream_close() */
+        if (av_dynarray_add_nofree(&is->ic_retired, &is->nb_ic_retired, is->ic) < 0) {
+            input_close(&nic);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        if (is->video_stream >= 0)
+            is->video_st = nic->streams[is->video_stream];
+        if (is->audio_stream >= 0)
+            is->audio_st = nic->streams[is->audio_stream];
+        if (is->subtitle_stream >= 0)
+            is->subtitle_st = nic->streams[is->subtitle_stream];
+        is->ic = nic;
+        if (is->variants) {
+            is->variant_next = -1;
+            variant_apply(is);
+        }
+
+        if (live) {
+            /* the new connection starts mid-GOP; what is queued still plays */
+            is->live_wait_key = is->video_stream >= 0 && !is->timeshift;
+        } else {
+            if (is->audio_stream >= 0)
+                packet_queue_flush(&is->audioq);
+            if (is->subtitle_stream >= 0)
+                packet_queue_flush(&is->subtitleq);
+            if (is->video_stream >= 0)
+                packet_queue_flush(&is->videoq);
+            set_clock(&is->extclk, pos, 0);
+        }
+        is->reconnects++;
+        is->eof = 0;
+        ret = 0;
+        break;
+    }
+    is->reconnecting = 0;
+    is->force_refresh = 1;
+    refresh_wake();
+    return ret;
+}
+
+static int record_io_thread(void *arg)
+{
+    Recorder *r = arg;
+
+    SDL_LockMutex(r->mutex);
+    for (;;) {
+        int slot;
+        while (!r->queue_count && !r->io_stop)
+            SDL_CondWait(r->cond, r->mutex);
+        if (!r->queue_count)
+            break;
+        slot = r->queue_head;
+        SDL_UnlockMutex(r->mutex);
+
+        if (!r->io_error &&
+            pwrite(r->fd, r->chunks[slot], r->chunk_len[slot], r->chunk_pos[slot]) != r->chunk_len[slot]) {
+            r->io_error = AVERROR(errno ? errno : EIO);
+            av_log(NULL, AV_LOG_ERROR, "record: write failed: %s\n", av_err2str(r->io_error));
+        }
+
+        SDL_LockMutex(r->mutex);
+        r->chunk_len[slot] = 0;
+        r->queue_head = (r->queue_head + 1) % RECORD_CHUNKS;
+        r->queue_count--;
+        SDL_CondBroadcast(r->cond);
+    }
+    SDL_UnlockMutex(r->mutex);
+    return 0;
+}
+
+/* hand the chunk being filled to the io thread and wait for a free one */
+static void record_queue_fill(Recorder *r)
+{
+    if (!r->chunk_len[r->fill])
+        return;
+    SDL_LockMutex(r->mutex);
+    r->queue_count++;
+    r->fill = (r->fill + 1) % RECORD_CHUNKS;
+    SDL_CondBroadcast(r->cond);
+    while (r->queue_count == RECORD_CHUNKS)
+        SDL_CondWait(r->cond, r->mutex);
+    SDL_UnlockMutex(r->mutex);
+}
+
+static int record_write(void *opaque, uint8_t *buf, int size)
+{
+    Recorder *r = opaque;
+    int done = 0;
+
+    while (done < size) {
+        int slot = r->fill, n;
+        if (!r->chunk_len[slot])
+            r->chunk_pos[slot] = r->pos;
+        n = FFMIN(size - done, RECORD_CHUNK_SIZE - r->chunk_len[slot]);
+        memcpy(r->chunks[slot] + r->chunk_len[slot], buf + done, n);
+        r->chunk_len[slot] += n;
+        r->pos += n;
+        done += n;
+        if (r->chunk_len[slot] == RECORD_CHUNK_SIZE)
+            record_queue_fill(r);
+    }
+    r->size = FFMAX(r->size, r->pos);
+    return r->io_error ? r->io_error : size;
+}
+
+/* the muxer only seeks back to patch headers at the end: a chunk ends there */
+static int64_t record_seek(void *opaque, int64_t offset, int whence)
+{
+    Recorder *r = opaque;
+
+    if (whence & AVSEEK_SIZE)
+        return r->size;
+    switch (whence & ~AVSEEK_FORCE) {
+    case SEEK_SET: break;
+    case SEEK_CUR: offset += r->pos;  break;
+    case SEEK_END: offset += r->size; break;
+    default: return AVERROR(EINVAL);
+    }
+    if (offset < 0)
+        return AVERROR(EINVAL);
+    record_queue_fill(r);
+    r->pos = offset;
+    return offset;
+}
+
+/* write out what is queued and close the file */
+static void record_close_io(Recorder *r)
+{
+    if (r->io_thread) {
+        SDL_LockMutex(r->mutex);
+        r->io_stop = 1;
+        SDL_CondBroadcast(r->cond);
+        SDL_UnlockMutex(r->mutex);
+        SDL_WaitThread(r->io_thread, NULL);
+        r->io_thread = NULL;
+    }
+    if (r->fd >= 0 && close(r->fd) < 0 && !r->io_error)
+        r->io_error = AVERROR(errno);
+    r->fd = -1;
+}
+
+static void record_free(Recorder *r)
+{
+    int i;
+
+    record_close_io(r);
+    if (r->oc) {
+        if (r->oc->pb) {
+            av_freep(&r->oc->pb->buffer);
+            avio_context_free(&r->oc->pb);
+        }
+        avformat_free_context(r->oc);
+    }
+    for (i = 0; i < RECORD_CHUNKS; i++)
+        av_freep(&r->chunks[i]);
+    SDL_DestroyCond(r->cond);
+    SDL_DestroyMutex(r->mutex);
+    av_packet_free(&r->pkt);
+    cenc_free(&r->cenc);
+    av_freep(&r->stream_map);
+    av_freep(&r->last_dts);
+    av_free(r);
+}
+
+/* recordings are named after the channel (or title) and the start time */
+static void record_make_paths(Recorder *r)
+{
+    char title[256], stamp[32], *c;
+    time_t now = time(NULL);
+    struct tm tm;
+
+    if (zap_count > 0 && zap_index >= 0 && zap_index < zap_count)
+        snprintf(title, sizeof(title), "%s", zap_channels[zap_index].name);
+    else if (window_title && window_title != input_filename)
+        snprintf(title, sizeof(title), "%s", window_title);
+    else
+        osd_get_title(input_filename, title, sizeof(title));
+    for (c = title; *c; c++)
+        if ((unsigned char)*c < 0x20 || strchr("/\\:*?\"<>|", *c))
+            *c = '_';
+    if (!title[0] || title[0] == '.')
+        snprintf(title, sizeof(title), "Recording");
+
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H-%M-%S", &tm);
+    snprintf(r->path, sizeof(r->path), "%s/%s %s.mkv", record_dir, title, stamp);
+    snprintf(r->tmp_path, sizeof(r->tmp_path), "%s/.%s %s.mkv", record_dir, title, stamp);
+}
+
+static int record_start(VideoState *is)
+{
+    AVFormatContext *ic = is->ic;
+    const int streams[3] = { is->video_stream, is->audio_stream, is->subtitle_stream };
+    uint8_t *io_buffer;
+    Recorder *r;
+    int i, ret;
+
+    if (!record_dir || !ic)
+        return AVERROR(EINVAL);
+    if (!(r = av_mallocz(sizeof(*r))))
+        return AVERROR(ENOMEM);
+    r->fd = -1;
+    record_make_paths(r);
+    mkdir(record_dir, 0755);
+
+    ret = avformat_alloc_output_context2(&r->oc, NULL, "matroska", r->tmp_path);
+    if (ret < 0)
+        goto fail;
+    r->nb_stream_map = ic->nb_streams;
+    r->stream_map = av_malloc_array(ic->nb_streams, sizeof(*r->stream_map));
+    r->last_dts = av_malloc_array(3, sizeof(*r->last_dts));
+    r->pkt = av_packet_alloc();
+    r->mutex = SDL_CreateMutex();
+    r->cond = SDL_CreateCond();
+    if (is->cenc)
+        r->cenc = cenc_alloc(is->cenc_key, 1);
+    ret = AVERROR(ENOMEM);
+    if (!r->stream_map || !r->last_dts || !r->pkt || !r->mutex || !r->cond || (is->cenc && !r->cenc))
+        goto fail;
+    for (i = 0; i < ic->nb_streams; i++)
+        r->stream_map[i] = -1;
+
+    for (i = 0; i < 3; i++) {
+        AVStream *in, *out;
+        if (streams[i] < 0 || streams[i] >= ic->nb_streams)
+            continue;
+        in = ic->streams[streams[i]];
+        if (avformat_query_codec(r->oc->oformat, in->codecpar->codec_id, FF_COMPLIANCE_NORMAL) != 1)
+            continue;
+        if (!(out = avformat_new_stream(r->oc, NULL)) ||
+            (ret = avcodec_parameters_copy(out->codecpar, in->codecpar)) < 0)
+            goto fail;
+        out->codecpar->codec_tag = 0;
+        out->time_base = in->time_base;
+        av_dict_copy(&out->metadata, in->metadata, 0);
+        r->stream_map[streams[i]] = out->index;
+        r->last_dts[out->index] = AV_NOPTS_VALUE;
+    }
+    ret = AVERROR(EINVAL);
+    if (!r->oc->nb_streams)
+        goto fail;
+    av_dict_copy(&r->oc->metadata, ic->metadata, 0);
+
+    ret = AVERROR(ENOMEM);
+    for (i = 0; i < RECORD_CHUNKS; i++)
+        if (!(r->chunks[i] = av_malloc(RECORD_CHUNK_SIZE)))
+            goto fail;
+    if (!(io_buffer = av_malloc(RECORD_IO_BUFFER)))
+        goto fail;
+    r->oc->pb = avio_alloc_context(io_buffer, RECORD_IO_BUFFER, 1, r, NULL, record_write, record_seek);
+    if (!r->oc->pb) {
+        av_free(io_buffer);
+        goto fail;
+    }
+    /* flushing per packet would defeat the chunking */
+    r->oc->flush_packets = 0;
+
+    r->fd = open(r->tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (r->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    if (!(r->io_thread = SDL_CreateThread(record_io_thread, "record_io", r)))
+        goto fail;
+    if ((ret = avformat_write_header(r->oc, NULL)) < 0)
+        goto fail;
+
+    av_log(NULL, AV_LOG_INFO, "record: %s\n", r->path);
+    is->recorder = r;
+    return 0;
+
+ fail:
+    av_log(NULL, AV_LOG_ERROR, "record: cannot start %s: %s\n", r->path, av_err2str(ret));
+    unlink(r->tmp_path);
+    record_free(r);
+    return ret;
+}
+
+/* finish the file; it only gets its real name if something was recorded */
+static void record_stop(VideoState *is)
+{
+    Recorder *r = is->recorder;
+
+    if (!r)
+        return;
+    is->recorder = NULL;
+    if (r->started)
+        av_write_trailer(r->oc);
+    avio_flush(r->oc->pb);
+    record_queue_fill(r);
+    record_close_io(r);
+
+    /* after a write error (card full) what made it to the card still plays */
+    if (r->started && r->size > 0 && rename(r->tmp_path, r->path) == 0) {
+        av_log(NULL, AV_LOG_INFO, "record: saved %s (%"PRId64" bytes)\n", r->path, r->size);
+    } else {
+        av_log(NULL, AV_LOG_ERROR, "record: %s discarded\n", r->path);
+        unlink(r->tmp_path);
+    }
+    record_free(r);
+}
+
+/* remux one input packet; also picks up start/stop requests from the GUI */
+static void record_packet(VideoState *is, const AVPacket *pkt)
+{
+    Recorder *r;
+    AVStream *in, *out;
+    int64_t dts, pts, last;
+    int index, ret;
+
+    if (is->record_req) {
+        is->record_req = 0;
+        if (is->recorder)
+            record_stop(is);
+        else
+            record_start(is);
+        is->force_refresh = 1;      /* the REC marker */
+        refresh_wake();
+    }
+    r = is->recorder;
+    if (!r || pkt->stream_index >= r->nb_stream_map || (index = r->stream_map[pkt->stream_index]) < 0)
+        return;
+    in  = is->ic->streams[pkt->stream_index];
+    out = r->oc->streams[index];
+    dts = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+    if (dts == AV_NOPTS_VALUE)
+        return;
+    dts = av_rescale_q(dts, in->time_base, AV_TIME_BASE_Q);
+    pts = pkt->pts != AV_NOPTS_VALUE ? av_rescale_q(pkt->pts, in->time_base, AV_TIME_BASE_Q) : dts;
+
+    if (!r->started) {
+        /* start on a video keyframe so the file plays from its first packet */
+        if (is->video_stream >= 0 && r->stream_map[is->video_stream] >= 0 &&
+            (pkt->stream_index != is->video_stream || !(pkt->flags & AV_PKT_FLAG_KEY)))
+            return;
+        r->offset = dts;
+        r->started = 1;
+    }
+
+    /* keep the timeline going over wraps and jumps of live inputs */
+    last = r->last_dts[index];
+    if (last == AV_NOPTS_VALUE && dts - r->offset < 0)
+        return;     /* from before the first keyframe */
+    if (last != AV_NOPTS_VALUE &&
+        (dts - r->offset < last || dts - r->offset > last + RECORD_MAX_GAP)) {
+        int64_t step = FFMAX(av_rescale_q(pkt->duration, in->time_base, AV_TIME_BASE_Q), 1);
+        r->offset = dts - (last + step);
+    }
+    r->last_dts[index] = dts - r->offset;
+
+    if ((ret = av_packet_ref(r->pkt, pkt)) < 0)
+        return;
+    if (r->cenc && (ret = cenc_decrypt(r->cenc, r->pkt)) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "record: cannot decrypt packet: %s\n", av_err2str(ret));
+        av_packet_unref(r->pkt);
+        return;
+    }
+    r->pkt->stream_index = index;
+    r->pkt->dts = av_rescale_q(dts - r->offset, AV_TIME_BASE_Q, out->time_base);
+    r->pkt->pts = FFMAX(av_rescale_q(pts - r->offset, AV_TIME_BASE_Q, out->time_base), r->pkt->dts);
+    r->pkt->duration = av_rescale_q(pkt->duration, in->time_base, out->time_base);
+    r->pkt->pos = -1;
+    ret = av_interleaved_write_frame(r->oc, r->pkt);
+    if (r->io_error) {
+        record_stop(is);
+    } else if (ret < 0) {
+        av_log(NULL, AV_LOG_WARNING, "record: packet dropped: %s\n", av_err2str(ret));
+    }
+}
+
+static int timeshift_io(Timeshift *ts, int64_t pos, void *buf, int len, int write)
+{
+    uint8_t *p = buf;
+
+    while (len > 0) {
+        int64_t off = pos % ts->size;
+        int n = FFMIN(len, ts->size - off);
+        ssize_t done = write ? pwrite(ts->fd, p, n, off) : pread(ts->fd, p, n, off);
+        if (done != n)
+            return done < 0 ? AVERROR(errno) : AVERROR(EIO);
+        p   += n;
+        pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/* forget keyframes that fell out of the ring or the time window;
+ * a reader left behind them jumps to the oldest one still there */
+static void timeshift_trim(Timeshift *ts)
+{
+    while (ts->first_key < ts->nb_keys) {
+        TimeshiftKey *k = &ts->keys[ts->first_key];
+        if (ts->reserve_pos <= k->offset + ts->size &&
+            ts->live_time - k->time <= ts->window)
+            break;
+        ts->first_key++;
+    }
+    if (ts->first_key < ts->nb_keys) {
+        if (ts->read_pos < ts->keys[ts->first_key].offset)
+            ts->read_pos = ts->keys[ts->first_key].offset;
+    } else if (ts->reserve_pos > ts->read_pos + ts->size) {
+        ts->read_pos = ts->write_pos;
+    }
+}
+
+/* the record at start is intact and still the one to read (mutex held) */
+static int timeshift_valid(Timeshift *ts, int64_t start)
+{
+    return ts->reserve_pos <= start + ts->size && ts->read_pos == start;
+}
+
+static int timeshift_add_key(Timeshift *ts, int64_t offset, int64_t time)
+{
+    if (ts->nb_keys == ts->max_keys) {
+        if (ts->first_key > 0) {
+            memmove(ts->keys, ts->keys + ts->first_key,
+                    (ts->nb_keys - ts->first_key) * sizeof(*ts->keys));
+            ts->nb_keys  -= ts->first_key;
+            ts->first_key = 0;
+        } else {
+            int max_keys = FFMAX(256, ts->max_keys * 2);
+            TimeshiftKey *keys = av_realloc_array(ts->keys, max_keys, sizeof(*keys));
+            if (!keys)
+                return AVERROR(ENOMEM);
+            ts->keys = keys;
+            ts->max_keys = max_keys;
+        }
+    }
+    ts->keys[ts->nb_keys].offset = offset;
+    ts->keys[ts->nb_keys].time = time;
+    ts->nb_keys++;
+    return 0;
+}
+
+static int timeshift_append(VideoState *is, Timeshift *ts, AVPacket *pkt)
+{
+    int clock_stream = is->video_stream >= 0 ? is->video_stream : is->audio_stream;
+    TimeshiftRecord rec = { 0 };
+    int64_t pos = ts->write_pos, len;
+    int i, ret;
+
+    /* a continuous timeline from the dts of one stream: live inputs
+     * wrap and jump, so raw timestamps cannot index the window */
+    if (pkt->stream_index == clock_stream) {
+        int64_t ts_pkt = pkt->dts != AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        if (ts_pkt != AV_NOPTS_VALUE) {
+            int64_t t = av_rescale_q(ts_pkt, is->ic->streams[clock_stream]->time_base, AV_TIME_BASE_Q);
+            if (ts->last_dts != AV_NOPTS_VALUE && t > ts->last_dts && t - ts->last_dts < TIMESHIFT_MAX_GAP)
+                ts->live_time += t - ts->last_dts;
+            ts->last_dts = t;
+        }
+    }
+
+    rec.size         = pkt->size;
+    rec.stream_index = pkt->stream_index;
+    rec.flags        = pkt->flags;
+    rec.pts          = pkt->pts;
+    rec.dts          = pkt->dts;
+    rec.duration     = pkt->duration;
+    rec.time         = ts->live_time;
+    for (i = 0; i < pkt->side_data_elems; i++)
+        rec.side_data_size += 8 + pkt->side_data[i].size;
+    len = sizeof(rec) + rec.size + rec.side_data_size;
+    if (len > ts->size / 4)
+        return AVERROR(ENOSPC);
+
+    /* Reserve the range first: keys and the reader leave what it will
+     * overwrite. The file is then written outside the lock, as the reader
+     * only reads below write_pos and checks reserve_pos afterwards. */
+    SDL_LockMutex(ts->mutex);
+    ts->reserve_pos = FFMAX(ts->reserve_pos, pos + len);
+    timeshift_trim(ts);
+    SDL_UnlockMutex(ts->mutex);
+
+    if ((ret = timeshift_io(ts, pos, &rec, sizeof(rec), 1)) < 0)
+        return ret;
+    pos += sizeof(rec);
+    if ((ret = timeshift_io(ts, pos, pkt->data, pkt->size, 1)) < 0)
+        return ret;
+    pos += pkt->size;
+    for (i = 0; i < pkt->side_data_elems; i++) {
+        int32_t hdr[2] = { pkt->side_data[i].type, pkt->side_data[i].size };
+        if ((ret = timeshift_io(ts, pos, hdr, sizeof(hdr), 1)) < 0 ||
+            (ret = timeshift_io(ts, pos + sizeof(hdr), pkt->side_data[i].data, hdr[1], 1)) < 0)
+            return ret;
+        pos += sizeof(hdr) + hdr[1];
+    }
+
+    SDL_LockMutex(ts->mutex);
+    if (pkt->stream_index == clock_stream && (pkt->flags & AV_PKT_FLAG_KEY))
+        ret = timeshift_add_key(ts, ts->write_pos, rec.time);
+    ts->write_pos = pos;
+    SDL_UnlockMutex(ts->mutex);
+    return ret;
+}
+
+/* records the input while the player may be paused or behind live */
+static int timeshift_thread(void *arg)
+{
+    VideoState *is = arg;
+    Timeshift *ts = is->timeshift;
+    AVPacket *pkt = av_packet_alloc();
+    int ret = AVERROR(ENOMEM);
+    int64_t idle_since = 0;
+    int wait_key = 0;
+
+    while (pkt && !ts->abort_request) {
+        is->read_wait_start = av_gettime_relative();
+        ret = av_read_frame(is->ic, pkt);
+        if (ret >= 0 && !variant_packet(is, pkt, av_gettime_relative() - is->read_wait_start)) {
+            is->read_wait_start = 0;
+            av_packet_unref(pkt);
+            continue;
+        }
+        is->read_wait_start = 0;
+        if (ret < 0) {
+            if (ts->abort_request)
+                break;
+            if (!idle_since)
+                idle_since = av_gettime_relative();
+            if (input_lost(is, 1, idle_since)) {
+                if (input_reconnect(is, 1) < 0)
+                    break;
+                idle_since = 0;
+                wait_key = is->video_stream >= 0;
+                continue;
+            }
+            if (is->ic->pb && is->ic->pb->error)
+                break;
+            ts->eof = ret == AVERROR_EOF || avio_feof(is->ic->pb);
+            SDL_Delay(10);
+            continue;
+        }
+        ts->eof = 0;
+        idle_since = 0;
+        is->reconnect_tries = 0;
+        if (wait_key) {
+            /* a reconnected input starts mid-GOP */
+            if (pkt->stream_index != is->video_stream || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            wait_key = 0;
+        }
+        record_packet(is, pkt);
+        if (pkt->stream_index == is->video_stream ||
+            pkt->stream_index == is->audio_stream ||
+            pkt->stream_index == is->subtitle_stream) {
+            ret = timeshift_append(is, ts, pkt);
+            if (ret < 0)
+                av_log(NULL, AV_LOG_WARNING, "timeshift: could not record packet: %s\n", av_err2str(ret));
         }
+        av_packet_unref(pkt);
+        queue_signal(&is->continue_read_thread);
+    }
 
-        /* prepare audio output */
-        if ((ret = audio_open(is, &ch_layout, sample_rate, &is->audio_tgt)) < 0)
-            goto fail;
-        is->audio_hw_buf_size = ret;
-        is->audio_src = is->audio_tgt;
-        is->audio_buf_size  = 0;
-        is->audio_buf_index = 0;
+    SDL_LockMutex(ts->mutex);
+    ts->error = ret < 0 && !ts->abort_request ? ret : 0;
+    SDL_UnlockMutex(ts->mutex);
+    queue_signal(&is->continue_read_thread);
+    av_packet_free(&pkt);
+    return 0;
+}
 
-        /* init averaging filter */
-        is->audio_diff_avg_coef  = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
-        is->audio_diff_avg_count = 0;
-        /* since we do not have a precise anough audio FIFO fullness,
-           we correct audio sync only if larger than this threshold */
-        is->audio_diff_threshold = (double)(is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
+static void timeshift_close(VideoState *is)
+{
+    Timeshift *ts = is->timeshift;
 
-        is->audio_stream = stream_index;
-        is->audio_st = ic->streams[stream_index];
+    if (!ts)
+        return;
+    ts->abort_request = 1;
+    if (ts->thread)
+        SDL_WaitThread(ts->thread, NULL);
+    is->timeshift = NULL;
+    if (ts->fd >= 0)
+        close(ts->fd);
+    SDL_DestroyMutex(ts->mutex);
+    av_freep(&ts->keys);
+    av_free(ts);
+}
 
-        if ((ret = decoder_init(&is->auddec, avctx, &is->audioq, is->continue_read_thread)) < 0)
-            goto fail;
-        if (is->ic->iformat->flags & AVFMT_NOTIMESTAMPS) {
-            is->auddec.start_pts = is->audio_st->start_time;
-            is->auddec.start_pts_tb = is->audio_st->time_base;
-        }
-        if ((ret = decoder_start(&is->auddec, audio_thread, "audio_decoder", is)) < 0)
-            goto out;
-        SDL_PauseAudioDevice(audio_dev, 0);
-        break;
-    case AVMEDIA_TYPE_VIDEO:
-        is->video_stream = stream_index;
-        is->video_st = ic->streams[stream_index];
+static int timeshift_open(VideoState *is)
+{
+    Timeshift *ts = av_mallocz(sizeof(*ts));
 
-        if ((ret = decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread)) < 0)
-            goto fail;
-        if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
-            goto out;
-        is->queue_attachments_req = 1;
-        break;
-    case AVMEDIA_TYPE_SUBTITLE:
-        is->subtitle_stream = stream_index;
-        is->subtitle_st = ic->streams[stream_index];
+    if (!ts)
+        return AVERROR(ENOMEM);
+    ts->size = (int64_t)timeshift_size_mb << 20;
+    ts->window = (int64_t)timeshift_window * AV_TIME_BASE;
+    ts->last_dts = AV_NOPTS_VALUE;
+    /* unlinked right away: the space is freed however the player ends */
+    ts->fd = open(timeshift_file, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (ts->fd >= 0)
+        unlink(timeshift_file);
+    ts->mutex = SDL_CreateMutex();
+    is->timeshift = ts;
+    if (ts->fd < 0 || !ts->mutex ||
+        !(ts->thread = SDL_CreateThread(timeshift_thread, "timeshift", is))) {
+        av_log(NULL, AV_LOG_WARNING, "timeshift: cannot record to %s\n", timeshift_file);
+        timeshift_close(is);
+        return AVERROR(EIO);
+    }
+    av_log(NULL, AV_LOG_INFO, "timeshift: %d s window, %d MB ring\n",
+           timeshift_window, timeshift_size_mb);
+    return 0;
+}
 
-        if ((ret = decoder_init(&is->subdec, avctx, &is->subtitleq, is->continue_read_thread)) < 0)
-            goto fail;
-        if ((ret = decoder_start(&is->subdec, subtitle_thread, "subtitle_decoder", is)) < 0)
-            goto out;
-        break;
-    default:
-        break;
+/* next recorded packet; AVERROR(EAGAIN) at the live edge */
+static int timeshift_read(VideoState *is, AVPacket *pkt)
+{
+    Timeshift *ts = is->timeshift;
+    TimeshiftRecord rec;
+    int64_t start, pos, end = 0, written;
+    int ret, valid;
+
+    SDL_LockMutex(ts->mutex);
+    start = ts->read_pos;
+    if (start >= ts->write_pos) {
+        ret = ts->error ? ts->error : ts->eof ? AVERROR_EOF : AVERROR(EAGAIN);
+        SDL_UnlockMutex(ts->mutex);
+        return ret;
+    }
+    SDL_UnlockMutex(ts->mutex);
+
+    ret = timeshift_io(ts, start, &rec, sizeof(rec), 0);
+    /* the header is only trusted if the writer did not reach it meanwhile */
+    SDL_LockMutex(ts->mutex);
+    valid = timeshift_valid(ts, start);
+    written = ts->write_pos;
+    SDL_UnlockMutex(ts->mutex);
+    if (!valid)
+        ret = AVERROR(EAGAIN);
+    if (ret >= 0) {
+        end = start + (int64_t)sizeof(rec) + rec.size + rec.side_data_size;
+        if (rec.size < 0 || rec.side_data_size < 0 || end - start > ts->size / 4 || end > written)
+            ret = AVERROR_INVALIDDATA;
+    }
+    if (ret >= 0)
+        ret = av_new_packet(pkt, rec.size);
+    pos = start + sizeof(rec);
+    if (ret >= 0)
+        ret = timeshift_io(ts, pos, pkt->data, rec.size, 0);
+    pos += rec.size;
+    while (ret >= 0 && pos < end) {
+        int32_t hdr[2];
+        uint8_t *data;
+        if ((ret = timeshift_io(ts, pos, hdr, sizeof(hdr), 0)) < 0)
+            break;
+        pos += sizeof(hdr);
+        if (hdr[1] < 0 || pos + hdr[1] > end ||
+            !(data = av_packet_new_side_data(pkt, hdr[0], hdr[1]))) {
+            ret = AVERROR_INVALIDDATA;
+            break;
+        }
+        ret = timeshift_io(ts, pos, data, hdr[1], 0);
+        pos += hdr[1];
     }
-    goto out;
 
-fail:
-    avcodec_free_context(&avctx);
-out:
-    av_channel_layout_uninit(&ch_layout);
-    av_dict_free(&opts);
+    SDL_LockMutex(ts->mutex);
+    if (!valid || !timeshift_valid(ts, start)) {
+        /* overwritten while reading, or moved by the writer: take the new position */
+        timeshift_trim(ts);
+        ret = AVERROR(EAGAIN);
+    } else if (ret < 0) {
+        /* unreadable record: continue from the live edge */
+        av_log(NULL, AV_LOG_WARNING, "timeshift: bad record: %s\n", av_err2str(ret));
+        ts->read_pos = ts->write_pos;
+        ret = AVERROR(EAGAIN);
+    } else {
+        ts->read_pos  = end;
+        ts->read_time = rec.time;
+    }
+    SDL_UnlockMutex(ts->mutex);
 
-    return ret;
+    if (ret < 0) {
+        av_packet_unref(pkt);
+        return ret;
+    }
+    pkt->stream_index = rec.stream_index;
+    pkt->flags        = rec.flags;
+    pkt->pts          = rec.pts;
+    pkt->dts          = rec.dts;
+    pkt->duration     = rec.duration;
+    return 0;
 }
 
-static int decode_interrupt_cb(void *ctx)
+/* move the reader rel (AV_TIME_BASE) away from what is playing, to the
+ * nearest keyframe in that direction; clamped to the window and live */
+static int timeshift_seek(VideoState *is, int64_t rel)
 {
-    VideoState *is = ctx;
-    return is->abort_request;
-}
-
-static int stream_has_enough_packets(AVStream *st, int stream_id, PacketQueue *queue) {
-    return stream_id < 0 ||
-           queue->abort_request ||
-           (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
-           queue->nb_packets > MIN_FRAMES && (!queue->duration || av_q2d(st->time_base) * queue->duration > 1.0);
+    Timeshift *ts = is->timeshift;
+    int64_t target;
+    int i, key = -1;
+
+    SDL_LockMutex(ts->mutex);
+    target = ts->read_time - (int64_t)(queued_duration(is) * AV_TIME_BASE) + rel;
+    if (ts->first_key >= ts->nb_keys) {
+        SDL_UnlockMutex(ts->mutex);
+        return AVERROR(EAGAIN);
+    }
+    if (rel > 0) {
+        for (i = ts->first_key; i < ts->nb_keys; i++)
+            if (ts->keys[i].time >= target)
+                break;
+        key = FFMIN(i, ts->nb_keys - 1);
+    } else {
+        for (i = ts->nb_keys - 1; i > ts->first_key; i--)
+            if (ts->keys[i].time <= target)
+                break;
+        key = i;
+    }
+    ts->read_pos  = ts->keys[key].offset;
+    ts->read_time = ts->keys[key].time;
+    SDL_UnlockMutex(ts->mutex);
+    return 0;
 }
 
-static int is_realtime(AVFormatContext *s)
+/* how far playback is behind live and where it is in the window (0..1) */
+static void timeshift_position(VideoState *is, double *behind, double *frac)
 {
-    if(   !strcmp(s->iformat->name, "rtp")
-       || !strcmp(s->iformat->name, "rtsp")
-       || !strcmp(s->iformat->name, "sdp")
-    )
-        return 1;
-
-    if(s->pb && (   !strncmp(s->url, "rtp:", 4)
-                 || !strncmp(s->url, "udp:", 4)
-                )
-    )
-        return 1;
-    return 0;
+    Timeshift *ts = is->timeshift;
+    int64_t oldest, play;
+
+    SDL_LockMutex(ts->mutex);
+    oldest = ts->first_key < ts->nb_keys ? ts->keys[ts->first_key].time : ts->live_time;
+    play = ts->read_time - (int64_t)(queued_duration(is) * AV_TIME_BASE);
+    *behind = FFMAX(ts->live_time - play, 0) / (double)AV_TIME_BASE;
+    *frac = ts->live_time > oldest ? (play - oldest) / (double)(ts->live_time - oldest) : 1;
+    SDL_UnlockMutex(ts->mutex);
+    *frac = av_clipd(*frac, 0, 1);
 }
 
 /* this thread gets the stream from the disk or the network */
@@ -3058,18 +6626,22 @@ static int read_thread(void *arg)
     int64_t stream_start_time;
     int pkt_in_play_range = 0;
     const AVDictionaryEntry *t;
-    SDL_mutex *wait_mutex = SDL_CreateMutex();
+    unsigned wake_seq;
     int scan_all_pmts_set = 0;
     int64_t pkt_ts;
+    AVDictionary *opts = NULL;
+    ZapPrefetch *zap_slot = zap_handoff;
+    int prefetched = 0;
+    int64_t idle_since = 0;
+    const char *proto;
+    int live;
 
-    if (!wait_mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
+    cpu_pin(CPU_LITTLE, NULL);
+    zap_handoff = NULL;
 
     memset(st_index, -1, sizeof(st_index));
     is->eof = 0;
+    is->cenc = zap_cenc_key(zap_count ? zap_index : -1, is->cenc_key);
 
     pkt = av_packet_alloc();
     if (!pkt) {
@@ -3077,6 +6649,13 @@ static int read_thread(void *arg)
         ret = AVERROR(ENOMEM);
         goto fail;
     }
+    /* a zapped-to channel may already be opened and probed */
+    if (zap_slot && (ic = zap_prefetch_take(zap_slot, is))) {
+        ic->interrupt_callback.callback = decode_interrupt_cb;
+        ic->interrupt_callback.opaque = is;
+        prefetched = 1;
+        goto input_ready;
+    }
     ic = avformat_alloc_context();
     if (!ic) {
         av_log(NULL, AV_LOG_FATAL, "Could not allocate context.\n");
@@ -3085,30 +6664,33 @@ static int read_thread(void *arg)
     }
     ic->interrupt_callback.callback = decode_interrupt_cb;
     ic->interrupt_callback.opaque = is;
-    if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
-        av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+    /* work on a copy: format_opts is reused for every channel when zapping */
+    zap_input_opts(&opts);
+    if (!av_dict_get(opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
+        av_dict_set(&opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
-    err = avformat_open_input(&ic, is->filename, is->iformat, &format_opts);
+    err = input_open(&ic, is->filename, is->iformat, &opts);
     if (err < 0) {
         print_error(is->filename, err);
         ret = -1;
         goto fail;
     }
     if (scan_all_pmts_set)
-        av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
+        av_dict_set(&opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
 
-    if ((t = av_dict_get(format_opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+    if ((t = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
         av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
         ret = AVERROR_OPTION_NOT_FOUND;
         goto fail;
     }
+ input_ready:
     is->ic = ic;
 
     if (genpts)
         ic->flags |= AVFMT_FLAG_GENPTS;
 
-    if (find_stream_info) {
+    if (find_stream_info && !prefetched) {
         AVDictionary **opts;
         int orig_nb_streams = ic->nb_streams;
 
@@ -3233,13 +6815,31 @@ static int read_thread(void *arg)
         goto fail;
     }
 
+    variant_init(is);
+
+    /* live input (no duration): record it so it can be paused and rewound */
+    live = is->realtime || ic->duration <= 0;
+    if (timeshift_window > 0 && timeshift_file && live)
+        timeshift_open(is);
+
+    proto = avio_find_protocol_name(is->filename);
+    if (is->timeshift || (proto && !strcmp(proto, "file")))
+        is->buffer_type = BUFFER_LOCAL;
+    else
+        is->buffer_type = live ? BUFFER_LIVE : BUFFER_VOD;
+
     if (infinite_buffer < 0 && is->realtime)
         infinite_buffer = 1;
 
     for (;;) {
+        /* before the requests are looked at: a signal from here on cuts the wait short */
+        wake_seq = atomic_load(&is->continue_read_thread.seq);
         if (is->abort_request)
             break;
-        if (is->paused != is->last_paused) {
+        /* a reconnect, here or in the timeshift thread, replaces the input */
+        ic = is->ic;
+        /* with timeshift the input keeps being recorded while paused */
+        if (is->paused != is->last_paused && !is->timeshift) {
             is->last_paused = is->paused;
             if (is->paused)
                 is->read_pause_return = av_read_pause(ic);
@@ -3263,7 +6863,13 @@ static int read_thread(void *arg)
 // FIXME the +-2 is due to rounding being not done in the correct direction in generation
 //      of the seek_pos/seek_rel variables
 
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            if (is->timeshift) {
+                ret = timeshift_seek(is, is->seek_rel);
+                /* low-latency mode leaves a rewound stream alone until it is back at live */
+                if (ret >= 0 && is->seek_rel < 0)
+                    is->live_rewound = 1;
+            } else
+                ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
             if (ret < 0) {
                 av_log(NULL, AV_LOG_ERROR,
                        "%s: error while seeking\n", is->ic->url);
@@ -3274,7 +6880,7 @@ static int read_thread(void *arg)
                     packet_queue_flush(&is->subtitleq);
                 if (is->video_stream >= 0)
                     packet_queue_flush(&is->videoq);
-                if (is->seek_flags & AVSEEK_FLAG_BYTE) {
+                if ((is->seek_flags & AVSEEK_FLAG_BYTE) || is->timeshift) {
                    set_clock(&is->extclk, NAN, 0);
                 } else {
                    set_clock(&is->extclk, seek_target / (double)AV_TIME_BASE, 0);
@@ -3286,6 +6892,28 @@ static int read_thread(void *arg)
             if (is->paused)
                 step_to_next_frame(is);
         }
+        if (is->live_jump_req) {
+            /* Live: what is queued is the backlog, the next packets read are
+             * live. Timeshift: the backlog is in the ring, so move the reader
+             * to the first keyframe at the target latency (or the newest). */
+            ret = 0;
+            if (is->timeshift) {
+                double behind, frac;
+                timeshift_position(is, &behind, &frac);
+                ret = timeshift_seek(is, (int64_t)((behind - live_latency) * AV_TIME_BASE));
+            }
+            if (ret >= 0) {
+                if (is->audio_stream >= 0)
+                    packet_queue_flush(&is->audioq);
+                if (is->subtitle_stream >= 0)
+                    packet_queue_flush(&is->subtitleq);
+                if (is->video_stream >= 0)
+                    packet_queue_flush(&is->videoq);
+                set_clock(&is->extclk, NAN, 0);
+                is->live_wait_key = is->video_stream >= 0 && !is->timeshift;
+            }
+            is->live_jump_req = 0;
+        }
         if (is->queue_attachments_req) {
             if (is->video_st && is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC) {
                 if ((ret = av_packet_ref(pkt, &is->video_st->attached_pic)) < 0)
@@ -3297,15 +6925,12 @@ static int read_thread(void *arg)
         }
 
         /* if the queue are full, no need to read more */
-        if (infinite_buffer<1 &&
-              (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE
-            || (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
-                stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
-                stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)))) {
-            /* wait 10 ms */
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
+        if (av_gettime_relative() - is->buffer_budget_time > BUFFER_BUDGET_INTERVAL) {
+            is->buffer_budget = buffer_budget(is);
+            is->buffer_budget_time = av_gettime_relative();
+        }
+        if (buffer_full(is)) {
+            queue_wait_timeout(&is->continue_read_thread, wake_seq, buffer_full_wait(is));
             continue;
         }
         if (!is->paused &&
@@ -3313,12 +6938,42 @@ static int read_thread(void *arg)
             (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0))) {
             if (loop != 1 && (!loop || --loop)) {
                 stream_seek(is, start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0);
-            } else if (autoexit) {
+            } else if (autoexit && !(live && stall_timeout > 0)) {  /* live: up to the watchdog */
                 ret = AVERROR_EOF;
                 goto fail;
             }
         }
-        ret = av_read_frame(ic, pkt);
+        if (is->timeshift) {
+            ret = timeshift_read(is, pkt);
+        } else {
+            is->read_wait_start = av_gettime_relative();
+            ret = av_read_frame(ic, pkt);
+            if (ret >= 0 && !variant_packet(is, pkt, av_gettime_relative() - is->read_wait_start)) {
+                is->read_wait_start = 0;
+                av_packet_unref(pkt);
+                continue;
+            }
+            is->read_wait_start = 0;
+        }
+        if (ret == AVERROR(EAGAIN) && is->timeshift) {
+            /* caught up with live: wait for the recorder */
+            queue_wait_timeout(&is->continue_read_thread, wake_seq, READ_WAIT_IDLE);
+            continue;
+        }
+        if (ret < 0 && !is->timeshift) {
+            /* with timeshift the recorder thread reconnects */
+            if (!idle_since)
+                idle_since = av_gettime_relative();
+            if (input_lost(is, live, idle_since)) {
+                if (input_reconnect(is, live) < 0) {
+                    if (is->abort_request)
+                        break;
+                    goto fail;
+                }
+                idle_since = 0;
+                continue;
+            }
+        }
         if (ret < 0) {
             if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
                 if (is->video_stream >= 0)
@@ -3335,12 +6990,26 @@ static int read_thread(void *arg)
                 else
                     break;
             }
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
+            /* at the end only a seek, a pause or the decoders finishing change anything */
+            queue_wait_timeout(&is->continue_read_thread, wake_seq,
+                               !is->eof ? READ_WAIT_MIN : is->paused ? -1 : READ_WAIT_IDLE);
             continue;
         } else {
             is->eof = 0;
+            if (!is->timeshift) {
+                idle_since = 0;
+                is->reconnect_tries = 0;
+            }
+        }
+        /* with timeshift the recorder thread sees the live packets first */
+        if (!is->timeshift)
+            record_packet(is, pkt);
+        if (is->live_wait_key) {
+            if (pkt->stream_index != is->video_stream || !(pkt->flags & AV_PKT_FLAG_KEY)) {
+                av_packet_unref(pkt);
+                continue;
+            }
+            is->live_wait_key = 0;
         }
         /* check if packet is in play range specified by user, then queue, otherwise discard */
         stream_start_time = ic->streams[pkt->stream_index]->start_time;
@@ -3365,17 +7034,18 @@ static int read_thread(void *arg)
     ret = 0;
  fail:
     if (ic && !is->ic)
-        avformat_close_input(&ic);
+        input_close(&ic);
 
     av_packet_free(&pkt);
+    av_dict_free(&opts);
     if (ret != 0) {
         SDL_Event event;
 
         event.type = FF_QUIT_EVENT;
         event.user.data1 = is;
         SDL_PushEvent(&event);
+        refresh_wake();
     }
-    SDL_DestroyMutex(wait_mutex);
     return 0;
 }
 
@@ -3410,15 +7080,11 @@ static VideoState *stream_open(const char *filename,
         packet_queue_init(&is->subtitleq) < 0)
         goto fail;
 
-    if (!(is->continue_read_thread = SDL_CreateCond())) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
-        goto fail;
-    }
-
     init_clock(&is->vidclk, &is->videoq.serial);
     init_clock(&is->audclk, &is->audioq.serial);
     init_clock(&is->extclk, &is->extclk.serial);
     is->audio_clock_serial = -1;
+    live_reset(is);
     if (startup_volume < 0)
         av_log(NULL, AV_LOG_WARNING, "-volume=%d < 0, setting to 0\n", startup_volume);
     if (startup_volume > 100)
@@ -3447,6 +7113,13 @@ static void stream_cycle_channel(VideoState *is, int codec_type)
     AVProgram *p = NULL;
     int nb_streams = is->ic->nb_streams;
 
+    /* the decoders are fed from whichever HLS variant is playing */
+    if (is->variants) {
+        av_log(NULL, AV_LOG_INFO, "No %s stream switching while following HLS variants\n",
+               av_get_media_type_string(codec_type));
+        return;
+    }
+
     if (codec_type == AVMEDIA_TYPE_VIDEO) {
         start_index = is->last_video_stream;
         old_index = is->video_stream;
@@ -3535,36 +7208,123 @@ static void toggle_audio_display(VideoState *is)
     }
 }
 
-static void refresh_loop_wait_event(VideoState *is, SDL_Event *event) {
-    double remaining_time = 0.0;
-    SDL_PumpEvents();
-    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
-        if (!cursor_hidden && av_gettime_relative() - cursor_last_shown > CURSOR_HIDE_DELAY) {
+/* an overlay past its expiry is redrawn away, otherwise the loop wakes for it */
+static void refresh_expiry(VideoState *is, int64_t t, int64_t now, int64_t *next)
+{
+    if (now >= t)
+        is->force_refresh = 1;
+    else
+        *next = FFMIN(*next, t);
+}
+
+/* run the timers that are due; returns the time to the next one, in seconds */
+static double refresh_timers(VideoState *is)
+{
+    int64_t now = av_gettime_relative(), next = INT64_MAX;
+
+    if (!cursor_hidden) {
+        if (now - cursor_last_shown > CURSOR_HIDE_DELAY) {
             SDL_ShowCursor(0);
             cursor_hidden = 1;
+        } else {
+            next = FFMIN(next, cursor_last_shown + CURSOR_HIDE_DELAY + 1);
+        }
+    }
+    /* D-pad hold repeat: inject synthetic hat event if held long enough */
+    if (hat_held_direction != 0) {
+        int64_t elapsed = now - hat_last_seek_time;
+        int64_t threshold = (hat_last_seek_time == 0) ?
+                            HAT_REPEAT_DELAY_US : HAT_REPEAT_INTERVAL_US;
+        if (elapsed >= threshold) {
+            SDL_Event synth;
+            memset(&synth, 0, sizeof(synth));
+            synth.type = SDL_JOYHATMOTION;
+            synth.jhat.value = hat_held_direction;
+            SDL_PeepEvents(&synth, 1, SDL_ADDEVENT, 0, 0);
+            hat_last_seek_time = now;
         }
-        /* D-pad hold repeat: inject synthetic hat event if held long enough */
-        if (hat_held_direction != 0) {
-            int64_t now = av_gettime_relative();
-            int64_t elapsed = now - hat_last_seek_time;
-            int64_t threshold = (hat_last_seek_time == 0) ?
-                                HAT_REPEAT_DELAY_US : HAT_REPEAT_INTERVAL_US;
-            if (elapsed >= threshold) {
-                SDL_Event synth;
-                memset(&synth, 0, sizeof(synth));
-                synth.type = SDL_JOYHATMOTION;
-                synth.jhat.value = hat_held_direction;
-                SDL_PeepEvents(&synth, 1, SDL_ADDEVENT, 0, 0);
-                hat_last_seek_time = now;
+        next = FFMIN(next, hat_last_seek_time + HAT_REPEAT_INTERVAL_US);
+    }
+    zap_prefetch_update();
+    if (zap_count >= 2 && zap_prefetch_due)
+        next = FFMIN(next, zap_prefetch_due);
+    /* the OSD stays up while paused or reconnecting */
+    if (osd_visible && !is->paused && !is->reconnecting)
+        refresh_expiry(is, osd_last_activity + OSD_TIMEOUT_US + 1, now, &next);
+    if (aspect_osd_until > 0)
+        refresh_expiry(is, aspect_osd_until, now, &next);
+    /* -stats prints every 30 ms while playing */
+    if (show_status == 1 && !is->paused)
+        next = FFMIN(next, now + 30000);
+
+    return next == INT64_MAX ? INFINITY : FFMAX(next - now, 0) / 1000000.0;
+}
+
+/* sleep until the deadline, a refresh_wake() or input */
+static void refresh_sleep(VideoState *is, double remaining_time)
+{
+    struct pollfd fds[REFRESH_MAX_INPUTS + 1];
+    struct timespec ts, *timeout = NULL;
+    struct input_event ev[16];
+    uint64_t count;
+    int64_t start = av_gettime_relative(), us;
+    int i, n = 0;
+
+    if (refresh_fd < 0 || !nb_refresh_inputs)
+        remaining_time = FFMIN(remaining_time, REFRESH_RATE);
+    if (remaining_time < INFINITY) {
+        us = remaining_time * 1000000.0;
+        ts.tv_sec  = us / 1000000;
+        ts.tv_nsec = us % 1000000 * 1000;
+        timeout = &ts;
+    }
+    fds[n++] = (struct pollfd){ .fd = refresh_fd, .events = POLLIN };
+    for (i = 0; i < nb_refresh_inputs; i++)
+        fds[n++] = (struct pollfd){ .fd = refresh_inputs[i], .events = POLLIN };
+
+    if (ppoll(fds, n, timeout, NULL) > 0) {
+        if (fds[0].revents & POLLIN && read(refresh_fd, &count, sizeof(count)) < 0)
+            av_log(NULL, AV_LOG_DEBUG, "refresh: %s\n", av_err2str(AVERROR(errno)));
+        /* drain the copies; a device that went away is dropped */
+        for (i = nb_refresh_inputs = 0; i < n - 1; i++) {
+            struct pollfd *p = &fds[i + 1];
+            ssize_t ret = -1;
+
+            if (p->revents & POLLIN)
+                while ((ret = read(p->fd, ev, sizeof(ev))) > 0)
+                    ;
+            if (p->revents & (POLLERR | POLLHUP | POLLNVAL) ||
+                (p->revents & POLLIN && (!ret || (errno != EAGAIN && errno != EINTR)))) {
+                close(p->fd);
+                continue;
             }
+            refresh_inputs[nb_refresh_inputs++] = p->fd;
         }
-        if (remaining_time > 0.0)
-            av_usleep((int64_t)(remaining_time * 1000000.0));
-        remaining_time = REFRESH_RATE;
+    }
+    atomic_store(&refresh_sleeping, 0);
+    refresh_wakeups++;
+    if (is->paused) {
+        refresh_paused_wakeups++;
+        refresh_paused_time += av_gettime_relative() - start;
+    }
+}
+
+static void refresh_loop_wait_event(VideoState *is, SDL_Event *event) {
+    double remaining_time;
+    SDL_PumpEvents();
+    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
+        /* from here on a frame queued or a state change by another thread
+         * makes the sleep return at once */
+        atomic_store(&refresh_sleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        remaining_time = refresh_timers(is);
         if (is->show_mode != SHOW_MODE_NONE)
             video_refresh(is, &remaining_time);
+        if (remaining_time > 0.0 && !SDL_HasEvents(SDL_FIRSTEVENT, SDL_LASTEVENT))
+            refresh_sleep(is, remaining_time);
         SDL_PumpEvents();
     }
+    atomic_store(&refresh_sleeping, 0);
 }
 
 static void seek_chapter(VideoState *is, int incr)
@@ -3594,6 +7354,125 @@ static void seek_chapter(VideoState *is, int incr)
                                  AV_TIME_BASE_Q), 0, 0);
 }
 
+static void zap_set_title(const char *status)
+{
+    snprintf(zap_title, sizeof(zap_title), "%d/%d %s%s", zap_index + 1, zap_count,
+             zap_channels[zap_index].name, status);
+    window_title = zap_title;
+    input_filename = zap_channels[zap_index].url;
+}
+
+/* Read the channel list; zapping stays off unless the input is in it */
+static void zap_load_list(void)
+{
+    FILE *f = fopen(zap_list_path, "r");
+    char line[4096];
+    int i;
+
+    if (!f) {
+        av_log(NULL, AV_LOG_WARNING, "Cannot open channel list %s\n", zap_list_path);
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *name = line, *url, *key, *flags;
+        ZapChannel *c;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (!(url = strchr(name, '\t')))
+            continue;
+        *url++ = '\0';
+        if ((key = strchr(url, '\t')))
+            *key++ = '\0';
+        else
+            key = "";
+        if ((flags = strchr(key, '\t')))
+            *flags++ = '\0';
+        else
+            flags = "";
+
+        c = av_dynarray2_add((void **)&zap_channels, &zap_count, sizeof(*c), NULL);
+        if (!c)
+            break;
+        c->name = av_strdup(name);
+        c->url  = av_strdup(url);
+        c->key  = av_strdup(key);
+        c->dead = !strcmp(flags, "dead");
+        if (!c->name || !c->url || !c->key) {
+            zap_count--;
+            break;
+        }
+    }
+    fclose(f);
+
+    if (zap_index < 0 || zap_index >= zap_count ||
+        strcmp(zap_channels[zap_index].url, input_filename)) {
+        for (i = 0; i < zap_count && strcmp(zap_channels[i].url, input_filename); i++);
+        zap_index = i;
+    }
+    if (zap_index >= zap_count || zap_count < 2) {
+        zap_count = 0;
+        return;
+    }
+    for (i = 0; i < ZAP_PREFETCH_SLOTS; i++)
+        zap_prefetch[i].index = -1;
+    zap_set_title("");
+    zap_prefetch_due = av_gettime_relative() + ZAP_PREFETCH_DELAY_US;
+}
+
+/* Tell the launcher which channel was watched last (<list>.pos) */
+static void zap_save_position(void)
+{
+    char path[1024];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s.pos", zap_list_path);
+    if ((f = fopen(path, "w"))) {
+        fprintf(f, "%d\n", zap_index);
+        fclose(f);
+    }
+}
+
+/* Switch to the channel dir steps away without leaving the player:
+ * window, renderer and the probed neighbours are kept. */
+static VideoState *zap_channel(VideoState *is, int dir)
+{
+    int i;
+
+    stream_close(is);
+    /* errors of the closed channel must not end the new one */
+    SDL_FlushEvent(FF_QUIT_EVENT);
+
+    zap_index = zap_step(zap_index, dir);
+    zap_set_title("");
+
+    zap_handoff = NULL;
+    for (i = 0; i < ZAP_PREFETCH_SLOTS; i++) {
+        ZapPrefetch *p = &zap_prefetch[i];
+        if (!p->thread || p->index != zap_index || SDL_AtomicGet(&p->owned))
+            continue;
+        if (SDL_AtomicGet(&p->done) &&
+            av_gettime_relative() - p->ready_time > ZAP_PREFETCH_MAX_AGE_US) {
+            zap_prefetch_release(p);
+        } else {
+            SDL_AtomicSet(&p->owned, 1);
+            zap_handoff = p;
+        }
+        break;
+    }
+
+    is = stream_open(zap_channels[zap_index].url, file_iformat);
+    if (!is) {
+        av_log(NULL, AV_LOG_FATAL, "Failed to initialize VideoState!\n");
+        do_exit(NULL);
+    }
+    zap_prefetch_due = av_gettime_relative() + ZAP_PREFETCH_DELAY_US;
+
+    /* black screen with the new channel name until its first frame */
+    osd_show();
+    video_display(is);
+    return is;
+}
+
 /* handle an event sent by the GUI */
 static void event_loop(VideoState *cur_stream)
 {
@@ -3609,6 +7488,10 @@ static void event_loop(VideoState *cur_stream)
     for (;;) {
         double x;
         refresh_loop_wait_event(cur_stream, &event);
+        /* buttons change what the OSD shows, also while paused */
+        if (event.type == SDL_KEYDOWN || event.type == SDL_JOYBUTTONDOWN ||
+            event.type == SDL_JOYHATMOTION)
+            cur_stream->force_refresh = 1;
         switch (event.type) {
         case SDL_KEYDOWN:
             if (exit_on_keydown || event.key.keysym.sym == SDLK_ESCAPE || event.key.keysym.sym == SDLK_q) {
@@ -3641,6 +7524,10 @@ static void event_loop(VideoState *cur_stream)
             case SDLK_s: // S: Step to next frame
                 step_to_next_frame(cur_stream);
                 break;
+            case SDLK_r: // R: start/stop recording
+                if (record_dir)
+                    cur_stream->record_req = 1;
+                break;
             case SDLK_a:
                 stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
                 break;
@@ -3706,7 +7593,10 @@ static void event_loop(VideoState *cur_stream)
                 }
                 break;
             do_seek:
-                    if (seek_by_bytes) {
+                    if (cur_stream->timeshift) {
+                        /* relative to what plays, see timeshift_seek() */
+                        stream_seek(cur_stream, 0, (int64_t)(incr * AV_TIME_BASE), 0);
+                    } else if (seek_by_bytes) {
                         pos = -1;
                         if (pos < 0 && cur_stream->video_stream >= 0)
                             pos = frame_queue_last_pos(&cur_stream->pictq);
@@ -3802,13 +7692,27 @@ static void event_loop(VideoState *cur_stream)
                     cur_stream->force_refresh = 1;
             }
             break;
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET:
+            osd_reset_textures();
+            cur_stream->force_refresh = 1;
+            break;
         case SDL_QUIT:
         case FF_QUIT_EVENT:
+            if (event.type == FF_QUIT_EVENT && zap_count > 1) {
+                /* a dead channel must not end zapping: keep the player up */
+                zap_set_title(" - NO SIGNAL");
+                osd_show();
+                video_display(cur_stream);
+                break;
+            }
             do_exit(cur_stream);
             break;
         /* Gamepad button mapping for TrimUI handheld:
          * B (btn 0) = quit, A (btn 1) = pause, Y (btn 2) = cycle aspect ratio,
-         * X (btn 3) = toggle OSD, L1 (btn 4) = seek -60s, R1 (btn 5) = seek +60s */
+         * X (btn 3) = toggle OSD, L1 (btn 4) = seek -60s, R1 (btn 5) = seek +60s,
+         * START (btn 7) = start/stop recording (with -record_dir)
+         * When zapping, L1/R1 take over audio/subtitle cycling from up/down */
         case SDL_JOYBUTTONDOWN:
             switch (event.jbutton.button) {
             case 0: /* B = quit */
@@ -3819,10 +7723,18 @@ static void event_loop(VideoState *cur_stream)
                 osd_show();
                 break;
             case 4: /* L1 = seek back 60s */
+                if (zap_count > 1) {
+                    stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
+                    break;
+                }
                 osd_show();
                 incr = -60.0;
                 goto do_seek;
             case 5: /* R1 = seek forward 60s */
+                if (zap_count > 1) {
+                    stream_cycle_channel(cur_stream, AVMEDIA_TYPE_SUBTITLE);
+                    break;
+                }
                 osd_show();
                 incr = 60.0;
                 goto do_seek;
@@ -3837,11 +7749,18 @@ static void event_loop(VideoState *cur_stream)
                 else
                     osd_show();
                 break;
+            case 7: /* START = start/stop recording */
+                if (record_dir) {
+                    cur_stream->record_req = 1;
+                    osd_show();
+                }
+                break;
             default:
                 break;
             }
             break;
         /* D-pad hat mapping: left/right = seek +-10s, up = cycle audio, down = cycle subtitle
+         * (previous/next channel when zapping)
          * Tracks held state for continuous seeking (left/right only) */
         case SDL_JOYHATMOTION:
             switch (event.jhat.value) {
@@ -3856,6 +7775,10 @@ static void event_loop(VideoState *cur_stream)
                 incr = 10.0;
                 goto do_seek;
             case SDL_HAT_UP:
+                if (zap_count > 1) {
+                    cur_stream = zap_channel(cur_stream, -1);
+                    break;
+                }
                 {
                     double pos = get_clock(&cur_stream->vidclk);
                     stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
@@ -3864,7 +7787,9 @@ static void event_loop(VideoState *cur_stream)
                 }
                 break;
             case SDL_HAT_DOWN:
-                if (nb_vfilters > 1) {
+                if (zap_count > 1) {
+                    cur_stream = zap_channel(cur_stream, 1);
+                } else if (nb_vfilters > 1) {
                     if (++cur_stream->vfilter_idx >= nb_vfilters)
                         cur_stream->vfilter_idx = 0;
                     const char *sv = vfilters_list[cur_stream->vfilter_idx];
@@ -4024,7 +7949,17 @@ static const OptionDef options[] = {
     { "loop", OPT_INT | HAS_ARG | OPT_EXPERT, { &loop }, "set number of times the playback shall be looped", "loop count" },
     { "framedrop", OPT_BOOL | OPT_EXPERT, { &framedrop }, "drop frames when cpu is too slow", "" },
     { "infbuf", OPT_BOOL | OPT_EXPERT, { &infinite_buffer }, "don't limit the input buffer size (useful with realtime streams)", "" },
+    { "variant_select", OPT_BOOL | OPT_EXPERT, { &variant_select }, "play one HLS variant chosen by screen height and throughput", "" },
+    { "stall_timeout", OPT_FLOAT | HAS_ARG | OPT_EXPERT, { &stall_timeout }, "reconnect an input that delivers nothing for this long while playback runs dry", "seconds" },
+    { "live_latency", OPT_FLOAT | HAS_ARG | OPT_EXPERT, { &live_latency }, "keep live inputs this close to the live edge by playing faster or skipping ahead", "seconds" },
+    { "prefetch_segments", OPT_INT | HAS_ARG | OPT_EXPERT, { &prefetch_segments }, "download this many HLS/DASH segments ahead, in parallel", "count" },
     { "window_title", OPT_STRING | HAS_ARG, { &window_title }, "set window title", "window title" },
+    { "channel_list", OPT_STRING | HAS_ARG | OPT_EXPERT, { &zap_list_path }, "zap with up/down between the channels in file (name<TAB>url<TAB>key<TAB>flags lines)", "file" },
+    { "channel_index", OPT_INT | HAS_ARG | OPT_EXPERT, { &zap_index }, "position of the input in the channel list", "index" },
+    { "timeshift", OPT_INT | HAS_ARG | OPT_EXPERT, { &timeshift_window }, "record live inputs to allow pause and rewind up to this long", "seconds" },
+    { "timeshift_size", OPT_INT | HAS_ARG | OPT_EXPERT, { &timeshift_size_mb }, "size of the timeshift ring file", "MB" },
+    { "timeshift_file", OPT_STRING | HAS_ARG | OPT_EXPERT, { &timeshift_file }, "timeshift ring file (removed on open)", "file" },
+    { "record_dir", OPT_STRING | HAS_ARG | OPT_EXPERT, { &record_dir }, "enable recording (START / r) of the input to Matroska files in dir", "dir" },
     { "left", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_left }, "set the x position for the left of the window", "x pos" },
     { "top", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_top }, "set the y position for the top of the window", "y pos" },
     { "vf", OPT_EXPERT | HAS_ARG, { .func_arg = opt_add_vfilter }, "set video filters", "filter_graph" },
@@ -4040,6 +7975,11 @@ static const OptionDef options[] = {
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
         "read and decode the streams to fill missing information with heuristics" },
     { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT, { &filter_nbthreads }, "number of filter threads per graph" },
+    { "direct_10bit", OPT_BOOL | OPT_EXPERT, { &direct_10bit }, "convert 10-bit video to 8 bits while uploading it instead of with swscale" },
+    { "cpu_governor", OPT_BOOL | OPT_EXPERT, { &cpu_governor }, "clamp the CPU clock to the lowest frequency that plays without dropping frames" },
+    { "cpu_limits_file", OPT_STRING | HAS_ARG | OPT_EXPERT, { &cpu_limits_file }, "save the CPU clock limits found at start to this file, removed once they are restored", "file" },
+    { "sysfs_root", OPT_STRING | HAS_ARG | OPT_EXPERT, { &sysfs_root }, "read CPU and thermal state from, and set CPU clocks in, this sysfs tree", "dir" },
+    { "cpu_placement", OPT_BOOL | OPT_EXPERT, { &cpu_placement }, "run video decoding on the performance cores and demuxing and audio on the efficiency cores" },
     { NULL, },
 };
 
@@ -4098,6 +8038,9 @@ int main(int argc, char **argv)
 #endif
     avformat_network_init();
 
+    /* no point polling for the other side of a queue on a single core */
+    queue_spin = av_cpu_count() > 1 ? QUEUE_SPIN : 0;
+
     signal(SIGINT , sigterm_handler); /* Interrupt (ANSI).    */
     signal(SIGTERM, sigterm_handler); /* Termination (ANSI).  */
 
@@ -4118,6 +8061,12 @@ int main(int argc, char **argv)
     if (display_disable) {
         video_disable = 1;
     }
+    /* the launcher's affinity is inherited: place the main thread (and what
+     * SDL starts from it) with the video decoder */
+    cpu_topology_init();
+    cpu_pin(CPU_BIG, NULL);
+    if (zap_list_path)
+        zap_load_list();
     flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK;
     if (audio_disable)
         flags &= ~SDL_INIT_AUDIO;
@@ -4138,6 +8087,9 @@ int main(int argc, char **argv)
     SDL_EventState(SDL_SYSWMEVENT, SDL_IGNORE);
     SDL_EventState(SDL_USEREVENT, SDL_IGNORE);
 
+    if (cpu_governor)
+        gov_start();
+
     if (!display_disable) {
         int flags = SDL_WINDOW_HIDDEN;
         if (alwaysontop)
@@ -4165,6 +8117,10 @@ int main(int argc, char **argv)
             if (renderer) {
                 if (!SDL_GetRendererInfo(renderer, &renderer_info))
                     av_log(NULL, AV_LOG_VERBOSE, "Initialized %s renderer.\n", renderer_info.name);
+                if (screen_height)
+                    panel_height = screen_height;
+                else
+                    SDL_GetRendererOutputSize(renderer, NULL, &panel_height);
             }
         }
         if (!window || !renderer || !renderer_info.num_texture_formats) {
@@ -4180,6 +8136,7 @@ int main(int argc, char **argv)
     }
 
     osd_show(); /* Show OSD briefly at playback start */
+    refresh_init();
     event_loop(is);
 
     /* never returns */
@@ -0,0 +1,278 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * ClearKey CENC sample decryption for ffplay
+ *
+ * AES-CTR ('cenc', 'cens') uses the ARMv8 AES instructions when the CPU has
+ * them; the CBC schemes and other CPUs go through libavutil's AES. Only
+ * libavutil is needed, so ffplay/tests builds this file on the host.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#if ARCH_AARCH64
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
+
+#include "libavutil/aes.h"
+#include "libavutil/bswap.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+
+#include "ffplay_cenc.h"
+
+#if ARCH_AARCH64 && !defined(HWCAP_AES)
+#define HWCAP_AES (1 << 3)
+#endif
+#define CENC_BATCH 32                    /* counter blocks per av_aes_crypt() call */
+
+/* keystream position in a sample, carried across its subsamples */
+typedef struct CencCtr {
+    uint8_t ctr[16];
+    uint8_t ks[16];
+    int ks_used;
+} CencCtr;
+
+static const uint8_t sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+/* the AES-128 key schedule (FIPS-197 5.2), round key r in round_keys[r] */
+static void cenc_expand_key(Cenc *c, const uint8_t *key)
+{
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+    uint8_t *w = c->round_keys[0];
+    int i;
+
+    memcpy(w, key, 16);
+    for (i = 16; i < 176; i += 4) {
+        uint8_t t[4] = { w[i - 4], w[i - 3], w[i - 2], w[i - 1] };
+        if (!(i & 15)) {                /* RotWord, SubWord, Rcon */
+            uint8_t t0 = t[0];
+            t[0] = sbox[t[1]] ^ rcon[i / 16 - 1];
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+        }
+        w[i]     = w[i - 16] ^ t[0];
+        w[i + 1] = w[i - 15] ^ t[1];
+        w[i + 2] = w[i - 14] ^ t[2];
+        w[i + 3] = w[i - 13] ^ t[3];
+    }
+}
+
+/* xor nb_blocks of keystream into buf, advancing the 64-bit counter */
+static void cenc_ctr_blocks_c(Cenc *c, uint8_t *ctr, uint8_t *buf, size_t nb_blocks)
+{
+    uint8_t ks[CENC_BATCH * 16];
+    uint64_t lo = AV_RB64(ctr + 8);
+    int i, n;
+
+    while (nb_blocks) {
+        n = FFMIN(nb_blocks, CENC_BATCH);
+        for (i = 0; i < n; i++) {
+            memcpy(ks + 16 * i, ctr, 8);
+            AV_WB64(ks + 16 * i + 8, lo++);
+        }
+        av_aes_crypt(c->enc, ks, ks, n, NULL, 0);
+        for (i = 0; i < n * 16; i += 8)
+            AV_WN64(buf + i, AV_RN64(buf + i) ^ AV_RN64(ks + i));
+        buf += n * 16;
+        nb_blocks -= n;
+    }
+    AV_WB64(ctr + 8, lo);
+}
+
+#if ARCH_AARCH64
+__attribute__((target("+crypto")))
+static void cenc_ctr_blocks_ce(Cenc *c, uint8_t *ctr, uint8_t *buf, size_t nb_blocks)
+{
+    uint8x16_t rk[11], b0, b1, b2, b3;
+    uint8x8_t hi = vld1_u8(ctr);
+    uint64_t lo = AV_RB64(ctr + 8);
+    int i, r;
+
+    for (i = 0; i < 11; i++)
+        rk[i] = vld1q_u8(c->round_keys[i]);
+    /* four blocks in flight hide the latency of the AES instructions */
+    for (; nb_blocks >= 4; nb_blocks -= 4, buf += 64, lo += 4) {
+        b0 = vcombine_u8(hi, vcreate_u8(av_bswap64(lo)));
+        b1 = vcombine_u8(hi, vcreate_u8(av_bswap64(lo + 1)));
+        b2 = vcombine_u8(hi, vcreate_u8(av_bswap64(lo + 2)));
+        b3 = vcombine_u8(hi, vcreate_u8(av_bswap64(lo + 3)));
+        for (r = 0; r < 9; r++) {
+            b0 = vaesmcq_u8(vaeseq_u8(b0, rk[r]));
+            b1 = vaesmcq_u8(vaeseq_u8(b1, rk[r]));
+            b2 = vaesmcq_u8(vaeseq_u8(b2, rk[r]));
+            b3 = vaesmcq_u8(vaeseq_u8(b3, rk[r]));
+        }
+        vst1q_u8(buf,      veorq_u8(vld1q_u8(buf),      veorq_u8(vaeseq_u8(b0, rk[9]), rk[10])));
+        vst1q_u8(buf + 16, veorq_u8(vld1q_u8(buf + 16), veorq_u8(vaeseq_u8(b1, rk[9]), rk[10])));
+        vst1q_u8(buf + 32, veorq_u8(vld1q_u8(buf + 32), veorq_u8(vaeseq_u8(b2, rk[9]), rk[10])));
+        vst1q_u8(buf + 48, veorq_u8(vld1q_u8(buf + 48), veorq_u8(vaeseq_u8(b3, rk[9]), rk[10])));
+    }
+    for (; nb_blocks; nb_blocks--, buf += 16, lo++) {
+        b0 = vcombine_u8(hi, vcreate_u8(av_bswap64(lo)));
+        for (r = 0; r < 9; r++)
+            b0 = vaesmcq_u8(vaeseq_u8(b0, rk[r]));
+        vst1q_u8(buf, veorq_u8(vld1q_u8(buf), veorq_u8(vaeseq_u8(b0, rk[9]), rk[10])));
+    }
+    AV_WB64(ctr + 8, lo);
+}
+#endif
+
+void cenc_free(Cenc **c)
+{
+    if (!*c)
+        return;
+    av_free((*c)->enc);
+    av_free((*c)->dec);
+    av_freep(c);
+}
+
+Cenc *cenc_alloc(const uint8_t *key, int use_ce)
+{
+    Cenc *c = av_mallocz(sizeof(*c));
+
+    if (!c || !(c->enc = av_aes_alloc()) || !(c->dec = av_aes_alloc()) ||
+        av_aes_init(c->enc, key, 128, 0) < 0 || av_aes_init(c->dec, key, 128, 1) < 0) {
+        cenc_free(&c);
+        return NULL;
+    }
+    cenc_expand_key(c, key);
+    c->ctr_blocks = cenc_ctr_blocks_c;
+#if ARCH_AARCH64
+    if (use_ce && (getauxval(AT_HWCAP) & HWCAP_AES)) {
+        c->ctr_blocks = cenc_ctr_blocks_ce;
+        c->ce = 1;
+    }
+#endif
+    return c;
+}
+
+static void cenc_ctr(Cenc *c, CencCtr *s, uint8_t *buf, size_t len)
+{
+    size_t n;
+
+    for (; len && s->ks_used < 16; len--)
+        *buf++ ^= s->ks[s->ks_used++];
+    if ((n = len / 16)) {
+        c->ctr_blocks(c, s->ctr, buf, n);
+        buf += n * 16;
+        len -= n * 16;
+    }
+    if (len) {                          /* the rest of this block opens the next range */
+        memset(s->ks, 0, sizeof(s->ks));
+        c->ctr_blocks(c, s->ctr, s->ks, 1);
+        for (s->ks_used = 0; s->ks_used < (int)len; s->ks_used++)
+            buf[s->ks_used] ^= s->ks[s->ks_used];
+    }
+}
+
+/* one protected range: all of it, or the first crypt of every crypt + skip
+ * blocks; what is left of a block at the end stays clear except in CTR
+ * without a pattern */
+static void cenc_range(Cenc *c, int cbc, unsigned crypt, unsigned skip,
+                       CencCtr *ctr, uint8_t *iv, uint8_t *p, size_t len)
+{
+    size_t n;
+
+    if (!crypt) {
+        if (cbc)
+            av_aes_crypt(c->dec, p, p, len / 16, iv, 1);
+        else
+            cenc_ctr(c, ctr, p, len);
+        return;
+    }
+    while (len >= 16) {
+        n = FFMIN(len / 16, crypt) * 16;
+        if (cbc)
+            av_aes_crypt(c->dec, p, p, n / 16, iv, 1);
+        else
+            cenc_ctr(c, ctr, p, n);
+        p += n;
+        len -= n;
+        n = FFMIN(len, (size_t)skip * 16);
+        p += n;
+        len -= n;
+    }
+}
+
+int cenc_decrypt_sample(Cenc *c, const AVEncryptionInfo *info, uint8_t *data, size_t size)
+{
+    CencCtr ctr;
+    uint8_t iv0[16] = { 0 }, iv[16], *p = data, *end = data + size;
+    unsigned i;
+    int cbc;
+
+    switch (info->scheme) {
+    case MKBETAG('c','e','n','c'):
+    case MKBETAG('c','e','n','s'):
+        cbc = 0;
+        break;
+    case MKBETAG('c','b','c','1'):
+    case MKBETAG('c','b','c','s'):
+        cbc = 1;
+        break;
+    default:
+        return AVERROR_PATCHWELCOME;
+    }
+
+    memcpy(iv0, info->iv, FFMIN(info->iv_size, 16));
+    memcpy(iv, iv0, 16);
+    memcpy(ctr.ctr, iv0, 16);
+    ctr.ks_used = 16;
+    /* without subsamples the whole sample is one protected range */
+    for (i = 0; i < FFMAX(info->subsample_count, 1); i++) {
+        size_t clear = 0, prot = end - p;
+
+        if (info->subsample_count) {
+            clear = info->subsamples[i].bytes_of_clear_data;
+            prot = info->subsamples[i].bytes_of_protected_data;
+        }
+        if (clear > (size_t)(end - p) || prot > (size_t)(end - p) - clear)
+            return AVERROR_INVALIDDATA;
+        p += clear;
+        if (info->scheme == MKBETAG('c','b','c','s'))   /* constant IV, per subsample */
+            memcpy(iv, iv0, 16);
+        cenc_range(c, cbc, info->crypt_byte_block, info->skip_byte_block, &ctr, iv, p, prot);
+        p += prot;
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * ClearKey CENC sample decryption for ffplay
+ */
+
+#ifndef FFTOOLS_FFPLAY_CENC_H
+#define FFTOOLS_FFPLAY_CENC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/encryption_info.h"
+
+typedef struct Cenc {
+    struct AVAES *enc;                   /* CTR keystream */
+    struct AVAES *dec;                   /* CBC */
+    uint8_t round_keys[11][16];          /* AES-128 key schedule, for the AES instructions */
+    int ce;                              /* CTR runs on the AES instructions */
+    void (*ctr_blocks)(struct Cenc *c, uint8_t *ctr, uint8_t *buf, size_t nb_blocks);
+} Cenc;
+
+/**
+ * Allocate a decryption context for a 16-byte key.
+ *
+ * @param use_ce use the ARMv8 AES instructions for AES-CTR if the CPU has
+ *               them; otherwise everything goes through libavutil's AES
+ * @return the context, NULL on allocation failure
+ */
+Cenc *cenc_alloc(const uint8_t *key, int use_ce);
+
+void cenc_free(Cenc **c);
+
+/**
+ * Decrypt one sample in place.
+ *
+ * Handles the 'cenc', 'cens', 'cbc1' and 'cbcs' schemes, with or without
+ * subsamples and crypt/skip patterns.
+ *
+ * @return 0 on success, AVERROR_INVALIDDATA if the subsamples do not fit
+ *         in size, AVERROR_PATCHWELCOME for an unknown scheme
+ */
+int cenc_decrypt_sample(Cenc *c, const AVEncryptionInfo *info, uint8_t *data, size_t size);
+
+#endif /* FFTOOLS_FFPLAY_CENC_H */
@@ -0,0 +1,242 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * CPU frequency governor for ffplay
+ *
+ * Everything here goes through the sysfs tree given to gov_init(), and
+ * there is no threading: ffplay.c runs the decisions on its own thread and
+ * serializes the writes. So ffplay/tests builds this file on the host and
+ * drives it on a fake tree.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+
+#include "ffplay_gov.h"
+
+static void sysfs_path(char *path, size_t size, const char *root, const char *fmt, va_list vl)
+{
+    int n = snprintf(path, size, "%s/", root);
+
+    if (n >= 0 && n < size)
+        vsnprintf(path + n, size - n, fmt, vl);
+}
+
+long sysfs_read_long(const char *root, const char *fmt, ...)
+{
+    char path[256];
+    va_list vl;
+    FILE *f;
+    long v = -1;
+
+    va_start(vl, fmt);
+    sysfs_path(path, sizeof(path), root, fmt, vl);
+    va_end(vl);
+    if ((f = fopen(path, "r"))) {
+        if (fscanf(f, "%ld", &v) != 1)
+            v = -1;
+        fclose(f);
+    }
+    return v;
+}
+
+static int sysfs_read_list(const char *root, int *v, int max, const char *fmt, ...)
+{
+    char path[256];
+    va_list vl;
+    FILE *f;
+    int n = 0;
+
+    va_start(vl, fmt);
+    sysfs_path(path, sizeof(path), root, fmt, vl);
+    va_end(vl);
+    if (!(f = fopen(path, "r")))
+        return -1;
+    while (n < max && fscanf(f, "%d", &v[n]) == 1)
+        n++;
+    fclose(f);
+    return n;
+}
+
+static int sysfs_write_long(const char *root, long v, const char *fmt, ...)
+{
+    char path[256];
+    va_list vl;
+    FILE *f;
+    int ret;
+
+    va_start(vl, fmt);
+    sysfs_path(path, sizeof(path), root, fmt, vl);
+    va_end(vl);
+    if (!(f = fopen(path, "w")))
+        return AVERROR(errno);
+    ret = fprintf(f, "%ld\n", v) < 0;
+    ret |= fclose(f);
+    return ret ? AVERROR(EIO) : 0;
+}
+
+/* keeps min <= max after each write, as the kernel rejects anything else */
+static void gov_set_limits(const Gov *g, GovPolicy *p, long min, long max)
+{
+    if (min > p->max) {
+        sysfs_write_long(g->root, max, GOV_POLICY "scaling_max_freq", p->cpu);
+        sysfs_write_long(g->root, min, GOV_POLICY "scaling_min_freq", p->cpu);
+    } else {
+        sysfs_write_long(g->root, min, GOV_POLICY "scaling_min_freq", p->cpu);
+        sysfs_write_long(g->root, max, GOV_POLICY "scaling_max_freq", p->cpu);
+    }
+    p->min = min;
+    p->max = max;
+}
+
+static int gov_freq(const Gov *g, const GovPolicy *p, int level)
+{
+    return p->freqs[g->levels ? level * (p->nb_freqs - 1) / g->levels : 0];
+}
+
+int gov_init(Gov *g, const char *root, int nb_cpus)
+{
+    int cpu, i, j;
+    long lo, hi;
+
+    *g = (Gov){ .root = root };
+    for (cpu = 0; cpu < nb_cpus && g->nb_policies < GOV_MAX_POLICIES; cpu++) {
+        GovPolicy *p = &g->policies[g->nb_policies];
+
+        p->cpu = cpu;
+        p->saved_min = p->min = sysfs_read_long(root, GOV_POLICY "scaling_min_freq", cpu);
+        p->saved_max = p->max = sysfs_read_long(root, GOV_POLICY "scaling_max_freq", cpu);
+        if (p->saved_min <= 0 || p->saved_max <= 0)
+            continue;
+        p->nb_freqs = sysfs_read_list(root, p->freqs, GOV_MAX_FREQS,
+                                      GOV_POLICY "scaling_available_frequencies", cpu);
+        if (p->nb_freqs > 0) {
+            for (i = 1; i < p->nb_freqs; i++)
+                for (j = i; j > 0 && p->freqs[j - 1] > p->freqs[j]; j--)
+                    FFSWAP(int, p->freqs[j - 1], p->freqs[j]);
+        } else {
+            lo = sysfs_read_long(root, GOV_POLICY "cpuinfo_min_freq", cpu);
+            hi = sysfs_read_long(root, GOV_POLICY "cpuinfo_max_freq", cpu);
+            if (lo <= 0 || hi < lo)
+                continue;
+            p->nb_freqs = GOV_LINEAR_FREQS;
+            for (i = 0; i < p->nb_freqs; i++)
+                p->freqs[i] = lo + (hi - lo) * i / (p->nb_freqs - 1);
+        }
+        /* read-only without root: leave the policy alone */
+        if (sysfs_write_long(root, p->saved_max, GOV_POLICY "scaling_max_freq", cpu) < 0)
+            continue;
+        g->levels = FFMAX(g->levels, p->nb_freqs - 1);
+        g->nb_policies++;
+    }
+    while (g->nb_zones < GOV_MAX_ZONES &&
+           sysfs_read_long(root, "class/thermal/thermal_zone%d/temp", g->nb_zones) != -1)
+        g->nb_zones++;
+    /* start where the launcher left the clock, at the top, and walk down */
+    g->level = g->levels;
+    return g->nb_policies;
+}
+
+int gov_temperature(const Gov *g)
+{
+    long t;
+    int i, max = INT_MIN;
+
+    for (i = 0; i < g->nb_zones; i++)
+        if ((t = sysfs_read_long(g->root, "class/thermal/thermal_zone%d/temp", i)) != -1)
+            max = FFMAX(max, t);
+    return max;
+}
+
+int gov_top_freq(const Gov *g, int level)
+{
+    int i, top = 0;
+
+    for (i = 0; i < g->nb_policies; i++)
+        top = FFMAX(top, gov_freq(g, &g->policies[i], level));
+    return top;
+}
+
+int gov_step(Gov *g, int dropped, double idle_share, int temp)
+{
+    dropped = !!dropped;
+    if (dropped)
+        g->hold = GOV_HOLD_TICKS;
+    if (temp >= GOV_TEMP_CRIT) {
+        g->level = FFMAX(g->level - 1, 0);
+        g->down = 0;
+    } else if ((dropped || idle_share < GOV_IDLE_LOW) && temp < GOV_TEMP_HOT) {
+        g->level = FFMIN(g->level + 1 + dropped, g->levels);
+        g->down = 0;
+    } else if (g->level > 0 && !g->hold &&
+               (1 - idle_share) * gov_top_freq(g, g->level) / gov_top_freq(g, g->level - 1) < 1 - GOV_HEADROOM) {
+        /* the decoder's busy time scales with the clock */
+        if (++g->down >= GOV_DOWN_TICKS) {
+            g->level = FFMAX(g->level - 1, 0);
+            g->down = 0;
+        }
+    } else {
+        g->down = 0;
+    }
+    g->hold = FFMAX(g->hold - 1, 0);
+    return g->level;
+}
+
+int gov_apply(Gov *g)
+{
+    int i, f;
+
+    for (i = 0; i < g->nb_policies; i++) {
+        GovPolicy *p = &g->policies[i];
+
+        f = gov_freq(g, p, g->level);
+        if (f != p->min || f != p->max)
+            gov_set_limits(g, p, f, f);
+    }
+    return gov_top_freq(g, g->level);
+}
+
+void gov_restore(Gov *g)
+{
+    int i;
+
+    for (i = 0; i < g->nb_policies; i++)
+        gov_set_limits(g, &g->policies[i], g->policies[i].saved_min, g->policies[i].saved_max);
+}
+
+int gov_save_limits(const Gov *g, const char *path)
+{
+    FILE *f;
+    int i, ret;
+
+    if (!(f = fopen(path, "w")))
+        return AVERROR(errno);
+    for (i = 0; i < g->nb_policies; i++)
+        fprintf(f, "%s/" GOV_POLICY " %ld %ld\n", g->root, g->policies[i].cpu,
+                g->policies[i].saved_min, g->policies[i].saved_max);
+    ret = ferror(f);
+    ret |= fclose(f);
+    return ret ? AVERROR(EIO) : 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * CPU frequency governor for ffplay: cpufreq policies, thermal zones and
+ * the step decisions
+ */
+
+#ifndef FFTOOLS_FFPLAY_GOV_H
+#define FFTOOLS_FFPLAY_GOV_H
+
+#define GOV_INTERVAL 1000000             /* between decisions, in microseconds */
+#define GOV_IDLE_LOW 0.10                /* share of time the decoder waits: step up below */
+#define GOV_HEADROOM 0.20                /* step down if it would still wait this much */
+#define GOV_DOWN_TICKS 3                 /* intervals with room to step down per step */
+#define GOV_HOLD_TICKS 15                /* no step down this long after a drop */
+#define GOV_TEMP_HOT 70000               /* millidegrees C */
+#define GOV_TEMP_CRIT 80000
+#define GOV_MAX_POLICIES 4
+#define GOV_MAX_FREQS 32
+#define GOV_LINEAR_FREQS 8               /* without scaling_available_frequencies */
+#define GOV_MAX_ZONES 16
+#define GOV_POLICY "devices/system/cpu/cpufreq/policy%d/"
+
+typedef struct GovPolicy {
+    int cpu;                             /* first cpu, names the policy */
+    int freqs[GOV_MAX_FREQS];            /* kHz, ascending */
+    int nb_freqs;
+    long saved_min, saved_max;
+    long min, max;                       /* limits written last */
+} GovPolicy;
+
+typedef struct Gov {
+    const char *root;                    /* sysfs, or a tree standing in for it */
+    GovPolicy policies[GOV_MAX_POLICIES];
+    int nb_policies;
+    int nb_zones;
+    int levels;                          /* steps of the longest frequency table */
+    int level;
+    int down;                            /* intervals in a row with room to step down */
+    int hold;                            /* intervals left before a step down */
+} Gov;
+
+/**
+ * Read a number from a file below root.
+ *
+ * @return the number, -1 when the file is missing or holds none
+ */
+long sysfs_read_long(const char *root, const char *fmt, ...);
+
+/**
+ * Find the cpufreq policies of cpus 0 to nb_cpus - 1 that can be written,
+ * with their frequency tables, and the thermal zones. Starts at the top
+ * level.
+ *
+ * @return the number of policies; 0 leaves nothing to govern
+ */
+int gov_init(Gov *g, const char *root, int nb_cpus);
+
+/**
+ * @return the hottest thermal zone in millidegrees C, INT_MIN without any
+ */
+int gov_temperature(const Gov *g);
+
+/**
+ * Decide the level for the next interval. It goes up at once when frames
+ * were dropped or the decoder had almost no time to spare, unless it is
+ * hot; down when it is critical, or slowly while the decoder would still
+ * wait on a full picture queue one level lower.
+ *
+ * @param dropped    nonzero if video frames were dropped in the interval
+ * @param idle_share share of the interval the decoder waited for room in
+ *                   the picture queue; 1 if it decoded nothing
+ * @param temp       gov_temperature()
+ * @return the new level, 0 to g->levels
+ */
+int gov_step(Gov *g, int dropped, double idle_share, int temp);
+
+/**
+ * @return the fastest clock at a level in kHz: the one the decoder runs at
+ */
+int gov_top_freq(const Gov *g, int level);
+
+/**
+ * Clamp every policy to a single frequency, that of the current level.
+ *
+ * @return the fastest clock in kHz
+ */
+int gov_apply(Gov *g);
+
+/**
+ * Put back the limits gov_init() found.
+ */
+void gov_restore(Gov *g);
+
+/**
+ * Save the limits gov_init() found, as "<policy dir> <min> <max>" lines,
+ * for the launcher to restore if the player dies.
+ *
+ * @return 0 on success, a negative AVERROR code otherwise
+ */
+int gov_save_limits(const Gov *g, const char *path);
+
+#endif /* FFTOOLS_FFPLAY_GOV_H */
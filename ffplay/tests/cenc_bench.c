@@ -0,0 +1,83 @@
+/*
+ * Throughput of ffplay_cenc.c per scheme, on libavutil's AES and on the
+ * ARMv8 AES instructions where the CPU has them. Samples are the size of a
+ * video packet, cut into subsamples like an H.264 access unit.
+ *
+ *   make -C ffplay/tests bench
+ *
+ * On the device, build against the real libavutil rather than the OpenSSL
+ * stand-in:
+ *
+ *   make -C ffplay/tests CC=aarch64-nextui-linux-gnu-gcc FFMPEG=/tmp/ffplay-build/install
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libavutil/macros.h"
+
+#include "ffplay_cenc.h"
+
+#define SAMPLE_SIZE (64 * 1024)
+#define SUBSAMPLES 4
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, uint32_t scheme, unsigned crypt, unsigned skip, int use_ce)
+{
+    static uint8_t buf[SAMPLE_SIZE];
+    AVSubsampleEncryptionInfo s[SUBSAMPLES];
+    AVEncryptionInfo info = { 0 };
+    uint8_t key[16] = { 1 }, iv[16] = { 2 };
+    Cenc *c = cenc_alloc(key, use_ce);
+    double t0, t;
+    int64_t bytes = 0;
+    int i;
+
+    if (use_ce && !c->ce) {
+        cenc_free(&c);
+        return;
+    }
+    /* a clear NAL header, then the slice data */
+    for (i = 0; i < SUBSAMPLES; i++) {
+        s[i].bytes_of_clear_data = 5;
+        s[i].bytes_of_protected_data = SAMPLE_SIZE / SUBSAMPLES - 5;
+    }
+    info.scheme = scheme;
+    info.crypt_byte_block = crypt;
+    info.skip_byte_block = skip;
+    info.iv = iv;
+    info.iv_size = 16;
+    info.subsamples = s;
+    info.subsample_count = SUBSAMPLES;
+
+    t0 = now();
+    do {
+        for (i = 0; i < 16; i++)
+            cenc_decrypt_sample(c, &info, buf, sizeof(buf));
+        bytes += 16 * sizeof(buf);
+    } while ((t = now() - t0) < 0.5);
+    printf("%-12s %-4s %8.1f MB/s\n", name, c->ce ? "ce" : "c", bytes / t / 1e6);
+    cenc_free(&c);
+}
+
+int main(void)
+{
+    int use_ce;
+
+    for (use_ce = 0; use_ce <= 1; use_ce++) {
+        bench("cenc",      MKBETAG('c','e','n','c'), 0, 0, use_ce);
+        bench("cens 1:9",  MKBETAG('c','e','n','s'), 1, 9, use_ce);
+    }
+    /* CBC is libavutil's either way */
+    bench("cbc1",      MKBETAG('c','b','c','1'), 0, 0, 0);
+    bench("cbcs 1:9",  MKBETAG('c','b','c','s'), 1, 9, 0);
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Known-answer tests for ffplay_cenc.c: the FIPS-197 key schedule and
+ * cipher, and the four CENC schemes built from the SP 800-38A CTR and CBC
+ * vectors, with subsamples and crypt/skip patterns. On a CPU with the ARMv8
+ * AES instructions every case runs on both CTR paths, and the two are also
+ * compared on random samples.
+ *
+ *   make -C ffplay/tests test
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+
+#include "ffplay_cenc.h"
+
+static int failures;
+
+#define CHECK(cond, ...) do {                                           \
+    if (!(cond)) {                                                      \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__);                     \
+        printf(__VA_ARGS__);                                            \
+        printf("\n");                                                   \
+        failures++;                                                     \
+    }                                                                   \
+} while (0)
+
+static void hex(uint8_t *dst, const char *s)
+{
+    for (; *s; s += 2)
+        sscanf(s, "%2hhx", dst++);
+}
+
+/* FIPS-197 appendix A.1 */
+static const char *const fips_key = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char *const fips_round_keys[11] = {
+    "2b7e151628aed2a6abf7158809cf4f3c",
+    "a0fafe1788542cb123a339392a6c7605",
+    "f2c295f27a96b9435935807a7359f67f",
+    "3d80477d4716fe3e1e237e446d7a883b",
+    "ef44a541a8525b7fb671253bdb0bad00",
+    "d4d1c6f87c839d87caf2b8bc11f915bc",
+    "6d88a37a110b3efddbf98641ca0093fd",
+    "4e54f70e5f5fc9f384a64fb24ea6dc4f",
+    "ead27321b58dbad2312bf5607f8d292f",
+    "ac7766f319fadc2128d12941575c006e",
+    "d014f9a8c9ee2589e13f0cc8b6630ca6",
+};
+
+/* SP 800-38A F.5.1 (CTR) and F.2.1 (CBC), key as above */
+static const char *const sp_plain =
+    "6bc1bee22e409f96e93d7e117393172a" "ae2d8a571e03ac9c9eb76fac45af8e51"
+    "30c81c46a35ce411e5fbc1191a0a52ef" "f69f2445df4f9b17ad2b417be66c3710";
+static const char *const sp_ctr_iv = "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+static const char *const sp_ctr =
+    "874d6191b620e3261bef6864990db6ce" "9806f66b7970fdff8617187bb9fffdff"
+    "5ae4df3edbd5d35e5b4f09020db03eab" "1e031dda2fbe03d1792170a0f3009cee";
+static const char *const sp_cbc_iv = "000102030405060708090a0b0c0d0e0f";
+static const char *const sp_cbc =
+    "7649abac8119b246cee98e9b12e9197d" "5086cb9b507219ee95db113a917678b2"
+    "73bed6b8e3c1743b7116e69e22229516" "3ff1caa1681fac09120eca307586e1a7";
+
+static uint8_t key[16], plain[64], ctr_iv[16], ctr_ct[64], cbc_iv[16], cbc_ct[64];
+
+/* a sample as pieces: clear bytes stay, protected ones are ciphertext in
+ * and plaintext out */
+typedef struct Piece {
+    int clear;                          /* 1: filler, the same before and after */
+    int offset, len;                    /* else a range of the vector */
+} Piece;
+
+static int build(uint8_t *in, uint8_t *out, const uint8_t *ct, const Piece *pieces, int nb)
+{
+    int i, j, size = 0;
+
+    for (i = 0; i < nb; i++) {
+        for (j = 0; j < pieces[i].len; j++, size++) {
+            if (pieces[i].clear) {
+                in[size] = out[size] = 0xa0 + i;
+            } else {
+                in[size]  = ct[pieces[i].offset + j];
+                out[size] = plain[pieces[i].offset + j];
+            }
+        }
+    }
+    return size;
+}
+
+static void run_case(const char *name, int use_ce, uint32_t scheme, unsigned crypt, unsigned skip,
+                     const uint8_t *iv, const uint8_t *ct, const Piece *pieces, int nb_pieces,
+                     const AVSubsampleEncryptionInfo *sub, int nb_sub)
+{
+    AVEncryptionInfo info = { 0 };
+    uint8_t in[512], out[512];
+    int size = build(in, out, ct, pieces, nb_pieces), ret;
+    Cenc *c = cenc_alloc(key, use_ce);
+
+    info.scheme = scheme;
+    info.crypt_byte_block = crypt;
+    info.skip_byte_block = skip;
+    info.iv = (uint8_t *)iv;
+    info.iv_size = 16;
+    info.subsamples = (AVSubsampleEncryptionInfo *)sub;
+    info.subsample_count = nb_sub;
+    ret = cenc_decrypt_sample(c, &info, in, size);
+    CHECK(ret == 0, "%s (%s): returned %d", name, c->ce ? "ce" : "c", ret);
+    CHECK(!memcmp(in, out, size), "%s (%s): wrong plaintext", name, c->ce ? "ce" : "c");
+    cenc_free(&c);
+}
+
+static void test_key_schedule(void)
+{
+    uint8_t rk[16];
+    Cenc *c = cenc_alloc(key, 0);
+    int r;
+
+    for (r = 0; r < 11; r++) {
+        hex(rk, fips_round_keys[r]);
+        CHECK(!memcmp(c->round_keys[r], rk, 16), "round key %d", r);
+    }
+    cenc_free(&c);
+}
+
+/* FIPS-197 appendix C.1: one CTR block is the cipher of the counter */
+static void test_cipher(int use_ce)
+{
+    AVEncryptionInfo info = { 0 };
+    uint8_t k[16], iv[16], buf[16] = { 0 }, expect[16];
+    Cenc *c;
+
+    hex(k, "000102030405060708090a0b0c0d0e0f");
+    hex(iv, "00112233445566778899aabbccddeeff");
+    hex(expect, "69c4e0d86a7b0430d8cdb78070b4c55a");
+    c = cenc_alloc(k, use_ce);
+    info.scheme = MKBETAG('c','e','n','c');
+    info.iv = iv;
+    info.iv_size = 16;
+    CHECK(!cenc_decrypt_sample(c, &info, buf, 16) && !memcmp(buf, expect, 16),
+          "FIPS-197 C.1 (%s)", c->ce ? "ce" : "c");
+    cenc_free(&c);
+}
+
+static void test_schemes(int use_ce)
+{
+    const uint32_t cenc = MKBETAG('c','e','n','c'), cens = MKBETAG('c','e','n','s');
+    const uint32_t cbc1 = MKBETAG('c','b','c','1'), cbcs = MKBETAG('c','b','c','s');
+
+    {   /* whole sample, no subsamples */
+        static const Piece p[] = { { 0, 0, 64 } };
+        run_case("cenc, no subsamples", use_ce, cenc, 0, 0, ctr_iv, ctr_ct, p, 1, NULL, 0);
+        run_case("cbc1, no subsamples", use_ce, cbc1, 0, 0, cbc_iv, cbc_ct, p, 1, NULL, 0);
+    }
+    {   /* the keystream runs on across subsamples, mid-block */
+        static const Piece p[] = { { 1, 0, 5 }, { 0, 0, 21 }, { 1, 0, 3 }, { 0, 21, 2 },
+                                   { 1, 0, 1 }, { 0, 23, 41 } };
+        static const AVSubsampleEncryptionInfo s[] = { { 5, 21 }, { 3, 2 }, { 1, 41 } };
+        run_case("cenc, subsamples", use_ce, cenc, 0, 0, ctr_iv, ctr_ct, p, 6, s, 3);
+    }
+    {   /* 1:1 pattern, the partial block at the end of a range stays clear,
+         * the counter only advances over the encrypted blocks */
+        static const Piece p[] = { { 1, 0, 4 }, { 0, 0, 16 }, { 1, 0, 16 }, { 0, 16, 16 },
+                                   { 1, 0, 16 }, { 0, 32, 16 }, { 1, 0, 7 },
+                                   { 1, 0, 2 }, { 0, 48, 16 } };
+        static const AVSubsampleEncryptionInfo s[] = { { 4, 87 }, { 2, 16 } };
+        run_case("cens, 1:1 pattern", use_ce, cens, 1, 1, ctr_iv, ctr_ct, p, 9, s, 2);
+    }
+    {   /* 2:3 pattern, a short last run of encrypted blocks */
+        static const Piece p[] = { { 0, 0, 32 }, { 1, 0, 48 }, { 0, 32, 16 } };
+        static const AVSubsampleEncryptionInfo s[] = { { 0, 96 } };
+        run_case("cens, 2:3 pattern", use_ce, cens, 2, 3, ctr_iv, ctr_ct, p, 3, s, 1);
+    }
+    {   /* the chain runs on across subsamples */
+        static const Piece p[] = { { 1, 0, 3 }, { 0, 0, 32 }, { 1, 0, 5 }, { 0, 32, 32 } };
+        static const AVSubsampleEncryptionInfo s[] = { { 3, 32 }, { 5, 32 } };
+        run_case("cbc1, subsamples", use_ce, cbc1, 0, 0, cbc_iv, cbc_ct, p, 4, s, 2);
+    }
+    {   /* 1:2 pattern: the chain skips the clear blocks, the IV restarts
+         * with each subsample, a partial block at the end stays clear */
+        static const Piece p[] = { { 1, 0, 4 }, { 0, 0, 16 }, { 1, 0, 32 }, { 0, 16, 16 },
+                                   { 1, 0, 32 }, { 0, 32, 16 }, { 1, 0, 10 },
+                                   { 1, 0, 1 }, { 0, 0, 16 }, { 1, 0, 32 }, { 0, 16, 16 } };
+        static const AVSubsampleEncryptionInfo s[] = { { 4, 122 }, { 1, 64 } };
+        run_case("cbcs, 1:2 pattern", use_ce, cbcs, 1, 2, cbc_iv, cbc_ct, p, 11, s, 2);
+    }
+}
+
+static void test_errors(void)
+{
+    AVEncryptionInfo info = { 0 };
+    AVSubsampleEncryptionInfo s[] = { { 10, 10 } };
+    uint8_t iv[16] = { 0 }, buf[19] = { 0 };
+    Cenc *c = cenc_alloc(key, 1);
+
+    info.iv = iv;
+    info.iv_size = 16;
+    info.scheme = MKBETAG('c','e','n','c');
+    info.subsamples = s;
+    info.subsample_count = 1;
+    CHECK(cenc_decrypt_sample(c, &info, buf, sizeof(buf)) == AVERROR_INVALIDDATA,
+          "subsample past the end of the sample");
+    s[0].bytes_of_clear_data = 20;
+    s[0].bytes_of_protected_data = 0;
+    CHECK(cenc_decrypt_sample(c, &info, buf, sizeof(buf)) == AVERROR_INVALIDDATA,
+          "clear data past the end of the sample");
+    info.subsample_count = 0;
+    info.scheme = MKBETAG('c','b','c','2');
+    CHECK(cenc_decrypt_sample(c, &info, buf, sizeof(buf)) == AVERROR_PATCHWELCOME,
+          "unknown scheme");
+    cenc_free(&c);
+}
+
+/* random samples through both CTR paths, with the counter about to wrap */
+static void test_c_vs_ce(void)
+{
+    uint8_t k[16], iv[16], a[4096], b[4096];
+    AVSubsampleEncryptionInfo s[8];
+    AVEncryptionInfo info = { 0 };
+    Cenc *c, *ce;
+    int i, j, n;
+
+    ce = cenc_alloc(key, 1);
+    if (!ce->ce) {
+        printf("skip: C against the AES instructions, not available\n");
+        cenc_free(&ce);
+        return;
+    }
+    cenc_free(&ce);
+    srand(1);
+    for (n = 0; n < 200; n++) {
+        size_t size = 0;
+
+        for (i = 0; i < 16; i++) {
+            k[i] = rand();
+            iv[i] = n & 1 ? 0xff : rand();
+        }
+        info.scheme = n & 2 ? MKBETAG('c','e','n','s') : MKBETAG('c','e','n','c');
+        info.crypt_byte_block = n & 2 ? 1 + rand() % 3 : 0;
+        info.skip_byte_block = n & 2 ? rand() % 10 : 0;
+        info.iv = iv;
+        info.iv_size = 16;
+        info.subsamples = s;
+        info.subsample_count = rand() % 9;
+        for (i = 0; i < (int)info.subsample_count; i++) {
+            s[i].bytes_of_clear_data = rand() % 64;
+            s[i].bytes_of_protected_data = rand() % 400;
+            size += s[i].bytes_of_clear_data + s[i].bytes_of_protected_data;
+        }
+        if (!info.subsample_count)
+            size = rand() % sizeof(a);
+        for (j = 0; j < (int)size; j++)
+            a[j] = b[j] = rand();
+        c = cenc_alloc(k, 0);
+        ce = cenc_alloc(k, 1);
+        cenc_decrypt_sample(c, &info, a, size);
+        cenc_decrypt_sample(ce, &info, b, size);
+        CHECK(!memcmp(a, b, size), "C and AES instructions differ, sample %d", n);
+        cenc_free(&c);
+        cenc_free(&ce);
+    }
+}
+
+int main(void)
+{
+    int use_ce;
+
+    hex(key, fips_key);
+    hex(plain, sp_plain);
+    hex(ctr_iv, sp_ctr_iv);
+    hex(ctr_ct, sp_ctr);
+    hex(cbc_iv, sp_cbc_iv);
+    hex(cbc_ct, sp_cbc);
+
+    test_key_schedule();
+    for (use_ce = 0; use_ce <= 1; use_ce++) {
+        test_cipher(use_ce);
+        test_schemes(use_ce);
+    }
+    test_errors();
+    test_c_vs_ce();
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return !!failures;
+}
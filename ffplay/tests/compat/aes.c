@@ -0,0 +1,43 @@
+/* av_aes_*() on OpenSSL: ECB, or CBC with iv updated, like libavutil. The
+ * EVP context is not freed, as av_free() cannot know about it. */
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "libavutil/aes.h"
+
+struct AVAES {
+    EVP_CIPHER_CTX *ctx;
+    uint8_t key[16];
+    int decrypt;
+};
+
+struct AVAES *av_aes_alloc(void)
+{
+    return calloc(1, sizeof(struct AVAES));
+}
+
+int av_aes_init(struct AVAES *a, const uint8_t *key, int key_bits, int decrypt)
+{
+    if (key_bits != 128 || !(a->ctx = EVP_CIPHER_CTX_new()))
+        return -1;
+    memcpy(a->key, key, 16);
+    a->decrypt = decrypt;
+    return 0;
+}
+
+void av_aes_crypt(struct AVAES *a, uint8_t *dst, const uint8_t *src, int count, uint8_t *iv, int decrypt)
+{
+    uint8_t last[16];
+    int len;
+
+    if (count <= 0)
+        return;
+    if (iv && decrypt)                  /* src may be dst */
+        memcpy(last, src + 16 * (count - 1), 16);
+    EVP_CipherInit_ex(a->ctx, iv ? EVP_aes_128_cbc() : EVP_aes_128_ecb(), NULL, a->key, iv, !decrypt);
+    EVP_CIPHER_CTX_set_padding(a->ctx, 0);
+    EVP_CipherUpdate(a->ctx, dst, &len, src, 16 * count);
+    if (iv)
+        memcpy(iv, decrypt ? last : dst + 16 * (count - 1), 16);
+}
@@ -0,0 +1,11 @@
+/* the parts of FFmpeg's config.h the host builds need */
+#ifndef FFPLAY_TESTS_CONFIG_H
+#define FFPLAY_TESTS_CONFIG_H
+
+#ifdef __aarch64__
+#define ARCH_AARCH64 1
+#else
+#define ARCH_AARCH64 0
+#endif
+
+#endif
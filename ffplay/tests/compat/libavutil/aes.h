@@ -0,0 +1,13 @@
+/* libavutil's AES API on OpenSSL, for host builds without FFmpeg (aes.c) */
+#ifndef FFPLAY_TESTS_AES_H
+#define FFPLAY_TESTS_AES_H
+
+#include <stdint.h>
+
+struct AVAES;
+
+struct AVAES *av_aes_alloc(void);
+int av_aes_init(struct AVAES *a, const uint8_t *key, int key_bits, int decrypt);
+void av_aes_crypt(struct AVAES *a, uint8_t *dst, const uint8_t *src, int count, uint8_t *iv, int decrypt);
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef FFPLAY_TESTS_BSWAP_H
+#define FFPLAY_TESTS_BSWAP_H
+
+#define av_bswap64 __builtin_bswap64
+
+#endif
@@ -0,0 +1,24 @@
+/* the structures of libavutil/encryption_info.h, without the side data API */
+#ifndef FFPLAY_TESTS_ENCRYPTION_INFO_H
+#define FFPLAY_TESTS_ENCRYPTION_INFO_H
+
+#include <stdint.h>
+
+typedef struct AVSubsampleEncryptionInfo {
+    unsigned int bytes_of_clear_data;
+    unsigned int bytes_of_protected_data;
+} AVSubsampleEncryptionInfo;
+
+typedef struct AVEncryptionInfo {
+    uint32_t scheme;
+    uint32_t crypt_byte_block;
+    uint32_t skip_byte_block;
+    uint8_t *key_id;
+    uint32_t key_id_size;
+    uint8_t *iv;
+    uint32_t iv_size;
+    AVSubsampleEncryptionInfo *subsamples;
+    uint32_t subsample_count;
+} AVEncryptionInfo;
+
+#endif
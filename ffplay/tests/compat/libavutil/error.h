@@ -0,0 +1,12 @@
+#ifndef FFPLAY_TESTS_ERROR_H
+#define FFPLAY_TESTS_ERROR_H
+
+#include <errno.h>
+
+#include "macros.h"
+
+#define AVERROR(e) (-(e))
+#define AVERROR_INVALIDDATA FFERRTAG('I','N','D','A')
+#define AVERROR_PATCHWELCOME FFERRTAG('P','A','W','E')
+
+#endif
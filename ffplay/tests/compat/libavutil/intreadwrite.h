@@ -0,0 +1,12 @@
+#ifndef FFPLAY_TESTS_INTREADWRITE_H
+#define FFPLAY_TESTS_INTREADWRITE_H
+
+#include <stdint.h>
+#include <string.h>
+
+static inline uint64_t AV_RN64(const void *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static inline void AV_WN64(void *p, uint64_t v) { memcpy(p, &v, 8); }
+#define AV_RB64(p) __builtin_bswap64(AV_RN64(p))
+#define AV_WB64(p, v) AV_WN64(p, __builtin_bswap64(v))
+
+#endif
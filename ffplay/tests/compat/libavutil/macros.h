@@ -0,0 +1,11 @@
+#ifndef FFPLAY_TESTS_MACROS_H
+#define FFPLAY_TESTS_MACROS_H
+
+#define FFMAX(a,b) ((a) > (b) ? (a) : (b))
+#define FFMIN(a,b) ((a) > (b) ? (b) : (a))
+#define FFSWAP(type,a,b) do{type SWAP_tmp= b; b= a; a= SWAP_tmp;}while(0)
+#define MKTAG(a,b,c,d)   ((a) | ((b) << 8) | ((c) << 16) | ((unsigned)(d) << 24))
+#define MKBETAG(a,b,c,d) ((d) | ((c) << 8) | ((b) << 16) | ((unsigned)(a) << 24))
+#define FFERRTAG(a, b, c, d) (-(int)MKTAG(a, b, c, d))
+
+#endif
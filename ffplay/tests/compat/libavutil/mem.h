@@ -0,0 +1,10 @@
+#ifndef FFPLAY_TESTS_MEM_H
+#define FFPLAY_TESTS_MEM_H
+
+#include <stdlib.h>
+
+#define av_mallocz(size) calloc(1, size)
+#define av_free free
+#define av_freep(p) do { free(*(p)); *(p) = NULL; } while (0)
+
+#endif
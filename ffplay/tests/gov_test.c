@@ -0,0 +1,224 @@
+/*
+ * Tests for ffplay_gov.c on a fake sysfs tree in a temporary directory:
+ * policy discovery, the step up, step down and thermal decisions, the
+ * limits written for each level, and their restore.
+ *
+ *   make -C ffplay/tests test
+ */
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ffplay_gov.h"
+
+static int failures;
+static char root[] = "/tmp/gov_test.XXXXXX";
+
+#define CHECK(cond, ...) do {                                           \
+    if (!(cond)) {                                                      \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__);                     \
+        printf(__VA_ARGS__);                                            \
+        printf("\n");                                                   \
+        failures++;                                                     \
+    }                                                                   \
+} while (0)
+
+/* create root/<dir>/<name> holding text, with its directories */
+static void put(const char *dir, const char *name, const char *text)
+{
+    char path[512], *p;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s/", root, dir);
+    for (p = path + strlen(root) + 1; (p = strchr(p, '/')); p++) {
+        *p = 0;
+        mkdir(path, 0755);
+        *p = '/';
+    }
+    strcat(path, name);
+    if (!(f = fopen(path, "w"))) {
+        perror(path);
+        exit(1);
+    }
+    fputs(text, f);
+    fclose(f);
+}
+
+static long policy_value(int cpu, const char *name)
+{
+    char fmt[128];
+
+    snprintf(fmt, sizeof(fmt), "%s%s", GOV_POLICY, name);
+    return sysfs_read_long(root, fmt, cpu);
+}
+
+/* cpu0-1: a table, unsorted; cpu2-3: only the hardware range; cpu4: read-only */
+static void make_tree(void)
+{
+    put("devices/system/cpu/cpufreq/policy0", "scaling_min_freq", "408000\n");
+    put("devices/system/cpu/cpufreq/policy0", "scaling_max_freq", "1800000\n");
+    put("devices/system/cpu/cpufreq/policy0", "scaling_available_frequencies",
+        "1200000 408000 1800000 816000 \n");
+
+    put("devices/system/cpu/cpufreq/policy2", "scaling_min_freq", "200000\n");
+    put("devices/system/cpu/cpufreq/policy2", "scaling_max_freq", "1600000\n");
+    put("devices/system/cpu/cpufreq/policy2", "cpuinfo_min_freq", "200000\n");
+    put("devices/system/cpu/cpufreq/policy2", "cpuinfo_max_freq", "1600000\n");
+
+    /* a directory in place of the file: cannot be opened for writing, even as root */
+    put("devices/system/cpu/cpufreq/policy4", "scaling_min_freq", "300000\n");
+    put("devices/system/cpu/cpufreq/policy4/scaling_max_freq", "x", "");
+    put("devices/system/cpu/cpufreq/policy4", "cpuinfo_min_freq", "300000\n");
+    put("devices/system/cpu/cpufreq/policy4", "cpuinfo_max_freq", "900000\n");
+
+    put("class/thermal/thermal_zone0", "temp", "41000\n");
+    put("class/thermal/thermal_zone1", "temp", "45000\n");
+}
+
+static void set_temp(int zone, int mc)
+{
+    char dir[64], text[32];
+
+    snprintf(dir, sizeof(dir), "class/thermal/thermal_zone%d", zone);
+    snprintf(text, sizeof(text), "%d\n", mc);
+    put(dir, "temp", text);
+}
+
+static void check_limits(int cpu, long freq)
+{
+    CHECK(policy_value(cpu, "scaling_min_freq") == freq && policy_value(cpu, "scaling_max_freq") == freq,
+          "policy%d: limits %ld-%ld, expected %ld", cpu, policy_value(cpu, "scaling_min_freq"),
+          policy_value(cpu, "scaling_max_freq"), freq);
+}
+
+static void test_init(Gov *g)
+{
+    CHECK(gov_init(g, root, 6) == 2, "%d policies, expected 2", g->nb_policies);
+    CHECK(g->policies[0].cpu == 0 && g->policies[1].cpu == 2, "policies on cpu%d and cpu%d",
+          g->policies[0].cpu, g->policies[1].cpu);
+    CHECK(g->policies[0].nb_freqs == 4 && g->policies[0].freqs[0] == 408000 &&
+          g->policies[0].freqs[3] == 1800000, "table not read in ascending order");
+    CHECK(g->policies[1].nb_freqs == GOV_LINEAR_FREQS && g->policies[1].freqs[0] == 200000 &&
+          g->policies[1].freqs[GOV_LINEAR_FREQS - 1] == 1600000, "hardware range not spread");
+    CHECK(g->levels == GOV_LINEAR_FREQS - 1, "%d levels", g->levels);
+    CHECK(g->level == g->levels, "starts at level %d, not the top", g->level);
+    CHECK(g->nb_zones == 2, "%d thermal zones", g->nb_zones);
+    CHECK(gov_temperature(g) == 45000, "temperature %d, expected the hottest zone", gov_temperature(g));
+
+    CHECK(gov_apply(g) == 1800000, "top clock not the fastest");
+    check_limits(0, 1800000);
+    check_limits(2, 1600000);
+}
+
+static void test_step_down(Gov *g)
+{
+    int level = g->level, i;
+
+    /* the decoder waits most of the time: one level down per GOV_DOWN_TICKS */
+    for (i = 1; i < GOV_DOWN_TICKS; i++)
+        CHECK(gov_step(g, 0, 0.9, 45000) == level, "stepped down after %d intervals", i);
+    CHECK(gov_step(g, 0, 0.9, 45000) == level - 1, "no step down after %d intervals", GOV_DOWN_TICKS);
+    gov_apply(g);
+    check_limits(2, 1400000);
+
+    /* not enough room one level lower: stays */
+    for (i = 0; i < 2 * GOV_DOWN_TICKS; i++)
+        CHECK(gov_step(g, 0, 0.15, 45000) == level - 1, "stepped down without headroom");
+
+    /* all the way down, never below 0 */
+    for (i = 0; i < GOV_DOWN_TICKS * (g->levels + 2); i++)
+        gov_step(g, 0, 1, 45000);
+    CHECK(g->level == 0, "level %d after idling, expected 0", g->level);
+    gov_apply(g);
+    check_limits(0, 408000);
+    check_limits(2, 200000);
+}
+
+static void test_step_up(Gov *g)
+{
+    int i;
+
+    /* busy decoder: one level up at once */
+    CHECK(gov_step(g, 0, 0.05, 45000) == 1, "busy decoder: level %d, expected 1", g->level);
+    /* dropped frames: two levels up, then no step down for a while */
+    CHECK(gov_step(g, 1, 0.5, 45000) == 3, "drop: level %d, expected 3", g->level);
+    for (i = 0; i < GOV_HOLD_TICKS - 1; i++)
+        CHECK(gov_step(g, 0, 1, 45000) == 3, "stepped down %d intervals after a drop", i + 1);
+    for (i = 0; i < GOV_DOWN_TICKS; i++)
+        gov_step(g, 0, 1, 45000);
+    CHECK(g->level == 2, "level %d once the hold is over, expected 2", g->level);
+
+    for (i = 0; i < g->levels + 1; i++)
+        gov_step(g, 1, 0, 45000);
+    CHECK(g->level == g->levels, "level %d, not capped at the top", g->level);
+}
+
+static void test_thermal(Gov *g)
+{
+    int level;
+
+    g->level = level = 3;
+    g->down = 0;
+
+    set_temp(0, GOV_TEMP_HOT);
+    CHECK(gov_step(g, 1, 0, gov_temperature(g)) == level, "stepped up while hot");
+
+    set_temp(0, GOV_TEMP_CRIT + 5000);
+    CHECK(gov_temperature(g) == GOV_TEMP_CRIT + 5000, "hot zone not seen");
+    CHECK(gov_step(g, 1, 0, gov_temperature(g)) == level - 1, "no step down while critical");
+    CHECK(gov_step(g, 1, 0, gov_temperature(g)) == level - 2, "no step down while critical");
+
+    set_temp(0, 41000);
+    CHECK(gov_step(g, 0, 0.05, gov_temperature(g)) == level - 1, "no step up once cool");
+}
+
+static void test_restore(Gov *g)
+{
+    char path[512], line[256];
+    FILE *f;
+    int n = 0;
+
+    snprintf(path, sizeof(path), "%s/limits", root);
+    CHECK(gov_save_limits(g, path) == 0, "limits not saved");
+    if ((f = fopen(path, "r"))) {
+        while (fgets(line, sizeof(line), f))
+            n++;
+        fclose(f);
+        CHECK(n == 2, "%d lines saved, expected one per policy", n);
+    }
+    unlink(path);
+
+    gov_restore(g);
+    CHECK(policy_value(0, "scaling_min_freq") == 408000 && policy_value(0, "scaling_max_freq") == 1800000,
+          "policy0 not restored");
+    CHECK(policy_value(2, "scaling_min_freq") == 200000 && policy_value(2, "scaling_max_freq") == 1600000,
+          "policy2 not restored");
+    CHECK(policy_value(4, "scaling_min_freq") == 300000, "read-only policy4 was written");
+}
+
+int main(void)
+{
+    char cmd[64];
+    Gov g;
+
+    if (!mkdtemp(root)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    make_tree();
+    test_init(&g);
+    test_step_down(&g);
+    test_step_up(&g);
+    test_thermal(&g);
+    test_restore(&g);
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+    if (system(cmd))
+        printf("cannot remove %s\n", root);
+    printf(failures ? "%d failures\n" : "ok\n", failures);
+    return !!failures;
+}
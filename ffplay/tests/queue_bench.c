@@ -0,0 +1,531 @@
+/*
+ * Host microbenchmark: lock-free packet and frame queues against the
+ * mutex/condition variable queues of upstream ffplay.
+ *
+ * The lock-free code below mirrors ffplay.c (QueueWait, packet_queue_*) with
+ * the AVPacket/AVFrame payload swapped for an integer, so it builds without
+ * FFmpeg. Keep it in step when the queues change. ffplay.c went back to the
+ * mutex/cond frame queue after the lock-free one lost here whenever one
+ * side is slow, which is how the refresh loop and the audio callback run;
+ * the lock-free frame queue stays as the comparison.
+ *
+ *   make -C ffplay/tests bench
+ */
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define FRAME_QUEUE_SIZE 6
+
+static atomic_long nb_futex_wait, nb_futex_wake;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* busy work standing in for demuxing or decoding one item */
+static void work(int iterations)
+{
+    volatile unsigned x = 0;
+    int i;
+
+    for (i = 0; i < iterations; i++)
+        x += i;
+}
+
+/* --- lock-free, as in ffplay.c ------------------------------------------ */
+
+typedef struct QueueWait {
+    atomic_uint seq;
+} QueueWait;
+
+#define QUEUE_WAITER  1u
+#define QUEUE_WAITERS 0xffu
+#define QUEUE_SEQ     0x100u
+#define QUEUE_SPIN    100
+
+static int queue_spin;
+
+static inline void queue_cpu_relax(void)
+{
+#if defined(__aarch64__)
+    __asm__ volatile("yield");
+#elif defined(__x86_64__) || defined(__i386__)
+    __asm__ volatile("pause");
+#endif
+}
+
+static unsigned queue_wait_begin(QueueWait *w)
+{
+    unsigned seq = atomic_fetch_add(&w->seq, QUEUE_WAITER) + QUEUE_WAITER;
+    atomic_thread_fence(memory_order_seq_cst);
+    return seq;
+}
+
+static void queue_unregister(QueueWait *w, unsigned seq)
+{
+    unsigned cur = atomic_load_explicit(&w->seq, memory_order_relaxed);
+
+    while ((cur & ~QUEUE_WAITERS) == (seq & ~QUEUE_WAITERS) && (cur & QUEUE_WAITERS) &&
+           !atomic_compare_exchange_weak(&w->seq, &cur, cur - QUEUE_WAITER))
+        ;
+}
+
+static void queue_wait_end(QueueWait *w, unsigned seq, int sleep)
+{
+    if (sleep) {
+        atomic_fetch_add_explicit(&nb_futex_wait, 1, memory_order_relaxed);
+        syscall(SYS_futex, &w->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+    }
+    queue_unregister(w, seq);
+}
+
+static void queue_wake(QueueWait *w)
+{
+    unsigned cur;
+
+    atomic_thread_fence(memory_order_seq_cst);
+    cur = atomic_load_explicit(&w->seq, memory_order_relaxed);
+    while (cur & QUEUE_WAITERS) {
+        if (atomic_compare_exchange_weak(&w->seq, &cur, (cur & ~QUEUE_WAITERS) + QUEUE_SEQ)) {
+            atomic_fetch_add_explicit(&nb_futex_wake, 1, memory_order_relaxed);
+            syscall(SYS_futex, &w->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+            break;
+        }
+    }
+}
+
+#define QUEUE_WAIT_WHILE(w, busy) do {                                          \
+        unsigned queue_seq_;                                                    \
+        int queue_spin_;                                                        \
+        for (queue_spin_ = 0; queue_spin_ < queue_spin && (busy); queue_spin_++) \
+            queue_cpu_relax();                                                  \
+        if (!(busy))                                                            \
+            break;                                                              \
+        queue_seq_ = queue_wait_begin(w);                                       \
+        queue_wait_end(w, queue_seq_, (busy));                                  \
+    } while (0)
+
+typedef struct Node {
+    int value;
+    int size;
+    atomic_int taken;
+    _Atomic(struct Node *) next;
+} Node;
+
+typedef struct LFPacketQueue {
+    _Atomic(Node *) head;
+    Node *tail;
+    Node *first;
+    Node *head_copy;
+    atomic_int nb_packets;
+    atomic_int size;
+    atomic_int abort_request;
+    QueueWait wait;
+} LFPacketQueue;
+
+static void lf_packet_queue_init(LFPacketQueue *q)
+{
+    Node *n = calloc(1, sizeof(*n));
+
+    memset(q, 0, sizeof(*q));
+    atomic_init(&q->head, n);
+    q->tail = q->first = q->head_copy = n;
+}
+
+static void lf_packet_queue_destroy(LFPacketQueue *q)
+{
+    Node *n = q->first, *next;
+
+    while (n) {
+        next = atomic_load_explicit(&n->next, memory_order_relaxed);
+        free(n);
+        n = next;
+    }
+}
+
+static Node *lf_packet_queue_node(LFPacketQueue *q)
+{
+    Node *n;
+
+    if (q->first == q->head_copy)
+        q->head_copy = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (q->first != q->head_copy) {
+        n = q->first;
+        q->first = atomic_load_explicit(&n->next, memory_order_relaxed);
+    } else if (!(n = calloc(1, sizeof(*n)))) {
+        return NULL;
+    }
+    atomic_store_explicit(&n->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&n->taken, 0, memory_order_relaxed);
+    return n;
+}
+
+static int lf_packet_queue_put(LFPacketQueue *q, int value)
+{
+    Node *n;
+
+    if (q->abort_request || !(n = lf_packet_queue_node(q)))
+        return -1;
+    n->value = value;
+    n->size = 64;
+    q->nb_packets++;
+    q->size += n->size;
+    atomic_store_explicit(&q->tail->next, n, memory_order_release);
+    q->tail = n;
+    queue_wake(&q->wait);
+    return 0;
+}
+
+static int lf_packet_queue_get(LFPacketQueue *q, int *value)
+{
+    Node *head, *n;
+
+    for (;;) {
+        if (q->abort_request)
+            return -1;
+        head = atomic_load_explicit(&q->head, memory_order_relaxed);
+        if ((n = atomic_load_explicit(&head->next, memory_order_acquire))) {
+            int taken = atomic_exchange(&n->taken, 1);
+            if (!taken) {
+                q->nb_packets--;
+                q->size -= n->size;
+                *value = n->value;
+            }
+            atomic_store_explicit(&q->head, n, memory_order_release);
+            if (!taken)
+                return 1;
+        } else {
+            QUEUE_WAIT_WHILE(&q->wait, !q->abort_request &&
+                             !atomic_load_explicit(&head->next, memory_order_acquire));
+        }
+    }
+}
+
+typedef struct LFFrameQueue {
+    int queue[FRAME_QUEUE_SIZE];
+    int rindex;
+    int windex;
+    atomic_int size;
+    QueueWait wait;
+} LFFrameQueue;
+
+static int *lf_frame_queue_peek_writable(LFFrameQueue *f)
+{
+    while (f->size >= FRAME_QUEUE_SIZE)
+        QUEUE_WAIT_WHILE(&f->wait, f->size >= FRAME_QUEUE_SIZE);
+    return &f->queue[f->windex];
+}
+
+static int *lf_frame_queue_peek_readable(LFFrameQueue *f)
+{
+    while (f->size <= 0)
+        QUEUE_WAIT_WHILE(&f->wait, f->size <= 0);
+    return &f->queue[f->rindex];
+}
+
+static void lf_frame_queue_push(LFFrameQueue *f)
+{
+    if (++f->windex == FRAME_QUEUE_SIZE)
+        f->windex = 0;
+    f->size++;
+    queue_wake(&f->wait);
+}
+
+static void lf_frame_queue_next(LFFrameQueue *f)
+{
+    if (++f->rindex == FRAME_QUEUE_SIZE)
+        f->rindex = 0;
+    f->size--;
+    queue_wake(&f->wait);
+}
+
+/* --- mutex/cond, as in upstream ffplay ---------------------------------- */
+
+typedef struct MCPacketQueue {
+    int *fifo;
+    int fifo_size, rpos, count;
+    int nb_packets;
+    int size;
+    int abort_request;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} MCPacketQueue;
+
+static void mc_packet_queue_init(MCPacketQueue *q)
+{
+    memset(q, 0, sizeof(*q));
+    q->fifo_size = 1;
+    q->fifo = malloc(sizeof(*q->fifo));
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->cond, NULL);
+}
+
+static void mc_packet_queue_destroy(MCPacketQueue *q)
+{
+    free(q->fifo);
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->cond);
+}
+
+/* AVFifo with auto-grow: double and unwrap when full */
+static int mc_packet_queue_put(MCPacketQueue *q, int value)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->abort_request) {
+        ret = -1;
+    } else {
+        if (q->count == q->fifo_size) {
+            int *fifo = malloc(2 * q->fifo_size * sizeof(*fifo)), i;
+            for (i = 0; i < q->count; i++)
+                fifo[i] = q->fifo[(q->rpos + i) % q->fifo_size];
+            free(q->fifo);
+            q->fifo = fifo;
+            q->fifo_size *= 2;
+            q->rpos = 0;
+        }
+        q->fifo[(q->rpos + q->count++) % q->fifo_size] = value;
+        q->nb_packets++;
+        q->size += 64;
+        pthread_cond_signal(&q->cond);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+static int mc_packet_queue_get(MCPacketQueue *q, int *value)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->mutex);
+    for (;;) {
+        if (q->abort_request) {
+            ret = -1;
+            break;
+        }
+        if (q->count) {
+            *value = q->fifo[q->rpos];
+            q->rpos = (q->rpos + 1) % q->fifo_size;
+            q->count--;
+            q->nb_packets--;
+            q->size -= 64;
+            ret = 1;
+            break;
+        }
+        pthread_cond_wait(&q->cond, &q->mutex);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+typedef struct MCFrameQueue {
+    int queue[FRAME_QUEUE_SIZE];
+    int rindex;
+    int windex;
+    int size;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} MCFrameQueue;
+
+static int *mc_frame_queue_peek_writable(MCFrameQueue *f)
+{
+    pthread_mutex_lock(&f->mutex);
+    while (f->size >= FRAME_QUEUE_SIZE)
+        pthread_cond_wait(&f->cond, &f->mutex);
+    pthread_mutex_unlock(&f->mutex);
+    return &f->queue[f->windex];
+}
+
+static int *mc_frame_queue_peek_readable(MCFrameQueue *f)
+{
+    pthread_mutex_lock(&f->mutex);
+    while (f->size <= 0)
+        pthread_cond_wait(&f->cond, &f->mutex);
+    pthread_mutex_unlock(&f->mutex);
+    return &f->queue[f->rindex];
+}
+
+static void mc_frame_queue_push(MCFrameQueue *f)
+{
+    if (++f->windex == FRAME_QUEUE_SIZE)
+        f->windex = 0;
+    pthread_mutex_lock(&f->mutex);
+    f->size++;
+    pthread_cond_signal(&f->cond);
+    pthread_mutex_unlock(&f->mutex);
+}
+
+static void mc_frame_queue_next(MCFrameQueue *f)
+{
+    if (++f->rindex == FRAME_QUEUE_SIZE)
+        f->rindex = 0;
+    pthread_mutex_lock(&f->mutex);
+    f->size--;
+    pthread_cond_signal(&f->cond);
+    pthread_mutex_unlock(&f->mutex);
+}
+
+/* --- runs ---------------------------------------------------------------- */
+
+typedef struct Run {
+    int lock_free;
+    int frames;                         /* frame queue, else packet queue */
+    int count;
+    int producer_work, consumer_work;
+    LFPacketQueue lfp;
+    MCPacketQueue mcp;
+    LFFrameQueue lff;
+    MCFrameQueue mcf;
+    int64_t sum;
+} Run;
+
+static void *producer(void *arg)
+{
+    Run *r = arg;
+    int i;
+
+    for (i = 1; i <= r->count; i++) {
+        work(r->producer_work);
+        if (r->frames) {
+            if (r->lock_free) {
+                *lf_frame_queue_peek_writable(&r->lff) = i;
+                lf_frame_queue_push(&r->lff);
+            } else {
+                *mc_frame_queue_peek_writable(&r->mcf) = i;
+                mc_frame_queue_push(&r->mcf);
+            }
+        } else if (r->lock_free) {
+            lf_packet_queue_put(&r->lfp, i);
+        } else {
+            mc_packet_queue_put(&r->mcp, i);
+        }
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    Run *r = arg;
+    int i, value = 0;
+
+    for (i = 1; i <= r->count; i++) {
+        if (r->frames) {
+            if (r->lock_free) {
+                value = *lf_frame_queue_peek_readable(&r->lff);
+                lf_frame_queue_next(&r->lff);
+            } else {
+                value = *mc_frame_queue_peek_readable(&r->mcf);
+                mc_frame_queue_next(&r->mcf);
+            }
+        } else if (r->lock_free) {
+            lf_packet_queue_get(&r->lfp, &value);
+        } else {
+            mc_packet_queue_get(&r->mcp, &value);
+        }
+        if (value != i) {
+            fprintf(stderr, "got item %d, expected %d\n", value, i);
+            exit(1);
+        }
+        r->sum += value;
+        work(r->consumer_work);
+    }
+    return NULL;
+}
+
+#define REPEATS 5
+
+static int cmp_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* one producer/consumer pass; returns ns per item, -1 if items got lost */
+static int64_t run_once(int lock_free, int frames, int count, int producer_work,
+                        int consumer_work, long *waits, long *wakes)
+{
+    Run r = { lock_free, frames, count, producer_work, consumer_work };
+    pthread_t p, c;
+    int64_t t;
+
+    lf_packet_queue_init(&r.lfp);
+    mc_packet_queue_init(&r.mcp);
+    pthread_mutex_init(&r.mcf.mutex, NULL);
+    pthread_cond_init(&r.mcf.cond, NULL);
+    atomic_store(&nb_futex_wait, 0);
+    atomic_store(&nb_futex_wake, 0);
+
+    t = now_ns();
+    pthread_create(&c, NULL, consumer, &r);
+    pthread_create(&p, NULL, producer, &r);
+    pthread_join(p, NULL);
+    pthread_join(c, NULL);
+    t = now_ns() - t;
+
+    *waits += atomic_load(&nb_futex_wait);
+    *wakes += atomic_load(&nb_futex_wake);
+    lf_packet_queue_destroy(&r.lfp);
+    mc_packet_queue_destroy(&r.mcp);
+    pthread_mutex_destroy(&r.mcf.mutex);
+    pthread_cond_destroy(&r.mcf.cond);
+    return r.sum != (int64_t)count * (count + 1) / 2 ? -1 : t / count;
+}
+
+/* both kinds, alternating so that they see the same machine; median of REPEATS */
+static int run(const char *name, int frames, int count, int producer_work, int consumer_work)
+{
+    int64_t t[2][REPEATS];
+    long waits = 0, wakes = 0, dummy = 0;
+    int i, lock_free;
+
+    for (i = 0; i < REPEATS; i++) {
+        for (lock_free = 1; lock_free >= 0; lock_free--) {
+            t[lock_free][i] = run_once(lock_free, frames, count, producer_work, consumer_work,
+                                       lock_free ? &waits : &dummy, lock_free ? &wakes : &dummy);
+            if (t[lock_free][i] < 0) {
+                fprintf(stderr, "%s: items lost\n", name);
+                return 1;
+            }
+        }
+    }
+    qsort(t[0], REPEATS, sizeof(t[0][0]), cmp_int64);
+    qsort(t[1], REPEATS, sizeof(t[1][0]), cmp_int64);
+    printf("%-24s %7"PRId64" %7"PRId64" ns/item   %5.2fx   futex wait %ld wake %ld\n", name,
+           t[1][REPEATS / 2], t[0][REPEATS / 2], (double)t[0][REPEATS / 2] / t[1][REPEATS / 2],
+           waits / REPEATS, wakes / REPEATS);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 1000000;
+    int ret = 0;
+
+    /* as ffplay: no point polling for the other thread on a single core */
+    queue_spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? QUEUE_SPIN : 0;
+    printf("%ld cpus, spin %d, median of %d\n", sysconf(_SC_NPROCESSORS_ONLN), queue_spin, REPEATS);
+    printf("%-24s %7s %7s           speedup  (lock-free, per run)\n", "", "lockfree", "mutex");
+    ret |= run("packets, no work",       0, count, 0, 0);
+    ret |= run("packets, slow consumer", 0, count / 10, 0, 200);
+    ret |= run("packets, slow producer", 0, count / 10, 200, 0);
+    ret |= run("frames, no work",        1, count, 0, 0);
+    ret |= run("frames, slow consumer",  1, count / 10, 0, 200);
+    ret |= run("frames, slow producer",  1, count / 10, 200, 0);
+    return ret;
+}
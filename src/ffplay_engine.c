@@ -4,6 +4,8 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <errno.h>
 
 #include "vp_defines.h"
@@ -84,9 +86,56 @@ static int is_bluetooth_audio(void) {
     return 0;
 }
 
+#define TIMESHIFT_FILE APP_DATA_DIR "/timeshift.bin"
+#define TIMESHIFT_MIN_MB 64
+#define TIMESHIFT_MAX_MB 1024
+#define RECORD_DIR VIDEO_ROOT "/Recordings"
+#define CPU_LIMITS_FILE APP_DATA_DIR "/cpu_limits"
+
+static void write_sysfs_long(const char* dir, const char* name, long value) {
+    char path[300];
+    snprintf(path, sizeof(path), "%s%s", dir, name);
+    FILE* f = fopen(path, "w");
+    if (f) {
+        fprintf(f, "%ld\n", value);
+        fclose(f);
+    }
+}
+
+// ffplay clamps the CPU clock while it plays and saves the limits it found
+// to CPU_LIMITS_FILE; it puts them back and removes the file on exit. If the
+// file is still there, ffplay was killed or crashed: restore them here.
+static void restore_cpu_limits(void) {
+    FILE* f = fopen(CPU_LIMITS_FILE, "r");
+    if (!f) return;
+    char dir[256];
+    long min, max;
+    while (fscanf(f, "%255s %ld %ld", dir, &min, &max) == 3) {
+        if (strncmp(dir, "/sys/", 5) != 0 || min <= 0 || max < min)
+            continue;
+        // max, min, max: one of the two keeps min <= max at each write,
+        // whatever the limits ffplay left
+        write_sysfs_long(dir, "scaling_max_freq", max);
+        write_sysfs_long(dir, "scaling_min_freq", min);
+        write_sysfs_long(dir, "scaling_max_freq", max);
+        LOG_info("ffplay: restored CPU clock limits %ld-%ld kHz in %s\n", min, max, dir);
+    }
+    fclose(f);
+    unlink(CPU_LIMITS_FILE);
+}
+
+// Timeshift ring size: up to half the free space of the data card (0 = too little)
+static int timeshift_ring_mb(void) {
+    struct statvfs st;
+    if (statvfs(APP_DATA_DIR, &st) != 0) return 0;
+    unsigned long long free_mb = ((unsigned long long)st.f_bavail * st.f_frsize) >> 20;
+    int mb = (int)MIN(free_mb / 2, TIMESHIFT_MAX_MB);
+    return mb >= TIMESHIFT_MIN_MB ? mb : 0;
+}
+
 // Build argv for ffplay and exec in a forked child. Returns exit status.
 static int ffplay_exec(FfplayConfig* config, int use_subs) {
-    char* argv[64];
+    char* argv[80];
     int argc = 0;
 
     argv[argc++] = FFPLAY_PATH;
@@ -192,13 +241,35 @@ static int ffplay_exec(FfplayConfig* config, int use_subs) {
     argv[argc++] = "-skip_idct";         // Skip IDCT on non-reference frames
     argv[argc++] = "noref";             // note: "noref" not "nonref"
 
+    // IPTV channel list for in-player zapping
+    char channel_index_str[16];
+    if (config->channel_list[0] != '\0') {
+        snprintf(channel_index_str, sizeof(channel_index_str), "%d", config->channel_index);
+        argv[argc++] = "-channel_list";
+        argv[argc++] = config->channel_list;
+        argv[argc++] = "-channel_index";
+        argv[argc++] = channel_index_str;
+    }
+
     // Stream-specific buffering options
     if (config->is_stream) {
         argv[argc++] = "-infbuf";       // Disable buffer size limit for live streams
+        // Live TV streams are plain H.264/AAC in TS/fMP4: a short probe is enough
+        // and is most of the time-to-first-frame when switching channels.
+        // Low-latency mode probes even less: everything probed is played late
+        char* probesize = "5000000";        // 5MB
+        char* analyzeduration = "5000000";  // 5 seconds
+        if (config->live_latency_ms > 0) {
+            probesize = "500000";
+            analyzeduration = "1000000";
+        } else if (config->channel_list[0]) {
+            probesize = "1000000";
+            analyzeduration = "2000000";
+        }
         argv[argc++] = "-probesize";
-        argv[argc++] = "5000000";       // 5MB probe size
+        argv[argc++] = probesize;
         argv[argc++] = "-analyzeduration";
-        argv[argc++] = "5000000";       // 5 seconds analysis
+        argv[argc++] = analyzeduration;
         argv[argc++] = "-user_agent";   // YouTube CDN requires a browser User-Agent
         argv[argc++] = "Mozilla/5.0";
         argv[argc++] = "-reconnect";
@@ -207,6 +278,39 @@ static int ffplay_exec(FfplayConfig* config, int use_subs) {
         argv[argc++] = "1";
         argv[argc++] = "-reconnect_delay_max";
         argv[argc++] = "5";            // Retry up to 5s before giving up
+        argv[argc++] = "-stall_timeout"; // ffplay reopens inputs that drop or stall mid-playback
+        argv[argc++] = "8";
+        argv[argc++] = "-prefetch_segments"; // HLS/DASH: fetch the next segments in parallel
+        argv[argc++] = "3";
+    }
+
+    // Live timeshift: ffplay records inputs without a duration into a ring file
+    char timeshift_str[16], timeshift_size_str[16];
+    int timeshift_mb = config->is_stream && config->timeshift_sec > 0 ? timeshift_ring_mb() : 0;
+    if (timeshift_mb > 0) {
+        snprintf(timeshift_str, sizeof(timeshift_str), "%d", config->timeshift_sec);
+        snprintf(timeshift_size_str, sizeof(timeshift_size_str), "%d", timeshift_mb);
+        argv[argc++] = "-timeshift";
+        argv[argc++] = timeshift_str;
+        argv[argc++] = "-timeshift_size";
+        argv[argc++] = timeshift_size_str;
+        argv[argc++] = "-timeshift_file";
+        argv[argc++] = TIMESHIFT_FILE;
+    }
+
+    // Recording: START remuxes the stream into an MKV next to the local videos
+    if (config->is_stream) {
+        mkdir(RECORD_DIR, 0755);
+        argv[argc++] = "-record_dir";
+        argv[argc++] = RECORD_DIR;
+    }
+
+    // Low-latency live: ffplay keeps its buffer near this many seconds
+    char live_latency_str[16];
+    if (config->is_stream && config->live_latency_ms > 0) {
+        snprintf(live_latency_str, sizeof(live_latency_str), "%.1f", config->live_latency_ms / 1000.0);
+        argv[argc++] = "-live_latency";
+        argv[argc++] = live_latency_str;
     }
 
     // ClearKey decryption for DASH DRM streams (CENC)
@@ -215,6 +319,10 @@ static int ffplay_exec(FfplayConfig* config, int use_subs) {
         argv[argc++] = config->decryption_key;
     }
 
+    // CPU clock limits, for restore_cpu_limits() if ffplay does not exit cleanly
+    argv[argc++] = "-cpu_limits_file";
+    argv[argc++] = CPU_LIMITS_FILE;
+
     // Input file (must be last)
     argv[argc++] = "-i";
     argv[argc++] = config->path;
@@ -275,6 +383,7 @@ static int ffplay_exec(FfplayConfig* config, int use_subs) {
     } while (result == -1 && errno == EINTR);
 
     ffplay_pid = 0;
+    restore_cpu_limits();
 
     if (WIFEXITED(status)) {
         int code = WEXITSTATUS(status);
@@ -311,6 +420,20 @@ int FfplayEngine_play(FfplayConfig* config) {
     int has_subs = (config->subtitle_path[0] != '\0') || (config->subtitle_count > 0);
     int exit_code = ffplay_exec(config, has_subs);
 
+    // ffplay reports the channel it was zapped to
+    if (config->channel_list[0] != '\0') {
+        char pos_path[300];
+        snprintf(pos_path, sizeof(pos_path), "%s.pos", config->channel_list);
+        FILE* f = fopen(pos_path, "r");
+        if (f) {
+            int index;
+            if (fscanf(f, "%d", &index) == 1 && index >= 0)
+                config->channel_index = index;
+            fclose(f);
+            unlink(pos_path);
+        }
+    }
+
 	// TG5050: restore display after ffplay exits
 	FfplayEngine_recoverDisplay();
 
@@ -328,7 +451,8 @@ void FfplayEngine_stop(void) {
         usleep(100000);
         // Force kill if still running
         kill(ffplay_pid, SIGKILL);
-        waitpid(ffplay_pid, NULL, WNOHANG);
+        waitpid(ffplay_pid, NULL, 0);
         ffplay_pid = 0;
+        restore_cpu_limits();
     }
 }
@@ -29,6 +29,18 @@ typedef struct {
 
     int screen_width;  // Device screen width for resolution cap (0 = no cap)
     bool is_hevc;      // true = HEVC/H.265 codec (enables aggressive decode opts)
+
+    // IPTV zapping: up/down in the player switches between the channels in this
+    // file ("name\turl\tkey" lines) without leaving ffplay (empty = off)
+    char channel_list[256];
+    int channel_index;  // Position of path in channel_list; updated to the last watched channel
+
+    // Live streams: keep up to this many seconds on the SD card for pause/rewind (0 = off)
+    int timeshift_sec;
+
+    // Live streams: stay this close to the live edge by playing slightly faster or
+    // skipping ahead (0 = off, buffer freely)
+    int live_latency_ms;
 } FfplayConfig;
 
 // Play a video using ffplay subprocess
@@ -0,0 +1,575 @@
+#include "image_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <SDL2/SDL_image.h>
+
+#include "vp_defines.h"
+#include "api.h"
+
+// On-disk entry: header followed by width * height ARGB8888 pixels (pitch = width * 4)
+#define IMAGE_CACHE_MAGIC 0x43495056   // "VPIC"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t width;
+    uint16_t height;
+    uint32_t flags;
+    uint32_t reserved;
+    int64_t src_size;       // Source file signature: entry is stale if either changes
+    int64_t src_mtime;
+} ImageCacheHeader;
+
+// In-memory LRU entry
+typedef struct {
+    uint64_t key;           // Hash of source path
+    int w, h, flags;
+    SDL_Surface* surface;
+    void* map;              // mmap'ed file backing surface->pixels (NULL = heap surface)
+    size_t map_size;
+    size_t bytes;
+    uint32_t last_used;
+} ImageCacheEntry;
+
+#define IMAGE_CACHE_MAX_ENTRIES 128
+
+static ImageCacheEntry entries[IMAGE_CACHE_MAX_ENTRIES];
+static int entry_count = 0;
+static size_t mem_used = 0;
+static uint32_t use_clock = 0;
+
+// Background decode of misses. A request moves from pending to done (decoded
+// surface handed to the next ImageCache_get) or to failed (not decodable, so it
+// is not retried until the source file changes).
+typedef struct {
+    uint64_t key;
+    int w, h, flags;
+    char src_path[512];
+    int64_t src_size;
+    int64_t src_mtime;
+    SDL_Surface* surface;   // Done: heap copy of the decoded image
+} ImageCacheJob;
+
+#define IMAGE_CACHE_PENDING 16  // Oldest request dropped when full (scrolled past)
+#define IMAGE_CACHE_DONE 8      // Oldest undelivered surface freed when full
+#define IMAGE_CACHE_FAILED 32
+
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t worker;
+static bool worker_started = false;
+static bool worker_quit = false;
+
+static ImageCacheJob pending[IMAGE_CACHE_PENDING];
+static int pending_count = 0;
+static ImageCacheJob done[IMAGE_CACHE_DONE];
+static int done_count = 0;
+static ImageCacheJob failed[IMAGE_CACHE_FAILED];
+static int failed_next = 0;
+
+static volatile int ready_count = 0;
+
+// Shown in place of an image that is still being decoded
+typedef struct {
+    int w, h, flags;
+    SDL_Surface* surface;
+} ImageCachePlaceholder;
+
+#define IMAGE_CACHE_PLACEHOLDERS 4
+#define IMAGE_CACHE_PLACEHOLDER_COLOR 0x40FFFFFF
+
+static ImageCachePlaceholder placeholders[IMAGE_CACHE_PLACEHOLDERS];
+static int placeholder_next = 0;
+
+// FNV-1a 64-bit
+static uint64_t hash_path(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void cache_file_path(uint64_t key, int w, int h, int flags, char* out, int size) {
+    snprintf(out, size, APP_IMAGE_CACHE_DIR "/%016llx_%dx%d_%x.argb",
+             (unsigned long long)key, w, h, flags);
+}
+
+// Scale src into a new w x h ARGB8888 surface, applying FIT/CIRCLE flags
+static SDL_Surface* render_scaled(SDL_Surface* src, int w, int h, int flags) {
+    SDL_Surface* converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
+    if (!converted) return NULL;
+    // Plain copy during scaling (no blending against the transparent target)
+    SDL_SetSurfaceBlendMode(converted, SDL_BLENDMODE_NONE);
+
+    SDL_Surface* scaled = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!scaled) { SDL_FreeSurface(converted); return NULL; }
+    SDL_FillRect(scaled, NULL, 0);
+
+    SDL_Rect src_rect = {0, 0, converted->w, converted->h};
+    SDL_Rect dst_rect = {0, 0, w, h};
+    if ((flags & IMAGE_CACHE_FIT) && converted->w > 0 && converted->h > 0) {
+        if (converted->w * h > converted->h * w) {
+            dst_rect.h = converted->h * w / converted->w;
+            if (dst_rect.h < 1) dst_rect.h = 1;
+            dst_rect.y = (h - dst_rect.h) / 2;
+        } else {
+            dst_rect.w = converted->w * h / converted->h;
+            if (dst_rect.w < 1) dst_rect.w = 1;
+            dst_rect.x = (w - dst_rect.w) / 2;
+        }
+    }
+    SDL_BlitScaled(converted, &src_rect, scaled, &dst_rect);
+    SDL_FreeSurface(converted);
+
+    if (flags & IMAGE_CACHE_CIRCLE) {
+        int radius = (w < h ? w : h) / 2;
+        int cx = w / 2, cy = h / 2;
+        uint32_t* pixels = (uint32_t*)scaled->pixels;
+        int pitch = scaled->pitch / 4;
+        for (int y = 0; y < h; y++) {
+            int dy = y - cy;
+            for (int x = 0; x < w; x++) {
+                int dx = x - cx;
+                if (dx * dx + dy * dy > radius * radius) {
+                    pixels[y * pitch + x] = 0;
+                }
+            }
+        }
+    }
+
+    return scaled;
+}
+
+// Write a surface as an on-disk entry (temp file + rename)
+static bool write_entry(const char* path, SDL_Surface* surf, int flags, const struct stat* src_st) {
+    ImageCacheHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = IMAGE_CACHE_MAGIC;
+    hdr.width = (uint16_t)surf->w;
+    hdr.height = (uint16_t)surf->h;
+    hdr.flags = (uint32_t)flags;
+    hdr.src_size = (int64_t)src_st->st_size;
+    hdr.src_mtime = (int64_t)src_st->st_mtime;
+
+    mkdir(SDCARD_PATH "/.cache", 0755);
+    mkdir(APP_IMAGE_CACHE_DIR, 0755);
+
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", path, (unsigned long)pthread_self());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = write(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr);
+    size_t row_bytes = (size_t)surf->w * 4;
+    for (int y = 0; ok && y < surf->h; y++) {
+        const uint8_t* row = (const uint8_t*)surf->pixels + (size_t)y * surf->pitch;
+        ok = write(fd, row, row_bytes) == (ssize_t)row_bytes;
+    }
+    close(fd);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+// Validate an on-disk entry against the source signature; optionally map it
+static bool open_entry(const char* path, int w, int h, int flags, const struct stat* src_st,
+                       void** map_out, size_t* size_out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    size_t size = sizeof(ImageCacheHeader) + (size_t)w * h * 4;
+    struct stat st;
+    ImageCacheHeader hdr;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size == size &&
+              read(fd, &hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+              hdr.magic == IMAGE_CACHE_MAGIC && hdr.width == w && hdr.height == h &&
+              hdr.flags == (uint32_t)flags &&
+              hdr.src_size == (int64_t)src_st->st_size &&
+              hdr.src_mtime == (int64_t)src_st->st_mtime;
+
+    if (ok && map_out) {
+        // Entry mtime tracks last use, which is what ImageCache_trimDir evicts by
+        if (time(NULL) - st.st_mtime > 24 * 60 * 60) futimens(fd, NULL);
+
+        // Private writable mapping: SDL never writes, but must not fault if it tries
+        void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            ok = false;
+        } else {
+            *map_out = map;
+            *size_out = size;
+        }
+    }
+    close(fd);
+    return ok;
+}
+
+bool ImageCache_isPrepared(const char* src_path, int w, int h, int flags) {
+    struct stat src_st;
+    if (!src_path || stat(src_path, &src_st) != 0 || src_st.st_size == 0) return false;
+    char path[512];
+    cache_file_path(hash_path(src_path), w, h, flags, path, sizeof(path));
+    return open_entry(path, w, h, flags, &src_st, NULL, NULL);
+}
+
+// Decode + scale + persist; returns the heap surface (caller frees) or NULL
+static SDL_Surface* decode_entry(const char* src_path, const char* path, int w, int h, int flags,
+                                 const struct stat* src_st) {
+    SDL_Surface* raw = IMG_Load(src_path);
+    if (!raw) return NULL;
+    SDL_Surface* scaled = render_scaled(raw, w, h, flags);
+    SDL_FreeSurface(raw);
+    if (!scaled) return NULL;
+
+    if (!write_entry(path, scaled, flags, src_st)) {
+        LOG_error("ImageCache: failed to write %s\n", path);
+    }
+    return scaled;
+}
+
+bool ImageCache_prepare(const char* src_path, int w, int h, int flags) {
+    if (w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF) return false;
+    struct stat src_st;
+    if (!src_path || stat(src_path, &src_st) != 0 || src_st.st_size == 0) return false;
+
+    char path[512];
+    cache_file_path(hash_path(src_path), w, h, flags, path, sizeof(path));
+    if (open_entry(path, w, h, flags, &src_st, NULL, NULL)) return true;
+
+    SDL_Surface* scaled = decode_entry(src_path, path, w, h, flags, &src_st);
+    if (!scaled) return false;
+    SDL_FreeSurface(scaled);
+    return true;
+}
+
+static void free_entry(ImageCacheEntry* e) {
+    if (e->surface) SDL_FreeSurface(e->surface);
+    if (e->map) munmap(e->map, e->map_size);
+    mem_used -= e->bytes;
+    memset(e, 0, sizeof(*e));
+}
+
+// Evict least-recently-used entries until `bytes` more fit in the budget
+static void make_room(size_t bytes) {
+    while (entry_count > 0 &&
+           (mem_used + bytes > IMAGE_CACHE_MEM_BUDGET || entry_count >= IMAGE_CACHE_MAX_ENTRIES)) {
+        int lru = 0;
+        for (int i = 1; i < entry_count; i++) {
+            if (entries[i].last_used < entries[lru].last_used) lru = i;
+        }
+        free_entry(&entries[lru]);
+        entries[lru] = entries[entry_count - 1];
+        memset(&entries[entry_count - 1], 0, sizeof(ImageCacheEntry));
+        entry_count--;
+    }
+}
+
+static bool job_matches(const ImageCacheJob* j, uint64_t key, int w, int h, int flags) {
+    return j->key == key && j->w == w && j->h == h && j->flags == flags;
+}
+
+static void* decode_thread(void* arg) {
+    (void)arg;
+    PWR_pinToCores(CPU_CORE_EFFICIENCY);
+
+    ImageCache_trimDir(APP_IMAGE_CACHE_DIR, ".argb", IMAGE_CACHE_DISK_BUDGET, IMAGE_CACHE_MAX_AGE_DAYS);
+
+    pthread_mutex_lock(&job_mutex);
+    while (1) {
+        while (pending_count == 0 && !worker_quit) {
+            pthread_cond_wait(&job_cond, &job_mutex);
+        }
+        if (worker_quit) break;
+
+        // Newest request first: it is the one on screen now
+        ImageCacheJob job = pending[--pending_count];
+        pthread_mutex_unlock(&job_mutex);
+
+        char path[512];
+        cache_file_path(job.key, job.w, job.h, job.flags, path, sizeof(path));
+        struct stat src_st;
+        bool have_src = stat(job.src_path, &src_st) == 0 && src_st.st_size > 0;
+        bool on_disk = have_src && open_entry(path, job.w, job.h, job.flags, &src_st, NULL, NULL);
+        SDL_Surface* scaled = NULL;
+        if (have_src && !on_disk) {
+            scaled = decode_entry(job.src_path, path, job.w, job.h, job.flags, &src_st);
+        }
+
+        pthread_mutex_lock(&job_mutex);
+        if (scaled) {
+            if (done_count == IMAGE_CACHE_DONE) {
+                SDL_FreeSurface(done[0].surface);
+                memmove(&done[0], &done[1], sizeof(ImageCacheJob) * (IMAGE_CACHE_DONE - 1));
+                done_count--;
+            }
+            job.surface = scaled;
+            done[done_count++] = job;
+        } else if (!on_disk) {
+            failed[failed_next] = job;
+            failed_next = (failed_next + 1) % IMAGE_CACHE_FAILED;
+        }
+        if (scaled || on_disk) ready_count++;
+    }
+    pthread_mutex_unlock(&job_mutex);
+    return NULL;
+}
+
+// Queue a miss for the decode thread; false if it is known not to decode
+// (caller holds job_mutex)
+static bool queue_decode(const char* src_path, uint64_t key, int w, int h, int flags,
+                         const struct stat* src_st) {
+    for (int i = 0; i < IMAGE_CACHE_FAILED; i++) {
+        const ImageCacheJob* f = &failed[i];
+        if (job_matches(f, key, w, h, flags) && f->src_size == (int64_t)src_st->st_size &&
+            f->src_mtime == (int64_t)src_st->st_mtime) {
+            return false;
+        }
+    }
+    for (int i = 0; i < pending_count; i++) {
+        if (job_matches(&pending[i], key, w, h, flags)) return true;
+    }
+
+    if (!worker_started) {
+        worker_quit = false;
+        if (pthread_create(&worker, NULL, decode_thread, NULL) != 0) return false;
+        worker_started = true;
+    }
+    if (pending_count == IMAGE_CACHE_PENDING) {
+        memmove(&pending[0], &pending[1], sizeof(ImageCacheJob) * (IMAGE_CACHE_PENDING - 1));
+        pending_count--;
+    }
+    ImageCacheJob* job = &pending[pending_count++];
+    memset(job, 0, sizeof(*job));
+    job->key = key;
+    job->w = w;
+    job->h = h;
+    job->flags = flags;
+    snprintf(job->src_path, sizeof(job->src_path), "%s", src_path);
+    job->src_size = (int64_t)src_st->st_size;
+    job->src_mtime = (int64_t)src_st->st_mtime;
+    pthread_cond_signal(&job_cond);
+    return true;
+}
+
+// Take a surface the decode thread finished for this request (caller holds job_mutex)
+static SDL_Surface* take_done(uint64_t key, int w, int h, int flags) {
+    for (int i = 0; i < done_count; i++) {
+        if (job_matches(&done[i], key, w, h, flags)) {
+            SDL_Surface* surface = done[i].surface;
+            done[i] = done[--done_count];
+            return surface;
+        }
+    }
+    return NULL;
+}
+
+static SDL_Surface* get_placeholder(int w, int h, int flags) {
+    for (int i = 0; i < IMAGE_CACHE_PLACEHOLDERS; i++) {
+        ImageCachePlaceholder* p = &placeholders[i];
+        if (p->surface && p->w == w && p->h == h && p->flags == flags) return p->surface;
+    }
+
+    // Same scaling and mask as a real image, from a single flat pixel
+    SDL_Surface* pixel = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!pixel) return NULL;
+    *(uint32_t*)pixel->pixels = IMAGE_CACHE_PLACEHOLDER_COLOR;
+    SDL_Surface* surface = render_scaled(pixel, w, h, flags);
+    SDL_FreeSurface(pixel);
+    if (!surface) return NULL;
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
+
+    ImageCachePlaceholder* p = &placeholders[placeholder_next];
+    placeholder_next = (placeholder_next + 1) % IMAGE_CACHE_PLACEHOLDERS;
+    if (p->surface) SDL_FreeSurface(p->surface);
+    p->w = w;
+    p->h = h;
+    p->flags = flags;
+    p->surface = surface;
+    return surface;
+}
+
+SDL_Surface* ImageCache_get(const char* src_path, int w, int h, int flags) {
+    if (!src_path || !src_path[0] || w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF) return NULL;
+
+    uint64_t key = hash_path(src_path);
+    for (int i = 0; i < entry_count; i++) {
+        ImageCacheEntry* e = &entries[i];
+        if (e->key == key && e->w == w && e->h == h && e->flags == flags) {
+            e->last_used = ++use_clock;
+            return e->surface;
+        }
+    }
+
+    struct stat src_st;
+    if (stat(src_path, &src_st) != 0 || src_st.st_size == 0) return NULL;
+
+    pthread_mutex_lock(&job_mutex);
+    SDL_Surface* surface = take_done(key, w, h, flags);
+    pthread_mutex_unlock(&job_mutex);
+
+    void* map = NULL;
+    size_t map_size = 0;
+
+    if (!surface) {
+        char path[512];
+        cache_file_path(key, w, h, flags, path, sizeof(path));
+
+        if (!open_entry(path, w, h, flags, &src_st, &map, &map_size)) {
+            // Miss: never decode on the caller's (UI) thread
+            pthread_mutex_lock(&job_mutex);
+            bool queued = queue_decode(src_path, key, w, h, flags, &src_st);
+            pthread_mutex_unlock(&job_mutex);
+            return queued ? get_placeholder(w, h, flags) : NULL;
+        }
+
+        surface = SDL_CreateRGBSurfaceWithFormatFrom((uint8_t*)map + sizeof(ImageCacheHeader),
+                                                     w, h, 32, w * 4, SDL_PIXELFORMAT_ARGB8888);
+        if (!surface) {
+            munmap(map, map_size);
+            return NULL;
+        }
+        SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
+    }
+
+    size_t bytes = (size_t)w * h * 4;
+    make_room(bytes);
+
+    ImageCacheEntry* e = &entries[entry_count++];
+    e->key = key;
+    e->w = w;
+    e->h = h;
+    e->flags = flags;
+    e->surface = surface;
+    e->map = map;
+    e->map_size = map_size;
+    e->bytes = bytes;
+    e->last_used = ++use_clock;
+    mem_used += bytes;
+    return surface;
+}
+
+int ImageCache_getReadyCount(void) {
+    return ready_count;
+}
+
+void ImageCache_clear(void) {
+    for (int i = 0; i < entry_count; i++) {
+        free_entry(&entries[i]);
+    }
+    entry_count = 0;
+    mem_used = 0;
+
+    for (int i = 0; i < IMAGE_CACHE_PLACEHOLDERS; i++) {
+        if (placeholders[i].surface) SDL_FreeSurface(placeholders[i].surface);
+    }
+    memset(placeholders, 0, sizeof(placeholders));
+    placeholder_next = 0;
+
+    // Requests for the screen being left; a decode in progress still lands on disk
+    pthread_mutex_lock(&job_mutex);
+    pending_count = 0;
+    for (int i = 0; i < done_count; i++) {
+        SDL_FreeSurface(done[i].surface);
+    }
+    done_count = 0;
+    pthread_mutex_unlock(&job_mutex);
+}
+
+void ImageCache_quit(void) {
+    if (worker_started) {
+        pthread_mutex_lock(&job_mutex);
+        worker_quit = true;
+        pthread_cond_broadcast(&job_cond);
+        pthread_mutex_unlock(&job_mutex);
+        // At most one decode (or the startup trim) to finish
+        pthread_join(worker, NULL);
+        worker_started = false;
+    }
+    ImageCache_clear();
+}
+
+typedef struct {
+    char name[256];
+    long long size;
+    time_t mtime;
+} CacheFile;
+
+static int compare_mtime_asc(const void* a, const void* b) {
+    time_t ta = ((const CacheFile*)a)->mtime, tb = ((const CacheFile*)b)->mtime;
+    return ta < tb ? -1 : ta > tb;
+}
+
+void ImageCache_trimDir(const char* dir, const char* suffix, long long max_bytes, int max_age_days) {
+    DIR* d = opendir(dir);
+    if (!d) return;
+
+    CacheFile* files = NULL;
+    int count = 0, capacity = 0;
+    long long total = 0;
+    time_t now = time(NULL);
+    size_t suffix_len = strlen(suffix);
+    char path[768];
+
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        bool is_tmp = len > 4 && strcmp(ent->d_name + len - 4, ".tmp") == 0;
+        bool is_entry = len > suffix_len && strcmp(ent->d_name + len - suffix_len, suffix) == 0;
+        if ((!is_tmp && !is_entry) || len >= sizeof(files[0].name)) continue;
+
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (is_tmp) {
+            // A writer that is still running keeps touching its file
+            if (now - st.st_mtime > 60 * 60) unlink(path);
+            continue;
+        }
+        if (count == capacity) {
+            int new_capacity = capacity ? capacity * 2 : 256;
+            CacheFile* grown = realloc(files, sizeof(CacheFile) * new_capacity);
+            if (!grown) break;
+            files = grown;
+            capacity = new_capacity;
+        }
+        CacheFile* f = &files[count++];
+        memcpy(f->name, ent->d_name, len + 1);
+        f->size = (long long)st.st_size;
+        f->mtime = st.st_mtime;
+        total += f->size;
+    }
+    closedir(d);
+
+    qsort(files, count, sizeof(CacheFile), compare_mtime_asc);
+
+    int removed = 0;
+    long long freed = 0;
+    time_t max_age = (time_t)max_age_days * 24 * 60 * 60;
+    for (int i = 0; i < count && (total > max_bytes || now - files[i].mtime > max_age); i++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, files[i].name);
+        if (unlink(path) != 0) continue;
+        total -= files[i].size;
+        freed += files[i].size;
+        removed++;
+    }
+    if (removed > 0) {
+        LOG_info("ImageCache: trimmed %d files (%lld KB) from %s\n", removed, freed / 1024, dir);
+    }
+    free(files);
+}
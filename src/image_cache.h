@@ -0,0 +1,51 @@
+#ifndef __IMAGE_CACHE_H__
+#define __IMAGE_CACHE_H__
+
+#include <stdbool.h>
+#include <SDL2/SDL.h>
+
+// Decoded, pre-scaled image cache for list icons (avatars, channel logos).
+// Each (source file, target size, flags) is decoded, scaled and masked once on a
+// background thread, then persisted as raw ARGB8888 under APP_IMAGE_CACHE_DIR and
+// mmap'ed back directly into an SDL surface. Surfaces stay in a byte-budgeted
+// in-memory LRU; the directory is trimmed to a disk budget, least recently used
+// entries first.
+
+#define IMAGE_CACHE_CIRCLE 0x1           // Apply circular alpha mask
+#define IMAGE_CACHE_FIT    0x2           // Keep aspect ratio (letterbox into w x h)
+
+#define IMAGE_CACHE_MEM_BUDGET (4 * 1024 * 1024)
+#define IMAGE_CACHE_DISK_BUDGET (32LL * 1024 * 1024)
+#define IMAGE_CACHE_MAX_AGE_DAYS 60
+
+// Get a w x h surface for src_path. Returned surface is owned by the cache and
+// stays valid until the next ImageCache_get/ImageCache_clear call (do not free).
+// Never decodes on the calling thread: if the entry is not on disk yet it is
+// queued for the decode thread and a placeholder of the same size and mask is
+// returned (redraw when ImageCache_getReadyCount changes).
+// Returns NULL if the source is missing or cannot be decoded.
+SDL_Surface* ImageCache_get(const char* src_path, int w, int h, int flags);
+
+// Number of background decodes finished so far (poll to know when to redraw)
+int ImageCache_getReadyCount(void);
+
+// Decode, scale and write the on-disk entry without touching the in-memory LRU.
+// Thread-safe: used by background workers so ImageCache_get only has to mmap.
+bool ImageCache_prepare(const char* src_path, int w, int h, int flags);
+
+// Check whether an up-to-date on-disk entry exists (no decode)
+bool ImageCache_isPrepared(const char* src_path, int w, int h, int flags);
+
+// Release all in-memory surfaces and drop pending decodes (on-disk entries are kept)
+void ImageCache_clear(void);
+
+// Stop the decode thread and release everything (app exit)
+void ImageCache_quit(void);
+
+// Bound a cache directory on disk: delete files ending in suffix that were last
+// modified more than max_age_days ago, then the oldest ones until the rest fit in
+// max_bytes. Leftover *.tmp files from interrupted writes are removed as well.
+// Blocking (readdir + stat of every file): call from a background thread.
+void ImageCache_trimDir(const char* dir, const char* suffix, long long max_bytes, int max_age_days);
+
+#endif
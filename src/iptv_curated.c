@@ -4,124 +4,397 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "vp_defines.h"
 #include "api.h"
-#include "include/parson/parson.h"
+#include "json_reader.h"
 
-#define MAX_CURATED_COUNTRIES 32
-#define MAX_CURATED_CHANNELS 256
+#define CURATED_CHANNELS_DIR "./channels"
+// Country index cache: one line per catalogue file, see save_index()
+#define CURATED_INDEX_FILE APP_DATA_DIR "/tv/curated_index.txt"
+#define CURATED_INDEX_VERSION 1
 
-static CuratedTVCountry curated_countries[MAX_CURATED_COUNTRIES];
+// One ./channels/<country>.json file
+typedef struct {
+    char file[256];         // File name inside CURATED_CHANNELS_DIR
+    long long size;         // Index entry is reused only while size/mtime match
+    long long mtime;
+    char name[64];
+    char code[8];
+    int channel_count;
+    int country;            // Index into curated_countries
+} CuratedFile;
+
+// Loaded channel range of a country
+typedef struct {
+    int channel_count;      // From the index (exact once loaded)
+    int first;              // Offset into curated_channels
+    bool loaded;
+} CountryRange;
+
+static CuratedFile* curated_files = NULL;
+static int curated_file_count = 0;
+static int curated_file_cap = 0;
+
+static CuratedTVCountry* curated_countries = NULL;
+static CountryRange* country_ranges = NULL;
 static int curated_country_count = 0;
+static int curated_country_cap = 0;
 
-static CuratedTVChannel curated_channels[MAX_CURATED_CHANNELS];
+static CuratedTVChannel* curated_channels = NULL;
 static int curated_channel_count = 0;
+static int curated_channel_cap = 0;
 
-static char channels_path[512] = "";
+// Streaming parse state for one ./channels/<country>.json file
+typedef struct {
+    char country_name[64];
+    char country_code[8];
+    bool count_only;            // Index build: count channels without storing them
+    int count;
+    bool out_of_memory;
+    CuratedTVChannel pending;   // Channel currently being read
+} CountryParse;
 
-static int load_country_channels(const char* filepath) {
-    JSON_Value* root = json_parse_file(filepath);
-    if (!root) {
-        LOG_error("Failed to parse JSON: %s\n", filepath);
-        return -1;
+static bool append_channel(const CuratedTVChannel* ch) {
+    if (curated_channel_count == curated_channel_cap) {
+        int cap = curated_channel_cap ? curated_channel_cap * 2 : 64;
+        CuratedTVChannel* grown = realloc(curated_channels, sizeof(CuratedTVChannel) * cap);
+        if (!grown) return false;
+        curated_channels = grown;
+        curated_channel_cap = cap;
     }
+    curated_channels[curated_channel_count++] = *ch;
+    return true;
+}
+
+static bool country_json_cb(void* userdata, JsonReaderEvent event,
+                            const char* path, const char* value, int len) {
+    CountryParse* p = (CountryParse*)userdata;
+    CuratedTVChannel* ch = &p->pending;
 
-    JSON_Object* obj = json_value_get_object(root);
-    if (!obj) {
-        json_value_free(root);
-        return -1;
+    if (strcmp(path, "channels[]") == 0) {
+        if (event == JSON_READER_OBJECT_START) {
+            memset(ch, 0, sizeof(*ch));
+        } else if (event == JSON_READER_OBJECT_END && ch->name[0] && ch->url[0]) {
+            if (!p->count_only && !append_channel(ch)) {
+                p->out_of_memory = true;
+                return false;
+            }
+            p->count++;
+        }
+        return true;
     }
 
-    const char* country_name = json_object_get_string(obj, "country");
-    const char* country_code = json_object_get_string(obj, "code");
+    if (event != JSON_READER_STRING) return true;
+
+    if (strcmp(path, "country") == 0) {
+        JsonReader_copy(p->country_name, sizeof(p->country_name), value, len);
+    } else if (strcmp(path, "code") == 0) {
+        JsonReader_copy(p->country_code, sizeof(p->country_code), value, len);
+    } else if (strcmp(path, "channels[].name") == 0) {
+        JsonReader_copy(ch->name, IPTV_MAX_NAME, value, len);
+    } else if (strcmp(path, "channels[].url") == 0) {
+        JsonReader_copy(ch->url, IPTV_MAX_URL, value, len);
+    } else if (p->count_only) {
+        // Other fields are not needed to build the index
+    } else if (strcmp(path, "channels[].category") == 0) {
+        JsonReader_copy(ch->category, IPTV_MAX_GROUP, value, len);
+    } else if (strcmp(path, "channels[].logo") == 0) {
+        JsonReader_copy(ch->logo, IPTV_MAX_LOGO, value, len);
+    } else if (strcmp(path, "channels[].decryption_key") == 0) {
+        JsonReader_copy(ch->decryption_key, IPTV_MAX_KEY, value, len);
+    }
+    return true;
+}
+
+// ============================================================================
+// Country index
+// ============================================================================
+
+static CuratedFile* add_file(void) {
+    if (curated_file_count == curated_file_cap) {
+        int cap = curated_file_cap ? curated_file_cap * 2 : 32;
+        CuratedFile* grown = realloc(curated_files, sizeof(CuratedFile) * cap);
+        if (!grown) return NULL;
+        curated_files = grown;
+        curated_file_cap = cap;
+    }
+    CuratedFile* f = &curated_files[curated_file_count++];
+    memset(f, 0, sizeof(*f));
+    return f;
+}
+
+// Read the index cache written by a previous run
+// Line format: <size>\t<mtime>\t<count>\t<code>\t<file>\t<name>
+static CuratedFile* load_index(int* count_out) {
+    *count_out = 0;
+    FILE* fp = fopen(CURATED_INDEX_FILE, "r");
+    if (!fp) return NULL;
+
+    char line[512];
+    int version = 0;
+    if (!fgets(line, sizeof(line), fp) || sscanf(line, "v%d", &version) != 1 ||
+        version != CURATED_INDEX_VERSION) {
+        fclose(fp);
+        return NULL;
+    }
+
+    CuratedFile* cached = NULL;
+    int count = 0, cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        CuratedFile f;
+        memset(&f, 0, sizeof(f));
+        char* fields[6];
+        int n = 0;
+        char* save = NULL;
+        for (char* tok = strtok_r(line, "\t", &save); tok && n < 6; tok = strtok_r(NULL, "\t", &save)) {
+            fields[n++] = tok;
+        }
+        if (n != 6) continue;
+
+        f.size = atoll(fields[0]);
+        f.mtime = atoll(fields[1]);
+        f.channel_count = atoi(fields[2]);
+        snprintf(f.code, sizeof(f.code), "%s", fields[3]);
+        snprintf(f.file, sizeof(f.file), "%s", fields[4]);
+        snprintf(f.name, sizeof(f.name), "%s", fields[5]);
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 32;
+            CuratedFile* grown = realloc(cached, sizeof(CuratedFile) * cap);
+            if (!grown) break;
+            cached = grown;
+        }
+        cached[count++] = f;
+    }
+    fclose(fp);
+
+    *count_out = count;
+    return cached;
+}
+
+static void save_index(void) {
+    mkdir(APP_DATA_DIR, 0755);
+    mkdir(APP_DATA_DIR "/tv", 0755);
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", CURATED_INDEX_FILE);
+    FILE* fp = fopen(tmp_path, "w");
+    if (!fp) return;
+
+    fprintf(fp, "v%d\n", CURATED_INDEX_VERSION);
+    for (int i = 0; i < curated_file_count; i++) {
+        const CuratedFile* f = &curated_files[i];
+        fprintf(fp, "%lld\t%lld\t%d\t%s\t%s\t%s\n",
+                f->size, f->mtime, f->channel_count, f->code, f->file, f->name);
+    }
+
+    bool ok = fflush(fp) == 0;
+    fclose(fp);
+    if (!ok || rename(tmp_path, CURATED_INDEX_FILE) != 0) unlink(tmp_path);
+}
+
+// Parse a catalogue file for its country and channel count only
+static bool index_file(CuratedFile* f) {
+    char filepath[768];
+    snprintf(filepath, sizeof(filepath), CURATED_CHANNELS_DIR "/%s", f->file);
 
-    if (!country_name || !country_code) {
-        json_value_free(root);
-        return -1;
+    CountryParse* parse = calloc(1, sizeof(CountryParse));
+    if (!parse) return false;
+    parse->count_only = true;
+
+    bool ok = JsonReader_parseFile(filepath, country_json_cb, parse);
+    if (ok && parse->country_name[0] && parse->country_code[0] &&
+        !strchr(parse->country_name, '\t') && !strchr(parse->country_code, '\t')) {
+        snprintf(f->name, sizeof(f->name), "%s", parse->country_name);
+        snprintf(f->code, sizeof(f->code), "%s", parse->country_code);
+        f->channel_count = parse->count;
+    } else {
+        if (!ok) LOG_error("Failed to parse JSON: %s\n", filepath);
+        ok = false;
     }
+    free(parse);
+    return ok;
+}
 
-    bool country_exists = false;
+static int add_country(const char* name, const char* code) {
     for (int i = 0; i < curated_country_count; i++) {
-        if (strcmp(curated_countries[i].code, country_code) == 0) {
-            country_exists = true;
-            break;
+        if (strcmp(curated_countries[i].code, code) == 0) return i;
+    }
+
+    if (curated_country_count == curated_country_cap) {
+        int cap = curated_country_cap ? curated_country_cap * 2 : 32;
+        CuratedTVCountry* countries = realloc(curated_countries, sizeof(CuratedTVCountry) * cap);
+        if (!countries) return -1;
+        curated_countries = countries;
+        CountryRange* ranges = realloc(country_ranges, sizeof(CountryRange) * cap);
+        if (!ranges) return -1;
+        country_ranges = ranges;
+        curated_country_cap = cap;
+    }
+
+    int idx = curated_country_count++;
+    snprintf(curated_countries[idx].name, sizeof(curated_countries[idx].name), "%s", name);
+    snprintf(curated_countries[idx].code, sizeof(curated_countries[idx].code), "%s", code);
+    memset(&country_ranges[idx], 0, sizeof(CountryRange));
+    return idx;
+}
+
+static void build_country_index(void) {
+    int cached_count = 0;
+    CuratedFile* cached = load_index(&cached_count);
+    bool index_changed = false;
+    int indexed = 0;
+
+    DIR* dir = opendir(CURATED_CHANNELS_DIR);
+    if (dir) {
+        struct dirent* ent;
+        while ((ent = readdir(dir)) != NULL) {
+            const char* ext = strrchr(ent->d_name, '.');
+            if (!ext || strcasecmp(ext, ".json") != 0) continue;
+            if (strlen(ent->d_name) >= sizeof(curated_files[0].file) || strchr(ent->d_name, '\t')) continue;
+
+            char filepath[768];
+            snprintf(filepath, sizeof(filepath), CURATED_CHANNELS_DIR "/%s", ent->d_name);
+            struct stat st;
+            if (stat(filepath, &st) != 0) continue;
+
+            CuratedFile* f = add_file();
+            if (!f) break;
+            snprintf(f->file, sizeof(f->file), "%s", ent->d_name);
+            f->size = (long long)st.st_size;
+            f->mtime = (long long)st.st_mtime;
+
+            // Reuse the cached entry while the file is unchanged
+            bool found = false;
+            for (int i = 0; i < cached_count; i++) {
+                if (strcmp(cached[i].file, f->file) == 0 &&
+                    cached[i].size == f->size && cached[i].mtime == f->mtime) {
+                    *f = cached[i];
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found) {
+                index_changed = true;
+                if (!index_file(f)) {
+                    curated_file_count--;
+                    continue;
+                }
+                indexed++;
+            }
         }
+        closedir(dir);
     }
 
-    if (!country_exists && curated_country_count < MAX_CURATED_COUNTRIES) {
-        strncpy(curated_countries[curated_country_count].name, country_name, 63);
-        curated_countries[curated_country_count].name[63] = '\0';
-        strncpy(curated_countries[curated_country_count].code, country_code, 7);
-        curated_countries[curated_country_count].code[7] = '\0';
-        curated_country_count++;
-    }
-
-    JSON_Array* channels_arr = json_object_get_array(obj, "channels");
-    if (channels_arr) {
-        int count = json_array_get_count(channels_arr);
-        for (int i = 0; i < count && curated_channel_count < MAX_CURATED_CHANNELS; i++) {
-            JSON_Object* channel = json_array_get_object(channels_arr, i);
-            if (!channel) continue;
-
-            const char* name = json_object_get_string(channel, "name");
-            const char* url = json_object_get_string(channel, "url");
-            const char* category = json_object_get_string(channel, "category");
-            const char* logo = json_object_get_string(channel, "logo");
-            const char* dkey = json_object_get_string(channel, "decryption_key");
-
-            if (name && url) {
-                strncpy(curated_channels[curated_channel_count].name, name, IPTV_MAX_NAME - 1);
-                curated_channels[curated_channel_count].name[IPTV_MAX_NAME - 1] = '\0';
-                strncpy(curated_channels[curated_channel_count].url, url, IPTV_MAX_URL - 1);
-                curated_channels[curated_channel_count].url[IPTV_MAX_URL - 1] = '\0';
-                strncpy(curated_channels[curated_channel_count].category, category ? category : "", IPTV_MAX_GROUP - 1);
-                curated_channels[curated_channel_count].category[IPTV_MAX_GROUP - 1] = '\0';
-                strncpy(curated_channels[curated_channel_count].logo, logo ? logo : "", IPTV_MAX_LOGO - 1);
-                curated_channels[curated_channel_count].logo[IPTV_MAX_LOGO - 1] = '\0';
-                strncpy(curated_channels[curated_channel_count].decryption_key, dkey ? dkey : "", IPTV_MAX_KEY - 1);
-                curated_channels[curated_channel_count].decryption_key[IPTV_MAX_KEY - 1] = '\0';
-                strncpy(curated_channels[curated_channel_count].country_code, country_code, 7);
-                curated_channels[curated_channel_count].country_code[7] = '\0';
-                curated_channel_count++;
+    if (curated_file_count != cached_count) index_changed = true;
+    free(cached);
+
+    // Countries (several files may share a code)
+    for (int i = 0; i < curated_file_count; i++) {
+        CuratedFile* f = &curated_files[i];
+        f->country = add_country(f->name, f->code);
+        if (f->country >= 0) country_ranges[f->country].channel_count += f->channel_count;
+    }
+
+    // Insertion sort by name (ranges and file links follow)
+    for (int i = 1; i < curated_country_count; i++) {
+        CuratedTVCountry key = curated_countries[i];
+        CountryRange key_range = country_ranges[i];
+        int j = i - 1;
+        while (j >= 0 && strcasecmp(curated_countries[j].name, key.name) > 0) {
+            curated_countries[j + 1] = curated_countries[j];
+            country_ranges[j + 1] = country_ranges[j];
+            j--;
+        }
+        curated_countries[j + 1] = key;
+        country_ranges[j + 1] = key_range;
+    }
+    for (int i = 0; i < curated_file_count; i++) {
+        for (int c = 0; c < curated_country_count; c++) {
+            if (strcmp(curated_countries[c].code, curated_files[i].code) == 0) {
+                curated_files[i].country = c;
+                break;
             }
         }
     }
 
-    json_value_free(root);
-    return 0;
+    if (index_changed) save_index();
+    LOG_info("Curated: %d countries from %d files (%d re-indexed)\n",
+             curated_country_count, curated_file_count, indexed);
 }
 
-static void load_curated_channels(void) {
-    curated_country_count = 0;
-    curated_channel_count = 0;
+// ============================================================================
+// Lazy channel loading
+// ============================================================================
+
+// Append a file's channels; returns number of channels added
+static int load_file_channels(const CuratedFile* f) {
+    char filepath[768];
+    snprintf(filepath, sizeof(filepath), CURATED_CHANNELS_DIR "/%s", f->file);
 
-    strcpy(channels_path, "./channels");
+    CountryParse* parse = calloc(1, sizeof(CountryParse));
+    if (!parse) return 0;
 
-    DIR* dir = opendir(channels_path);
-    if (!dir) return;
+    int first = curated_channel_count;
+    bool ok = JsonReader_parseFile(filepath, country_json_cb, parse);
+    if (!ok || parse->out_of_memory) {
+        LOG_error("Failed to load channels: %s\n", filepath);
+        // Drop any channels added from a broken file
+        curated_channel_count = first;
+        free(parse);
+        return 0;
+    }
+    free(parse);
 
-    struct dirent* ent;
-    while ((ent = readdir(dir)) != NULL) {
-        const char* ext = strrchr(ent->d_name, '.');
-        if (!ext || strcasecmp(ext, ".json") != 0) continue;
+    for (int i = first; i < curated_channel_count; i++) {
+        snprintf(curated_channels[i].country_code, sizeof(curated_channels[i].country_code), "%s", f->code);
+    }
+    return curated_channel_count - first;
+}
 
-        char filepath[768];
-        snprintf(filepath, sizeof(filepath), "%s/%s", channels_path, ent->d_name);
-        load_country_channels(filepath);
+static int find_country(const char* country_code) {
+    if (!country_code) return -1;
+    for (int i = 0; i < curated_country_count; i++) {
+        if (strcmp(curated_countries[i].code, country_code) == 0) return i;
     }
+    return -1;
+}
+
+static void load_country(int country) {
+    CountryRange* range = &country_ranges[country];
+    if (range->loaded) return;
 
-    closedir(dir);
+    // All files of the country are appended back to back: one contiguous range
+    range->first = curated_channel_count;
+    for (int i = 0; i < curated_file_count; i++) {
+        if (curated_files[i].country == country) load_file_channels(&curated_files[i]);
+    }
+    range->channel_count = curated_channel_count - range->first;
+    range->loaded = true;
 }
 
 void IPTV_curated_init(void) {
-    load_curated_channels();
+    build_country_index();
 }
 
 void IPTV_curated_cleanup(void) {
-    curated_country_count = 0;
-    curated_channel_count = 0;
-    channels_path[0] = '\0';
+    free(curated_files);
+    free(curated_countries);
+    free(country_ranges);
+    free(curated_channels);
+    curated_files = NULL;
+    curated_countries = NULL;
+    country_ranges = NULL;
+    curated_channels = NULL;
+    curated_file_count = curated_file_cap = 0;
+    curated_country_count = curated_country_cap = 0;
+    curated_channel_count = curated_channel_cap = 0;
 }
 
 int IPTV_curated_get_country_count(void) {
@@ -133,27 +406,19 @@ const CuratedTVCountry* IPTV_curated_get_countries(void) {
 }
 
 int IPTV_curated_get_channel_count(const char* country_code) {
-    int count = 0;
-    for (int i = 0; i < curated_channel_count; i++) {
-        if (strcmp(curated_channels[i].country_code, country_code) == 0) {
-            count++;
-        }
-    }
-    return count;
+    int country = find_country(country_code);
+    return country >= 0 ? country_ranges[country].channel_count : 0;
 }
 
 const CuratedTVChannel* IPTV_curated_get_channels(const char* country_code, int* count) {
-    const CuratedTVChannel* first = NULL;
     *count = 0;
+    int country = find_country(country_code);
+    if (country < 0) return NULL;
 
-    for (int i = 0; i < curated_channel_count; i++) {
-        if (strcmp(curated_channels[i].country_code, country_code) == 0) {
-            if (!first) {
-                first = &curated_channels[i];
-            }
-            (*count)++;
-        }
-    }
+    load_country(country);
+    const CountryRange* range = &country_ranges[country];
+    if (range->channel_count == 0) return NULL;
 
-    return first;
+    *count = range->channel_count;
+    return &curated_channels[range->first];
 }
@@ -17,11 +17,15 @@ typedef struct {
     char country_code[8];
 } CuratedTVChannel;
 
+// Builds the country index only (cached on disk, re-read only for changed files)
 void IPTV_curated_init(void);
 void IPTV_curated_cleanup(void);
 int IPTV_curated_get_country_count(void);
 const CuratedTVCountry* IPTV_curated_get_countries(void);
+// Channel count from the index (does not load the country)
 int IPTV_curated_get_channel_count(const char* country_code);
+// Loads the country's channels on first use. The returned range stays valid
+// until another country is loaded for the first time.
 const CuratedTVChannel* IPTV_curated_get_channels(const char* country_code, int* count);
 
 #endif
@@ -0,0 +1,952 @@
+#include "iptv_epg.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+#include "vp_defines.h"
+#include "api.h"
+
+#define WGET_BIN "./bin/wget"
+
+#define EPG_DIR APP_DATA_DIR "/tv/epg"
+#define EPG_STORE APP_DATA_DIR "/tv/epg.bin"
+
+#define EPG_MAGIC 0x47455056        // "VPEG"
+#define EPG_VERSION 1
+#define EPG_KEEP_PAST (6 * 3600)    // Programmes that ended longer ago are not stored
+#define EPG_URL_REFRESH (12 * 3600) // Re-download a guide URL after this
+#define EPG_MAX_URL 1024
+
+// ============================================================================
+// Store layout (mmap'ed as is)
+//   EPGHeader | EPGKey[key_count] | EPGEntry[programme_count] | strings
+// Keys are channel ids and display names (normalized, hashed), sorted by hash;
+// several keys may point at the same programme range.
+// ============================================================================
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_sig;        // Names, sizes and mtimes of the source files
+    uint32_t key_count;
+    uint32_t programme_count;
+    uint32_t strings_size;
+    uint32_t reserved;
+} EPGHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t first;             // First programme of the channel
+    uint32_t count;
+} EPGKey;
+
+typedef struct {
+    uint32_t start;             // Unix time (UTC)
+    uint32_t stop;
+    uint32_t title;             // Offset into strings (0 = "")
+} EPGEntry;
+
+// Mapped store (UI thread only)
+static void* store_map = NULL;
+static size_t store_size = 0;
+static const EPGHeader* store_header = NULL;
+static const EPGKey* store_keys = NULL;
+static const EPGEntry* store_entries = NULL;
+static const char* store_strings = NULL;
+static int generation = 0;
+
+// Background rebuild
+static pthread_mutex_t build_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t build_thread;
+static bool build_running = false;
+static volatile bool build_done = false;
+static char pending_url[EPG_MAX_URL] = "";
+static bool pending_rebuild = false;
+
+// ============================================================================
+// Hashing / time helpers
+// ============================================================================
+
+// FNV-1a over lowercased alphanumerics, so "BBC One HD" matches "bbc.one.hd"
+static uint64_t hash_key(const char* s, int len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    bool any = false;
+    for (int i = 0; i < len && s[i]; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c < 0x80 && !isalnum(c)) continue;
+        h ^= (uint8_t)tolower(c);
+        h *= 0x100000001b3ULL;
+        any = true;
+    }
+    return any ? h : 0;
+}
+
+static uint64_t fnv_mix(uint64_t h, const void* data, size_t len) {
+    const uint8_t* p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Days since 1970-01-01 of a civil date (proleptic Gregorian)
+static int64_t days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = (int)(y - era * 400);
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int read_digits(const char** s, int n) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        if (!isdigit((unsigned char)**s)) return -1;
+        v = v * 10 + (**s - '0');
+        (*s)++;
+    }
+    return v;
+}
+
+// XMLTV time: "YYYYMMDDhhmmss +hhmm" (seconds, time and offset optional)
+static uint32_t parse_xmltv_time(const char* s) {
+    int year = read_digits(&s, 4), mon = read_digits(&s, 2), day = read_digits(&s, 2);
+    if (year < 1970 || mon < 1 || mon > 12 || day < 1 || day > 31) return 0;
+
+    int hour = 0, min = 0, sec = 0;
+    if (isdigit((unsigned char)*s)) {
+        hour = read_digits(&s, 2);
+        min = read_digits(&s, 2);
+        if (isdigit((unsigned char)*s)) sec = read_digits(&s, 2);
+        if (hour < 0 || min < 0 || sec < 0) return 0;
+    }
+
+    int64_t t = days_from_civil(year, mon, day) * 86400 + hour * 3600 + min * 60 + sec;
+
+    while (*s == ' ') s++;
+    if (*s == '+' || *s == '-') {
+        int sign = *s == '-' ? -1 : 1;
+        s++;
+        int oh = read_digits(&s, 2), om = read_digits(&s, 2);
+        if (oh >= 0 && om >= 0) t -= sign * (oh * 3600 + om * 60);
+    }
+    return t > 0 && t < UINT32_MAX ? (uint32_t)t : 0;
+}
+
+// ============================================================================
+// Builder
+// ============================================================================
+
+typedef struct {
+    uint32_t chan;
+    uint32_t start;
+    uint32_t stop;
+    uint32_t title;
+} BuildProgramme;
+
+typedef struct {
+    uint64_t hash;
+    uint32_t chan;
+} BuildAlias;
+
+typedef struct {
+    // Interned titles
+    char* strings;
+    uint32_t strings_len, strings_cap;
+    uint32_t* title_slots;          // String offset + 1 (0 = empty)
+    uint32_t title_cap, title_count;
+
+    // Channel id hash -> channel number
+    uint64_t* chan_keys;
+    uint32_t* chan_values;
+    uint32_t chan_cap, chan_count;
+
+    BuildProgramme* programmes;
+    uint32_t programme_count, programme_cap;
+
+    BuildAlias* aliases;
+    uint32_t alias_count, alias_cap;
+
+    uint32_t min_stop;              // Drop programmes that ended before this
+    bool failed;                    // Out of memory
+} EPGBuild;
+
+static bool grow(void** ptr, uint32_t* cap, uint32_t need, size_t elem) {
+    if (need <= *cap) return true;
+    uint32_t new_cap = *cap ? *cap : 1024;
+    while (new_cap < need) new_cap *= 2;
+    void* p = realloc(*ptr, new_cap * elem);
+    if (!p) return false;
+    *ptr = p;
+    *cap = new_cap;
+    return true;
+}
+
+static uint32_t str_hash(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool title_table_resize(EPGBuild* b, uint32_t cap) {
+    uint32_t* slots = calloc(cap, sizeof(uint32_t));
+    if (!slots) return false;
+    for (uint32_t i = 0; i < b->title_cap; i++) {
+        uint32_t v = b->title_slots[i];
+        if (!v) continue;
+        uint32_t j = str_hash(b->strings + v - 1) & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = v;
+    }
+    free(b->title_slots);
+    b->title_slots = slots;
+    b->title_cap = cap;
+    return true;
+}
+
+// Offset of s in the string pool, adding it once
+static uint32_t intern_title(EPGBuild* b, const char* s) {
+    if (!s[0]) return 0;
+    if (b->title_count * 4 >= b->title_cap * 3 &&
+        !title_table_resize(b, b->title_cap ? b->title_cap * 2 : 4096)) {
+        b->failed = true;
+        return 0;
+    }
+
+    uint32_t j = str_hash(s) & (b->title_cap - 1);
+    while (b->title_slots[j]) {
+        if (strcmp(b->strings + b->title_slots[j] - 1, s) == 0) return b->title_slots[j] - 1;
+        j = (j + 1) & (b->title_cap - 1);
+    }
+
+    uint32_t len = (uint32_t)strlen(s) + 1;
+    if (!grow((void**)&b->strings, &b->strings_cap, b->strings_len + len, 1)) {
+        b->failed = true;
+        return 0;
+    }
+    uint32_t off = b->strings_len;
+    memcpy(b->strings + off, s, len);
+    b->strings_len += len;
+    b->title_slots[j] = off + 1;
+    b->title_count++;
+    return off;
+}
+
+static void add_alias(EPGBuild* b, uint64_t hash, uint32_t chan) {
+    if (!hash) return;
+    if (!grow((void**)&b->aliases, &b->alias_cap, b->alias_count + 1, sizeof(BuildAlias))) {
+        b->failed = true;
+        return;
+    }
+    b->aliases[b->alias_count].hash = hash;
+    b->aliases[b->alias_count].chan = chan;
+    b->alias_count++;
+}
+
+static bool chan_table_resize(EPGBuild* b, uint32_t cap) {
+    uint64_t* keys = calloc(cap, sizeof(uint64_t));
+    uint32_t* values = calloc(cap, sizeof(uint32_t));
+    if (!keys || !values) {
+        free(keys);
+        free(values);
+        return false;
+    }
+    for (uint32_t i = 0; i < b->chan_cap; i++) {
+        if (!b->chan_keys[i]) continue;
+        uint32_t j = (uint32_t)b->chan_keys[i] & (cap - 1);
+        while (keys[j]) j = (j + 1) & (cap - 1);
+        keys[j] = b->chan_keys[i];
+        values[j] = b->chan_values[i];
+    }
+    free(b->chan_keys);
+    free(b->chan_values);
+    b->chan_keys = keys;
+    b->chan_values = values;
+    b->chan_cap = cap;
+    return true;
+}
+
+// Channel number for an XMLTV channel id (the id itself becomes a lookup key)
+static int32_t channel_for_id(EPGBuild* b, const char* id) {
+    uint64_t hash = hash_key(id, (int)strlen(id));
+    if (!hash) return -1;
+    if (b->chan_count * 4 >= b->chan_cap * 3 &&
+        !chan_table_resize(b, b->chan_cap ? b->chan_cap * 2 : 1024)) {
+        b->failed = true;
+        return -1;
+    }
+
+    uint32_t j = (uint32_t)hash & (b->chan_cap - 1);
+    while (b->chan_keys[j]) {
+        if (b->chan_keys[j] == hash) return (int32_t)b->chan_values[j];
+        j = (j + 1) & (b->chan_cap - 1);
+    }
+    b->chan_keys[j] = hash;
+    b->chan_values[j] = b->chan_count;
+    add_alias(b, hash, b->chan_count);
+    return (int32_t)b->chan_count++;
+}
+
+static void add_programme(EPGBuild* b, int32_t chan, uint32_t start, uint32_t stop, uint32_t title) {
+    if (chan < 0 || !start || stop <= start || stop < b->min_stop) return;
+    if (!grow((void**)&b->programmes, &b->programme_cap, b->programme_count + 1, sizeof(BuildProgramme))) {
+        b->failed = true;
+        return;
+    }
+    BuildProgramme* p = &b->programmes[b->programme_count++];
+    p->chan = (uint32_t)chan;
+    p->start = start;
+    p->stop = stop;
+    p->title = title;
+}
+
+static void free_build(EPGBuild* b) {
+    free(b->strings);
+    free(b->title_slots);
+    free(b->chan_keys);
+    free(b->chan_values);
+    free(b->programmes);
+    free(b->aliases);
+    memset(b, 0, sizeof(*b));
+}
+
+// ============================================================================
+// Streaming XMLTV scanner
+// Only <channel>/<display-name> and <programme>/<title> are of interest, so a
+// small tag scanner is enough; input arrives in arbitrary chunks.
+// ============================================================================
+
+#define XML_TAG_MAX 1024
+#define XML_TEXT_MAX 256
+
+enum { CAPTURE_NONE = 0, CAPTURE_TITLE, CAPTURE_DISPLAY_NAME };
+
+typedef struct {
+    EPGBuild* b;
+
+    char tag[XML_TAG_MAX];
+    int tag_len;
+    bool in_tag;
+    char quote;                 // Inside a quoted attribute value
+    char last2[2];              // Last chars of the tag (comment/CDATA ends)
+
+    char text[XML_TEXT_MAX];
+    int text_len;
+    int capture;
+
+    int32_t channel;            // Current <channel>, -1 = none
+    bool in_programme;
+    int32_t prog_channel;
+    uint32_t prog_start, prog_stop, prog_title;
+    bool have_title;
+} XmlParse;
+
+// Value of attribute name in a tag; false if missing
+static bool tag_attr(const char* tag, const char* name, char* out, int size) {
+    int name_len = (int)strlen(name);
+    const char* p = tag;
+    while ((p = strstr(p, name))) {
+        bool word_start = p > tag && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\n' || p[-1] == '\r');
+        const char* v = p + name_len;
+        while (*v == ' ') v++;
+        if (!word_start || *v != '=') {
+            p += name_len;
+            continue;
+        }
+        v++;
+        while (*v == ' ') v++;
+        char q = *v;
+        if (q != '"' && q != '\'') return false;
+        v++;
+        const char* end = strchr(v, q);
+        if (!end) return false;
+        int len = MIN((int)(end - v), size - 1);
+        memcpy(out, v, len);
+        out[len] = '\0';
+        return true;
+    }
+    return false;
+}
+
+static void put_utf8(char** out, char* end, unsigned cp) {
+    char buf[4];
+    int n;
+    if (cp < 0x80) { buf[0] = (char)cp; n = 1; }
+    else if (cp < 0x800) { buf[0] = (char)(0xC0 | (cp >> 6)); buf[1] = (char)(0x80 | (cp & 0x3F)); n = 2; }
+    else if (cp < 0x10000) { buf[0] = (char)(0xE0 | (cp >> 12)); buf[1] = (char)(0x80 | ((cp >> 6) & 0x3F)); buf[2] = (char)(0x80 | (cp & 0x3F)); n = 3; }
+    else { buf[0] = (char)(0xF0 | (cp >> 18)); buf[1] = (char)(0x80 | ((cp >> 12) & 0x3F)); buf[2] = (char)(0x80 | ((cp >> 6) & 0x3F)); buf[3] = (char)(0x80 | (cp & 0x3F)); n = 4; }
+    if (*out + n > end) return;
+    memcpy(*out, buf, n);
+    *out += n;
+}
+
+// Decode entities and collapse whitespace, in place
+static void clean_text(char* s) {
+    char* out = s;
+    const char* in = s;
+    bool space = true;      // Drops leading whitespace
+    while (*in) {
+        if (*in == '&') {
+            const char* semi = strchr(in, ';');
+            if (semi && semi - in <= 10) {
+                unsigned cp = 0;
+                if (in[1] == '#') {
+                    cp = (unsigned)(in[2] == 'x' || in[2] == 'X' ? strtoul(in + 3, NULL, 16) : strtoul(in + 2, NULL, 10));
+                } else if (strncmp(in, "&amp;", 5) == 0) cp = '&';
+                else if (strncmp(in, "&lt;", 4) == 0) cp = '<';
+                else if (strncmp(in, "&gt;", 4) == 0) cp = '>';
+                else if (strncmp(in, "&quot;", 6) == 0) cp = '"';
+                else if (strncmp(in, "&apos;", 6) == 0) cp = '\'';
+                if (cp && cp < 0x110000) {
+                    // Decoded form is never longer than the entity
+                    put_utf8(&out, (char*)semi + 1, cp);
+                    in = semi + 1;
+                    space = false;
+                    continue;
+                }
+            }
+        }
+        if (isspace((unsigned char)*in)) {
+            if (!space) *out++ = ' ';
+            space = true;
+            in++;
+            continue;
+        }
+        *out++ = *in++;
+        space = false;
+    }
+    if (out > s && out[-1] == ' ') out--;
+    *out = '\0';
+}
+
+static void start_capture(XmlParse* x, int kind) {
+    x->capture = kind;
+    x->text_len = 0;
+}
+
+static void process_tag(XmlParse* x) {
+    x->tag[x->tag_len] = '\0';
+    char* t = x->tag;
+
+    // <![CDATA[...]]> inside a captured element is text
+    if (strncmp(t, "![CDATA[", 8) == 0) {
+        if (x->capture) {
+            int len = x->tag_len - 8 - 2;   // Without the closing "]]"
+            for (int i = 0; i < len && x->text_len < XML_TEXT_MAX - 1; i++) {
+                x->text[x->text_len++] = t[8 + i];
+            }
+        }
+        return;
+    }
+    if (t[0] == '!' || t[0] == '?') return;
+
+    bool closing = t[0] == '/';
+    if (closing) t++;
+    int name_len = (int)strcspn(t, " \t\r\n/");
+    bool self_closing = x->tag_len > 0 && x->tag[x->tag_len - 1] == '/';
+    #define NAME_IS(n) (name_len == (int)sizeof(n) - 1 && strncmp(t, n, name_len) == 0)
+
+    if (!closing) {
+        char value[256];
+        if (NAME_IS("programme")) {
+            x->in_programme = !self_closing;
+            x->have_title = false;
+            x->prog_title = 0;
+            x->prog_start = tag_attr(t, "start", value, sizeof(value)) ? parse_xmltv_time(value) : 0;
+            x->prog_stop = tag_attr(t, "stop", value, sizeof(value)) ? parse_xmltv_time(value) : 0;
+            x->prog_channel = tag_attr(t, "channel", value, sizeof(value)) ? channel_for_id(x->b, value) : -1;
+        } else if (NAME_IS("channel")) {
+            x->channel = (!self_closing && tag_attr(t, "id", value, sizeof(value))) ? channel_for_id(x->b, value) : -1;
+        } else if (NAME_IS("title") && x->in_programme && !x->have_title && !self_closing) {
+            start_capture(x, CAPTURE_TITLE);
+        } else if (NAME_IS("display-name") && x->channel >= 0 && !self_closing) {
+            start_capture(x, CAPTURE_DISPLAY_NAME);
+        }
+    } else {
+        if (NAME_IS("title") && x->capture == CAPTURE_TITLE) {
+            x->text[x->text_len] = '\0';
+            clean_text(x->text);
+            x->prog_title = intern_title(x->b, x->text);
+            x->have_title = true;
+            x->capture = CAPTURE_NONE;
+        } else if (NAME_IS("display-name") && x->capture == CAPTURE_DISPLAY_NAME) {
+            x->text[x->text_len] = '\0';
+            clean_text(x->text);
+            add_alias(x->b, hash_key(x->text, x->text_len), (uint32_t)x->channel);
+            x->capture = CAPTURE_NONE;
+        } else if (NAME_IS("programme") && x->in_programme) {
+            add_programme(x->b, x->prog_channel, x->prog_start, x->prog_stop, x->prog_title);
+            x->in_programme = false;
+            x->capture = CAPTURE_NONE;
+        } else if (NAME_IS("channel")) {
+            x->channel = -1;
+            x->capture = CAPTURE_NONE;
+        }
+    }
+    #undef NAME_IS
+}
+
+static void xml_feed(XmlParse* x, const char* data, int len) {
+    for (int i = 0; i < len; i++) {
+        char c = data[i];
+
+        if (!x->in_tag) {
+            if (c == '<') {
+                x->in_tag = true;
+                x->tag_len = 0;
+                x->quote = 0;
+                x->last2[0] = x->last2[1] = 0;
+            } else if (x->capture) {
+                if (x->text_len < XML_TEXT_MAX - 1) x->text[x->text_len++] = c;
+            } else {
+                // Skip text nobody wants
+                const char* lt = memchr(data + i, '<', len - i);
+                if (!lt) return;
+                i = (int)(lt - data) - 1;
+            }
+            continue;
+        }
+
+        bool comment = x->tag_len >= 3 && strncmp(x->tag, "!--", 3) == 0;
+        bool cdata = x->tag_len >= 8 && strncmp(x->tag, "![CDATA[", 8) == 0;
+        if (c == '>' && !x->quote) {
+            bool done = true;
+            if (comment) done = x->last2[0] == '-' && x->last2[1] == '-';
+            else if (cdata) done = x->last2[0] == ']' && x->last2[1] == ']';
+            if (done) {
+                x->in_tag = false;
+                if (!comment) process_tag(x);
+                continue;
+            }
+        } else if (!comment && !cdata) {
+            if (x->quote) {
+                if (c == x->quote) x->quote = 0;
+            } else if ((c == '"' || c == '\'') && memchr(x->tag, '=', x->tag_len)) {
+                x->quote = c;
+            }
+        }
+
+        x->last2[0] = x->last2[1];
+        x->last2[1] = c;
+        if (x->tag_len < XML_TAG_MAX - 1) x->tag[x->tag_len++] = c;
+    }
+}
+
+// Parse one guide file (plain or gzip; gzread handles both)
+static bool parse_file(EPGBuild* b, const char* path) {
+    gzFile gz = gzopen(path, "rb");
+    if (!gz) return false;
+    gzbuffer(gz, 64 * 1024);
+
+    XmlParse* x = calloc(1, sizeof(XmlParse));
+    char* buf = malloc(64 * 1024);
+    if (!x || !buf) {
+        free(x);
+        free(buf);
+        gzclose(gz);
+        return false;
+    }
+    x->b = b;
+    x->channel = -1;
+
+    int n;
+    while ((n = gzread(gz, buf, 64 * 1024)) > 0 && !b->failed) {
+        xml_feed(x, buf, n);
+    }
+
+    free(buf);
+    free(x);
+    gzclose(gz);
+    return !b->failed;
+}
+
+// ============================================================================
+// Store writing / mapping
+// ============================================================================
+
+static int compare_programmes(const void* a, const void* b) {
+    const BuildProgramme* pa = a;
+    const BuildProgramme* pb = b;
+    if (pa->chan != pb->chan) return pa->chan < pb->chan ? -1 : 1;
+    if (pa->start != pb->start) return pa->start < pb->start ? -1 : 1;
+    return 0;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    const EPGKey* ka = a;
+    const EPGKey* kb = b;
+    if (ka->hash != kb->hash) return ka->hash < kb->hash ? -1 : 1;
+    // Same name for two channels: prefer the one with more data
+    return ka->count > kb->count ? -1 : ka->count < kb->count ? 1 : 0;
+}
+
+static bool write_store(EPGBuild* b, uint64_t sig) {
+    qsort(b->programmes, b->programme_count, sizeof(BuildProgramme), compare_programmes);
+
+    // Drop duplicates (same channel and start, e.g. from two guides)
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < b->programme_count; i++) {
+        if (n > 0 && b->programmes[n - 1].chan == b->programmes[i].chan &&
+            b->programmes[n - 1].start == b->programmes[i].start) continue;
+        b->programmes[n++] = b->programmes[i];
+    }
+    b->programme_count = n;
+
+    // Programme range per channel
+    uint32_t* first = malloc(sizeof(uint32_t) * (b->chan_count + 1));
+    uint32_t* count = calloc(b->chan_count + 1, sizeof(uint32_t));
+    EPGKey* keys = malloc(sizeof(EPGKey) * (b->alias_count + 1));
+    EPGEntry* entries = malloc(sizeof(EPGEntry) * (b->programme_count + 1));
+    if (!first || !count || !keys || !entries) {
+        free(first); free(count); free(keys); free(entries);
+        return false;
+    }
+    for (uint32_t i = 0; i < b->programme_count; i++) {
+        const BuildProgramme* p = &b->programmes[i];
+        if (count[p->chan]++ == 0) first[p->chan] = i;
+        entries[i].start = p->start;
+        entries[i].stop = p->stop;
+        entries[i].title = p->title;
+    }
+
+    uint32_t key_count = 0;
+    for (uint32_t i = 0; i < b->alias_count; i++) {
+        uint32_t chan = b->aliases[i].chan;
+        if (!count[chan]) continue;
+        keys[key_count].hash = b->aliases[i].hash;
+        keys[key_count].first = first[chan];
+        keys[key_count].count = count[chan];
+        key_count++;
+    }
+    qsort(keys, key_count, sizeof(EPGKey), compare_keys);
+    n = 0;
+    for (uint32_t i = 0; i < key_count; i++) {
+        if (n > 0 && keys[n - 1].hash == keys[i].hash) continue;
+        keys[n++] = keys[i];
+    }
+    key_count = n;
+
+    if (b->strings_len == 0) {
+        // Offset 0 must be a valid empty string
+        b->strings = malloc(1);
+        if (b->strings) b->strings[0] = '\0';
+        b->strings_len = b->strings ? 1 : 0;
+    }
+
+    EPGHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = EPG_MAGIC;
+    header.version = EPG_VERSION;
+    header.source_sig = sig;
+    header.key_count = key_count;
+    header.programme_count = b->programme_count;
+    header.strings_size = b->strings_len;
+
+    const char* tmp_path = EPG_STORE ".tmp";
+    bool ok = false;
+    FILE* f = fopen(tmp_path, "wb");
+    if (f) {
+        ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(keys, sizeof(EPGKey), key_count, f) == key_count &&
+             fwrite(entries, sizeof(EPGEntry), b->programme_count, f) == b->programme_count &&
+             fwrite(b->strings, 1, b->strings_len, f) == b->strings_len;
+        if (fclose(f) != 0) ok = false;
+        if (ok) ok = rename(tmp_path, EPG_STORE) == 0;
+        if (!ok) unlink(tmp_path);
+    }
+
+    LOG_info("EPG: %u channels, %u keys, %u programmes, %u bytes of titles\n",
+             b->chan_count, key_count, b->programme_count, b->strings_len);
+
+    free(first);
+    free(count);
+    free(keys);
+    free(entries);
+    return ok;
+}
+
+static void unmap_store(void) {
+    if (store_map) munmap(store_map, store_size);
+    store_map = NULL;
+    store_size = 0;
+    store_header = NULL;
+    store_keys = NULL;
+    store_entries = NULL;
+    store_strings = NULL;
+}
+
+static bool map_store(void) {
+    unmap_store();
+
+    int fd = open(EPG_STORE, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(EPGHeader)) {
+        close(fd);
+        return false;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const EPGHeader* h = map;
+    size_t need = sizeof(EPGHeader) + (size_t)h->key_count * sizeof(EPGKey) +
+                  (size_t)h->programme_count * sizeof(EPGEntry) + h->strings_size;
+    if (h->magic != EPG_MAGIC || h->version != EPG_VERSION || need != (size_t)st.st_size ||
+        h->strings_size == 0 || ((const char*)map)[need - 1] != '\0') {
+        munmap(map, st.st_size);
+        return false;
+    }
+
+    store_map = map;
+    store_size = st.st_size;
+    store_header = h;
+    store_keys = (const EPGKey*)(h + 1);
+    store_entries = (const EPGEntry*)(store_keys + h->key_count);
+    store_strings = (const char*)(store_entries + h->programme_count);
+    return true;
+}
+
+// ============================================================================
+// Sources
+// ============================================================================
+
+static bool is_guide_file(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (!ext || name[0] == '.') return false;
+    return strcasecmp(ext, ".xml") == 0 || strcasecmp(ext, ".gz") == 0 || strcasecmp(ext, ".xmltv") == 0;
+}
+
+// Signature of the guide folder; 0 if there are no guides
+static uint64_t source_signature(void) {
+    DIR* dir = opendir(EPG_DIR);
+    if (!dir) return 0;
+
+    uint64_t sig = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir))) {
+        if (!is_guide_file(ent->d_name)) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", EPG_DIR, ent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        // Order independent: combine per-file hashes with xor
+        uint64_t h = 0xcbf29ce484222325ULL;
+        h = fnv_mix(h, ent->d_name, strlen(ent->d_name));
+        int64_t size = st.st_size, mtime = st.st_mtime;
+        h = fnv_mix(h, &size, sizeof(size));
+        h = fnv_mix(h, &mtime, sizeof(mtime));
+        sig ^= h;
+    }
+    closedir(dir);
+    return sig ? fnv_mix(sig, "v1", 2) : 0;
+}
+
+static bool build_store(uint64_t sig) {
+    DIR* dir = opendir(EPG_DIR);
+    if (!dir) return false;
+
+    EPGBuild b;
+    memset(&b, 0, sizeof(b));
+    uint32_t now = (uint32_t)time(NULL);
+    b.min_stop = now > EPG_KEEP_PAST ? now - EPG_KEEP_PAST : 0;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) && !b.failed) {
+        if (!is_guide_file(ent->d_name)) continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", EPG_DIR, ent->d_name);
+        if (!parse_file(&b, path)) LOG_info("EPG: cannot read %s\n", path);
+    }
+    closedir(dir);
+
+    bool ok = !b.failed && write_store(&b, sig);
+    free_build(&b);
+    return ok;
+}
+
+static void guide_path_for_url(const char* url, char* out, int size) {
+    snprintf(out, size, "%s/url_%016llx.xmltv", EPG_DIR,
+             (unsigned long long)fnv_mix(0xcbf29ce484222325ULL, url, strlen(url)));
+}
+
+static void download_guide(const char* url) {
+    char path[512];
+    guide_path_for_url(url, path, sizeof(path));
+
+    char tmp_path[520];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    char cmd[EPG_MAX_URL + 640];
+    snprintf(cmd, sizeof(cmd),
+        WGET_BIN " -q -T 30 -t 2 --no-check-certificate -U 'Mozilla/5.0' -O '%s' '%s' 2>/dev/null",
+        tmp_path, url);
+    system(cmd);
+
+    struct stat st;
+    if (stat(tmp_path, &st) != 0 || st.st_size == 0 || rename(tmp_path, path) != 0) {
+        LOG_info("EPG: download failed: %s\n", url);
+        unlink(tmp_path);
+    }
+}
+
+static void* build_thread_main(void* arg) {
+    PWR_pinToCores(CPU_CORE_EFFICIENCY);
+
+    pthread_mutex_lock(&build_mutex);
+    while (1) {
+        char url[EPG_MAX_URL];
+        strcpy(url, pending_url);
+        pending_url[0] = '\0';
+        pending_rebuild = false;
+        pthread_mutex_unlock(&build_mutex);
+
+        if (url[0]) download_guide(url);
+        uint64_t sig = source_signature();
+        if (sig) build_store(sig);
+
+        pthread_mutex_lock(&build_mutex);
+        if (!pending_url[0] && !pending_rebuild) break;
+    }
+    build_done = true;
+    pthread_mutex_unlock(&build_mutex);
+    return NULL;
+}
+
+// Start (or extend) a background rebuild, optionally downloading url first
+static void request_build(const char* url) {
+    pthread_mutex_lock(&build_mutex);
+    if (url) {
+        strncpy(pending_url, url, EPG_MAX_URL - 1);
+        pending_url[EPG_MAX_URL - 1] = '\0';
+    }
+    pending_rebuild = true;
+    if (!build_running) {
+        mkdir(APP_DATA_DIR, 0755);
+        mkdir(APP_DATA_DIR "/tv", 0755);
+        mkdir(EPG_DIR, 0755);
+        build_done = false;
+        build_running = pthread_create(&build_thread, NULL, build_thread_main, NULL) == 0;
+    }
+    pthread_mutex_unlock(&build_mutex);
+}
+
+// Pick up a finished rebuild (UI thread)
+static void poll_build(void) {
+    if (!build_done) return;
+    pthread_join(build_thread, NULL);
+    pthread_mutex_lock(&build_mutex);
+    build_running = false;
+    build_done = false;
+    pthread_mutex_unlock(&build_mutex);
+
+    map_store();
+    generation++;
+}
+
+// ============================================================================
+// Public API
+// ============================================================================
+
+void IPTV_epg_init(void) {
+    uint64_t sig = source_signature();
+    bool mapped = map_store();
+    if (!sig) return;   // No guides: whatever is mapped is still the last known guide
+    if (!mapped || store_header->source_sig != sig) request_build(NULL);
+}
+
+void IPTV_epg_importUrl(const char* url) {
+    if (!url || !url[0] || strlen(url) >= EPG_MAX_URL || strchr(url, '\'')) return;
+    if (strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) return;
+
+    char path[512];
+    guide_path_for_url(url, path, sizeof(path));
+    struct stat st;
+    if (stat(path, &st) == 0 && time(NULL) - st.st_mtime < EPG_URL_REFRESH) return;
+
+    request_build(url);
+}
+
+static const EPGKey* find_key(uint64_t hash) {
+    if (!hash || !store_header) return NULL;
+    uint32_t lo = 0, hi = store_header->key_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (store_keys[mid].hash < hash) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < store_header->key_count && store_keys[lo].hash == hash ? &store_keys[lo] : NULL;
+}
+
+static void fill_programme(const EPGEntry* e, EPGProgramme* out) {
+    if (!out) return;
+    if (!e) {
+        out->title = NULL;
+        out->start = out->stop = 0;
+        return;
+    }
+    out->title = store_strings + (e->title < store_header->strings_size ? e->title : 0);
+    out->start = e->start;
+    out->stop = e->stop;
+}
+
+bool IPTV_epg_getNowNext(const char* tvg_id, const char* name, time_t now,
+                         EPGProgramme* now_out, EPGProgramme* next_out) {
+    fill_programme(NULL, now_out);
+    fill_programme(NULL, next_out);
+    poll_build();
+    if (!store_header) return false;
+
+    const EPGKey* key = NULL;
+    if (tvg_id && tvg_id[0]) key = find_key(hash_key(tvg_id, (int)strlen(tvg_id)));
+    if (!key && name && name[0]) key = find_key(hash_key(name, (int)strlen(name)));
+    if (!key || key->first + key->count > store_header->programme_count) return false;
+
+    // Last programme starting at or before now
+    const EPGEntry* progs = store_entries + key->first;
+    uint32_t lo = 0, hi = key->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((time_t)progs[mid].start <= now) lo = mid + 1;
+        else hi = mid;
+    }
+    // progs[lo] is the first one starting after now
+    if (lo > 0 && (time_t)progs[lo - 1].stop > now) fill_programme(&progs[lo - 1], now_out);
+    if (lo < key->count) fill_programme(&progs[lo], next_out);
+    return (now_out && now_out->title) || (next_out && next_out->title);
+}
+
+int IPTV_epg_getGeneration(void) {
+    poll_build();
+    return generation;
+}
+
+void IPTV_epg_cleanup(void) {
+    pthread_mutex_lock(&build_mutex);
+    bool running = build_running;
+    pending_url[0] = '\0';
+    pending_rebuild = false;
+    pthread_mutex_unlock(&build_mutex);
+
+    // A rebuild may be inside wget or a large guide; don't block exit on it
+    if (running) pthread_detach(build_thread);
+    build_running = false;
+    unmap_store();
+}
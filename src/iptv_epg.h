@@ -0,0 +1,37 @@
+#ifndef __IPTV_EPG_H__
+#define __IPTV_EPG_H__
+
+#include <stdbool.h>
+#include <time.h>
+
+// XMLTV programme guide.
+// Guides (*.xml, *.xml.gz, *.xmltv) in the app's tv/epg folder and guides
+// downloaded from a playlist's url-tvg are parsed in a background thread into
+// a compact binary store (tv/epg.bin): per-channel programme arrays sorted by
+// start time with interned titles. The store is mmap'ed and looked up by
+// binary search, so now/next for a visible row costs a few microseconds.
+
+typedef struct {
+    const char* title;  // NULL if there is no programme (valid until the guide is rebuilt)
+    time_t start;
+    time_t stop;
+} EPGProgramme;
+
+// Map the stored guide and rebuild it in the background if sources changed
+void IPTV_epg_init(void);
+
+// Download an XMLTV guide (plain or gzip) into the guide folder and rebuild.
+// Skipped while the previous download of the same URL is recent.
+void IPTV_epg_importUrl(const char* url);
+
+// Now/next for a channel, matched by tvg-id first, then by name.
+// Returns false if the guide has nothing for the channel.
+bool IPTV_epg_getNowNext(const char* tvg_id, const char* name, time_t now,
+                         EPGProgramme* now_out, EPGProgramme* next_out);
+
+// Changes whenever a rebuilt guide is mapped; lists redraw when it changes
+int IPTV_epg_getGeneration(void);
+
+void IPTV_epg_cleanup(void);
+
+#endif
@@ -0,0 +1,428 @@
+#include "iptv_health.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "vp_defines.h"
+#include "api.h"
+#include "wget_fetch.h"
+
+#define HEALTH_FILE APP_DATA_DIR "/tv/health.txt"
+#define HEALTH_FILE_VERSION "v1"
+
+#define HEALTH_SLOTS 4096           // Stored channels (power of two); oldest half dropped when full
+#define HEALTH_QUEUE_SIZE 32        // Pending probes; oldest dropped when full
+#define HEALTH_MAX_URL 1024
+
+#define HEALTH_OK_TTL (6 * 3600)    // Re-probe working channels after 6 h
+#define HEALTH_DEAD_TTL 3600        // ...and dead ones after 1 h
+#define HEALTH_SLOW_TTFB_MS 1500    // First byte later than this = slow
+
+#define PROBE_MAX_BYTES (256 * 1024)
+#define PROBE_MAX_MS 3000
+#define PROBE_HEAD_SIZE 4096        // Start of the response kept for manifest parsing
+
+typedef struct {
+    uint64_t key;           // URL hash (0 = empty slot)
+    uint8_t status;
+    uint8_t queued;         // Probe pending or running
+    uint16_t ttfb_ms;
+    uint32_t kbps;
+    uint32_t last_check;
+    uint32_t last_success;
+} HealthEntry;
+
+typedef struct {
+    uint64_t key;
+    char url[HEALTH_MAX_URL];
+} HealthJob;
+
+static pthread_mutex_t health_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t health_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[IPTV_HEALTH_WORKERS];
+static WgetChild probes[IPTV_HEALTH_WORKERS];    // Each worker's wget, killed on cleanup
+static bool workers_started = false;
+static volatile bool workers_quit = false;
+
+static HealthEntry entries[HEALTH_SLOTS];
+static int entry_count = 0;
+static bool store_loaded = false;
+static bool store_dirty = false;
+
+static HealthJob queue[HEALTH_QUEUE_SIZE];
+static int queue_count = 0;
+
+static volatile int probed_count = 0;
+
+// FNV-1a 64-bit (never 0, which marks empty slots)
+static uint64_t hash_url(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+static int64_t now_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static HealthEntry* store_lookup(uint64_t key, bool insert);
+
+static int compare_last_check_desc(const void* a, const void* b) {
+    const HealthEntry* ea = a;
+    const HealthEntry* eb = b;
+    if (ea->last_check != eb->last_check) return ea->last_check > eb->last_check ? -1 : 1;
+    return 0;
+}
+
+// Keep the most recently checked half of the store (caller holds health_mutex)
+static void store_evict(void) {
+    HealthEntry* keep = malloc(sizeof(entries));
+    if (!keep) {
+        memset(entries, 0, sizeof(entries));
+        entry_count = 0;
+        return;
+    }
+    int n = 0;
+    for (int i = 0; i < HEALTH_SLOTS; i++) {
+        if (entries[i].key) keep[n++] = entries[i];
+    }
+    qsort(keep, n, sizeof(HealthEntry), compare_last_check_desc);
+
+    memset(entries, 0, sizeof(entries));
+    entry_count = 0;
+    for (int i = 0; i < n / 2; i++) {
+        HealthEntry* e = store_lookup(keep[i].key, true);
+        if (e) *e = keep[i];
+    }
+    free(keep);
+    store_dirty = true;
+}
+
+// Find or insert the entry for key (caller holds health_mutex)
+static HealthEntry* store_lookup(uint64_t key, bool insert) {
+    for (int probe = 0; probe < HEALTH_SLOTS; probe++) {
+        HealthEntry* e = &entries[(key + probe) & (HEALTH_SLOTS - 1)];
+        if (e->key == key) return e;
+        if (e->key == 0) {
+            if (!insert) return NULL;
+            if (entry_count >= HEALTH_SLOTS * 3 / 4) {
+                store_evict();
+                return store_lookup(key, true);
+            }
+            memset(e, 0, sizeof(*e));
+            e->key = key;
+            entry_count++;
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Load the persisted store once (caller holds health_mutex)
+static void store_load(void) {
+    if (store_loaded) return;
+    store_loaded = true;
+
+    FILE* f = fopen(HEALTH_FILE, "r");
+    if (!f) return;
+
+    char line[128];
+    if (!fgets(line, sizeof(line), f) || strncmp(line, HEALTH_FILE_VERSION, 2) != 0) {
+        fclose(f);
+        return;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long key;
+        unsigned int status, ttfb, kbps, last_check, last_success;
+        if (sscanf(line, "%llx %u %u %u %u %u", &key, &status, &ttfb, &kbps,
+                   &last_check, &last_success) != 6 || key == 0) continue;
+        if (status > IPTV_HEALTH_DEAD) continue;
+        HealthEntry* e = store_lookup((uint64_t)key, true);
+        if (!e) break;
+        e->status = (uint8_t)status;
+        e->ttfb_ms = (uint16_t)MIN(ttfb, 65535u);
+        e->kbps = kbps;
+        e->last_check = last_check;
+        e->last_success = last_success;
+    }
+    fclose(f);
+}
+
+// Write the store (caller holds health_mutex)
+static void store_write(void) {
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/tv", APP_DATA_DIR);
+    mkdir(APP_DATA_DIR, 0755);
+    mkdir(dir, 0755);
+
+    const char* tmp_path = HEALTH_FILE ".tmp";
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) return;
+
+    fprintf(f, "%s\n", HEALTH_FILE_VERSION);
+    for (int i = 0; i < HEALTH_SLOTS; i++) {
+        const HealthEntry* e = &entries[i];
+        if (!e->key || e->status == IPTV_HEALTH_UNKNOWN) continue;
+        fprintf(f, "%016llx %u %u %u %u %u\n", (unsigned long long)e->key,
+                e->status, e->ttfb_ms, e->kbps, e->last_check, e->last_success);
+    }
+    if (fclose(f) == 0 && rename(tmp_path, HEALTH_FILE) == 0) {
+        store_dirty = false;
+    } else {
+        unlink(tmp_path);
+    }
+}
+
+static bool is_stale(const HealthEntry* e, uint32_t now) {
+    if (e->status == IPTV_HEALTH_UNKNOWN) return true;
+    uint32_t ttl = e->status == IPTV_HEALTH_DEAD ? HEALTH_DEAD_TTL : HEALTH_OK_TTL;
+    return now - e->last_check >= ttl || e->last_check > now;
+}
+
+// First number after attr in text (e.g. BANDWIDTH=1280000 or bandwidth="1280000")
+static long parse_attr_number(const char* text, const char* attr) {
+    const char* p = strstr(text, attr);
+    if (!p) return 0;
+    p += strlen(attr);
+    while (*p == '=' || *p == '"' || *p == ' ') p++;
+    return strtol(p, NULL, 10);
+}
+
+// Fetch the start of a channel and classify it
+static void probe_channel(WgetChild* probe, const char* url, HealthEntry* result) {
+    const char* args[] = {"-q", "-T", "5", "-t", "1", "--no-check-certificate",
+                          "-U", "Mozilla/5.0", "-O", "-", url, NULL};
+
+    char head[PROBE_HEAD_SIZE];
+    int head_len = 0;
+    size_t total = 0;
+    int64_t start = now_ms(), first = 0, last = 0;
+
+    int fd = -1;
+    pid_t pid = wget_child_start(probe, args, &fd);
+    if (pid > 0) {
+        char buf[8192];
+        ssize_t n;
+        // read() so the first chunk is seen as soon as it arrives
+        while ((n = read(fd, buf, sizeof(buf))) > 0) {
+            last = now_ms();
+            if (!first) first = last;
+            if (head_len < PROBE_HEAD_SIZE - 1) {
+                int copy = MIN((int)n, PROBE_HEAD_SIZE - 1 - head_len);
+                memcpy(head + head_len, buf, copy);
+                head_len += copy;
+            }
+            total += n;
+            if (total >= PROBE_MAX_BYTES || last - start >= PROBE_MAX_MS) break;
+        }
+        // Seen enough: a live stream would otherwise keep wget going
+        if (n > 0) kill(pid, SIGTERM);
+        close(fd);
+        wget_child_wait(probe, pid);
+    }
+    head[head_len] = '\0';
+
+    result->last_check = (uint32_t)time(NULL);
+    result->kbps = 0;
+
+    const char* text = head;
+    if ((uint8_t)text[0] == 0xEF && (uint8_t)text[1] == 0xBB && (uint8_t)text[2] == 0xBF) text += 3;
+    while (*text == ' ' || *text == '\r' || *text == '\n' || *text == '\t') text++;
+
+    bool ok = total > 0;
+    if (ok && strncmp(text, "#EXTM3U", 7) == 0) {
+        // HLS: master playlists advertise the variant bitrates
+        result->kbps = (uint32_t)(parse_attr_number(text, "BANDWIDTH") / 1000);
+    } else if (ok && (strstr(text, "<MPD") || strncmp(text, "<?xml", 5) == 0)) {
+        result->kbps = (uint32_t)(parse_attr_number(text, "bandwidth") / 1000);
+    } else if (ok && (strncasecmp(text, "<!DOCTYPE html", 14) == 0 || strncasecmp(text, "<html", 5) == 0)) {
+        // Error or portal page served with 200
+        ok = false;
+    } else if (ok && total >= 64 * 1024 && last > first) {
+        // Raw stream (TS/ICY...): measured throughput
+        result->kbps = (uint32_t)(total * 8 / (last - first));
+    }
+
+    if (ok) {
+        int ttfb = (int)(first - start);
+        result->ttfb_ms = (uint16_t)MIN(ttfb, 65535);
+        result->status = ttfb > HEALTH_SLOW_TTFB_MS ? IPTV_HEALTH_SLOW : IPTV_HEALTH_OK;
+        result->last_success = result->last_check;
+    } else {
+        result->status = IPTV_HEALTH_DEAD;
+    }
+}
+
+static void* health_worker_thread(void* arg) {
+    WgetChild* probe = &probes[(intptr_t)arg];
+    PWR_pinToCores(CPU_CORE_EFFICIENCY);
+    // Linux applies this to the calling thread only; wget children inherit it
+    setpriority(PRIO_PROCESS, 0, 10);
+
+    while (1) {
+        pthread_mutex_lock(&health_mutex);
+        while (queue_count == 0 && !workers_quit) {
+            pthread_cond_wait(&health_cond, &health_mutex);
+        }
+        if (workers_quit) {
+            pthread_mutex_unlock(&health_mutex);
+            break;
+        }
+
+        // Newest request first: it is the one on screen now
+        HealthJob job = queue[--queue_count];
+        pthread_mutex_unlock(&health_mutex);
+
+        HealthEntry result;
+        memset(&result, 0, sizeof(result));
+        probe_channel(probe, job.url, &result);
+
+        pthread_mutex_lock(&health_mutex);
+        if (workers_quit) {
+            // Likely cut short by cleanup, which says nothing about the channel
+            pthread_mutex_unlock(&health_mutex);
+            break;
+        }
+        HealthEntry* e = store_lookup(job.key, true);
+        if (e) {
+            uint32_t last_success = e->last_success;
+            *e = result;
+            e->key = job.key;
+            if (result.status == IPTV_HEALTH_DEAD) {
+                // Keep what we knew about the last time it worked
+                e->last_success = last_success;
+            }
+            store_dirty = true;
+        }
+        probed_count++;
+        pthread_mutex_unlock(&health_mutex);
+    }
+    return NULL;
+}
+
+static void start_workers(void) {
+    workers_quit = false;
+    memset(probes, 0, sizeof(probes));
+    for (int i = 0; i < IPTV_HEALTH_WORKERS; i++) {
+        pthread_create(&workers[i], NULL, health_worker_thread, (void*)(intptr_t)i);
+    }
+    workers_started = true;
+}
+
+static void fill_health(const HealthEntry* e, IPTVHealth* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!e) return;
+    out->status = e->status;
+    out->ttfb_ms = e->ttfb_ms;
+    out->kbps = (int)e->kbps;
+    out->last_check = e->last_check;
+    out->last_success = e->last_success;
+}
+
+IPTVHealthStatus IPTV_health_get(const char* url, IPTVHealth* out) {
+    fill_health(NULL, out);
+    if (!url || !url[0]) return IPTV_HEALTH_UNKNOWN;
+
+    // Only HTTP(S) can be probed with wget; URL is passed inside single quotes
+    bool probeable = strlen(url) < HEALTH_MAX_URL && !strchr(url, '\'') &&
+                     (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0);
+
+    uint64_t key = hash_url(url);
+
+    pthread_mutex_lock(&health_mutex);
+    store_load();
+    HealthEntry* e = store_lookup(key, probeable);
+    if (e && probeable && !e->queued && is_stale(e, (uint32_t)time(NULL))) {
+        if (!workers_started) start_workers();
+
+        if (queue_count == HEALTH_QUEUE_SIZE) {
+            // Scrolled past: forget the oldest request so it is re-queued if seen again
+            HealthEntry* old = store_lookup(queue[0].key, false);
+            if (old) old->queued = 0;
+            memmove(&queue[0], &queue[1], sizeof(HealthJob) * (HEALTH_QUEUE_SIZE - 1));
+            queue_count--;
+        }
+        HealthJob* job = &queue[queue_count++];
+        job->key = key;
+        strncpy(job->url, url, HEALTH_MAX_URL - 1);
+        job->url[HEALTH_MAX_URL - 1] = '\0';
+        e->queued = 1;
+        pthread_cond_signal(&health_cond);
+    }
+    IPTVHealthStatus status = e ? (IPTVHealthStatus)e->status : IPTV_HEALTH_UNKNOWN;
+    fill_health(e, out);
+    pthread_mutex_unlock(&health_mutex);
+
+    return status;
+}
+
+IPTVHealthStatus IPTV_health_peek(const char* url) {
+    if (!url || !url[0]) return IPTV_HEALTH_UNKNOWN;
+    uint64_t key = hash_url(url);
+
+    pthread_mutex_lock(&health_mutex);
+    store_load();
+    HealthEntry* e = store_lookup(key, false);
+    IPTVHealthStatus status = e ? (IPTVHealthStatus)e->status : IPTV_HEALTH_UNKNOWN;
+    pthread_mutex_unlock(&health_mutex);
+
+    return status;
+}
+
+int IPTV_health_getProbedCount(void) {
+    return probed_count;
+}
+
+void IPTV_health_cancel(void) {
+    pthread_mutex_lock(&health_mutex);
+    for (int i = 0; i < queue_count; i++) {
+        HealthEntry* e = store_lookup(queue[i].key, false);
+        if (e) e->queued = 0;
+    }
+    queue_count = 0;
+    pthread_mutex_unlock(&health_mutex);
+}
+
+void IPTV_health_save(void) {
+    pthread_mutex_lock(&health_mutex);
+    if (store_dirty) store_write();
+    pthread_mutex_unlock(&health_mutex);
+}
+
+void IPTV_health_cleanup(void) {
+    if (workers_started) {
+        IPTV_health_cancel();
+        pthread_mutex_lock(&health_mutex);
+        workers_quit = true;
+        pthread_cond_broadcast(&health_cond);
+        pthread_mutex_unlock(&health_mutex);
+
+        // A probe ends as soon as its wget is killed, so joining is quick, and
+        // no worker writes the store while the save below runs
+        for (int i = 0; i < IPTV_HEALTH_WORKERS; i++) {
+            wget_child_cancel(&probes[i]);
+        }
+        for (int i = 0; i < IPTV_HEALTH_WORKERS; i++) {
+            pthread_join(workers[i], NULL);
+        }
+        workers_started = false;
+    }
+    IPTV_health_save();
+}
@@ -0,0 +1,49 @@
+#ifndef __IPTV_HEALTH_H__
+#define __IPTV_HEALTH_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Background channel health prober.
+// A couple of low-priority workers fetch the start of each channel's manifest
+// (or stream) with wget and record reachability, time-to-first-byte and
+// bitrate. Results persist across sessions, so lists can show health and
+// sort/skip dead channels without launching the player.
+
+#define IPTV_HEALTH_WORKERS 2
+
+typedef enum {
+    IPTV_HEALTH_UNKNOWN = 0,    // Not probed yet
+    IPTV_HEALTH_OK,
+    IPTV_HEALTH_SLOW,           // Reachable but slow first byte (or flaky)
+    IPTV_HEALTH_DEAD,           // Last probe failed
+} IPTVHealthStatus;
+
+typedef struct {
+    IPTVHealthStatus status;
+    int ttfb_ms;            // Time to first byte of the last successful probe
+    int kbps;               // Advertised (HLS/DASH) or measured bitrate, 0 = unknown
+    uint32_t last_check;    // Unix time of the last probe
+    uint32_t last_success;  // Unix time of the last successful probe (0 = never)
+} IPTVHealth;
+
+// Health of a channel. Unknown or stale entries are queued for probing;
+// most recently requested go first. out may be NULL.
+IPTVHealthStatus IPTV_health_get(const char* url, IPTVHealth* out);
+
+// Stored status only (never queues a probe)
+IPTVHealthStatus IPTV_health_peek(const char* url);
+
+// Number of probes finished so far; lists redraw when it changes
+int IPTV_health_getProbedCount(void);
+
+// Drop queued (not yet started) probes, e.g. before playback
+void IPTV_health_cancel(void);
+
+// Write the store to disk if it changed
+void IPTV_health_save(void);
+
+// Stop workers and save
+void IPTV_health_cleanup(void);
+
+#endif
@@ -0,0 +1,300 @@
+#include "iptv_logos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "vp_defines.h"
+#include "api.h"
+#include "image_cache.h"
+#include "wget_fetch.h"
+
+#define LOGO_STATE_SLOTS 512    // Tracked logos (power of two); idle entries dropped when full
+#define LOGO_QUEUE_SIZE 32      // Pending requests; oldest dropped when full
+#define LOGO_MAX_URL 256
+
+// On-disk bound for downloaded originals, applied once per run before the first
+// fetch. Logos are never rewritten once fetched (their mtime is part of the
+// prepared image signature), so the oldest downloads go first.
+#define LOGO_DIR_MAX_BYTES (32LL * 1024 * 1024)
+#define LOGO_DIR_MAX_AGE_DAYS 90
+
+enum {
+    LOGO_UNKNOWN = 0,
+    LOGO_QUEUED,
+    LOGO_LOADING,
+    LOGO_READY,
+    LOGO_FAILED,
+};
+
+typedef struct {
+    uint64_t key;       // URL hash (0 = empty slot)
+    int state;
+} LogoState;
+
+typedef struct {
+    uint64_t key;
+    char url[LOGO_MAX_URL];
+    int size;
+} LogoJob;
+
+static pthread_mutex_t logo_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t logo_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[IPTV_LOGOS_WORKERS];
+static WgetChild downloads[IPTV_LOGOS_WORKERS];   // Each worker's wget, killed on cleanup
+static bool workers_started = false;
+static volatile bool workers_quit = false;
+static bool dir_trimmed = false;
+
+static LogoState states[LOGO_STATE_SLOTS];
+static int state_count = 0;
+
+static LogoJob queue[LOGO_QUEUE_SIZE];
+static int queue_count = 0;
+
+static volatile int ready_count = 0;
+
+// FNV-1a 64-bit (never 0, which marks empty slots)
+static uint64_t hash_url(const char* s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+// Downloaded (original) logo file; format is detected by IMG_Load
+static void logo_file_path(uint64_t key, char* out, int size) {
+    snprintf(out, size, APP_IPTV_LOGOS_DIR "/%016llx.img", (unsigned long long)key);
+}
+
+static LogoState* state_probe(uint64_t key) {
+    for (int probe = 0; probe < LOGO_STATE_SLOTS; probe++) {
+        LogoState* s = &states[(key + probe) & (LOGO_STATE_SLOTS - 1)];
+        if (s->key == key || s->key == 0) return s;
+    }
+    return NULL;
+}
+
+// Rebuild the table with only the logos a worker still owns (queued or loading).
+// Ready/failed ones are forgotten; ready logos are re-validated cheaply on disk.
+static bool state_compact(void) {
+    LogoState busy[LOGO_STATE_SLOTS];
+    int busy_count = 0;
+    for (int i = 0; i < LOGO_STATE_SLOTS; i++) {
+        if (states[i].state == LOGO_QUEUED || states[i].state == LOGO_LOADING) {
+            busy[busy_count++] = states[i];
+        }
+    }
+    if (busy_count == state_count) return false;
+
+    memset(states, 0, sizeof(states));
+    for (int i = 0; i < busy_count; i++) {
+        *state_probe(busy[i].key) = busy[i];
+    }
+    state_count = busy_count;
+    return true;
+}
+
+// Find or insert the state slot for key (caller holds logo_mutex)
+static LogoState* state_lookup(uint64_t key, bool insert) {
+    for (int probe = 0; probe < LOGO_STATE_SLOTS; probe++) {
+        LogoState* s = &states[(key + probe) & (LOGO_STATE_SLOTS - 1)];
+        if (s->key == key) return s;
+        if (s->key == 0) {
+            if (!insert) return NULL;
+            if (state_count >= LOGO_STATE_SLOTS * 3 / 4) {
+                if (!state_compact()) return NULL;
+                return state_lookup(key, true);
+            }
+            s->key = key;
+            s->state = LOGO_UNKNOWN;
+            state_count++;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void set_state(uint64_t key, int state) {
+    pthread_mutex_lock(&logo_mutex);
+    LogoState* s = state_lookup(key, false);
+    if (s) s->state = state;
+    if (state == LOGO_READY) ready_count++;
+    pthread_mutex_unlock(&logo_mutex);
+}
+
+static bool download_logo(int worker, const char* url, const char* path) {
+    mkdir(SDCARD_PATH "/.cache", 0755);
+    mkdir(APP_IPTV_LOGOS_DIR, 0755);
+
+    char tmp_path[512];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%lx.tmp", path, (unsigned long)pthread_self());
+
+    const char* args[] = {"-q", "-T", "10", "-t", "1", "--no-check-certificate",
+                          "-O", tmp_path, url, NULL};
+    pid_t pid = wget_child_start(&downloads[worker], args, NULL);
+    int status = pid > 0 ? wget_child_wait(&downloads[worker], pid) : -1;
+
+    struct stat st;
+    if (status != 0 || stat(tmp_path, &st) != 0 || st.st_size == 0 || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+static void process_job(int worker, const LogoJob* job) {
+    char path[512];
+    logo_file_path(job->key, path, sizeof(path));
+
+    struct stat st;
+    bool have_file = stat(path, &st) == 0 && st.st_size > 0;
+    if (have_file && ImageCache_isPrepared(path, job->size, job->size, IMAGE_CACHE_FIT)) {
+        set_state(job->key, LOGO_READY);
+        return;
+    }
+
+    if (!have_file && !download_logo(worker, job->url, path)) {
+        set_state(job->key, LOGO_FAILED);
+        return;
+    }
+
+    if (ImageCache_prepare(path, job->size, job->size, IMAGE_CACHE_FIT)) {
+        set_state(job->key, LOGO_READY);
+    } else {
+        // Not a decodable image: drop it so a fixed logo can be fetched next session
+        LOG_info("IPTV logo: cannot decode %s\n", job->url);
+        unlink(path);
+        set_state(job->key, LOGO_FAILED);
+    }
+}
+
+static void* logo_worker_thread(void* arg) {
+    PWR_pinToCores(CPU_CORE_EFFICIENCY);
+
+    // First worker bounds the directory; the others wait so nothing is deleted
+    // while it is being fetched or prepared
+    if ((intptr_t)arg == 0) {
+        pthread_mutex_lock(&logo_mutex);
+        bool trim = !dir_trimmed;
+        pthread_mutex_unlock(&logo_mutex);
+        if (trim) {
+            ImageCache_trimDir(APP_IPTV_LOGOS_DIR, ".img", LOGO_DIR_MAX_BYTES, LOGO_DIR_MAX_AGE_DAYS);
+            pthread_mutex_lock(&logo_mutex);
+            dir_trimmed = true;
+            pthread_cond_broadcast(&logo_cond);
+            pthread_mutex_unlock(&logo_mutex);
+        }
+    }
+
+    while (1) {
+        pthread_mutex_lock(&logo_mutex);
+        while ((queue_count == 0 || !dir_trimmed) && !workers_quit) {
+            pthread_cond_wait(&logo_cond, &logo_mutex);
+        }
+        if (workers_quit) {
+            pthread_mutex_unlock(&logo_mutex);
+            break;
+        }
+
+        // Newest request first: it is the one on screen now
+        LogoJob job = queue[--queue_count];
+        LogoState* s = state_lookup(job.key, false);
+        if (s) s->state = LOGO_LOADING;
+        pthread_mutex_unlock(&logo_mutex);
+
+        process_job((int)(intptr_t)arg, &job);
+    }
+    return NULL;
+}
+
+static void start_workers(void) {
+    workers_quit = false;
+    memset(downloads, 0, sizeof(downloads));
+    for (int i = 0; i < IPTV_LOGOS_WORKERS; i++) {
+        pthread_create(&workers[i], NULL, logo_worker_thread, (void*)(intptr_t)i);
+    }
+    workers_started = true;
+}
+
+SDL_Surface* IPTV_logos_get(const char* logo_url, int size) {
+    if (!logo_url || !logo_url[0] || size <= 0) return NULL;
+    // URL is passed to wget inside single quotes
+    if (strlen(logo_url) >= LOGO_MAX_URL || strchr(logo_url, '\'')) return NULL;
+
+    uint64_t key = hash_url(logo_url);
+
+    pthread_mutex_lock(&logo_mutex);
+    LogoState* s = state_lookup(key, true);
+    int state = s ? s->state : LOGO_FAILED;
+
+    if (state == LOGO_UNKNOWN) {
+        if (!workers_started) start_workers();
+
+        if (queue_count == LOGO_QUEUE_SIZE) {
+            // Scrolled past: forget the oldest request so it is re-queued if seen again
+            LogoState* old = state_lookup(queue[0].key, false);
+            if (old && old->state == LOGO_QUEUED) old->state = LOGO_UNKNOWN;
+            memmove(&queue[0], &queue[1], sizeof(LogoJob) * (LOGO_QUEUE_SIZE - 1));
+            queue_count--;
+        }
+        LogoJob* job = &queue[queue_count++];
+        job->key = key;
+        strncpy(job->url, logo_url, LOGO_MAX_URL - 1);
+        job->url[LOGO_MAX_URL - 1] = '\0';
+        job->size = size;
+        s->state = LOGO_QUEUED;
+        pthread_cond_signal(&logo_cond);
+    }
+    pthread_mutex_unlock(&logo_mutex);
+
+    if (state != LOGO_READY) return NULL;
+
+    // Prepared on disk by a worker: this is an mmap, or an LRU hit (a placeholder
+    // only if the entry was trimmed from disk since)
+    char path[512];
+    logo_file_path(key, path, sizeof(path));
+    return ImageCache_get(path, size, size, IMAGE_CACHE_FIT);
+}
+
+int IPTV_logos_getReadyCount(void) {
+    return ready_count;
+}
+
+void IPTV_logos_cancel(void) {
+    pthread_mutex_lock(&logo_mutex);
+    for (int i = 0; i < queue_count; i++) {
+        LogoState* s = state_lookup(queue[i].key, false);
+        if (s && s->state == LOGO_QUEUED) s->state = LOGO_UNKNOWN;
+    }
+    queue_count = 0;
+    pthread_mutex_unlock(&logo_mutex);
+}
+
+void IPTV_logos_cleanup(void) {
+    if (!workers_started) return;
+
+    IPTV_logos_cancel();
+    pthread_mutex_lock(&logo_mutex);
+    workers_quit = true;
+    pthread_cond_broadcast(&logo_cond);
+    pthread_mutex_unlock(&logo_mutex);
+
+    // Joined, as workers use the image cache and SDL, which are torn down next.
+    // Killing a running download makes that quick; a worker busy decoding or
+    // scaling a logo finishes that one first.
+    for (int i = 0; i < IPTV_LOGOS_WORKERS; i++) {
+        wget_child_cancel(&downloads[i]);
+    }
+    for (int i = 0; i < IPTV_LOGOS_WORKERS; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    workers_started = false;
+}
@@ -0,0 +1,27 @@
+#ifndef __IPTV_LOGOS_H__
+#define __IPTV_LOGOS_H__
+
+#include <SDL2/SDL.h>
+
+// Background channel logo pipeline.
+// Logos are downloaded by a small worker pool (IPTV_LOGOS_WORKERS concurrent
+// wget's), decoded and downscaled into the image cache off the UI thread.
+// The list renderer only ever gets already-prepared surfaces.
+
+#define IPTV_LOGOS_WORKERS 3
+
+// Get the logo for a channel at size x size, or NULL if not ready yet.
+// Unknown logos are queued for download; most recently requested go first.
+// Returned surface is owned by the image cache (do not free).
+SDL_Surface* IPTV_logos_get(const char* logo_url, int size);
+
+// Number of logos that finished loading so far; lists redraw when it changes
+int IPTV_logos_getReadyCount(void);
+
+// Drop queued (not yet started) requests, e.g. when leaving a list
+void IPTV_logos_cancel(void);
+
+// Stop workers
+void IPTV_logos_cleanup(void);
+
+#endif
@@ -0,0 +1,595 @@
+#define _GNU_SOURCE
+#include "iptv_playlist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "vp_defines.h"
+#include "api.h"
+#include "iptv.h"
+
+#define WGET_BIN "./bin/wget"
+
+#define IPTV_PLAYLISTS_DIR APP_DATA_DIR "/tv/playlists"
+#define BUNDLED_PLAYLISTS_DIR "./playlists"
+
+#define PLAYLIST_CHUNK 4096
+#define PLAYLIST_MAX_LINE 4096          // Longer lines are truncated
+#define GROUP_HASH_SLOTS 2048           // Power of two, > 1.5x IPTV_PLAYLIST_MAX_GROUPS
+
+// Channel record: all strings are offsets into the arena (0 = "")
+typedef struct {
+    uint32_t name;
+    uint32_t url;
+    uint32_t logo;
+    uint32_t tvg_id;
+    uint32_t catchup;
+    uint32_t catchup_source;
+    uint32_t key;
+    uint16_t group;
+    uint16_t catchup_days;
+} PlaylistEntry;
+
+// Attributes of the #EXTINF line waiting for its URL line
+typedef struct {
+    char line[PLAYLIST_MAX_LINE];
+    int line_len;
+    bool first_line;
+    bool have_extinf;
+    char name[IPTV_MAX_NAME];
+    char logo[IPTV_MAX_LOGO];
+    char tvg_id[128];
+    char group[IPTV_MAX_GROUP];
+    char extgrp[IPTV_MAX_GROUP];
+    char catchup[32];
+    char catchup_source[IPTV_MAX_URL];
+    char key[IPTV_MAX_KEY];
+    int catchup_days;
+    bool full;                  // Channel or memory limit reached
+} PlaylistParse;
+
+static IPTVPlaylistFile playlist_files[IPTV_PLAYLIST_MAX_FILES];
+static int playlist_file_count = 0;
+
+// Open playlist
+static char* arena = NULL;
+static uint32_t arena_len = 0;
+static uint32_t arena_cap = 0;
+
+static PlaylistEntry* entries = NULL;
+static int entry_count = 0;
+static int entry_cap = 0;
+
+static uint32_t group_names[IPTV_PLAYLIST_MAX_GROUPS];
+static int group_sizes[IPTV_PLAYLIST_MAX_GROUPS];
+static int group_start[IPTV_PLAYLIST_MAX_GROUPS];
+static int group_count = 0;
+static uint16_t group_hash[GROUP_HASH_SLOTS];   // Group index + 1 (0 = empty)
+static int* group_members = NULL;               // Channel indices, grouped
+static char epg_url[IPTV_MAX_URL];              // url-tvg of the #EXTM3U header
+
+// ============================================================================
+// Arena
+// ============================================================================
+
+static bool arena_reserve(uint32_t len) {
+    if (arena_len + len <= arena_cap) return true;
+    uint32_t cap = arena_cap ? arena_cap : 64 * 1024;
+    while (cap < arena_len + len) cap *= 2;
+    char* grown = realloc(arena, cap);
+    if (!grown) return false;
+    arena = grown;
+    arena_cap = cap;
+    return true;
+}
+
+// Store a string, returning its offset (0 = empty string or out of memory)
+static uint32_t arena_add(const char* s) {
+    if (!s || !s[0]) return 0;
+    uint32_t len = (uint32_t)strlen(s) + 1;
+    if (!arena_reserve(len)) return 0;
+    uint32_t off = arena_len;
+    memcpy(arena + off, s, len);
+    arena_len += len;
+    return off;
+}
+
+static const char* arena_str(uint32_t off) {
+    return arena ? arena + off : "";
+}
+
+static void reset_playlist(void) {
+    free(arena);
+    free(entries);
+    free(group_members);
+    arena = NULL;
+    arena_len = arena_cap = 0;
+    entries = NULL;
+    entry_count = entry_cap = 0;
+    group_members = NULL;
+    group_count = 0;
+    memset(group_hash, 0, sizeof(group_hash));
+    memset(group_sizes, 0, sizeof(group_sizes));
+    epg_url[0] = '\0';
+
+    // Offset 0 is the shared empty string
+    if (arena_reserve(1)) arena[arena_len++] = '\0';
+}
+
+// ============================================================================
+// Groups
+// ============================================================================
+
+static uint32_t hash_group(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int group_index(const char* name) {
+    if (!name[0]) name = "General";
+
+    uint32_t h = hash_group(name);
+    for (int probe = 0; probe < GROUP_HASH_SLOTS; probe++) {
+        uint16_t* slot = &group_hash[(h + probe) & (GROUP_HASH_SLOTS - 1)];
+        if (*slot == 0) {
+            if (group_count >= IPTV_PLAYLIST_MAX_GROUPS) return group_count - 1;
+            group_names[group_count] = arena_add(name);
+            *slot = (uint16_t)(group_count + 1);
+            return group_count++;
+        }
+        if (strcmp(arena_str(group_names[*slot - 1]), name) == 0) return *slot - 1;
+    }
+    return 0;
+}
+
+// Build per-group channel index (counting sort, keeps file order within a group)
+static bool build_group_index(void) {
+    group_members = malloc(sizeof(int) * (entry_count > 0 ? entry_count : 1));
+    if (!group_members) return false;
+
+    int start = 0;
+    for (int g = 0; g < group_count; g++) {
+        group_start[g] = start;
+        start += group_sizes[g];
+    }
+
+    int fill[IPTV_PLAYLIST_MAX_GROUPS];
+    memcpy(fill, group_start, sizeof(int) * group_count);
+    for (int i = 0; i < entry_count; i++) {
+        group_members[fill[entries[i].group]++] = i;
+    }
+    return true;
+}
+
+// ============================================================================
+// Parser
+// ============================================================================
+
+static void copy_attr(char* dst, int dst_size, const char* value, int len) {
+    if (len > dst_size - 1) len = dst_size - 1;
+    if (len < 0) len = 0;
+    memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
+static void trim(char* s) {
+    char* start = s;
+    while (*start && isspace((unsigned char)*start)) start++;
+    int len = (int)strlen(start);
+    while (len > 0 && isspace((unsigned char)start[len - 1])) len--;
+    memmove(s, start, len);
+    s[len] = '\0';
+}
+
+// #EXTINF:<duration> key="value" key=value ...,<name>
+static void parse_extinf(PlaylistParse* p, const char* s) {
+    p->have_extinf = true;
+    p->name[0] = p->logo[0] = p->tvg_id[0] = p->group[0] = '\0';
+    p->catchup[0] = p->catchup_source[0] = '\0';
+    p->catchup_days = 0;
+
+    // Skip duration
+    while (*s && *s != ' ' && *s != '\t' && *s != ',') s++;
+
+    while (*s) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == ',' || !*s) break;
+
+        const char* key = s;
+        while (*s && *s != '=' && *s != ' ' && *s != ',') s++;
+        int key_len = (int)(s - key);
+        if (*s != '=') continue;
+        s++;
+
+        const char* value;
+        int value_len;
+        if (*s == '"') {
+            value = ++s;
+            while (*s && *s != '"') s++;
+            value_len = (int)(s - value);
+            if (*s == '"') s++;
+        } else {
+            value = s;
+            while (*s && *s != ' ' && *s != ',') s++;
+            value_len = (int)(s - value);
+        }
+
+        #define ATTR_IS(k) (key_len == (int)sizeof(k) - 1 && strncasecmp(key, k, key_len) == 0)
+        if (ATTR_IS("tvg-id")) {
+            copy_attr(p->tvg_id, sizeof(p->tvg_id), value, value_len);
+        } else if (ATTR_IS("tvg-logo")) {
+            copy_attr(p->logo, sizeof(p->logo), value, value_len);
+        } else if (ATTR_IS("group-title")) {
+            copy_attr(p->group, sizeof(p->group), value, value_len);
+        } else if (ATTR_IS("catchup") || ATTR_IS("catchup-type")) {
+            copy_attr(p->catchup, sizeof(p->catchup), value, value_len);
+        } else if (ATTR_IS("catchup-source")) {
+            copy_attr(p->catchup_source, sizeof(p->catchup_source), value, value_len);
+        } else if (ATTR_IS("catchup-days")) {
+            char days[16];
+            copy_attr(days, sizeof(days), value, value_len);
+            p->catchup_days = atoi(days);
+        }
+        #undef ATTR_IS
+    }
+
+    if (*s == ',') {
+        copy_attr(p->name, sizeof(p->name), s + 1, (int)strlen(s + 1));
+        trim(p->name);
+    }
+}
+
+// #EXTM3U url-tvg="..." (or x-tvg-url); only the first of a comma-separated list is used
+static void parse_header(const char* s) {
+    const char* attr = strcasestr(s, "url-tvg=");
+    int skip = 8;
+    if (!attr) {
+        attr = strcasestr(s, "x-tvg-url=");
+        skip = 10;
+    }
+    if (!attr) return;
+    attr += skip;
+
+    bool quoted = *attr == '"';
+    if (quoted) attr++;
+    int len = (int)strcspn(attr, quoted ? "\"," : " ,");
+    copy_attr(epg_url, sizeof(epg_url), attr, len);
+    trim(epg_url);
+}
+
+static void add_channel(PlaylistParse* p, const char* url) {
+    if (entry_count >= IPTV_PLAYLIST_MAX_CHANNELS) {
+        p->full = true;
+        return;
+    }
+    if (entry_count == entry_cap) {
+        int cap = entry_cap ? entry_cap * 2 : 256;
+        PlaylistEntry* grown = realloc(entries, sizeof(PlaylistEntry) * cap);
+        if (!grown) {
+            p->full = true;
+            return;
+        }
+        entries = grown;
+        entry_cap = cap;
+    }
+
+    // Plain M3U (no #EXTINF): use the URL as the name
+    const char* name = p->have_extinf && p->name[0] ? p->name : url;
+    const char* group = p->group[0] ? p->group : p->extgrp;
+
+    PlaylistEntry* e = &entries[entry_count];
+    memset(e, 0, sizeof(*e));
+    e->name = arena_add(name);
+    e->url = arena_add(url);
+    if (p->have_extinf) {
+        e->logo = arena_add(p->logo);
+        e->tvg_id = arena_add(p->tvg_id);
+        e->catchup = arena_add(p->catchup);
+        e->catchup_source = arena_add(p->catchup_source);
+        e->catchup_days = (uint16_t)(p->catchup_days > 0 ? p->catchup_days : 0);
+    }
+    e->key = arena_add(p->key);
+    if (!e->url) {
+        p->full = true;   // Arena allocation failed
+        return;
+    }
+    e->group = (uint16_t)group_index(group);
+    group_sizes[e->group]++;
+    entry_count++;
+
+    p->have_extinf = false;
+    p->extgrp[0] = '\0';
+    p->key[0] = '\0';
+}
+
+static void parse_line(PlaylistParse* p, char* line) {
+    // Strip UTF-8 BOM on the first line
+    if (p->first_line) {
+        p->first_line = false;
+        if ((uint8_t)line[0] == 0xEF && (uint8_t)line[1] == 0xBB && (uint8_t)line[2] == 0xBF) line += 3;
+    }
+    trim(line);
+    if (!line[0]) return;
+
+    if (line[0] == '#') {
+        if (strncasecmp(line, "#EXTINF:", 8) == 0) {
+            parse_extinf(p, line + 8);
+        } else if (strncasecmp(line, "#EXTM3U", 7) == 0) {
+            parse_header(line + 7);
+        } else if (strncasecmp(line, "#EXTGRP:", 8) == 0) {
+            copy_attr(p->extgrp, sizeof(p->extgrp), line + 8, (int)strlen(line + 8));
+        } else if (strncasecmp(line, "#KODIPROP:inputstream.adaptive.license_key=", 43) == 0) {
+            // ClearKey as "<kid>:<key>" (hex); ffplay only needs the key
+            const char* key = line + 43;
+            const char* colon = strchr(key, ':');
+            if (colon && !strchr(key, '/')) {
+                copy_attr(p->key, sizeof(p->key), colon + 1, (int)strlen(colon + 1));
+            }
+        }
+        return;
+    }
+
+    add_channel(p, line);
+}
+
+// Split input into lines (any chunk size); returns false once the playlist is full
+static bool parse_feed(PlaylistParse* p, const char* data, int len) {
+    for (int i = 0; i < len && !p->full; i++) {
+        char c = data[i];
+        if (c == '\n' || c == '\r') {
+            if (p->line_len > 0) {
+                p->line[p->line_len] = '\0';
+                parse_line(p, p->line);
+                p->line_len = 0;
+            }
+        } else if (p->line_len < PLAYLIST_MAX_LINE - 1) {
+            p->line[p->line_len++] = c;
+        }
+    }
+    return !p->full;
+}
+
+bool IPTV_playlist_parseStream(FILE* fp, FILE* copy) {
+    if (!fp) return false;
+
+    reset_playlist();
+
+    PlaylistParse* p = calloc(1, sizeof(PlaylistParse));
+    if (!p) return false;
+    p->first_line = true;
+
+    char chunk[PLAYLIST_CHUNK];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (copy) fwrite(chunk, 1, n, copy);
+        if (!parse_feed(p, chunk, (int)n)) {
+            LOG_info("Playlist: stopped at %d channels\n", entry_count);
+            break;
+        }
+    }
+    // Last line without trailing newline
+    if (p->line_len > 0 && !p->full) {
+        p->line[p->line_len] = '\0';
+        parse_line(p, p->line);
+    }
+    free(p);
+
+    if (!build_group_index()) {
+        reset_playlist();
+        return false;
+    }
+    return entry_count > 0;
+}
+
+// ============================================================================
+// Files
+// ============================================================================
+
+static bool has_playlist_ext(const char* name) {
+    const char* ext = strrchr(name, '.');
+    return ext && (strcasecmp(ext, ".m3u") == 0 || strcasecmp(ext, ".m3u8") == 0);
+}
+
+static void scan_dir(const char* dir_path) {
+    DIR* dir = opendir(dir_path);
+    if (!dir) return;
+
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL && playlist_file_count < IPTV_PLAYLIST_MAX_FILES) {
+        if (ent->d_name[0] == '.' || !has_playlist_ext(ent->d_name)) continue;
+
+        IPTVPlaylistFile* f = &playlist_files[playlist_file_count++];
+        snprintf(f->path, sizeof(f->path), "%s/%s", dir_path, ent->d_name);
+        strncpy(f->name, ent->d_name, sizeof(f->name) - 1);
+        f->name[sizeof(f->name) - 1] = '\0';
+        char* dot = strrchr(f->name, '.');
+        if (dot) *dot = '\0';
+    }
+    closedir(dir);
+}
+
+void IPTV_playlist_scan(void) {
+    playlist_file_count = 0;
+    scan_dir(IPTV_PLAYLISTS_DIR);
+    scan_dir(BUNDLED_PLAYLISTS_DIR);
+
+    // Insertion sort by name
+    for (int i = 1; i < playlist_file_count; i++) {
+        IPTVPlaylistFile key = playlist_files[i];
+        int j = i - 1;
+        while (j >= 0 && strcasecmp(playlist_files[j].name, key.name) > 0) {
+            playlist_files[j + 1] = playlist_files[j];
+            j--;
+        }
+        playlist_files[j + 1] = key;
+    }
+}
+
+int IPTV_playlist_getFileCount(void) {
+    return playlist_file_count;
+}
+
+const IPTVPlaylistFile* IPTV_playlist_getFiles(void) {
+    return playlist_files;
+}
+
+bool IPTV_playlist_open(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        reset_playlist();
+        return false;
+    }
+    bool ok = IPTV_playlist_parseStream(fp, NULL);
+    fclose(fp);
+    LOG_info("Playlist: %s -> %d channels, %d groups\n", path, entry_count, group_count);
+    return ok;
+}
+
+// File name for an imported URL: last path component, sanitized
+static void playlist_name_from_url(const char* url, char* out, int size) {
+    const char* end = url + strcspn(url, "?#");
+    const char* start = end;
+    while (start > url && start[-1] != '/') start--;
+
+    int len = 0;
+    for (const char* s = start; s < end && len < size - 1; s++) {
+        char c = *s;
+        out[len++] = (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.') ? c : '_';
+    }
+    out[len] = '\0';
+
+    char* dot = strrchr(out, '.');
+    if (dot) *dot = '\0';
+    if (!out[0]) snprintf(out, size, "playlist");
+}
+
+bool IPTV_playlist_importUrl(const char* url, char* path_out, int path_size) {
+    // URL is passed to wget inside single quotes
+    if (!url || !url[0] || strchr(url, '\'')) return false;
+
+    mkdir(APP_DATA_DIR, 0755);
+    mkdir(APP_DATA_DIR "/tv", 0755);
+    mkdir(IPTV_PLAYLISTS_DIR, 0755);
+
+    // Never replace an imported playlist: same names get a -2, -3, ... suffix
+    char name[64];
+    playlist_name_from_url(url, name, sizeof(name));
+    snprintf(path_out, path_size, IPTV_PLAYLISTS_DIR "/%s.m3u", name);
+    for (int n = 2; access(path_out, F_OK) == 0; n++) {
+        if (n > 99) return false;
+        snprintf(path_out, path_size, IPTV_PLAYLISTS_DIR "/%s-%d.m3u", name, n);
+    }
+
+    char tmp_path[600];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path_out);
+    FILE* copy = fopen(tmp_path, "w");
+    if (!copy) return false;
+
+    char cmd[2048];
+    snprintf(cmd, sizeof(cmd),
+        WGET_BIN " -q -T 15 -t 2 --no-check-certificate -O - '%s' 2>/dev/null", url);
+    FILE* pipe = popen(cmd, "r");
+    if (!pipe) {
+        fclose(copy);
+        unlink(tmp_path);
+        return false;
+    }
+
+    bool ok = IPTV_playlist_parseStream(pipe, copy);
+    // A full playlist stops reading early and wget dies on the closed pipe;
+    // otherwise anything but a clean exit (timeout, cut off) is a failure
+    bool stopped_early = !feof(pipe) && !ferror(pipe);
+    int status = pclose(pipe);
+    if (!stopped_early && (status == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)) {
+        LOG_error("Playlist: download incomplete (wget status %d)\n", status);
+        ok = false;
+    }
+    if (fclose(copy) != 0) ok = false;
+
+    if (!ok || rename(tmp_path, path_out) != 0) {
+        LOG_error("Playlist: import failed: %s\n", url);
+        unlink(tmp_path);
+        IPTV_playlist_close();
+        return false;
+    }
+
+    LOG_info("Playlist: imported %s -> %d channels\n", url, entry_count);
+    IPTV_playlist_scan();
+    return true;
+}
+
+void IPTV_playlist_close(void) {
+    reset_playlist();
+}
+
+// ============================================================================
+// Access
+// ============================================================================
+
+int IPTV_playlist_getChannelCount(void) {
+    return entry_count;
+}
+
+int IPTV_playlist_getGroupCount(void) {
+    return group_count;
+}
+
+const char* IPTV_playlist_getGroupName(int group) {
+    if (group < 0 || group >= group_count) return "";
+    return arena_str(group_names[group]);
+}
+
+int IPTV_playlist_getGroupSize(int group) {
+    if (group == IPTV_PLAYLIST_ALL_GROUPS) return entry_count;
+    if (group < 0 || group >= group_count) return 0;
+    return group_sizes[group];
+}
+
+int IPTV_playlist_getGroupChannel(int group, int i) {
+    if (group == IPTV_PLAYLIST_ALL_GROUPS) return (i >= 0 && i < entry_count) ? i : -1;
+    if (group < 0 || group >= group_count || i < 0 || i >= group_sizes[group]) return -1;
+    return group_members[group_start[group] + i];
+}
+
+bool IPTV_playlist_getChannel(int index, IPTVPlaylistChannel* out) {
+    if (index < 0 || index >= entry_count) return false;
+    const PlaylistEntry* e = &entries[index];
+    out->name = arena_str(e->name);
+    out->url = arena_str(e->url);
+    out->logo = arena_str(e->logo);
+    out->tvg_id = arena_str(e->tvg_id);
+    out->group = arena_str(group_names[e->group]);
+    out->catchup = arena_str(e->catchup);
+    out->catchup_source = arena_str(e->catchup_source);
+    out->decryption_key = arena_str(e->key);
+    out->catchup_days = e->catchup_days;
+    return true;
+}
+
+const char* IPTV_playlist_getEpgUrl(void) {
+    return epg_url;
+}
+
+void IPTV_playlist_cleanup(void) {
+    free(arena);
+    free(entries);
+    free(group_members);
+    arena = NULL;
+    entries = NULL;
+    group_members = NULL;
+    arena_len = arena_cap = 0;
+    entry_count = entry_cap = 0;
+    group_count = 0;
+    playlist_file_count = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef __IPTV_PLAYLIST_H__
+#define __IPTV_PLAYLIST_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// M3U/M3U8 playlist support.
+// Playlists are parsed line by line from a file or an HTTP stream, so memory
+// use does not depend on the input size. The open playlist is kept in a string
+// arena (one allocation for all names/URLs) plus a compact entry array and a
+// per-group index, which lets the UI page through 10k+ channels without copying.
+
+#define IPTV_PLAYLIST_MAX_FILES 32
+#define IPTV_PLAYLIST_MAX_CHANNELS 100000
+#define IPTV_PLAYLIST_MAX_GROUPS 1024
+#define IPTV_PLAYLIST_ALL_GROUPS -1    // Pseudo group: every channel in file order
+
+// A playlist file available for browsing
+typedef struct {
+    char name[64];      // Display name (file name without extension)
+    char path[512];
+} IPTVPlaylistFile;
+
+// Channel view into the arena (valid until the playlist is closed)
+typedef struct {
+    const char* name;
+    const char* url;
+    const char* logo;            // tvg-logo
+    const char* tvg_id;          // tvg-id (EPG channel id)
+    const char* group;           // group-title / #EXTGRP
+    const char* catchup;         // catchup mode, e.g. "default", "append", "shift" ("" = none)
+    const char* catchup_source;  // catchup-source URL template
+    const char* decryption_key;  // ClearKey from #KODIPROP license_key ("" = none)
+    int catchup_days;
+} IPTVPlaylistChannel;
+
+// Find playlist files (user dir and bundled ./playlists)
+void IPTV_playlist_scan(void);
+int IPTV_playlist_getFileCount(void);
+const IPTVPlaylistFile* IPTV_playlist_getFiles(void);
+
+// Parse a playlist file, replacing the currently open one
+bool IPTV_playlist_open(const char* path);
+
+// Download a playlist URL into the user playlist dir while parsing it (single pass).
+// On success the playlist is open and path_out holds the saved file.
+bool IPTV_playlist_importUrl(const char* url, char* path_out, int path_size);
+
+// Parse from any stream (file or pipe); if copy is set, input is also written to it
+bool IPTV_playlist_parseStream(FILE* fp, FILE* copy);
+
+// Release the open playlist
+void IPTV_playlist_close(void);
+
+// Open playlist access
+int IPTV_playlist_getChannelCount(void);
+int IPTV_playlist_getGroupCount(void);
+const char* IPTV_playlist_getGroupName(int group);
+int IPTV_playlist_getGroupSize(int group);           // group may be IPTV_PLAYLIST_ALL_GROUPS
+int IPTV_playlist_getGroupChannel(int group, int i); // i-th channel index of a group
+bool IPTV_playlist_getChannel(int index, IPTVPlaylistChannel* out);
+const char* IPTV_playlist_getEpgUrl(void);           // XMLTV guide of the open playlist ("" if none)
+
+void IPTV_playlist_cleanup(void);
+
+#endif
@@ -0,0 +1,365 @@
+#include "json_reader.h"
+
+#include <string.h>
+
+#define JSON_READER_CHUNK 4096
+
+// Parser states
+enum {
+    ST_VALUE,        // Expecting a value
+    ST_AFTER_VALUE,  // Expecting ',' or a closing bracket
+    ST_OBJ_OPEN,     // After '{': key or '}'
+    ST_OBJ_KEY,      // After ',' in object: key
+    ST_COLON,        // After key: ':'
+    ST_ARR_OPEN,     // After '[': value or ']'
+    ST_STRING,
+    ST_ESCAPE,
+    ST_UNICODE,
+    ST_LITERAL,      // Number, true, false, null
+    ST_DONE
+};
+
+void JsonReader_init(JsonReader* reader, JsonReaderCallback callback, void* userdata) {
+    memset(reader, 0, sizeof(*reader));
+    reader->callback = callback;
+    reader->userdata = userdata;
+    reader->state = ST_VALUE;
+}
+
+void JsonReader_copy(char* dst, int dst_size, const char* value, int len) {
+    if (dst_size <= 0) return;
+    if (!value) len = 0;
+    if (len > dst_size - 1) len = dst_size - 1;
+    if (len > 0) memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
+static bool emit(JsonReader* r, JsonReaderEvent event, const char* value, int len) {
+    if (!r->callback(r->userdata, event, r->path, value, len)) {
+        r->stopped = true;
+        return false;
+    }
+    return true;
+}
+
+static void token_put(JsonReader* r, char c) {
+    if (r->token_len < JSON_READER_MAX_VALUE - 1) {
+        r->token[r->token_len++] = c;
+    }
+}
+
+// Append a code point as UTF-8
+static void token_put_utf8(JsonReader* r, unsigned int cp) {
+    if (cp < 0x80) {
+        token_put(r, (char)cp);
+    } else if (cp < 0x800) {
+        token_put(r, (char)(0xC0 | (cp >> 6)));
+        token_put(r, (char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        token_put(r, (char)(0xE0 | (cp >> 12)));
+        token_put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        token_put(r, (char)(0x80 | (cp & 0x3F)));
+    } else {
+        token_put(r, (char)(0xF0 | (cp >> 18)));
+        token_put(r, (char)(0x80 | ((cp >> 12) & 0x3F)));
+        token_put(r, (char)(0x80 | ((cp >> 6) & 0x3F)));
+        token_put(r, (char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+static void path_set(JsonReader* r, int len) {
+    r->path_len = len;
+    r->path[len] = '\0';
+}
+
+static void path_append(JsonReader* r, const char* s, int len) {
+    int room = JSON_READER_MAX_PATH - 1 - r->path_len;
+    if (len > room) len = room;
+    if (len > 0) {
+        memcpy(r->path + r->path_len, s, len);
+        r->path_len += len;
+    }
+    r->path[r->path_len] = '\0';
+}
+
+static void end_value(JsonReader* r) {
+    r->state = (r->depth == 0) ? ST_DONE : ST_AFTER_VALUE;
+}
+
+static bool push(JsonReader* r, char type) {
+    if (r->depth >= JSON_READER_MAX_DEPTH) {
+        r->error = true;
+        return false;
+    }
+    r->container[r->depth] = type;
+    r->path_base[r->depth] = r->path_len;
+    r->depth++;
+    return true;
+}
+
+// Close the innermost container (caller has checked the bracket matches)
+static bool pop(JsonReader* r) {
+    char type = r->container[r->depth - 1];
+    path_set(r, r->path_base[r->depth - 1]);
+    if (!emit(r, type == '{' ? JSON_READER_OBJECT_END : JSON_READER_ARRAY_END, NULL, 0)) return false;
+    r->depth--;
+    end_value(r);
+    return true;
+}
+
+static bool begin_value(JsonReader* r, char c) {
+    switch (c) {
+    case '{':
+        if (!emit(r, JSON_READER_OBJECT_START, NULL, 0)) return false;
+        if (!push(r, '{')) return false;
+        r->state = ST_OBJ_OPEN;
+        return true;
+    case '[':
+        if (!emit(r, JSON_READER_ARRAY_START, NULL, 0)) return false;
+        if (!push(r, '[')) return false;
+        path_append(r, "[]", 2);
+        r->state = ST_ARR_OPEN;
+        return true;
+    case '"':
+        r->token_len = 0;
+        r->token_is_key = false;
+        r->high_surrogate = 0;
+        r->state = ST_STRING;
+        return true;
+    default:
+        if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+            r->token_len = 0;
+            token_put(r, c);
+            r->state = ST_LITERAL;
+            return true;
+        }
+        r->error = true;
+        return false;
+    }
+}
+
+static bool is_literal_char(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+           c == '-' || c == '+' || c == '.' || c == 'E';
+}
+
+static bool end_literal(JsonReader* r) {
+    r->token[r->token_len] = '\0';
+    JsonReaderEvent ev;
+    if (strcmp(r->token, "true") == 0) ev = JSON_READER_TRUE;
+    else if (strcmp(r->token, "false") == 0) ev = JSON_READER_FALSE;
+    else if (strcmp(r->token, "null") == 0) ev = JSON_READER_NULL;
+    else if (r->token[0] == '-' || (r->token[0] >= '0' && r->token[0] <= '9')) ev = JSON_READER_NUMBER;
+    else {
+        r->error = true;
+        return false;
+    }
+    if (!emit(r, ev, r->token, r->token_len)) return false;
+    end_value(r);
+    return true;
+}
+
+static bool end_string(JsonReader* r) {
+    r->token[r->token_len] = '\0';
+    if (r->token_is_key) {
+        // Key path = <object path>.<key>
+        path_set(r, r->path_base[r->depth - 1]);
+        if (r->path_len > 0) path_append(r, ".", 1);
+        path_append(r, r->token, r->token_len);
+        r->state = ST_COLON;
+        return true;
+    }
+    if (!emit(r, JSON_READER_STRING, r->token, r->token_len)) return false;
+    end_value(r);
+    return true;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static void end_unicode(JsonReader* r) {
+    unsigned int cp = r->unicode;
+    if (cp >= 0xD800 && cp <= 0xDBFF) {
+        r->high_surrogate = cp;
+        return;
+    }
+    if (cp >= 0xDC00 && cp <= 0xDFFF) {
+        if (!r->high_surrogate) return;  // Unpaired low surrogate: drop
+        cp = 0x10000 + ((r->high_surrogate - 0xD800) << 10) + (cp - 0xDC00);
+    }
+    r->high_surrogate = 0;
+    token_put_utf8(r, cp);
+}
+
+static inline bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+int JsonReader_feed(JsonReader* r, const char* data, int len) {
+    if (r->error) return -1;
+    if (r->stopped) return 0;
+
+    int i = 0;
+    while (i < len) {
+        char c = data[i];
+
+        switch (r->state) {
+        case ST_STRING: {
+            // Fast path: copy plain characters up to the next quote or escape
+            int start = i;
+            while (i < len && data[i] != '"' && data[i] != '\\') i++;
+            if (i > start) {
+                int n = i - start;
+                int room = JSON_READER_MAX_VALUE - 1 - r->token_len;
+                if (n > room) n = room;
+                if (n > 0) {
+                    memcpy(r->token + r->token_len, data + start, n);
+                    r->token_len += n;
+                }
+                r->high_surrogate = 0;
+            }
+            if (i >= len) continue;
+            if (data[i] == '"') {
+                i++;
+                if (!end_string(r)) goto out;
+            } else {
+                i++;
+                r->state = ST_ESCAPE;
+            }
+            continue;
+        }
+        case ST_ESCAPE:
+            i++;
+            r->state = ST_STRING;
+            switch (c) {
+            case '"': case '\\': case '/': token_put(r, c); break;
+            case 'b': token_put(r, '\b'); break;
+            case 'f': token_put(r, '\f'); break;
+            case 'n': token_put(r, '\n'); break;
+            case 'r': token_put(r, '\r'); break;
+            case 't': token_put(r, '\t'); break;
+            case 'u':
+                r->unicode = 0;
+                r->unicode_digits = 0;
+                r->state = ST_UNICODE;
+                break;
+            default:
+                r->error = true;
+                goto out;
+            }
+            continue;
+        case ST_UNICODE: {
+            int v = hex_value(c);
+            if (v < 0) { r->error = true; goto out; }
+            i++;
+            r->unicode = (r->unicode << 4) | (unsigned int)v;
+            if (++r->unicode_digits == 4) {
+                end_unicode(r);
+                r->state = ST_STRING;
+            }
+            continue;
+        }
+        case ST_LITERAL:
+            if (is_literal_char(c)) {
+                token_put(r, c);
+                i++;
+                continue;
+            }
+            // Delimiter: finish the literal and reprocess this character
+            if (!end_literal(r)) goto out;
+            continue;
+        default:
+            break;
+        }
+
+        i++;
+        if (is_space(c)) continue;
+
+        switch (r->state) {
+        case ST_VALUE:
+            if (!begin_value(r, c)) goto out;
+            break;
+        case ST_ARR_OPEN:
+            if (c == ']') {
+                if (!pop(r)) goto out;
+            } else if (!begin_value(r, c)) {
+                goto out;
+            }
+            break;
+        case ST_OBJ_OPEN:
+        case ST_OBJ_KEY:
+            if (c == '"') {
+                r->token_len = 0;
+                r->token_is_key = true;
+                r->high_surrogate = 0;
+                r->state = ST_STRING;
+            } else if (c == '}' && r->state == ST_OBJ_OPEN) {
+                if (!pop(r)) goto out;
+            } else {
+                r->error = true;
+                goto out;
+            }
+            break;
+        case ST_COLON:
+            if (c != ':') { r->error = true; goto out; }
+            r->state = ST_VALUE;
+            break;
+        case ST_AFTER_VALUE: {
+            char top = r->container[r->depth - 1];
+            if (c == ',') {
+                r->state = (top == '{') ? ST_OBJ_KEY : ST_VALUE;
+            } else if ((c == '}' && top == '{') || (c == ']' && top == '[')) {
+                if (!pop(r)) goto out;
+            } else {
+                r->error = true;
+                goto out;
+            }
+            break;
+        }
+        case ST_DONE:
+            // Only whitespace may follow the document
+            r->error = true;
+            goto out;
+        }
+    }
+
+out:
+    if (r->error) return -1;
+    return r->stopped ? 0 : 1;
+}
+
+bool JsonReader_finish(JsonReader* r) {
+    if (r->error) return false;
+    if (r->stopped) return true;
+    // A bare top-level number has no trailing delimiter
+    if (r->state == ST_LITERAL && r->depth == 0) {
+        if (!end_literal(r)) return r->stopped;
+    }
+    return r->state == ST_DONE;
+}
+
+bool JsonReader_parseStream(FILE* fp, JsonReaderCallback callback, void* userdata) {
+    if (!fp) return false;
+
+    JsonReader reader;
+    JsonReader_init(&reader, callback, userdata);
+
+    char chunk[JSON_READER_CHUNK];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (JsonReader_feed(&reader, chunk, (int)n) <= 0) break;
+    }
+    return JsonReader_finish(&reader);
+}
+
+bool JsonReader_parseFile(const char* path, JsonReaderCallback callback, void* userdata) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    bool ok = JsonReader_parseStream(fp, callback, userdata);
+    fclose(fp);
+    return ok;
+}
@@ -0,0 +1,74 @@
+#ifndef __JSON_READER_H__
+#define __JSON_READER_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Streaming (SAX-style) JSON reader.
+// Input is fed in chunks of any size (file reads, pipe reads); every value is
+// reported with its path from the document root, e.g. "channel", "[].id" or
+// "channels[].name" (object keys joined by '.', array elements as "[]").
+// No tree is built and the whole input is never held in memory.
+
+#define JSON_READER_MAX_DEPTH 32
+#define JSON_READER_MAX_PATH 256
+#define JSON_READER_MAX_VALUE 2048   // Longer strings are truncated (still parsed)
+
+typedef enum {
+    JSON_READER_STRING,
+    JSON_READER_NUMBER,
+    JSON_READER_TRUE,
+    JSON_READER_FALSE,
+    JSON_READER_NULL,
+    JSON_READER_OBJECT_START,
+    JSON_READER_OBJECT_END,
+    JSON_READER_ARRAY_START,
+    JSON_READER_ARRAY_END,
+} JsonReaderEvent;
+
+// Called for every value and container boundary.
+// value/len: decoded string, or the literal text of numbers/booleans/null
+// (NULL/0 for container events). Return false to stop parsing early.
+typedef bool (*JsonReaderCallback)(void* userdata, JsonReaderEvent event,
+                                   const char* path, const char* value, int len);
+
+// Reader state (fixed size, can live on the stack)
+typedef struct {
+    JsonReaderCallback callback;
+    void* userdata;
+    int state;
+    int depth;
+    char container[JSON_READER_MAX_DEPTH];   // '{' or '[' per open container
+    int path_base[JSON_READER_MAX_DEPTH];    // Path length of each open container
+    char path[JSON_READER_MAX_PATH];
+    int path_len;
+    char token[JSON_READER_MAX_VALUE];
+    int token_len;
+    bool token_is_key;
+    unsigned int unicode;                    // \uXXXX accumulator
+    int unicode_digits;
+    unsigned int high_surrogate;             // Pending UTF-16 high surrogate
+    bool stopped;
+    bool error;
+} JsonReader;
+
+// Prepare a reader for a new document
+void JsonReader_init(JsonReader* reader, JsonReaderCallback callback, void* userdata);
+
+// Feed the next chunk of input
+// Returns 1 to continue, 0 if the callback stopped parsing, -1 on syntax error
+int JsonReader_feed(JsonReader* reader, const char* data, int len);
+
+// Signal end of input; returns true if a complete document was parsed (or stopped early)
+bool JsonReader_finish(JsonReader* reader);
+
+// Read a FILE* (regular file or popen() pipe) in chunks until EOF, stop or error
+bool JsonReader_parseStream(FILE* fp, JsonReaderCallback callback, void* userdata);
+
+// Open and parse a file
+bool JsonReader_parseFile(const char* path, JsonReaderCallback callback, void* userdata);
+
+// Copy a reported string value into a fixed-size buffer (always NUL-terminated)
+void JsonReader_copy(char* dst, int dst_size, const char* value, int len);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "vp_defines.h"
 #include "api.h"
@@ -8,7 +9,13 @@
 #include "module_iptv.h"
 #include "iptv.h"
 #include "iptv_curated.h"
+#include "iptv_epg.h"
+#include "iptv_health.h"
+#include "iptv_logos.h"
+#include "iptv_playlist.h"
+#include "image_cache.h"
 #include "wifi.h"
+#include "keyboard.h"
 #include "ffplay_engine.h"
 #include "ui_iptv.h"
 #include "ui_main.h"
@@ -20,7 +27,9 @@
 typedef enum {
     IPTV_STATE_USER_CHANNELS,      // Main screen: user's saved channels
     IPTV_STATE_CURATED_COUNTRIES,  // Browse curated countries
-    IPTV_STATE_CURATED_CHANNELS   // Browse curated channels in a country
+    IPTV_STATE_CURATED_CHANNELS,  // Browse curated channels in a country
+    IPTV_STATE_PLAYLIST_GROUPS,   // Groups of an opened M3U playlist
+    IPTV_STATE_PLAYLIST_CHANNELS  // Channels of a playlist group
 } IPTVModuleState;
 
 static ScrollTextState iptv_scroll = {0};
@@ -34,6 +43,14 @@ static const char* curated_selected_country_code = NULL;
 static char curated_toast_message[128] = "";
 static uint32_t curated_toast_time = 0;
 
+// Playlist browse state
+static char playlist_title[64] = "";
+static int playlist_group_selected = 0;
+static int playlist_group_scroll = 0;
+static int playlist_group = IPTV_PLAYLIST_ALL_GROUPS;
+static int playlist_channel_selected = 0;
+static int playlist_channel_scroll = 0;
+
 // Confirmation dialog state
 static bool show_confirm = false;
 static int confirm_action_type = 0;   // 0 = delete from main list, 1 = remove from browse
@@ -42,24 +59,190 @@ static char confirm_channel_name[IPTV_MAX_NAME] = "";
 static char confirm_channel_url[IPTV_MAX_URL] = "";
 
 // Sorted channel index mapping for alphabetical display
-static int sorted_channel_indices[256];
+static int* sorted_channel_indices = NULL;
 static int sorted_channel_count = 0;
+static const CuratedTVChannel* sort_channels = NULL;
+
+// Dead channels (per the health prober) sort last, then by name
+static int compare_channel_names(const void* a, const void* b) {
+    int ia = *(const int*)a, ib = *(const int*)b;
+    bool dead_a = IPTV_health_peek(sort_channels[ia].url) == IPTV_HEALTH_DEAD;
+    bool dead_b = IPTV_health_peek(sort_channels[ib].url) == IPTV_HEALTH_DEAD;
+    if (dead_a != dead_b) return dead_a ? 1 : -1;
+    int cmp = strcasecmp(sort_channels[ia].name, sort_channels[ib].name);
+    return cmp ? cmp : ia - ib;
+}
 
 static void build_sorted_channel_indices(const char* country_code) {
     int sc = 0;
     const CuratedTVChannel* cs = IPTV_curated_get_channels(country_code, &sc);
-    sorted_channel_count = (sc < 256) ? sc : 256;
+    sorted_channel_count = 0;
+
+    int* indices = realloc(sorted_channel_indices, sizeof(int) * (sc > 0 ? sc : 1));
+    if (!indices) return;
+    sorted_channel_indices = indices;
+    sorted_channel_count = sc;
     for (int i = 0; i < sorted_channel_count; i++) sorted_channel_indices[i] = i;
-    // Insertion sort by name
-    for (int i = 1; i < sorted_channel_count; i++) {
-        int key = sorted_channel_indices[i];
-        int j = i - 1;
-        while (j >= 0 && strcasecmp(cs[sorted_channel_indices[j]].name, cs[key].name) > 0) {
-            sorted_channel_indices[j + 1] = sorted_channel_indices[j];
-            j--;
+
+    sort_channels = cs;
+    qsort(sorted_channel_indices, sorted_channel_count, sizeof(int), compare_channel_names);
+}
+
+// Live TV can be paused and rewound this far (recorded on the SD card by ffplay)
+#define IPTV_TIMESHIFT_SEC (30 * 60)
+
+// Live TV is played about this far behind what the server has sent
+#define IPTV_LIVE_LATENCY_MS 3000
+
+// Channel list handed to ffplay for up/down zapping ("name\turl\tkey\tflags" lines).
+// Every channel gets a line so ffplay's indices match the list on screen;
+// channels the health prober found dead are flagged so zapping skips them.
+#define IPTV_ZAP_LIST "/tmp/iptv_zap_list.txt"
+
+static void zap_list_add(FILE* f, const char* name, const char* url, const char* key) {
+    char clean[256];
+    snprintf(clean, sizeof(clean), "%s", name ? name : "");
+    for (char* c = clean; *c; c++) {
+        if (*c == '\t' || *c == '\r' || *c == '\n') *c = ' ';
+    }
+    // Unplayable URLs are kept as empty lines so the indices still match
+    if (!url || strlen(url) >= sizeof(((FfplayConfig*)0)->path) || strpbrk(url, "\t\r\n")) url = "";
+    if (!key || strpbrk(key, "\t\r\n")) key = "";
+    bool dead = url[0] && IPTV_health_peek(url) == IPTV_HEALTH_DEAD;
+    fprintf(f, "%s\t%s\t%s\t%s\n", clean, url, key, dead ? "dead" : "");
+}
+
+static bool write_user_zap_list(void) {
+    FILE* f = fopen(IPTV_ZAP_LIST, "w");
+    if (!f) return false;
+    const IPTVChannel* channels = IPTV_getUserChannels();
+    int count = IPTV_getUserChannelCount();
+    for (int i = 0; i < count; i++) {
+        zap_list_add(f, channels[i].name, channels[i].url, channels[i].decryption_key);
+    }
+    fclose(f);
+    return true;
+}
+
+static bool write_playlist_zap_list(int group) {
+    FILE* f = fopen(IPTV_ZAP_LIST, "w");
+    if (!f) return false;
+    int count = IPTV_playlist_getGroupSize(group);
+    for (int i = 0; i < count; i++) {
+        IPTVPlaylistChannel ch;
+        if (IPTV_playlist_getChannel(IPTV_playlist_getGroupChannel(group, i), &ch)) {
+            zap_list_add(f, ch.name, ch.url, ch.decryption_key);
+        } else {
+            zap_list_add(f, "", "", "");
         }
-        sorted_channel_indices[j + 1] = key;
     }
+    fclose(f);
+    return true;
+}
+
+// Play a stream with ffplay; returns the (possibly re-created) screen surface.
+// If zap_index is set, IPTV_ZAP_LIST holds the list it indexes: the player can
+// switch channels itself and zap_index comes back as the last channel watched.
+static SDL_Surface* play_stream(SDL_Surface* screen, int show_setting,
+                                const char* name, const char* url, const char* decryption_key,
+                                int* zap_index) {
+    // Ensure WiFi and play stream
+    Wifi_ensureConnected(screen, show_setting);
+
+    FfplayConfig config;
+    memset(&config, 0, sizeof(config));
+    config.source = FFPLAY_SOURCE_STREAM;
+    config.is_stream = true;
+    config.screen_width = screen->w;
+    config.timeshift_sec = IPTV_TIMESHIFT_SEC;
+    config.live_latency_ms = IPTV_LIVE_LATENCY_MS;
+    strncpy(config.path, url, sizeof(config.path) - 1);
+    strncpy(config.title, name, sizeof(config.title) - 1);
+    if (decryption_key && decryption_key[0])
+        strncpy(config.decryption_key, decryption_key, sizeof(config.decryption_key) - 1);
+    if (zap_index) {
+        strncpy(config.channel_list, IPTV_ZAP_LIST, sizeof(config.channel_list) - 1);
+        config.channel_index = *zap_index;
+    }
+
+    IPTV_logos_cancel();
+    IPTV_health_cancel();
+    ModuleCommon_setAutosleepDisabled(true);
+    FfplayEngine_play(&config);
+    if (zap_index) {
+        *zap_index = config.channel_index;
+        unlink(IPTV_ZAP_LIST);
+    }
+
+    Fonts_load();
+
+    // TG5050: display recovery creates a new screen surface
+    SDL_Surface* ns = FfplayEngine_getReinitScreen();
+    if (ns) screen = ns;
+
+    Icons_init();
+    return screen;
+}
+
+// Open a playlist file, showing progress while it is parsed
+static bool open_playlist(SDL_Surface* screen, int show_setting, const IPTVPlaylistFile* file) {
+    render_iptv_loading(screen, show_setting, file->name, "Loading playlist...");
+    GFX_flip(screen);
+
+    if (!IPTV_playlist_open(file->path)) return false;
+    IPTV_epg_importUrl(IPTV_playlist_getEpgUrl());
+
+    strncpy(playlist_title, file->name, sizeof(playlist_title) - 1);
+    playlist_title[sizeof(playlist_title) - 1] = '\0';
+    playlist_group_selected = 0;
+    playlist_group_scroll = 0;
+    return true;
+}
+
+// Ask for a playlist URL and import it; returns true if the playlist is now open
+static bool import_playlist(SDL_Surface** screenp, int show_setting) {
+    // TG5050: release display before keyboard (external binary takes DRM master)
+    FfplayEngine_prepareForExternal();
+
+    char* url = Keyboard_open("Playlist URL");
+
+    // Flush stale button state from keyboard
+    PAD_poll(); PAD_reset();
+
+    // TG5050: restore display after keyboard exits
+    FfplayEngine_recoverDisplay();
+    SDL_Surface* ns = FfplayEngine_getReinitScreen();
+    if (ns) *screenp = ns;
+
+    Fonts_load();
+    Icons_init();
+
+    if (!url) return false;
+    if (!url[0]) {
+        free(url);
+        return false;
+    }
+
+    Wifi_ensureConnected(*screenp, show_setting);
+
+    render_iptv_loading(*screenp, show_setting, "Browse Channels", "Importing playlist...");
+    GFX_flip(*screenp);
+
+    char path[512];
+    bool ok = IPTV_playlist_importUrl(url, path, sizeof(path));
+    free(url);
+    if (!ok) return false;
+    IPTV_epg_importUrl(IPTV_playlist_getEpgUrl());
+
+    const char* name = strrchr(path, '/');
+    name = name ? name + 1 : path;
+    strncpy(playlist_title, name, sizeof(playlist_title) - 1);
+    playlist_title[sizeof(playlist_title) - 1] = '\0';
+    char* dot = strrchr(playlist_title, '.');
+    if (dot) *dot = '\0';
+    playlist_group_selected = 0;
+    playlist_group_scroll = 0;
+    return true;
 }
 
 ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
@@ -67,6 +250,10 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
     int show_setting = 0;
     int ch_selected = 0, ch_scroll = 0;
     IPTVModuleState state = IPTV_STATE_USER_CHANNELS;
+    int logos_ready = IPTV_logos_getReadyCount();
+    int images_ready = ImageCache_getReadyCount();
+    int health_probed = IPTV_health_getProbedCount();
+    int epg_generation = IPTV_epg_getGeneration();
 
     memset(&iptv_scroll, 0, sizeof(iptv_scroll));
     show_confirm = false;
@@ -120,14 +307,33 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
             }
 
             int country_count = IPTV_curated_get_country_count();
+            int browse_count = country_count + IPTV_playlist_getFileCount();
 
-            if (PAD_justRepeated(BTN_UP) && country_count > 0) {
-                curated_country_selected = (curated_country_selected > 0) ? curated_country_selected - 1 : country_count - 1;
+            if (PAD_justRepeated(BTN_UP) && browse_count > 0) {
+                curated_country_selected = (curated_country_selected > 0) ? curated_country_selected - 1 : browse_count - 1;
+                dirty = 1;
+            }
+            else if (PAD_justRepeated(BTN_DOWN) && browse_count > 0) {
+                curated_country_selected = (curated_country_selected < browse_count - 1) ? curated_country_selected + 1 : 0;
+                dirty = 1;
+            }
+            else if (PAD_justPressed(BTN_A) && curated_country_selected >= country_count && curated_country_selected < browse_count) {
+                // M3U playlist
+                const IPTVPlaylistFile* file = &IPTV_playlist_getFiles()[curated_country_selected - country_count];
+                if (open_playlist(screen, show_setting, file)) {
+                    state = IPTV_STATE_PLAYLIST_GROUPS;
+                } else {
+                    IPTV_playlist_close();
+                }
                 dirty = 1;
+                continue;
             }
-            else if (PAD_justRepeated(BTN_DOWN) && country_count > 0) {
-                curated_country_selected = (curated_country_selected < country_count - 1) ? curated_country_selected + 1 : 0;
+            else if (PAD_justPressed(BTN_X)) {
+                if (import_playlist(&screen, show_setting)) {
+                    state = IPTV_STATE_PLAYLIST_GROUPS;
+                }
                 dirty = 1;
+                continue;
             }
             else if (PAD_justPressed(BTN_A) && country_count > 0) {
                 const CuratedTVCountry* countries = IPTV_curated_get_countries();
@@ -207,11 +413,30 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
             else if (PAD_justPressed(BTN_B)) {
                 curated_toast_message[0] = '\0';
                 clear_toast();
+                IPTV_logos_cancel();
                 state = IPTV_STATE_CURATED_COUNTRIES;
                 dirty = 1;
                 continue;
             }
 
+            // Redraw when background logos arrive
+            if (IPTV_logos_getReadyCount() != logos_ready) {
+                logos_ready = IPTV_logos_getReadyCount();
+                dirty = 1;
+            }
+            if (ImageCache_getReadyCount() != images_ready) {
+                images_ready = ImageCache_getReadyCount();
+                dirty = 1;
+            }
+            if (IPTV_health_getProbedCount() != health_probed) {
+                health_probed = IPTV_health_getProbedCount();
+                dirty = 1;
+            }
+            if (IPTV_epg_getGeneration() != epg_generation) {
+                epg_generation = IPTV_epg_getGeneration();
+                dirty = 1;
+            }
+
             ModuleCommon_PWR_update(&dirty, &show_setting);
             if (dirty) {
                 render_iptv_curated_channels(screen, show_setting, curated_selected_country_code,
@@ -229,6 +454,160 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
             continue;
         }
 
+        // Handle playlist groups
+        if (state == IPTV_STATE_PLAYLIST_GROUPS) {
+            GlobalInputResult global = ModuleCommon_handleGlobalInput(screen, &show_setting, STATE_IPTV_CATEGORIES);
+            if (global.should_quit) return MODULE_EXIT_QUIT;
+            if (global.input_consumed) {
+                if (global.dirty) dirty = 1;
+                GFX_sync();
+                continue;
+            }
+
+            int group_rows = IPTV_playlist_getGroupCount() + 1;   // + "All Channels"
+
+            if (PAD_justRepeated(BTN_UP)) {
+                playlist_group_selected = (playlist_group_selected > 0) ? playlist_group_selected - 1 : group_rows - 1;
+                dirty = 1;
+            }
+            else if (PAD_justRepeated(BTN_DOWN)) {
+                playlist_group_selected = (playlist_group_selected < group_rows - 1) ? playlist_group_selected + 1 : 0;
+                dirty = 1;
+            }
+            else if (PAD_justPressed(BTN_A)) {
+                playlist_group = playlist_group_selected - 1;
+                playlist_channel_selected = 0;
+                playlist_channel_scroll = 0;
+                state = IPTV_STATE_PLAYLIST_CHANNELS;
+                dirty = 1;
+                continue;
+            }
+            else if (PAD_justPressed(BTN_B)) {
+                IPTV_logos_cancel();
+                IPTV_playlist_close();
+                state = IPTV_STATE_CURATED_COUNTRIES;
+                dirty = 1;
+                continue;
+            }
+
+            ModuleCommon_PWR_update(&dirty, &show_setting);
+            if (dirty) {
+                render_iptv_playlist_groups(screen, show_setting, playlist_title,
+                                            playlist_group_selected, &playlist_group_scroll);
+                if (show_setting) GFX_blitHardwareHints(screen, show_setting);
+                GFX_flip(screen);
+                dirty = 0;
+            } else {
+                GFX_sync();
+            }
+            continue;
+        }
+
+        // Handle playlist channels (rows are rendered on demand from the playlist index)
+        if (state == IPTV_STATE_PLAYLIST_CHANNELS) {
+            GlobalInputResult global = ModuleCommon_handleGlobalInput(screen, &show_setting, STATE_IPTV_PLAYLIST_CHANNELS);
+            if (global.should_quit) return MODULE_EXIT_QUIT;
+            if (global.input_consumed) {
+                if (global.dirty) dirty = 1;
+                GFX_sync();
+                continue;
+            }
+
+            int channel_count = IPTV_playlist_getGroupSize(playlist_group);
+            IPTVPlaylistChannel channel;
+            bool have_channel = IPTV_playlist_getChannel(
+                IPTV_playlist_getGroupChannel(playlist_group, playlist_channel_selected), &channel);
+
+            if (PAD_justRepeated(BTN_UP) && channel_count > 0) {
+                playlist_channel_selected = (playlist_channel_selected > 0) ? playlist_channel_selected - 1 : channel_count - 1;
+                dirty = 1;
+            }
+            else if (PAD_justRepeated(BTN_DOWN) && channel_count > 0) {
+                playlist_channel_selected = (playlist_channel_selected < channel_count - 1) ? playlist_channel_selected + 1 : 0;
+                dirty = 1;
+            }
+            else if (PAD_justRepeated(BTN_LEFT) && channel_count > 0) {
+                // Page up
+                int page = calc_list_layout(screen).items_per_page;
+                playlist_channel_selected = MAX(0, playlist_channel_selected - page);
+                dirty = 1;
+            }
+            else if (PAD_justRepeated(BTN_RIGHT) && channel_count > 0) {
+                // Page down
+                int page = calc_list_layout(screen).items_per_page;
+                playlist_channel_selected = MIN(channel_count - 1, playlist_channel_selected + page);
+                dirty = 1;
+            }
+            else if (PAD_justPressed(BTN_A) && have_channel) {
+                bool zap = write_playlist_zap_list(playlist_group);
+                int index = playlist_channel_selected;
+                screen = play_stream(screen, show_setting, channel.name, channel.url, channel.decryption_key,
+                                     zap ? &index : NULL);
+                if (index >= 0 && index < channel_count) playlist_channel_selected = index;
+                dirty = 1;
+            }
+            else if (PAD_justPressed(BTN_Y) && have_channel) {
+                if (IPTV_userChannelExists(channel.url)) {
+                    // Already added - confirm removal
+                    strncpy(confirm_channel_name, channel.name, IPTV_MAX_NAME - 1);
+                    confirm_channel_name[IPTV_MAX_NAME - 1] = '\0';
+                    strncpy(confirm_channel_url, channel.url, IPTV_MAX_URL - 1);
+                    confirm_channel_url[IPTV_MAX_URL - 1] = '\0';
+                    confirm_action_type = 1;
+                    show_confirm = true;
+                } else if (IPTV_addUserChannel(channel.name, channel.url, channel.group, channel.logo, channel.decryption_key) >= 0) {
+                    snprintf(curated_toast_message, sizeof(curated_toast_message), "Added: %s", channel.name);
+                    curated_toast_time = SDL_GetTicks();
+                } else {
+                    snprintf(curated_toast_message, sizeof(curated_toast_message), "Maximum %d channels reached", IPTV_MAX_USER_CHANNELS);
+                    curated_toast_time = SDL_GetTicks();
+                }
+                dirty = 1;
+            }
+            else if (PAD_justPressed(BTN_B)) {
+                curated_toast_message[0] = '\0';
+                clear_toast();
+                IPTV_logos_cancel();
+                state = IPTV_STATE_PLAYLIST_GROUPS;
+                dirty = 1;
+                continue;
+            }
+
+            if (IPTV_logos_getReadyCount() != logos_ready) {
+                logos_ready = IPTV_logos_getReadyCount();
+                dirty = 1;
+            }
+            if (ImageCache_getReadyCount() != images_ready) {
+                images_ready = ImageCache_getReadyCount();
+                dirty = 1;
+            }
+            if (IPTV_health_getProbedCount() != health_probed) {
+                health_probed = IPTV_health_getProbedCount();
+                dirty = 1;
+            }
+            if (IPTV_epg_getGeneration() != epg_generation) {
+                epg_generation = IPTV_epg_getGeneration();
+                dirty = 1;
+            }
+
+            ModuleCommon_PWR_update(&dirty, &show_setting);
+            if (dirty) {
+                const char* title = playlist_group == IPTV_PLAYLIST_ALL_GROUPS
+                                    ? playlist_title : IPTV_playlist_getGroupName(playlist_group);
+                render_iptv_playlist_channels(screen, show_setting, title, playlist_group,
+                                              playlist_channel_selected, &playlist_channel_scroll,
+                                              curated_toast_message, curated_toast_time);
+                if (show_setting) GFX_blitHardwareHints(screen, show_setting);
+                GFX_flip(screen);
+                dirty = 0;
+
+                ModuleCommon_tickToast(curated_toast_message, curated_toast_time, &dirty);
+            } else {
+                GFX_sync();
+            }
+            continue;
+        }
+
         // IPTV_STATE_USER_CHANNELS (main screen)
         GlobalInputResult global = ModuleCommon_handleGlobalInput(screen, &show_setting, STATE_IPTV_LIST);
         if (global.should_quit) return MODULE_EXIT_QUIT;
@@ -241,11 +620,15 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
         int user_count = IPTV_getUserChannelCount();
 
         if (PAD_justPressed(BTN_B)) {
+            IPTV_logos_cancel();
+            IPTV_health_cancel();
+            IPTV_health_save();
             GFX_clearLayers(LAYER_SCROLLTEXT);
             return MODULE_EXIT_TO_MENU;
         }
         else if (PAD_justPressed(BTN_Y)) {
             // Open curated channel browser
+            IPTV_playlist_scan();
             curated_country_selected = 0;
             curated_country_scroll = 0;
             state = IPTV_STATE_CURATED_COUNTRIES;
@@ -275,31 +658,11 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
                 const IPTVChannel* channels = IPTV_getUserChannels();
                 const IPTVChannel* ch = &channels[ch_selected];
 
-                // Ensure WiFi and play stream
-                Wifi_ensureConnected(screen, show_setting);
-
-                FfplayConfig config;
-                memset(&config, 0, sizeof(config));
-                config.source = FFPLAY_SOURCE_STREAM;
-                config.is_stream = true;
-                config.screen_width = screen->w;
-                strncpy(config.path, ch->url, sizeof(config.path) - 1);
-                strncpy(config.title, ch->name, sizeof(config.title) - 1);
-                if (ch->decryption_key[0])
-                    strncpy(config.decryption_key, ch->decryption_key, sizeof(config.decryption_key) - 1);
-
-                ModuleCommon_setAutosleepDisabled(true);
-                FfplayEngine_play(&config);
-
-                Fonts_load();
-
-                // TG5050: display recovery creates a new screen surface
-				{
-					SDL_Surface* ns = FfplayEngine_getReinitScreen();
-					if (ns) screen = ns;
-				}
-                
-                Icons_init();
+                bool zap = write_user_zap_list();
+                int index = ch_selected;
+                screen = play_stream(screen, show_setting, ch->name, ch->url, ch->decryption_key,
+                                     zap ? &index : NULL);
+                if (index >= 0 && index < user_count) ch_selected = index;
                 memset(&iptv_scroll, 0, sizeof(iptv_scroll));
                 dirty = 1;
             }
@@ -307,6 +670,18 @@ ModuleExitReason IPTVModule_run(SDL_Surface* screen) {
 
         if (ScrollText_isScrolling(&iptv_scroll)) ScrollText_animateOnly(&iptv_scroll);
         if (ScrollText_needsRender(&iptv_scroll)) dirty = 1;
+        if (IPTV_logos_getReadyCount() != logos_ready) {
+            logos_ready = IPTV_logos_getReadyCount();
+            dirty = 1;
+        }
+        if (IPTV_health_getProbedCount() != health_probed) {
+            health_probed = IPTV_health_getProbedCount();
+            dirty = 1;
+        }
+        if (IPTV_epg_getGeneration() != epg_generation) {
+            epg_generation = IPTV_epg_getGeneration();
+            dirty = 1;
+        }
 
         ModuleCommon_PWR_update(&dirty, &show_setting);
         if (dirty) {
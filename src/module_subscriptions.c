@@ -9,6 +9,7 @@
 #include "module_common.h"
 #include "module_subscriptions.h"
 #include "subscriptions.h"
+#include "image_cache.h"
 #include "youtube.h"
 #include "wifi.h"
 #include "ffplay_engine.h"
@@ -124,6 +125,7 @@ static void queue_cancel(void) {
 ModuleExitReason SubscriptionsModule_run(SDL_Surface* screen) {
     int dirty = 1;
     int show_setting = 0;
+    int images_ready = ImageCache_getReadyCount();
     int selected = 0;
     int scroll_offset = 0;
     int channel_selected = 0;
@@ -566,6 +568,12 @@ ModuleExitReason SubscriptionsModule_run(SDL_Surface* screen) {
         if (ScrollText_isScrolling(&sub_scroll)) ScrollText_animateOnly(&sub_scroll);
         if (ScrollText_needsRender(&sub_scroll)) dirty = 1;
 
+        // Redraw when background avatar decodes replace their placeholders
+        if (ImageCache_getReadyCount() != images_ready) {
+            images_ready = ImageCache_getReadyCount();
+            dirty = 1;
+        }
+
         ModuleCommon_PWR_update(&dirty, &show_setting);
         if (dirty) {
             render_subscriptions_list(screen, show_setting, subs,
@@ -8,6 +8,7 @@
 #include "vp_defines.h"
 #include "api.h"
 #include "include/parson/parson.h"
+#include "json_reader.h"
 
 static SubscriptionList subs;
 
@@ -15,65 +16,42 @@ static void ensure_data_dir(void) {
     mkdir(APP_DATA_DIR, 0755);
 }
 
+// Streaming parse of subscriptions.json: [{"name","id","url","video_count",...}, ...]
+static bool subs_json_cb(void* userdata, JsonReaderEvent event,
+                         const char* path, const char* value, int len) {
+    (void)userdata;
+    if (subs.count >= SUBS_MAX_CHANNELS) return false;
+    SubscriptionChannel* ch = &subs.channels[subs.count];
+
+    if (strcmp(path, "[]") == 0) {
+        if (event == JSON_READER_OBJECT_START) {
+            memset(ch, 0, sizeof(*ch));
+        } else if (event == JSON_READER_OBJECT_END && ch->channel_name[0]) {
+            subs.count++;
+        }
+    } else if (event == JSON_READER_STRING) {
+        if (strcmp(path, "[].name") == 0) JsonReader_copy(ch->channel_name, SUBS_MAX_NAME, value, len);
+        else if (strcmp(path, "[].id") == 0) JsonReader_copy(ch->channel_id, SUBS_MAX_ID, value, len);
+        else if (strcmp(path, "[].url") == 0) JsonReader_copy(ch->channel_url, SUBS_MAX_URL, value, len);
+    } else if (event == JSON_READER_NUMBER) {
+        if (strcmp(path, "[].video_count") == 0) ch->video_count = atoi(value);
+        else if (strcmp(path, "[].seen_count") == 0) ch->seen_video_count = atoi(value);
+        else if (strcmp(path, "[].last_updated") == 0) ch->last_updated = (time_t)atof(value);
+    }
+    return true;
+}
+
 void Subscriptions_init(void) {
     memset(&subs, 0, sizeof(subs));
 
     FILE* fp = fopen(APP_SUBSCRIPTIONS_FILE, "r");
     if (!fp) return;
 
-    // Read entire file
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-
-    if (size <= 0 || size > 1024 * 1024) {
-        fclose(fp);
-        return;
+    // Entries completed before a parse error are kept
+    if (!JsonReader_parseStream(fp, subs_json_cb, NULL)) {
+        LOG_error("Subscriptions: failed to parse %s (loaded %d)\n", APP_SUBSCRIPTIONS_FILE, subs.count);
     }
-
-    char* buf = malloc(size + 1);
-    if (!buf) {
-        fclose(fp);
-        return;
-    }
-    fread(buf, 1, size, fp);
-    buf[size] = '\0';
     fclose(fp);
-
-    // Parse JSON
-    JSON_Value* root = json_parse_string(buf);
-    free(buf);
-    if (!root) return;
-
-    JSON_Array* channels = json_value_get_array(root);
-    if (!channels) {
-        json_value_free(root);
-        return;
-    }
-
-    int count = (int)json_array_get_count(channels);
-    if (count > SUBS_MAX_CHANNELS) count = SUBS_MAX_CHANNELS;
-
-    for (int i = 0; i < count; i++) {
-        JSON_Object* ch = json_array_get_object(channels, i);
-        if (!ch) continue;
-
-        const char* id = json_object_get_string(ch, "id");
-        const char* name = json_object_get_string(ch, "name");
-
-        if (name && name[0]) {
-            strncpy(subs.channels[subs.count].channel_name, name, SUBS_MAX_NAME - 1);
-            if (id) strncpy(subs.channels[subs.count].channel_id, id, SUBS_MAX_ID - 1);
-            const char* url = json_object_get_string(ch, "url");
-            if (url) strncpy(subs.channels[subs.count].channel_url, url, SUBS_MAX_URL - 1);
-            subs.channels[subs.count].video_count = (int)json_object_get_number(ch, "video_count");
-            subs.channels[subs.count].seen_video_count = (int)json_object_get_number(ch, "seen_count");
-            subs.channels[subs.count].last_updated = (time_t)json_object_get_number(ch, "last_updated");
-            subs.count++;
-        }
-    }
-
-    json_value_free(root);
 }
 
 const SubscriptionList* Subscriptions_getList(void) {
@@ -191,6 +169,12 @@ bool Subscriptions_getChannelDir(const char* channel_id, char* path_out, int siz
 }
 
 bool Subscriptions_getVideosPath(const char* channel_id, char* path_out, int size) {
+    if (!channel_id || !channel_id[0]) return false;
+    snprintf(path_out, size, APP_YOUTUBE_DIR "/%s/videos.bin", channel_id);
+    return true;
+}
+
+bool Subscriptions_getLegacyVideosPath(const char* channel_id, char* path_out, int size) {
     if (!channel_id || !channel_id[0]) return false;
     snprintf(path_out, size, APP_YOUTUBE_DIR "/%s/videos.json", channel_id);
     return true;
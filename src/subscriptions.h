@@ -56,9 +56,12 @@ void Subscriptions_markSeen(int index, int count);
 // Get channel data directory path: APP_YOUTUBE_DIR "/<channel_id>"
 bool Subscriptions_getChannelDir(const char* channel_id, char* path_out, int size);
 
-// Get videos.json path for a channel
+// Get videos.bin (binary video cache) path for a channel
 bool Subscriptions_getVideosPath(const char* channel_id, char* path_out, int size);
 
+// Get pre-binary videos.json path for a channel (read once for migration)
+bool Subscriptions_getLegacyVideosPath(const char* channel_id, char* path_out, int size);
+
 // Get avatar.jpg path for a channel
 bool Subscriptions_getAvatarPath(const char* channel_id, char* path_out, int size);
 
@@ -0,0 +1,180 @@
+// Host benchmark: the streaming JSON reader against parson on a yt-dlp style
+// document, picking out the channel fields the way channel_info_thread_func does.
+//
+//   make -C src/tests bench
+//
+// The document is synthetic (video metadata with many formats, each carrying a
+// long signed URL), so sizes are comparable to a real `yt-dlp -j` output.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "json_reader.h"
+#include "include/parson/parson.h"
+
+#define BENCH_FORMATS 600
+#define BENCH_RUNS 20
+#define BENCH_CHUNK 4096      // JsonReader_parseStream's read size
+
+typedef struct {
+    char channel[128];
+    char channel_url[256];
+    char channel_id[64];
+    double follower_count;
+} ChannelFields;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Peak resident set size so far, in KB
+static long peak_rss_kb(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+static void append(char** buf, size_t* len, size_t* cap, const char* fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static void append(char** buf, size_t* len, size_t* cap, const char* fmt, ...) {
+    va_list ap;
+    for (;;) {
+        va_start(ap, fmt);
+        int n = vsnprintf(*buf + *len, *cap - *len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < *cap - *len) {
+            *len += n;
+            return;
+        }
+        *cap *= 2;
+        *buf = realloc(*buf, *cap);
+        if (!*buf) exit(1);
+    }
+}
+
+static char* make_document(size_t* size_out) {
+    size_t cap = 1 << 16, len = 0;
+    char* buf = malloc(cap);
+    if (!buf) exit(1);
+
+    append(&buf, &len, &cap, "{\"id\": \"dQw4w9WgXcQ\", \"title\": \"Synthetic video \\u00e9\\ud83d\\ude00\","
+           " \"description\": \"");
+    for (int i = 0; i < 200; i++) append(&buf, &len, &cap, "Line %d of the description.\\n", i);
+    append(&buf, &len, &cap, "\", \"duration\": 212, \"view_count\": 1234567890, \"formats\": [");
+    for (int i = 0; i < BENCH_FORMATS; i++) {
+        append(&buf, &len, &cap,
+               "%s{\"format_id\": \"%d\", \"ext\": \"mp4\", \"width\": %d, \"height\": %d,"
+               " \"fps\": 29.97, \"tbr\": %.3f, \"vcodec\": \"avc1.64001F\", \"acodec\": \"none\","
+               " \"filesize\": %d, \"protocol\": \"https\", \"url\": \"https://rr3---sn-example.googlevideo.com/videoplayback?expire=1700000000&ei=",
+               i ? ", " : "", 100 + i, 256 + i, 144 + i, 100.5 + i, 1000000 + i * 977);
+        for (int k = 0; k < 200; k++) append(&buf, &len, &cap, "%08x", (unsigned)(i * 2654435761u + k * 40503u));
+        append(&buf, &len, &cap, "&itag=%d\", \"http_headers\": {\"User-Agent\": \"Mozilla/5.0\","
+               " \"Accept\": \"text/html\"}, \"fragments\": [", 100 + i);
+        for (int k = 0; k < 10; k++) append(&buf, &len, &cap, "%s{\"duration\": 5.005}", k ? ", " : "");
+        append(&buf, &len, &cap, "]}");
+    }
+    append(&buf, &len, &cap, "], \"channel\": \"Example Channel\", \"channel_id\": \"UCabcdefghijklmnopqrstuv\","
+           " \"channel_url\": \"https://www.youtube.com/channel/UCabcdefghijklmnopqrstuv\","
+           " \"channel_follower_count\": 4560000, \"tags\": [\"a\", \"b\", null, true, false, -1.5e3]}");
+    *size_out = len;
+    return buf;
+}
+
+static bool reader_cb(void* userdata, JsonReaderEvent event, const char* path,
+                      const char* value, int len) {
+    ChannelFields* f = (ChannelFields*)userdata;
+    if (event == JSON_READER_STRING) {
+        if (strcmp(path, "channel") == 0) {
+            JsonReader_copy(f->channel, sizeof(f->channel), value, len);
+        } else if (strcmp(path, "channel_url") == 0) {
+            JsonReader_copy(f->channel_url, sizeof(f->channel_url), value, len);
+        } else if (strcmp(path, "channel_id") == 0) {
+            JsonReader_copy(f->channel_id, sizeof(f->channel_id), value, len);
+        }
+    } else if (event == JSON_READER_NUMBER && strcmp(path, "channel_follower_count") == 0) {
+        f->follower_count = atof(value);
+    }
+    return true;
+}
+
+// Same chunking as JsonReader_parseStream, minus the stdio reads
+static bool parse_reader(const char* doc, size_t size, ChannelFields* f) {
+    JsonReader reader;
+    JsonReader_init(&reader, reader_cb, f);
+    for (size_t off = 0; off < size; off += BENCH_CHUNK) {
+        int n = size - off < BENCH_CHUNK ? (int)(size - off) : BENCH_CHUNK;
+        if (JsonReader_feed(&reader, doc + off, n) < 0) return false;
+    }
+    return JsonReader_finish(&reader);
+}
+
+// What the DOM version did: build the tree, look the fields up, free it
+static bool parse_parson(const char* doc, ChannelFields* f) {
+    JSON_Value* root = json_parse_string(doc);
+    JSON_Object* obj = json_value_get_object(root);
+    if (!obj) {
+        json_value_free(root);
+        return false;
+    }
+    const char* s;
+    if ((s = json_object_get_string(obj, "channel"))) snprintf(f->channel, sizeof(f->channel), "%s", s);
+    if ((s = json_object_get_string(obj, "channel_url"))) snprintf(f->channel_url, sizeof(f->channel_url), "%s", s);
+    if ((s = json_object_get_string(obj, "channel_id"))) snprintf(f->channel_id, sizeof(f->channel_id), "%s", s);
+    f->follower_count = json_object_get_number(obj, "channel_follower_count");
+    json_value_free(root);
+    return true;
+}
+
+int main(void) {
+    size_t size;
+    char* doc = make_document(&size);
+    ChannelFields a, b;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+
+    // Reader first: parson's heap growth would otherwise hide its (absent) one
+    long rss_base = peak_rss_kb();
+    double t0 = now_ms();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        if (!parse_reader(doc, size, &a)) {
+            fprintf(stderr, "json_reader: parse failed\n");
+            return 1;
+        }
+    }
+    double reader_ms = (now_ms() - t0) / BENCH_RUNS;
+    long reader_rss = peak_rss_kb() - rss_base;
+
+    rss_base = peak_rss_kb();
+    t0 = now_ms();
+    for (int i = 0; i < BENCH_RUNS; i++) {
+        if (!parse_parson(doc, &b)) {
+            fprintf(stderr, "parson: parse failed\n");
+            return 1;
+        }
+    }
+    double parson_ms = (now_ms() - t0) / BENCH_RUNS;
+    long parson_rss = peak_rss_kb() - rss_base;
+
+    if (strcmp(a.channel, b.channel) || strcmp(a.channel_url, b.channel_url) ||
+        strcmp(a.channel_id, b.channel_id) || a.follower_count != b.follower_count) {
+        fprintf(stderr, "mismatch: '%s' '%s' '%s' %.0f vs '%s' '%s' '%s' %.0f\n",
+                a.channel, a.channel_url, a.channel_id, a.follower_count,
+                b.channel, b.channel_url, b.channel_id, b.follower_count);
+        return 1;
+    }
+
+    printf("document: %.2f MB, %d formats, %d runs\n", size / 1e6, BENCH_FORMATS, BENCH_RUNS);
+    printf("parson:      %6.2f ms/parse, +%ld KB peak RSS\n", parson_ms, parson_rss);
+    printf("json_reader: %6.2f ms/parse, +%ld KB peak RSS (%zu byte reader state)\n",
+           reader_ms, reader_rss, sizeof(JsonReader));
+    free(doc);
+    return 0;
+}
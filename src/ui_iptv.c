@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "vp_defines.h"
 #include "api.h"
@@ -8,6 +9,54 @@
 #include "ui_utils.h"
 #include "iptv.h"
 #include "iptv_curated.h"
+#include "iptv_epg.h"
+#include "iptv_health.h"
+#include "iptv_logos.h"
+#include "iptv_playlist.h"
+
+// Channel logo size inside a single-row pill
+static int logo_size(const ListLayout* layout) {
+    return layout->item_h - SCALE1(8);
+}
+
+// Health dot at the right end of a row (probes unknown channels in the background).
+// Returns the width it takes, 0 if nothing is known yet.
+static int render_health_dot(SDL_Surface* screen, const char* url, int y, int item_h) {
+    Uint32 color;
+    switch (IPTV_health_get(url, NULL)) {
+        case IPTV_HEALTH_OK:   color = SDL_MapRGB(screen->format, 0x4C, 0xAF, 0x50); break;
+        case IPTV_HEALTH_SLOW: color = SDL_MapRGB(screen->format, 0xFF, 0xB3, 0x00); break;
+        case IPTV_HEALTH_DEAD: color = SDL_MapRGB(screen->format, 0xE5, 0x39, 0x35); break;
+        default: return 0;
+    }
+    int size = SCALE1(6);
+    int x = screen->w - SCALE1(PADDING * 2) - size;
+    SDL_FillRect(screen, &(SDL_Rect){x, y + (item_h - size) / 2, size, size}, color);
+    return size + SCALE1(6);
+}
+
+// Room for the current programme on the right of a row
+#define EPG_NOTE_WIDTH SCALE1(110)
+
+// Title of the programme on air now, NULL if the guide doesn't know the channel
+static const char* epg_now_title(const char* tvg_id, const char* name) {
+    EPGProgramme now;
+    if (!IPTV_epg_getNowNext(tvg_id, name, time(NULL), &now, NULL)) return NULL;
+    return now.title && now.title[0] ? now.title : NULL;
+}
+
+// Small gray note at the right end of a row (category, group or programme),
+// right_inset leaves room for the health dot
+static void render_row_note(SDL_Surface* screen, const char* text, int y, int item_h,
+                            int right_inset, int max_width, bool is_selected) {
+    char truncated[256];
+    GFX_truncateText(Fonts_getTiny(), text, truncated, max_width, 0);
+    SDL_Color color = is_selected ? COLOR_GRAY : COLOR_DARK_TEXT;
+    SDL_Surface* note = TTF_RenderUTF8_Blended(Fonts_getTiny(), truncated, color);
+    if (!note) return;
+    SDL_BlitSurface(note, NULL, screen, &(SDL_Rect){screen->w - note->w - SCALE1(PADDING * 2) - right_inset, y + (item_h - note->h) / 2});
+    SDL_FreeSurface(note);
+}
 
 // Render user's channel list (main screen)
 void render_iptv_user_channels(SDL_Surface* screen, int show_setting,
@@ -31,13 +80,34 @@ void render_iptv_user_channels(SDL_Surface* screen, int show_setting,
         bool is_selected = (idx == selected);
         int y = layout.list_y + i * layout.item_h;
 
-        ListItemPos pos = render_list_item_pill(screen, &layout,
+        // Logo (only once the background pipeline has it ready)
+        int icon_size = logo_size(&layout);
+        SDL_Surface* logo = IPTV_logos_get(ch->logo, icon_size);
+        int logo_width = logo ? icon_size + SCALE1(6) : 0;
+
+        // Narrower pill when the current programme is shown next to it
+        const char* programme = epg_now_title(NULL, ch->name);
+        ListLayout row_layout = layout;
+        if (programme) row_layout.max_width -= EPG_NOTE_WIDTH;
+
+        ListItemPos pos = render_list_item_pill(screen, &row_layout,
                                                  ch->name, truncated,
-                                                 y, is_selected, 0);
+                                                 y, is_selected, logo_width);
+
+        if (logo) {
+            SDL_BlitSurface(logo, NULL, screen,
+                            &(SDL_Rect){pos.text_x, y + (layout.item_h - icon_size) / 2, icon_size, icon_size});
+        }
+
+        int dot_width = render_health_dot(screen, ch->url, y, layout.item_h);
+        if (programme) {
+            render_row_note(screen, programme, y, layout.item_h, dot_width,
+                            EPG_NOTE_WIDTH - SCALE1(PADDING) - dot_width, is_selected);
+        }
 
         render_list_item_text(screen, scroll_state, ch->name, Fonts_getMedium(),
-                              pos.text_x, pos.text_y,
-                              pos.pill_width - SCALE1(BUTTON_PADDING * 2),
+                              pos.text_x + logo_width, pos.text_y,
+                              pos.pill_width - logo_width - SCALE1(BUTTON_PADDING * 2),
                               is_selected);
     }
 
@@ -58,7 +128,7 @@ void render_iptv_empty(SDL_Surface* screen, int show_setting) {
     GFX_blitButtonGroup((char*[]){"Y", "MANAGE", "B", "BACK", NULL}, 1, screen, 1);
 }
 
-// Render curated country list for browsing
+// Render curated country list for browsing, followed by M3U playlists
 void render_iptv_curated_countries(SDL_Surface* screen, int show_setting,
                                     int selected, int* scroll_offset) {
     GFX_clear(screen);
@@ -70,26 +140,36 @@ void render_iptv_curated_countries(SDL_Surface* screen, int show_setting,
 
     int country_count = IPTV_curated_get_country_count();
     const CuratedTVCountry* countries = IPTV_curated_get_countries();
+    int playlist_count = IPTV_playlist_getFileCount();
+    const IPTVPlaylistFile* playlists = IPTV_playlist_getFiles();
+    int total = country_count + playlist_count;
 
     ListLayout layout = calc_list_layout(screen);
     adjust_list_scroll(selected, scroll_offset, layout.items_per_page);
 
-    for (int i = 0; i < layout.items_per_page && *scroll_offset + i < country_count; i++) {
+    for (int i = 0; i < layout.items_per_page && *scroll_offset + i < total; i++) {
         int idx = *scroll_offset + i;
-        const CuratedTVCountry* country = &countries[idx];
         bool is_selected = (idx == selected);
+        const char* name;
+        char count_str[32];
+
+        if (idx < country_count) {
+            const CuratedTVCountry* country = &countries[idx];
+            name = country->name;
+            snprintf(count_str, sizeof(count_str), "%d channels", IPTV_curated_get_channel_count(country->code));
+        } else {
+            name = playlists[idx - country_count].name;
+            snprintf(count_str, sizeof(count_str), "Playlist");
+        }
 
         int y = layout.list_y + i * layout.item_h;
 
-        ListItemPos pos = render_list_item_pill(screen, &layout, country->name, truncated, y, is_selected, 0);
+        ListItemPos pos = render_list_item_pill(screen, &layout, name, truncated, y, is_selected, 0);
 
-        render_list_item_text(screen, NULL, country->name, Fonts_getMedium(),
+        render_list_item_text(screen, NULL, name, Fonts_getMedium(),
                               pos.text_x, pos.text_y, layout.max_width, is_selected);
 
-        // Channel count on right
-        int curated_ch_count = IPTV_curated_get_channel_count(country->code);
-        char count_str[32];
-        snprintf(count_str, sizeof(count_str), "%d channels", curated_ch_count);
+        // Channel count (or type) on right
         SDL_Color count_color = is_selected ? COLOR_GRAY : COLOR_DARK_TEXT;
         SDL_Surface* count_text = TTF_RenderUTF8_Blended(Fonts_getTiny(), count_str, count_color);
         if (count_text) {
@@ -98,8 +178,9 @@ void render_iptv_curated_countries(SDL_Surface* screen, int show_setting,
         }
     }
 
-    render_scroll_indicators(screen, *scroll_offset, layout.items_per_page, country_count);
+    render_scroll_indicators(screen, *scroll_offset, layout.items_per_page, total);
 
+    GFX_blitButtonGroup((char*[]){"X", "IMPORT", NULL}, 0, screen, 0);
     GFX_blitButtonGroup((char*[]){"B", "BACK", "A", "SELECT", NULL}, 1, screen, 1);
 }
 
@@ -111,7 +192,6 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
                                    const char* toast_message, uint32_t toast_time) {
     GFX_clear(screen);
 
-    int hw = screen->w;
     char truncated[256];
 
     // Get country name for title
@@ -151,16 +231,25 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
 
         int y = layout.list_y + i * layout.item_h;
 
-        // Calculate prefix width for added indicator
-        int prefix_width = 0;
+        // Logo (only once the background pipeline has it ready)
+        int icon_size = logo_size(&layout);
+        SDL_Surface* logo = IPTV_logos_get(channel->logo, icon_size);
+        int logo_width = logo ? icon_size + SCALE1(6) : 0;
+
+        // Calculate prefix width for logo and added indicator
+        int prefix_width = logo_width;
         if (added) {
             int pw, ph;
             TTF_SizeUTF8(Fonts_getSmall(), "[+]", &pw, &ph);
-            prefix_width = pw + SCALE1(6);
+            prefix_width += pw + SCALE1(6);
         }
 
+        // Programme on air replaces the category when the guide has the channel
+        const char* programme = epg_now_title(NULL, channel->name);
+        int note_width = programme ? EPG_NOTE_WIDTH : SCALE1(60);
+
         // Render pill background and get text position
-        int name_max_width = layout.max_width - prefix_width - SCALE1(60);
+        int name_max_width = layout.max_width - prefix_width - note_width;
         int text_width = GFX_truncateText(Fonts_getMedium(), channel->name, truncated, name_max_width, SCALE1(BUTTON_PADDING * 2));
         int pill_width = MIN(layout.max_width, prefix_width + text_width + SCALE1(BUTTON_PADDING));
 
@@ -170,12 +259,17 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
         int text_x = SCALE1(PADDING) + SCALE1(BUTTON_PADDING);
         int text_y = y + (layout.item_h - TTF_FontHeight(Fonts_getMedium())) / 2;
 
+        if (logo) {
+            SDL_BlitSurface(logo, NULL, screen,
+                            &(SDL_Rect){text_x, y + (layout.item_h - icon_size) / 2, icon_size, icon_size});
+        }
+
         // Added indicator prefix
         if (added) {
             SDL_Color prefix_color = Fonts_getListTextColor(is_selected);
             SDL_Surface* prefix_text = TTF_RenderUTF8_Blended(Fonts_getSmall(), "[+]", prefix_color);
             if (prefix_text) {
-                SDL_BlitSurface(prefix_text, NULL, screen, &(SDL_Rect){text_x, y + (layout.item_h - prefix_text->h) / 2});
+                SDL_BlitSurface(prefix_text, NULL, screen, &(SDL_Rect){text_x + logo_width, y + (layout.item_h - prefix_text->h) / 2});
                 SDL_FreeSurface(prefix_text);
             }
         }
@@ -184,14 +278,12 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
         render_list_item_text(screen, NULL, channel->name, Fonts_getMedium(),
                               text_x + prefix_width, text_y, name_max_width, is_selected);
 
-        // Category on right
-        if (channel->category[0]) {
-            SDL_Color cat_color = is_selected ? COLOR_GRAY : COLOR_DARK_TEXT;
-            SDL_Surface* cat_text = TTF_RenderUTF8_Blended(Fonts_getTiny(), channel->category, cat_color);
-            if (cat_text) {
-                SDL_BlitSurface(cat_text, NULL, screen, &(SDL_Rect){hw - cat_text->w - SCALE1(PADDING * 2), y + (layout.item_h - cat_text->h) / 2});
-                SDL_FreeSurface(cat_text);
-            }
+        // Health and programme/category on right
+        int dot_width = render_health_dot(screen, channel->url, y, layout.item_h);
+        const char* note = programme ? programme : channel->category;
+        if (note[0]) {
+            render_row_note(screen, note, y, layout.item_h, dot_width,
+                            note_width - SCALE1(PADDING) - dot_width, is_selected);
         }
     }
 
@@ -207,3 +299,148 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
         GFX_blitButtonGroup((char*[]){"B", "BACK", "A", "ADD", NULL}, 1, screen, 1);
     }
 }
+
+// Render playlist groups ("All Channels" first, then group-title groups)
+void render_iptv_playlist_groups(SDL_Surface* screen, int show_setting,
+                                  const char* title, int selected, int* scroll_offset) {
+    GFX_clear(screen);
+
+    int hw = screen->w;
+    char truncated[256];
+
+    render_screen_header(screen, title, show_setting);
+
+    int total = IPTV_playlist_getGroupCount() + 1;
+
+    ListLayout layout = calc_list_layout(screen);
+    adjust_list_scroll(selected, scroll_offset, layout.items_per_page);
+
+    for (int i = 0; i < layout.items_per_page && *scroll_offset + i < total; i++) {
+        int idx = *scroll_offset + i;
+        bool is_selected = (idx == selected);
+        int group = idx - 1;   // Row 0 = IPTV_PLAYLIST_ALL_GROUPS
+        const char* name = group < 0 ? "All Channels" : IPTV_playlist_getGroupName(group);
+
+        int y = layout.list_y + i * layout.item_h;
+
+        ListItemPos pos = render_list_item_pill(screen, &layout, name, truncated, y, is_selected, 0);
+
+        render_list_item_text(screen, NULL, name, Fonts_getMedium(),
+                              pos.text_x, pos.text_y, layout.max_width, is_selected);
+
+        char count_str[32];
+        snprintf(count_str, sizeof(count_str), "%d channels", IPTV_playlist_getGroupSize(group));
+        SDL_Color count_color = is_selected ? COLOR_GRAY : COLOR_DARK_TEXT;
+        SDL_Surface* count_text = TTF_RenderUTF8_Blended(Fonts_getTiny(), count_str, count_color);
+        if (count_text) {
+            SDL_BlitSurface(count_text, NULL, screen, &(SDL_Rect){hw - count_text->w - SCALE1(PADDING * 2), y + (layout.item_h - count_text->h) / 2});
+            SDL_FreeSurface(count_text);
+        }
+    }
+
+    render_scroll_indicators(screen, *scroll_offset, layout.items_per_page, total);
+
+    GFX_blitButtonGroup((char*[]){"B", "BACK", "A", "SELECT", NULL}, 1, screen, 1);
+}
+
+// Render channels of a playlist group.
+// Only the visible rows are touched, so cost does not depend on playlist size.
+void render_iptv_playlist_channels(SDL_Surface* screen, int show_setting,
+                                    const char* title, int group,
+                                    int selected, int* scroll_offset,
+                                    const char* toast_message, uint32_t toast_time) {
+    GFX_clear(screen);
+
+    char truncated[256];
+
+    render_screen_header(screen, title, show_setting);
+
+    int total = IPTV_playlist_getGroupSize(group);
+
+    ListLayout layout = calc_list_layout(screen);
+    adjust_list_scroll(selected, scroll_offset, layout.items_per_page);
+
+    bool selected_exists = false;
+    IPTVPlaylistChannel channel;
+
+    for (int i = 0; i < layout.items_per_page && *scroll_offset + i < total; i++) {
+        int idx = *scroll_offset + i;
+        if (!IPTV_playlist_getChannel(IPTV_playlist_getGroupChannel(group, idx), &channel)) continue;
+        bool is_selected = (idx == selected);
+        bool added = IPTV_userChannelExists(channel.url);
+        if (is_selected) selected_exists = added;
+
+        int y = layout.list_y + i * layout.item_h;
+
+        int icon_size = logo_size(&layout);
+        SDL_Surface* logo = IPTV_logos_get(channel.logo, icon_size);
+        int logo_width = logo ? icon_size + SCALE1(6) : 0;
+
+        int prefix_width = logo_width;
+        if (added) {
+            int pw, ph;
+            TTF_SizeUTF8(Fonts_getSmall(), "[+]", &pw, &ph);
+            prefix_width += pw + SCALE1(6);
+        }
+
+        // On the right: the programme on air, else the group in "All Channels"
+        const char* note = epg_now_title(channel.tvg_id, channel.name);
+        int note_width = EPG_NOTE_WIDTH;
+        if (!note && group == IPTV_PLAYLIST_ALL_GROUPS && channel.group[0]) {
+            note = channel.group;
+            note_width = SCALE1(60);
+        }
+        int name_max_width = layout.max_width - prefix_width - (note ? note_width : 0);
+        int text_width = GFX_truncateText(Fonts_getMedium(), channel.name, truncated, name_max_width, SCALE1(BUTTON_PADDING * 2));
+        int pill_width = MIN(layout.max_width, prefix_width + text_width + SCALE1(BUTTON_PADDING));
+
+        SDL_Rect pill_rect = {SCALE1(PADDING), y, pill_width, layout.item_h};
+        Fonts_drawListItemBg(screen, &pill_rect, is_selected);
+
+        int text_x = SCALE1(PADDING) + SCALE1(BUTTON_PADDING);
+        int text_y = y + (layout.item_h - TTF_FontHeight(Fonts_getMedium())) / 2;
+
+        if (logo) {
+            SDL_BlitSurface(logo, NULL, screen,
+                            &(SDL_Rect){text_x, y + (layout.item_h - icon_size) / 2, icon_size, icon_size});
+        }
+
+        if (added) {
+            SDL_Color prefix_color = Fonts_getListTextColor(is_selected);
+            SDL_Surface* prefix_text = TTF_RenderUTF8_Blended(Fonts_getSmall(), "[+]", prefix_color);
+            if (prefix_text) {
+                SDL_BlitSurface(prefix_text, NULL, screen, &(SDL_Rect){text_x + logo_width, y + (layout.item_h - prefix_text->h) / 2});
+                SDL_FreeSurface(prefix_text);
+            }
+        }
+
+        render_list_item_text(screen, NULL, channel.name, Fonts_getMedium(),
+                              text_x + prefix_width, text_y, name_max_width, is_selected);
+
+        int dot_width = render_health_dot(screen, channel.url, y, layout.item_h);
+        if (note) {
+            render_row_note(screen, note, y, layout.item_h, dot_width,
+                            note_width - SCALE1(PADDING) - dot_width, is_selected);
+        }
+    }
+
+    render_scroll_indicators(screen, *scroll_offset, layout.items_per_page, total);
+
+    render_toast(screen, toast_message, toast_time);
+
+    GFX_blitButtonGroup((char*[]){"Y", selected_exists ? "REMOVE" : "ADD", NULL}, 0, screen, 0);
+    GFX_blitButtonGroup((char*[]){"B", "BACK", "A", "PLAY", NULL}, 1, screen, 1);
+}
+
+// Render a blocking progress message (playlist load/import)
+void render_iptv_loading(SDL_Surface* screen, int show_setting,
+                          const char* title, const char* message) {
+    GFX_clear(screen);
+    render_screen_header(screen, title, show_setting);
+
+    SDL_Surface* text = TTF_RenderUTF8_Blended(Fonts_getMedium(), message, COLOR_WHITE);
+    if (text) {
+        SDL_BlitSurface(text, NULL, screen, &(SDL_Rect){(screen->w - text->w) / 2, (screen->h - text->h) / 2});
+        SDL_FreeSurface(text);
+    }
+}
@@ -13,7 +13,7 @@ void render_iptv_user_channels(SDL_Surface* screen, int show_setting,
 // Render IPTV empty state (no channels added)
 void render_iptv_empty(SDL_Surface* screen, int show_setting);
 
-// Render curated country list for browsing
+// Render curated country list for browsing, followed by M3U playlists
 void render_iptv_curated_countries(SDL_Surface* screen, int show_setting,
                                     int selected, int* scroll_offset);
 
@@ -24,4 +24,18 @@ void render_iptv_curated_channels(SDL_Surface* screen, int show_setting,
                                    const int* sorted_indices, int sorted_count,
                                    const char* toast_message, uint32_t toast_time);
 
+// Render playlist groups ("All Channels" first, then group-title groups)
+void render_iptv_playlist_groups(SDL_Surface* screen, int show_setting,
+                                  const char* title, int selected, int* scroll_offset);
+
+// Render channels of a playlist group (group may be IPTV_PLAYLIST_ALL_GROUPS)
+void render_iptv_playlist_channels(SDL_Surface* screen, int show_setting,
+                                    const char* title, int group,
+                                    int selected, int* scroll_offset,
+                                    const char* toast_message, uint32_t toast_time);
+
+// Render a blocking progress message (playlist load/import)
+void render_iptv_loading(SDL_Surface* screen, int show_setting,
+                          const char* title, const char* message);
+
 #endif
@@ -83,9 +83,26 @@ static const ControlHelp iptv_list_controls[] = {
     {NULL, NULL}
 };
 
-// IPTV curated browse controls
+// IPTV curated country list controls
 static const ControlHelp iptv_curated_controls[] = {
     {"Up/Down", "Navigate"},
+    {"X", "Import Playlist URL"},
+    {"Start (hold)", "Exit App"},
+    {NULL, NULL}
+};
+
+// IPTV curated channel and playlist category controls
+static const ControlHelp iptv_browse_controls[] = {
+    {"Up/Down", "Navigate"},
+    {"Start (hold)", "Exit App"},
+    {NULL, NULL}
+};
+
+// IPTV playlist channel controls
+static const ControlHelp iptv_playlist_controls[] = {
+    {"Up/Down", "Navigate"},
+    {"Left/Right", "Page Up/Down"},
+    {"Y", "Add/Remove Channel"},
     {"Start (hold)", "Exit App"},
     {NULL, NULL}
 };
@@ -153,10 +170,18 @@ void render_controls_help(SDL_Surface* screen, int app_state) {
             page_title = "IPTV";
             break;
         case STATE_IPTV_CURATED_COUNTRIES:
-        case STATE_IPTV_CURATED_CHANNELS:
             controls = iptv_curated_controls;
             page_title = "Browse Channels";
             break;
+        case STATE_IPTV_CURATED_CHANNELS:
+        case STATE_IPTV_CATEGORIES:
+            controls = iptv_browse_controls;
+            page_title = "Browse Channels";
+            break;
+        case STATE_IPTV_PLAYLIST_CHANNELS:
+            controls = iptv_playlist_controls;
+            page_title = "Playlist";
+            break;
         case STATE_YOUTUBE_RESULTS:
             controls = youtube_results_controls;
             page_title = "YouTube";
@@ -1,8 +1,5 @@
 #include <stdio.h>
 #include <string.h>
-#include <sys/stat.h>
-
-#include <SDL2/SDL_image.h>
 
 #include "vp_defines.h"
 #include "api.h"
@@ -10,106 +7,19 @@
 #include "ui_fonts.h"
 #include "ui_utils.h"
 #include "subscriptions.h"
-
-// Avatar thumbnail cache (in-memory)
-#define AVATAR_CACHE_SIZE 8
-
-typedef struct {
-    char channel_id[SUBS_MAX_ID];
-    SDL_Surface* surface;
-} AvatarCacheEntry;
-
-static AvatarCacheEntry avatar_cache[AVATAR_CACHE_SIZE];
-static int avatar_cache_count = 0;
-
-static SDL_Surface* avatar_cache_find(const char* channel_id) {
-    for (int i = 0; i < avatar_cache_count; i++) {
-        if (strcmp(avatar_cache[i].channel_id, channel_id) == 0) {
-            return avatar_cache[i].surface;
-        }
-    }
-    return NULL;
-}
-
-static void avatar_cache_add(const char* channel_id, SDL_Surface* surface) {
-    if (avatar_cache_count >= AVATAR_CACHE_SIZE) {
-        SDL_FreeSurface(avatar_cache[0].surface);
-        memmove(&avatar_cache[0], &avatar_cache[1],
-                sizeof(AvatarCacheEntry) * (AVATAR_CACHE_SIZE - 1));
-        avatar_cache_count = AVATAR_CACHE_SIZE - 1;
-    }
-    strncpy(avatar_cache[avatar_cache_count].channel_id, channel_id, SUBS_MAX_ID - 1);
-    avatar_cache[avatar_cache_count].channel_id[SUBS_MAX_ID - 1] = '\0';
-    avatar_cache[avatar_cache_count].surface = surface;
-    avatar_cache_count++;
-}
-
-// Scale an avatar surface to target_size x target_size and apply circular mask
-static SDL_Surface* scale_avatar(SDL_Surface* src, int target_size) {
-    if (!src) return NULL;
-
-    SDL_Surface* converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ARGB8888, 0);
-    if (!converted) return NULL;
-
-    SDL_Surface* scaled = SDL_CreateRGBSurfaceWithFormat(
-        0, target_size, target_size, 32, SDL_PIXELFORMAT_ARGB8888);
-    if (!scaled) { SDL_FreeSurface(converted); return NULL; }
-
-    SDL_Rect src_rect = {0, 0, converted->w, converted->h};
-    SDL_Rect dst_rect = {0, 0, target_size, target_size};
-    SDL_BlitScaled(converted, &src_rect, scaled, &dst_rect);
-    SDL_FreeSurface(converted);
-
-    // Apply circular mask
-    int radius = target_size / 2;
-    uint32_t* pixels = (uint32_t*)scaled->pixels;
-    int pitch = scaled->pitch / 4;
-    for (int y = 0; y < target_size; y++) {
-        for (int x = 0; x < target_size; x++) {
-            int dx = x - radius;
-            int dy = y - radius;
-            if (dx * dx + dy * dy > radius * radius) {
-                pixels[y * pitch + x] = 0;
-            }
-        }
-    }
-
-    return scaled;
-}
-
-static void avatar_load_visible(const SubscriptionList* subs, int scroll, int items_per_page) {
-    for (int i = 0; i < items_per_page && (scroll + i) < subs->count; i++) {
-        int idx = scroll + i;
-        const SubscriptionChannel* ch = &subs->channels[idx];
-        if (!ch->channel_id[0]) continue;
-        if (avatar_cache_find(ch->channel_id)) continue;
-
-        char path[512];
-        if (!Subscriptions_getAvatarPath(ch->channel_id, path, sizeof(path))) continue;
-
-        struct stat st;
-        if (stat(path, &st) != 0 || st.st_size == 0) continue;
-
-        SDL_Surface* raw = IMG_Load(path);
-        if (!raw) continue;
-
-        int icon_size = SCALE1(PILL_SIZE) * 3 / 2 - SCALE1(8);
-        SDL_Surface* scaled = scale_avatar(raw, icon_size);
-        SDL_FreeSurface(raw);
-
-        if (scaled) {
-            avatar_cache_add(ch->channel_id, scaled);
-        }
-    }
+#include "image_cache.h"
+
+// Avatars are decoded, scaled and circle-masked once by the image cache
+static SDL_Surface* avatar_get(const SubscriptionChannel* ch) {
+    if (!ch->channel_id[0]) return NULL;
+    char path[512];
+    if (!Subscriptions_getAvatarPath(ch->channel_id, path, sizeof(path))) return NULL;
+    int icon_size = SCALE1(PILL_SIZE) * 3 / 2 - SCALE1(8);
+    return ImageCache_get(path, icon_size, icon_size, IMAGE_CACHE_CIRCLE);
 }
 
 void SubUI_clearAvatarCache(void) {
-    for (int i = 0; i < avatar_cache_count; i++) {
-        if (avatar_cache[i].surface) {
-            SDL_FreeSurface(avatar_cache[i].surface);
-        }
-    }
-    avatar_cache_count = 0;
+    ImageCache_clear();
 }
 
 void render_subscriptions_list(SDL_Surface* screen, int show_setting,
@@ -136,9 +46,6 @@ void render_subscriptions_list(SDL_Surface* screen, int show_setting,
     int scroll = scroll_offset;
     adjust_list_scroll(selected, &scroll, items_per_page);
 
-    // Lazy-load one avatar per frame
-    avatar_load_visible(subs, scroll, items_per_page);
-
     for (int i = 0; i < items_per_page && (scroll + i) < subs->count; i++) {
         int idx = scroll + i;
         const SubscriptionChannel* ch = &subs->channels[idx];
@@ -153,12 +60,8 @@ void render_subscriptions_list(SDL_Surface* screen, int show_setting,
         }
 
         // Check if we have an avatar
-        bool has_avatar = false;
-        SDL_Surface* avatar = NULL;
-        if (ch->channel_id[0]) {
-            avatar = avatar_cache_find(ch->channel_id);
-            if (avatar) has_avatar = true;
-        }
+        SDL_Surface* avatar = avatar_get(ch);
+        bool has_avatar = avatar != NULL;
 
         ListItemRichPos pos = render_list_item_pill_rich(screen, &layout,
                                                           ch->channel_name, subtitle, truncated,
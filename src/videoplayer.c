@@ -14,6 +14,7 @@
 
 #include "ui_fonts.h"
 #include "ui_icons.h"
+#include "image_cache.h"
 
 #include "module_common.h"
 #include "module_menu.h"
@@ -29,6 +30,10 @@
 #include "subscriptions.h"
 #include "iptv.h"
 #include "iptv_curated.h"
+#include "iptv_epg.h"
+#include "iptv_logos.h"
+#include "iptv_health.h"
+#include "iptv_playlist.h"
 #include "keyboard.h"
 
 // Global quit flag
@@ -127,6 +132,7 @@ int main(int argc, char* argv[]) {
     // Initialize IPTV (loads playlists + cached channels)
     IPTV_init();
     IPTV_curated_init();
+    IPTV_epg_init();
 
     // Main application loop
     while (!quit) {
@@ -170,6 +176,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    IPTV_logos_cleanup();
+    IPTV_health_cleanup();
+    IPTV_epg_cleanup();
+    IPTV_playlist_cleanup();
     IPTV_curated_cleanup();
     IPTV_cleanup();
     Subscriptions_cleanup();
@@ -177,6 +187,7 @@ int main(int argc, char* argv[]) {
     SelfUpdate_cleanup();
     Settings_quit();
     ModuleCommon_quit();
+    ImageCache_quit();
     Icons_quit();
     Fonts_unload();
 
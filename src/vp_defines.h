@@ -12,6 +12,8 @@
 #define APP_DATA_DIR SHARED_USERDATA_PATH "/video-player"
 #define APP_SETTINGS_DIR APP_DATA_DIR
 #define APP_THUMBNAILS_DIR SDCARD_PATH "/.cache/youtube-thumbnails"
+#define APP_IMAGE_CACHE_DIR SDCARD_PATH "/.cache/video-player-images"
+#define APP_IPTV_LOGOS_DIR SDCARD_PATH "/.cache/iptv-logos"
 #define APP_SUBSCRIPTIONS_FILE APP_DATA_DIR "/subscriptions.json"
 #define APP_YOUTUBE_DIR APP_DATA_DIR "/youtube"
 
@@ -56,6 +58,7 @@ typedef enum {
     STATE_IPTV_PLAYING = 22,
     STATE_IPTV_CURATED_COUNTRIES = 23,
     STATE_IPTV_CURATED_CHANNELS = 24,
+    STATE_IPTV_PLAYLIST_CHANNELS = 25,
     STATE_SUBSCRIPTIONS = 30,
     STATE_SETTINGS = 40,
     STATE_ABOUT = 41,
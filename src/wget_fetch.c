@@ -4,8 +4,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include "defines.h"
 #include "api.h"
 
@@ -137,3 +142,67 @@ int wget_download_file(const char* url, const char* filepath,
 
     return result;
 }
+
+// Guards every WgetChild, so a cancel cannot slip between fork() and the
+// pid being recorded
+static pthread_mutex_t child_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+pid_t wget_child_start(WgetChild* child, const char* const* args, int* out_fd) {
+    char* argv[32];
+    int argc = 0;
+    argv[argc++] = WGET_BIN;
+    while (*args && argc < 31) argv[argc++] = (char*)*args++;
+    argv[argc] = NULL;
+
+    // Close-on-exec, so wgets started by other threads don't hold the pipe open
+    int pipe_fd[2] = {-1, -1};
+    if (out_fd && pipe2(pipe_fd, O_CLOEXEC) != 0) return -1;
+
+    pthread_mutex_lock(&child_mutex);
+    pid_t pid = child->cancelled ? -1 : fork();
+    if (pid == 0) {
+        // Child: only async-signal-safe calls until exec
+        int null_fd = open("/dev/null", O_RDWR);
+        dup2(out_fd ? pipe_fd[1] : null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        for (int fd = 3; fd < 256; fd++) close(fd);
+        execv(WGET_BIN, argv);
+        _exit(127);
+    }
+    if (pid > 0) child->pid = pid;
+    pthread_mutex_unlock(&child_mutex);
+
+    if (out_fd) {
+        close(pipe_fd[1]);
+        if (pid > 0) {
+            *out_fd = pipe_fd[0];
+        } else {
+            close(pipe_fd[0]);
+        }
+    }
+    return pid;
+}
+
+int wget_child_wait(WgetChild* child, pid_t pid) {
+    // Wait without reaping first: until the child is reaped its pid cannot be
+    // reused, so a concurrent cancel never signals an unrelated process
+    siginfo_t info;
+    while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) != 0 && errno == EINTR);
+
+    pthread_mutex_lock(&child_mutex);
+    child->pid = 0;
+    pthread_mutex_unlock(&child_mutex);
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+void wget_child_cancel(WgetChild* child) {
+    pthread_mutex_lock(&child_mutex);
+    child->cancelled = true;
+    if (child->pid > 0) kill(child->pid, SIGTERM);
+    pthread_mutex_unlock(&child_mutex);
+}
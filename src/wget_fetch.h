@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 
 // Fetch URL content into memory buffer using wget
 int wget_fetch(const char* url, uint8_t* buffer, int buffer_size);
@@ -11,4 +12,23 @@ int wget_fetch(const char* url, uint8_t* buffer, int buffer_size);
 int wget_download_file(const char* url, const char* filepath,
                        volatile int* progress_pct, volatile bool* should_stop);
 
+// A wget run by a worker thread that another thread can stop. Zero it before
+// the worker starts.
+typedef struct {
+    pid_t pid;          // Running child (0 = none)
+    bool cancelled;     // Set by wget_child_cancel(); no new child starts
+} WgetChild;
+
+// Start wget with args (NULL-terminated, without the program name). With
+// out_fd its stdout is a pipe whose read end is returned there, else it goes
+// to /dev/null. Returns the pid, or -1 on failure or once cancelled.
+pid_t wget_child_start(WgetChild* child, const char* const* args, int* out_fd);
+
+// Wait for the child from wget_child_start(); returns its exit status, or -1
+// if it was killed or could not be waited for
+int wget_child_wait(WgetChild* child, pid_t pid);
+
+// Kill the running child, if any, and refuse to start another
+void wget_child_cancel(WgetChild* child);
+
 #endif // WGET_FETCH_H
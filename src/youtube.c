@@ -5,12 +5,15 @@
 #include <string.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <zlib.h>
 
 #include "vp_defines.h"
 #include "api.h"
-#include "include/parson/parson.h"
+#include "json_reader.h"
 
 #define YTDLP_BIN "./bin/yt-dlp"
 #define WGET_BIN "./bin/wget"
@@ -494,102 +497,85 @@ void YouTube_cancelResolve(void) {
     }
 }
 
+// Fields picked out of the yt-dlp video JSON while it streams in
+typedef struct {
+    YouTubeChannelInfoOp* op;
+    double follower_count;
+    bool has_root;
+} ChannelInfoParse;
+
+static bool channel_info_json_cb(void* userdata, JsonReaderEvent event,
+                                 const char* path, const char* value, int len) {
+    ChannelInfoParse* p = (ChannelInfoParse*)userdata;
+    YouTubeChannelInfo* info = &p->op->info;
+
+    if (event == JSON_READER_OBJECT_START && path[0] == '\0') {
+        p->has_root = true;
+    } else if (event == JSON_READER_STRING) {
+        if (strcmp(path, "channel") == 0) {
+            JsonReader_copy(info->name, sizeof(info->name), value, len);
+        } else if (strcmp(path, "channel_url") == 0) {
+            JsonReader_copy(info->channel_url, sizeof(info->channel_url), value, len);
+        } else if (strcmp(path, "channel_id") == 0) {
+            JsonReader_copy(info->channel_id_str, sizeof(info->channel_id_str), value, len);
+        }
+    } else if (event == JSON_READER_NUMBER && strcmp(path, "channel_follower_count") == 0) {
+        p->follower_count = atof(value);
+    }
+    return !p->op->cancel;
+}
+
 // Background thread: fetch channel info via yt-dlp JSON
 static void* channel_info_thread_func(void* arg) {
     YouTubeChannelInfoOp* op = (YouTubeChannelInfoOp*)arg;
     PWR_pinToCores(CPU_CORE_EFFICIENCY);
 
-    // Step 1: Use yt-dlp to get video metadata JSON (includes channel info)
-    const char* temp_file = "/tmp/yt_channel_info.json";
+    // Step 1: Stream yt-dlp video metadata JSON (includes channel info) straight
+    // from the pipe; only the handful of channel fields are kept
     char cmd[1024];
     snprintf(cmd, sizeof(cmd),
         YTDLP_BIN " -j --no-warnings --socket-timeout 15"
-        " \"https://www.youtube.com/watch?v=%s\" > %s 2>/dev/null",
-        op->video_id, temp_file);
+        " \"https://www.youtube.com/watch?v=%s\" 2>/dev/null",
+        op->video_id);
 
     LOG_info("yt-dlp channel info: %s\n", cmd);
 
-    int ret = system(cmd);
-
-    if (op->cancel) {
-        unlink(temp_file);
-        op->state = YT_OP_IDLE;
-        return NULL;
-    }
-
-    if (ret != 0) {
+    FILE* pipe = popen(cmd, "r");
+    if (!pipe) {
         snprintf(op->error, sizeof(op->error), "Failed to fetch channel info");
-        unlink(temp_file);
-        op->state = YT_OP_ERROR;
-        return NULL;
-    }
-
-    // Step 2: Read and parse JSON
-    FILE* f = fopen(temp_file, "r");
-    if (!f) {
-        snprintf(op->error, sizeof(op->error), "Failed to read channel info");
         op->state = YT_OP_ERROR;
         return NULL;
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    ChannelInfoParse parse = {op, 0, false};
+    bool parsed = JsonReader_parseStream(pipe, channel_info_json_cb, &parse);
+    int ret = pclose(pipe);
 
-    if (size <= 0 || size > 2 * 1024 * 1024) {
-        fclose(f);
-        unlink(temp_file);
-        snprintf(op->error, sizeof(op->error), "Invalid channel info data");
-        op->state = YT_OP_ERROR;
+    if (op->cancel) {
+        op->state = YT_OP_IDLE;
         return NULL;
     }
 
-    char* buf = malloc(size + 1);
-    if (!buf) {
-        fclose(f);
-        unlink(temp_file);
-        snprintf(op->error, sizeof(op->error), "Out of memory");
+    if (ret != 0) {
+        snprintf(op->error, sizeof(op->error), "Failed to fetch channel info");
         op->state = YT_OP_ERROR;
         return NULL;
     }
 
-    fread(buf, 1, size, f);
-    buf[size] = '\0';
-    fclose(f);
-    unlink(temp_file);
-
-    if (op->cancel) {
-        free(buf);
-        op->state = YT_OP_IDLE;
-        return NULL;
-    }
-
-    JSON_Value* root = json_parse_string(buf);
-    free(buf);
-
-    if (!root) {
+    if (!parsed) {
         snprintf(op->error, sizeof(op->error), "Failed to parse channel info");
         op->state = YT_OP_ERROR;
         return NULL;
     }
 
-    JSON_Object* obj = json_value_get_object(root);
-    if (!obj) {
-        json_value_free(root);
+    if (!parse.has_root) {
         snprintf(op->error, sizeof(op->error), "Invalid channel info format");
         op->state = YT_OP_ERROR;
         return NULL;
     }
 
-    // Extract channel name
-    const char* channel = json_object_get_string(obj, "channel");
-    if (channel) {
-        strncpy(op->info.name, channel, sizeof(op->info.name) - 1);
-        op->info.name[sizeof(op->info.name) - 1] = '\0';
-    }
-
-    // Extract subscriber count
-    double follower_count = json_object_get_number(obj, "channel_follower_count");
+    // Step 2: Format subscriber count
+    double follower_count = parse.follower_count;
     if (follower_count > 0) {
         if (follower_count >= 1000000) {
             snprintf(op->info.subscriber_count, sizeof(op->info.subscriber_count),
@@ -605,25 +591,8 @@ static void* channel_info_thread_func(void* arg) {
         strncpy(op->info.subscriber_count, "Subscribers hidden", sizeof(op->info.subscriber_count) - 1);
     }
 
-    // Extract channel URL for avatar fetch (copy before freeing JSON)
-    char channel_url_buf[512] = {0};
-    const char* channel_url_raw = json_object_get_string(obj, "channel_url");
-    if (channel_url_raw) {
-        strncpy(channel_url_buf, channel_url_raw, sizeof(channel_url_buf) - 1);
-        strncpy(op->info.channel_url, channel_url_raw, sizeof(op->info.channel_url) - 1);
-    }
-    const char* ch_id_raw = json_object_get_string(obj, "channel_id");
-    if (ch_id_raw) {
-        strncpy(op->info.channel_id_str, ch_id_raw, sizeof(op->info.channel_id_str) - 1);
-    }
-    const char* channel_url = channel_url_buf;
-
-    json_value_free(root);
-
-    if (op->cancel) {
-        op->state = YT_OP_IDLE;
-        return NULL;
-    }
+    // Channel URL for avatar fetch
+    const char* channel_url = op->info.channel_url;
 
     // Step 3: Try to download channel avatar via thumbnail URL
     // YouTube channel avatars follow a pattern: use uploader_id or channel_id
@@ -849,72 +818,196 @@ void YouTube_cancelUploads(void) {
     }
 }
 
-void YouTube_saveVideosCache(const char* channel_id, YouTubeSearchResults* results) {
-    char dir[512], path[512];
-    if (!Subscriptions_getChannelDir(channel_id, dir, sizeof(dir))) return;
-    if (!Subscriptions_getVideosPath(channel_id, path, sizeof(path))) return;
+// Binary per-channel video cache (videos.bin)
+// Layout: header | entries[count] | string blob of NUL-terminated UTF-8 strings.
+// String offsets are relative to the blob. Native (little-endian) byte order;
+// the file is mmap'ed and read in place, no parsing.
+#define VIDEOS_CACHE_MAGIC 0x43565056   // "VPVC"
+#define VIDEOS_CACHE_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t blob_size;
+    uint32_t checksum;      // crc32 of entries + blob
+    uint32_t reserved;
+} VideosCacheHeader;
+
+typedef struct {
+    uint32_t id_off;
+    uint32_t title_off;
+    uint32_t channel_off;
+    int32_t duration_sec;
+} VideosCacheEntry;
+
+static uint32_t blob_put(char* blob, uint32_t* blob_len, const char* str) {
+    uint32_t off = *blob_len;
+    size_t len = strlen(str) + 1;
+    memcpy(blob + off, str, len);
+    *blob_len += (uint32_t)len;
+    return off;
+}
+
+bool YouTube_saveVideosCache(const char* channel_id, YouTubeSearchResults* results) {
+    char dir[512], path[512], tmp_path[520];
+    if (!Subscriptions_getChannelDir(channel_id, dir, sizeof(dir))) return false;
+    if (!Subscriptions_getVideosPath(channel_id, path, sizeof(path))) return false;
     mkdir(APP_DATA_DIR, 0755);
     mkdir(APP_YOUTUBE_DIR, 0755);
     mkdir(dir, 0755);
 
-    JSON_Value* root = json_value_init_array();
-    JSON_Array* arr = json_value_get_array(root);
-    for (int i = 0; i < results->count; i++) {
-        JSON_Value* item = json_value_init_object();
-        JSON_Object* obj = json_value_get_object(item);
-        json_object_set_string(obj, "id", results->items[i].id);
-        json_object_set_string(obj, "title", results->items[i].title);
-        json_object_set_string(obj, "channel", results->items[i].channel);
-        json_object_set_number(obj, "duration", results->items[i].duration_sec);
-        json_array_append_value(arr, item);
+    int count = results->count;
+    if (count < 0) count = 0;
+    if (count > YT_MAX_RESULTS) count = YT_MAX_RESULTS;
+
+    size_t blob_max = 0;
+    for (int i = 0; i < count; i++) {
+        blob_max += strlen(results->items[i].id) + strlen(results->items[i].title) +
+                    strlen(results->items[i].channel) + 3;
+    }
+    size_t table_size = sizeof(VideosCacheEntry) * count;
+    uint8_t* buf = malloc(sizeof(VideosCacheHeader) + table_size + blob_max);
+    if (!buf) return false;
+
+    VideosCacheHeader* hdr = (VideosCacheHeader*)buf;
+    VideosCacheEntry* entries = (VideosCacheEntry*)(buf + sizeof(VideosCacheHeader));
+    char* blob = (char*)(buf + sizeof(VideosCacheHeader) + table_size);
+    uint32_t blob_len = 0;
+
+    for (int i = 0; i < count; i++) {
+        const YouTubeResult* r = &results->items[i];
+        entries[i].id_off = blob_put(blob, &blob_len, r->id);
+        entries[i].title_off = blob_put(blob, &blob_len, r->title);
+        entries[i].channel_off = blob_put(blob, &blob_len, r->channel);
+        entries[i].duration_sec = r->duration_sec;
+    }
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = VIDEOS_CACHE_MAGIC;
+    hdr->version = VIDEOS_CACHE_VERSION;
+    hdr->count = (uint32_t)count;
+    hdr->blob_size = blob_len;
+    hdr->checksum = (uint32_t)crc32(0L, (const Bytef*)entries, (uInt)(table_size + blob_len));
+
+    // Write to a temp file and rename so a crash never leaves a torn cache
+    size_t total = sizeof(VideosCacheHeader) + table_size + blob_len;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) { free(buf); return false; }
+    bool ok = write(fd, buf, total) == (ssize_t)total;
+    if (ok) ok = fsync(fd) == 0;
+    close(fd);
+    free(buf);
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        LOG_error("Failed to write videos cache: %s\n", path);
+        unlink(tmp_path);
+        return false;
     }
-    json_serialize_to_file_pretty(root, path);
-    json_value_free(root);
+    return true;
 }
 
-int YouTube_loadVideosCache(const char* channel_id, YouTubeSearchResults* results) {
-    char path[512];
-    if (!Subscriptions_getVideosPath(channel_id, path, sizeof(path))) return 0;
-    memset(results, 0, sizeof(*results));
+// Map videos.bin and copy entries out; returns -1 if missing or invalid
+static int load_videos_cache_bin(const char* path, YouTubeSearchResults* results) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
 
-    FILE* fp = fopen(path, "r");
-    if (!fp) return 0;
-    fseek(fp, 0, SEEK_END);
-    long size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    if (size <= 0 || size > 512 * 1024) { fclose(fp); return 0; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(VideosCacheHeader)) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    int result = -1;
+    const VideosCacheHeader* hdr = (const VideosCacheHeader*)map;
+    size_t table_size = (size_t)hdr->count * sizeof(VideosCacheEntry);
+
+    if (hdr->magic == VIDEOS_CACHE_MAGIC && hdr->version == VIDEOS_CACHE_VERSION &&
+        hdr->count <= YT_MAX_RESULTS &&
+        sizeof(VideosCacheHeader) + table_size + hdr->blob_size == size &&
+        (hdr->blob_size == 0 || map[size - 1] == '\0')) {
+
+        const VideosCacheEntry* entries = (const VideosCacheEntry*)(map + sizeof(VideosCacheHeader));
+        const char* blob = (const char*)entries + table_size;
+        uint32_t crc = (uint32_t)crc32(0L, (const Bytef*)entries, (uInt)(table_size + hdr->blob_size));
+
+        if (crc == hdr->checksum) {
+            result = 0;
+            for (uint32_t i = 0; i < hdr->count; i++) {
+                const VideosCacheEntry* e = &entries[i];
+                if (e->id_off >= hdr->blob_size || e->title_off >= hdr->blob_size ||
+                    e->channel_off >= hdr->blob_size) {
+                    result = -1;
+                    break;
+                }
+                YouTubeResult* r = &results->items[results->count];
+                strncpy(r->id, blob + e->id_off, YT_MAX_ID - 1);
+                strncpy(r->title, blob + e->title_off, YT_MAX_TITLE - 1);
+                strncpy(r->channel, blob + e->channel_off, YT_MAX_CHANNEL - 1);
+                r->duration_sec = e->duration_sec;
+                if (r->id[0]) results->count++;
+            }
+        }
+    }
 
-    char* buf = malloc(size + 1);
-    if (!buf) { fclose(fp); return 0; }
-    fread(buf, 1, size, fp);
-    buf[size] = '\0';
-    fclose(fp);
+    munmap((void*)map, size);
+    if (result < 0) {
+        LOG_error("Discarding invalid videos cache: %s\n", path);
+        memset(results, 0, sizeof(*results));
+        return -1;
+    }
+    return results->count;
+}
 
-    JSON_Value* root = json_parse_string(buf);
-    free(buf);
-    if (!root) return 0;
+// Streaming parse of legacy videos.json: [{"id","title","channel","duration"}, ...]
+static bool videos_cache_json_cb(void* userdata, JsonReaderEvent event,
+                                 const char* path, const char* value, int len) {
+    YouTubeSearchResults* results = (YouTubeSearchResults*)userdata;
+    if (results->count >= YT_MAX_RESULTS) return false;
+    YouTubeResult* r = &results->items[results->count];
+
+    if (strcmp(path, "[]") == 0) {
+        if (event == JSON_READER_OBJECT_START) {
+            memset(r, 0, sizeof(*r));
+        } else if (event == JSON_READER_OBJECT_END && r->id[0]) {
+            results->count++;
+        }
+    } else if (event == JSON_READER_STRING) {
+        if (strcmp(path, "[].id") == 0) JsonReader_copy(r->id, YT_MAX_ID, value, len);
+        else if (strcmp(path, "[].title") == 0) JsonReader_copy(r->title, YT_MAX_TITLE, value, len);
+        else if (strcmp(path, "[].channel") == 0) JsonReader_copy(r->channel, YT_MAX_CHANNEL, value, len);
+    } else if (event == JSON_READER_NUMBER && strcmp(path, "[].duration") == 0) {
+        r->duration_sec = atoi(value);
+    }
+    return true;
+}
 
-    JSON_Array* arr = json_value_get_array(root);
-    if (!arr) { json_value_free(root); return 0; }
+int YouTube_loadVideosCache(const char* channel_id, YouTubeSearchResults* results) {
+    char path[512], legacy_path[512];
+    if (!Subscriptions_getVideosPath(channel_id, path, sizeof(path))) return 0;
+    memset(results, 0, sizeof(*results));
 
-    int count = (int)json_array_get_count(arr);
-    if (count > YT_MAX_RESULTS) count = YT_MAX_RESULTS;
+    int count = load_videos_cache_bin(path, results);
+    if (count >= 0) return count;
 
-    for (int i = 0; i < count; i++) {
-        JSON_Object* obj = json_array_get_object(arr, i);
-        if (!obj) continue;
-        YouTubeResult* r = &results->items[results->count];
-        const char* id = json_object_get_string(obj, "id");
-        const char* title = json_object_get_string(obj, "title");
-        const char* channel = json_object_get_string(obj, "channel");
-        if (!id || !id[0]) continue;
-        strncpy(r->id, id, YT_MAX_ID - 1);
-        if (title) strncpy(r->title, title, YT_MAX_TITLE - 1);
-        if (channel) strncpy(r->channel, channel, YT_MAX_CHANNEL - 1);
-        r->duration_sec = (int)json_object_get_number(obj, "duration");
-        results->count++;
+    // One-time migration from the old pretty-printed videos.json
+    if (!Subscriptions_getLegacyVideosPath(channel_id, legacy_path, sizeof(legacy_path))) return 0;
+    if (!JsonReader_parseFile(legacy_path, videos_cache_json_cb, results)) {
+        memset(results, 0, sizeof(*results));
+        return 0;
+    }
+    if (results->count > 0) {
+        // Keep the JSON until the binary cache is safely written, or nothing is left
+        if (YouTube_saveVideosCache(channel_id, results)) {
+            unlink(legacy_path);
+            LOG_info("Migrated videos cache to binary: %s\n", path);
+        }
     }
-    json_value_free(root);
     return results->count;
 }
 
@@ -141,8 +141,8 @@ void YouTube_fetchUploadsAsync(const char* channel_url, const char* channel_id);
 YouTubeUploadsOp* YouTube_getUploadsOp(void);
 void YouTube_cancelUploads(void);
 
-// Save/load cached videos for a channel
-void YouTube_saveVideosCache(const char* channel_id, YouTubeSearchResults* results);
+// Save/load cached videos for a channel (save returns false if nothing was written)
+bool YouTube_saveVideosCache(const char* channel_id, YouTubeSearchResults* results);
 int YouTube_loadVideosCache(const char* channel_id, YouTubeSearchResults* results);
 
 // Per-channel thumbnail management